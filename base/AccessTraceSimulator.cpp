@@ -0,0 +1,153 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#include "AccessTraceSimulator.h"
+
+#include <list>
+#include <algorithm>
+
+using namespace std;
+
+namespace {
+
+// One simulated cache, holding (channel, unit) keys with the most
+// recently inserted (or, for LRU, used) at the front
+class SimulatedCache
+{
+public:
+    typedef pair<int, int64_t> Key;
+
+    SimulatedCache(bool lru, int capacity) :
+        m_lru(lru), m_capacity(capacity) { }
+
+    bool access(const Key &key) {
+        auto itr = m_index.find(key);
+        if (itr != m_index.end()) {
+            if (m_lru) {
+                m_order.splice(m_order.begin(), m_order, itr->second);
+            }
+            return true;
+        }
+        if (m_capacity <= 0) {
+            return false;
+        }
+        m_order.push_front(key);
+        m_index[key] = m_order.begin();
+        if (int(m_order.size()) > m_capacity) {
+            m_index.erase(m_order.back());
+            m_order.pop_back();
+        }
+        return false;
+    }
+
+private:
+    bool m_lru;
+    int m_capacity;
+    list<Key> m_order;
+    map<Key, list<Key>::iterator> m_index;
+};
+
+bool
+isColumnSource(uint8_t source)
+{
+    return source == AccessTracer::FFTColumn ||
+        source == AccessTracer::PeakCacheColumn;
+}
+
+}
+
+AccessTraceSimulator::AccessTraceSimulator(Policy policy, int capacity,
+                                           int frameBlockSize) :
+    m_policy(policy),
+    m_capacity(capacity),
+    m_frameBlockSize(std::max(frameBlockSize, 1))
+{
+}
+
+AccessTraceSimulator::ResultMap
+AccessTraceSimulator::replay(const vector<AccessTracer::Record> &records) const
+{
+    ResultMap results;
+    map<pair<uint8_t, uint64_t>, SimulatedCache> caches;
+
+    for (const auto &r: records) {
+
+        if (r.count <= 0) continue;
+
+        auto source = AccessTracer::Source(r.source);
+        auto key = make_pair(r.source, r.object);
+        auto citr = caches.find(key);
+        if (citr == caches.end()) {
+            citr = caches.insert
+                ({ key, SimulatedCache(m_policy == LRU, m_capacity) }).first;
+        }
+
+        int64_t first = r.start, last = r.start + r.count - 1;
+        if (!isColumnSource(r.source)) {
+            // Round towards negative infinity, as frame ranges may
+            // start before zero
+            auto block = [&](int64_t f) {
+                return f >= 0 ? f / m_frameBlockSize :
+                    -((-f - 1) / m_frameBlockSize) - 1;
+            };
+            first = block(first);
+            last = block(last);
+        }
+
+        Result &result = results[source];
+        for (int64_t unit = first; unit <= last; ++unit) {
+            if (citr->second.access({ r.channel, unit })) {
+                ++result.hits;
+            } else {
+                ++result.misses;
+            }
+        }
+    }
+
+    return results;
+}
+
+AccessTraceSimulator::ResultMap
+AccessTraceSimulator::getRecordedResults
+(const vector<AccessTracer::Record> &records)
+{
+    ResultMap results;
+
+    for (const auto &r: records) {
+        auto source = AccessTracer::Source(r.source);
+        switch (r.outcome) {
+        case AccessTracer::Hit:
+            ++results[source].hits;
+            break;
+        case AccessTracer::Partial:
+        case AccessTracer::Miss:
+            ++results[source].misses;
+            break;
+        default:
+            break;
+        }
+    }
+
+    return results;
+}
+
+QString
+AccessTraceSimulator::getPolicyName(Policy policy)
+{
+    switch (policy) {
+    case LRU: return "LRU";
+    case FIFO: return "FIFO";
+    }
+    return "unknown";
+}
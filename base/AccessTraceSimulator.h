@@ -0,0 +1,81 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef SV_ACCESS_TRACE_SIMULATOR_H
+#define SV_ACCESS_TRACE_SIMULATOR_H
+
+#include "AccessTracer.h"
+
+#include <vector>
+#include <map>
+
+/**
+ * Replay a trace recorded by AccessTracer against a simulated cache
+ * of a given size and replacement policy, to estimate the hit rate
+ * that cache would have had for the same workload.
+ *
+ * Each object in the trace (each model or file reader) is given its
+ * own simulated cache of the same capacity, as the real caches are
+ * per-object. The capacity is measured in units: one column for the
+ * column sources, and one block of frameBlockSize frames (of one
+ * channel, or of all channels if the record has no channel) for the
+ * frame sources. A record covering several units counts a hit or
+ * miss for each of them.
+ */
+class AccessTraceSimulator
+{
+public:
+    enum Policy {
+        LRU,
+        FIFO
+    };
+
+    AccessTraceSimulator(Policy policy, int capacity,
+                         int frameBlockSize = 1024);
+
+    struct Result {
+        Result() : hits(0), misses(0) { }
+        int64_t hits;
+        int64_t misses;
+        double getHitRate() const {
+            int64_t total = hits + misses;
+            return total > 0 ? double(hits) / double(total) : 0.0;
+        }
+    };
+
+    typedef std::map<AccessTracer::Source, Result> ResultMap;
+
+    /**
+     * Replay the given records, in order, against empty caches and
+     * return the hits and misses for each source.
+     */
+    ResultMap replay(const std::vector<AccessTracer::Record> &records) const;
+
+    /**
+     * Return the hit and miss counts recorded in the trace itself,
+     * for comparison. Partial hits are counted as misses, and records
+     * with unknown outcome are not counted.
+     */
+    static ResultMap getRecordedResults
+    (const std::vector<AccessTracer::Record> &records);
+
+    static QString getPolicyName(Policy policy);
+
+private:
+    Policy m_policy;
+    int m_capacity;
+    int m_frameBlockSize;
+};
+
+#endif
@@ -0,0 +1,365 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#include "AccessTracer.h"
+
+#include "Debug.h"
+
+#include "system/System.h"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+
+static const char traceMagic[8] = { 'S', 'V', 'T', 'R', 'A', 'C', 'E', 0 };
+static const uint32_t traceVersion = 1;
+
+// Records per thread ring buffer. The writer is woken when a ring is
+// half full, and otherwise empties the rings at a regular interval
+static const uint64_t ringRecords = 4096;
+static const chrono::milliseconds writerInterval(100);
+
+std::atomic<int> AccessTracer::m_state(-1);
+
+/**
+ * A ring of records pushed by a single thread and taken by the
+ * writer thread. The counts only ever increase, and the ring index
+ * is the count modulo its size.
+ */
+struct AccessTracer::ThreadBuffer
+{
+    ThreadBuffer(uint32_t t) :
+        thread(t), records(ringRecords),
+        pushed(0), taken(0), busy(false), retired(false) { }
+
+    const uint32_t thread; // serial number of the owning thread
+    vector<Record> records;
+    atomic<uint64_t> pushed; // written by the owning thread
+    atomic<uint64_t> taken;  // written by the writer thread
+    atomic<bool> busy;       // owning thread is between check and push
+    atomic<bool> retired;    // owning thread has exited
+};
+
+AccessTracer *
+AccessTracer::getInstance()
+{
+    static AccessTracer instance;
+    return &instance;
+}
+
+AccessTracer::AccessTracer() :
+    m_writerWake(false),
+    m_writerExiting(false)
+{
+}
+
+AccessTracer::~AccessTracer()
+{
+    stop();
+}
+
+bool
+AccessTracer::checkEnvironment()
+{
+    static std::once_flag flag;
+    std::call_once(flag, []() {
+            std::string path;
+            if (getEnvUtf8("SV_ACCESS_TRACE", path) && path != "") {
+                getInstance()->start(QString::fromStdString(path));
+            }
+            int unchecked = -1;
+            m_state.compare_exchange_strong(unchecked, 0);
+        });
+    return m_state.load() > 0;
+}
+
+bool
+AccessTracer::start(QString path)
+{
+    stop();
+
+    lock_guard<mutex> locker(m_mutex);
+
+    m_file.setFileName(path);
+    if (!m_file.open(QFile::WriteOnly | QFile::Truncate)) {
+        SVCERR << "WARNING: AccessTracer::start: Failed to open trace file \""
+               << path << "\" for writing" << endl;
+        return false;
+    }
+
+    uint32_t recordSize = sizeof(Record);
+    m_file.write(traceMagic, sizeof(traceMagic));
+    m_file.write(reinterpret_cast<const char *>(&traceVersion),
+                 sizeof(traceVersion));
+    m_file.write(reinterpret_cast<const char *>(&recordSize),
+                 sizeof(recordSize));
+
+    SVDEBUG << "AccessTracer: Writing access trace to \"" << path
+            << "\"" << endl;
+
+    m_origin = chrono::steady_clock::now();
+    m_writerWake = false;
+    m_writerExiting = false;
+    m_writer = thread([this]() { writerLoop(); });
+    m_state = 1;
+    return true;
+}
+
+void
+AccessTracer::stop()
+{
+    lock_guard<mutex> locker(m_mutex);
+
+    if (!m_writer.joinable()) {
+        return;
+    }
+
+    m_state = 0;
+
+    // Any thread that saw tracing as active before it stopped must
+    // finish its push before the writer takes the last records
+    {
+        lock_guard<mutex> bufferLocker(m_buffersMutex);
+        for (const auto &b: m_buffers) {
+            while (b->busy) {
+                this_thread::yield();
+            }
+        }
+    }
+
+    {
+        lock_guard<mutex> writerLocker(m_writerMutex);
+        m_writerExiting = true;
+    }
+    m_writerCondition.notify_one();
+    m_writer.join();
+
+    m_file.close();
+}
+
+AccessTracer::ThreadBuffer *
+AccessTracer::getThreadBuffer()
+{
+    // Owned jointly by the thread and the tracer, which drops it
+    // once the thread has exited and its records have been taken
+    struct Owner {
+        shared_ptr<ThreadBuffer> buffer;
+        ~Owner() {
+            if (buffer) buffer->retired = true;
+        }
+    };
+    static atomic<uint32_t> threadCount(0);
+    thread_local Owner owner;
+
+    if (!owner.buffer) {
+        owner.buffer = make_shared<ThreadBuffer>(++threadCount);
+        lock_guard<mutex> locker(m_buffersMutex);
+        m_buffers.push_back(owner.buffer);
+    }
+    return owner.buffer.get();
+}
+
+void
+AccessTracer::append(Source source, uint64_t object, int channel,
+                     int64_t start, int64_t count, Outcome outcome)
+{
+    ThreadBuffer *b = getThreadBuffer();
+
+    b->busy = true;
+
+    // Checked again now that we are busy, in case of a stop()
+    if (m_state <= 0) {
+        b->busy = false;
+        return;
+    }
+
+    Record r;
+    r.time = uint64_t(chrono::duration_cast<chrono::nanoseconds>
+                      (chrono::steady_clock::now() - m_origin).count());
+    r.object = object;
+    r.start = start;
+    r.count = count;
+    r.thread = b->thread;
+    r.channel = int16_t(channel);
+    r.source = source;
+    r.outcome = outcome;
+
+    uint64_t pushed = b->pushed.load(memory_order_relaxed);
+    uint64_t used = pushed - b->taken.load(memory_order_acquire);
+
+    while (used >= ringRecords) {
+        // The writer has fallen behind: wait for it rather than lose
+        // records, unless tracing stops meanwhile
+        wakeWriter();
+        this_thread::yield();
+        if (m_state <= 0) {
+            b->busy = false;
+            return;
+        }
+        used = pushed - b->taken.load(memory_order_acquire);
+    }
+
+    b->records[pushed % ringRecords] = r;
+    b->pushed.store(pushed + 1, memory_order_release);
+    b->busy = false;
+
+    if (used + 1 == ringRecords / 2) {
+        wakeWriter();
+    }
+}
+
+void
+AccessTracer::wakeWriter()
+{
+    {
+        lock_guard<mutex> locker(m_writerMutex);
+        m_writerWake = true;
+    }
+    m_writerCondition.notify_one();
+}
+
+void
+AccessTracer::writerLoop()
+{
+    vector<Record> records;
+
+    unique_lock<mutex> locker(m_writerMutex);
+
+    while (true) {
+
+        m_writerCondition.wait_for(locker, writerInterval, [this]() {
+                return m_writerWake || m_writerExiting;
+            });
+        
+        bool exiting = m_writerExiting;
+        m_writerWake = false;
+        locker.unlock();
+
+        drain(records);
+        write(records);
+        records.clear();
+
+        locker.lock();
+        if (exiting) {
+            break;
+        }
+    }
+}
+
+void
+AccessTracer::drain(vector<Record> &records)
+{
+    lock_guard<mutex> locker(m_buffersMutex);
+
+    for (const auto &b: m_buffers) {
+        uint64_t pushed = b->pushed.load(memory_order_acquire);
+        uint64_t taken = b->taken.load(memory_order_relaxed);
+        for (uint64_t i = taken; i < pushed; ++i) {
+            records.push_back(b->records[i % ringRecords]);
+        }
+        b->taken.store(pushed, memory_order_release);
+    }
+
+    // A retired thread pushes no more, so once its records have been
+    // taken its buffer can go
+    m_buffers.erase
+        (remove_if(m_buffers.begin(), m_buffers.end(),
+                   [](const shared_ptr<ThreadBuffer> &b) {
+                       return b->retired &&
+                           b->taken == b->pushed;
+                   }),
+         m_buffers.end());
+}
+
+void
+AccessTracer::write(const vector<Record> &records)
+{
+    if (records.empty() || !m_file.isOpen()) {
+        return;
+    }
+    qint64 bytes = qint64(records.size() * sizeof(Record));
+    if (m_file.write(reinterpret_cast<const char *>(records.data()), bytes)
+        != bytes) {
+        SVCERR << "WARNING: AccessTracer::write: Failed to write to trace file, stopping trace" << endl;
+        m_state = 0;
+        m_file.close();
+    }
+}
+
+bool
+AccessTracer::readTrace(QString path, vector<Record> &records)
+{
+    records.clear();
+
+    QFile file(path);
+    if (!file.open(QFile::ReadOnly)) {
+        SVCERR << "AccessTracer::readTrace: Failed to open trace file \""
+               << path << "\"" << endl;
+        return false;
+    }
+
+    char magic[sizeof(traceMagic)];
+    uint32_t version = 0, recordSize = 0;
+    if (file.read(magic, sizeof(magic)) != qint64(sizeof(magic)) ||
+        memcmp(magic, traceMagic, sizeof(magic)) != 0 ||
+        file.read(reinterpret_cast<char *>(&version), sizeof(version))
+        != qint64(sizeof(version)) ||
+        file.read(reinterpret_cast<char *>(&recordSize), sizeof(recordSize))
+        != qint64(sizeof(recordSize))) {
+        SVCERR << "AccessTracer::readTrace: File \"" << path
+               << "\" is not an access trace" << endl;
+        return false;
+    }
+
+    if (version != traceVersion || recordSize != sizeof(Record)) {
+        SVCERR << "AccessTracer::readTrace: Trace file \"" << path
+               << "\" has unsupported version " << version
+               << " or record size " << recordSize << endl;
+        return false;
+    }
+
+    qint64 available = file.size() - file.pos();
+    size_t n = size_t(available) / sizeof(Record);
+    records.resize(n);
+    qint64 bytes = qint64(n * sizeof(Record));
+    if (file.read(reinterpret_cast<char *>(records.data()), bytes) != bytes) {
+        SVCERR << "AccessTracer::readTrace: Failed to read records from \""
+               << path << "\"" << endl;
+        records.clear();
+        return false;
+    }
+
+    // Each thread's records are written in order, but those of
+    // different threads are interleaved only as closely as the
+    // writer happened to empty their buffers
+    stable_sort(records.begin(), records.end(),
+                [](const Record &a, const Record &b) {
+                    return a.time < b.time;
+                });
+
+    return true;
+}
+
+QString
+AccessTracer::getSourceName(Source source)
+{
+    switch (source) {
+    case AudioFileRead: return "audio-file-read";
+    case FFTColumn: return "fft-column";
+    case PeakCacheColumn: return "peak-cache-column";
+    case RangeSummary: return "range-summary";
+    }
+    return "unknown";
+}
@@ -0,0 +1,168 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef SV_ACCESS_TRACER_H
+#define SV_ACCESS_TRACER_H
+
+#include <QString>
+#include <QFile>
+
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+
+/**
+ * Opt-in recorder of data accesses, for tuning caches. When active,
+ * instrumented code (audio file readers, FFT and peak-cache models,
+ * wave-file summaries) pushes a compact fixed-size record of each
+ * request into a lock-free ring buffer belonging to the calling
+ * thread. A writer thread empties the rings and writes the records
+ * to the trace file, so the caller neither locks nor waits for file
+ * I/O, unless it records faster than the writer can keep up with and
+ * its ring fills. The resulting trace can be replayed against
+ * simulated caches of other sizes and policies using
+ * AccessTraceSimulator.
+ *
+ * Tracing is off unless start() is called, or the environment
+ * variable SV_ACCESS_TRACE is set to the path of a file to write (in
+ * which case tracing starts at the first instrumented access). When
+ * it is off, the cost of an instrumented access is a single relaxed
+ * atomic load.
+ *
+ * The trace file consists of an 8-byte magic string "SVTRACE" and a
+ * NUL, a 32-bit version, a 32-bit record size, and then the records
+ * themselves, all in native byte order.
+ *
+ * This class is a singleton, and is thread-safe.
+ */
+class AccessTracer
+{
+public:
+    enum Source : uint8_t {
+        AudioFileRead = 1,      // AudioFileReader; range in frames
+        FFTColumn = 2,          // FFTModel; range in columns
+        PeakCacheColumn = 3,    // Dense3DModelPeakCache; range in columns
+        RangeSummary = 4        // Wave-file model summaries; range in frames
+    };
+
+    enum Outcome : uint8_t {
+        Unknown = 0,
+        Hit = 1,
+        Partial = 2,
+        Miss = 3
+    };
+
+    struct Record {
+        uint64_t time;      // nanoseconds since tracing started
+        uint64_t object;    // model id, or address of a non-model
+        int64_t start;      // first frame or column
+        int64_t count;      // number of frames or columns
+        uint32_t thread;    // serial number of the requesting thread
+        int16_t channel;    // -1 if all channels or not applicable
+        uint8_t source;     // a Source
+        uint8_t outcome;    // an Outcome
+    };
+
+    static AccessTracer *getInstance();
+
+    /**
+     * Return true if tracing is active.
+     */
+    static bool isActive() {
+        int state = m_state.load(std::memory_order_relaxed);
+        if (state < 0) {
+            return checkEnvironment();
+        }
+        return state > 0;
+    }
+
+    /**
+     * Record an access, if tracing is active.
+     */
+    static void record(Source source, uint64_t object, int channel,
+                       int64_t start, int64_t count,
+                       Outcome outcome = Unknown) {
+        if (isActive()) {
+            getInstance()->append(source, object, channel,
+                                  start, count, outcome);
+        }
+    }
+
+    /**
+     * Start writing a trace to the given file, replacing it if it
+     * exists. If a trace is already being written, it is finished
+     * first. Return false if the file could not be opened.
+     */
+    bool start(QString path);
+
+    /**
+     * Stop tracing, and write out any records that have not yet
+     * been written.
+     */
+    void stop();
+
+    /**
+     * Read the trace in the given file into records, in time
+     * order. Return false if the file could not be read or is not a
+     * trace from a compatible version.
+     */
+    static bool readTrace(QString path, std::vector<Record> &records);
+
+    static QString getSourceName(Source source);
+
+private:
+    AccessTracer();
+    ~AccessTracer();
+
+    AccessTracer(const AccessTracer &) =delete;
+    AccessTracer &operator=(const AccessTracer &) =delete;
+
+    // -1 if the environment has not been checked yet, otherwise 1
+    // if tracing is active and 0 if it is not
+    static std::atomic<int> m_state;
+
+    static bool checkEnvironment();
+
+    struct ThreadBuffer;
+    ThreadBuffer *getThreadBuffer();
+
+    std::mutex m_mutex; // serialises start and stop
+    std::mutex m_buffersMutex;
+    std::vector<std::shared_ptr<ThreadBuffer>> m_buffers;
+    QFile m_file;
+    std::chrono::steady_clock::time_point m_origin;
+
+    std::thread m_writer;
+    std::mutex m_writerMutex;
+    std::condition_variable m_writerCondition;
+    bool m_writerWake;
+    bool m_writerExiting;
+
+    void append(Source source, uint64_t object, int channel,
+                int64_t start, int64_t count, Outcome outcome);
+
+    void wakeWriter();
+    void writerLoop();
+
+    // Called from the writer thread only
+    void drain(std::vector<Record> &records);
+    void write(const std::vector<Record> &records);
+};
+
+#endif
@@ -0,0 +1,173 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#include "CPUFeatures.h"
+
+#include "Debug.h"
+#include "system/System.h"
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#endif
+
+using std::string;
+
+std::atomic<int> CPUFeatures::m_forced(-1);
+std::atomic<int> CPUFeatures::m_generation(0);
+
+static bool
+supportedBy(CPUFeatures::ISA isa, CPUFeatures::ISA detected)
+{
+    typedef CPUFeatures::ISA ISA;
+    if (isa == ISA::Scalar) return true;
+    if (isa == ISA::NEON || detected == ISA::NEON) return isa == detected;
+    return int(isa) <= int(detected);
+}
+
+CPUFeatures::ISA
+CPUFeatures::detect()
+{
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) return ISA::AVX512;
+    if (__builtin_cpu_supports("avx2") &&
+        __builtin_cpu_supports("fma")) return ISA::AVX2;
+    if (__builtin_cpu_supports("sse2")) return ISA::SSE2;
+    return ISA::Scalar;
+
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+
+    int info[4];
+    __cpuid(info, 0);
+    int maxLeaf = info[0];
+
+    __cpuid(info, 1);
+    bool sse2 = (info[3] & (1 << 26)) != 0;
+    bool fma = (info[2] & (1 << 12)) != 0;
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+
+    bool avx2 = false, avx512 = false;
+
+    if (osxsave && maxLeaf >= 7) {
+        unsigned long long xcr0 = _xgetbv(0);
+        bool osYmm = (xcr0 & 0x6) == 0x6;
+        bool osZmm = (xcr0 & 0xe6) == 0xe6;
+        __cpuidex(info, 7, 0);
+        avx2 = osYmm && fma && (info[1] & (1 << 5)) != 0;
+        avx512 = osZmm && (info[1] & (1 << 16)) != 0;
+    }
+
+    if (avx512) return ISA::AVX512;
+    if (avx2) return ISA::AVX2;
+    if (sse2) return ISA::SSE2;
+    return ISA::Scalar;
+
+#elif defined(__aarch64__) || defined(_M_ARM64) || defined(__ARM_NEON)
+
+    // Advanced SIMD is mandatory on AArch64, and if we were compiled
+    // with NEON enabled on 32-bit ARM we can't run without it anyway
+    return ISA::NEON;
+
+#else
+
+    return ISA::Scalar;
+
+#endif
+}
+
+CPUFeatures::ISA
+CPUFeatures::getDetectedISA()
+{
+    static ISA detected = [] {
+        ISA isa = detect();
+        SVDEBUG << "CPUFeatures: Detected instruction set is "
+                << getISAName(isa) << endl;
+        string forced;
+        if (getEnvUtf8("SV_FORCE_ISA", forced) && forced != "") {
+            ISA f;
+            if (!getISAForName(forced, f)) {
+                SVCERR << "CPUFeatures: WARNING: Unknown instruction set \""
+                       << forced << "\" in SV_FORCE_ISA, ignoring it" << endl;
+            } else if (!supportedBy(f, isa)) {
+                SVCERR << "CPUFeatures: WARNING: Instruction set \""
+                       << forced << "\" in SV_FORCE_ISA is not supported "
+                       << "on this processor, ignoring it" << endl;
+            } else {
+                SVDEBUG << "CPUFeatures: Forcing instruction set "
+                        << getISAName(f) << " from environment" << endl;
+                m_forced = int(f);
+            }
+        }
+        return isa;
+    }();
+    return detected;
+}
+
+bool
+CPUFeatures::isSupported(ISA isa)
+{
+    return supportedBy(isa, getDetectedISA());
+}
+
+CPUFeatures::ISA
+CPUFeatures::getActiveISA()
+{
+    ISA detected = getDetectedISA();
+    int forced = m_forced;
+    if (forced >= 0) return ISA(forced);
+    return detected;
+}
+
+bool
+CPUFeatures::forceISA(ISA isa)
+{
+    if (!isSupported(isa)) return false;
+    m_forced = int(isa);
+    ++m_generation;
+    return true;
+}
+
+void
+CPUFeatures::clearForcedISA()
+{
+    (void)getDetectedISA(); // ensure the environment has been consulted
+    m_forced = -1;
+    ++m_generation;
+}
+
+string
+CPUFeatures::getISAName(ISA isa)
+{
+    switch (isa) {
+    case ISA::Scalar: return "scalar";
+    case ISA::SSE2: return "sse2";
+    case ISA::AVX2: return "avx2";
+    case ISA::AVX512: return "avx512";
+    case ISA::NEON: return "neon";
+    }
+    return "scalar";
+}
+
+bool
+CPUFeatures::getISAForName(string name, ISA &isa)
+{
+    for (ISA i: { ISA::Scalar, ISA::SSE2, ISA::AVX2, ISA::AVX512, ISA::NEON }) {
+        if (name == getISAName(i)) {
+            isa = i;
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,93 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef SV_CPU_FEATURES_H
+#define SV_CPU_FEATURES_H
+
+#include <string>
+#include <atomic>
+
+/**
+ * Run-time detection of the vector instruction sets available on the
+ * processor we are running on, for use in selecting among
+ * implementations of numeric kernels (see NumericKernels).
+ *
+ * The instruction set actually used may be forced to something lower
+ * than the one detected, either by calling forceISA (for testing) or
+ * by setting the environment variable SV_FORCE_ISA to one of the
+ * names returned by getISAName before the first query. A forced
+ * instruction set that is not supported by the processor is ignored.
+ */
+class CPUFeatures
+{
+public:
+    /**
+     * Instruction set levels, in increasing order of preference
+     * within each architecture. Scalar is always available.
+     */
+    enum class ISA {
+        Scalar,
+        SSE2,
+        AVX2,
+        AVX512,
+        NEON
+    };
+
+    /**
+     * Return the best instruction set supported by this processor
+     * (and operating system, for those needing OS register support).
+     */
+    static ISA getDetectedISA();
+
+    /**
+     * Return the instruction set that kernels should use: the
+     * detected one, unless a supported one has been forced.
+     */
+    static ISA getActiveISA();
+
+    /**
+     * Return true if code for the given instruction set may be run
+     * on this processor.
+     */
+    static bool isSupported(ISA isa);
+
+    /**
+     * Force kernels to use the given instruction set, if it is
+     * supported. Return false (and change nothing) if it is not.
+     */
+    static bool forceISA(ISA isa);
+
+    /**
+     * Cancel any forced instruction set, so that the detected one is
+     * used again.
+     */
+    static void clearForcedISA();
+
+    /**
+     * Return a counter that is incremented every time the active
+     * instruction set changes, so that callers caching a choice of
+     * implementation can tell when to choose again.
+     */
+    static int getGeneration() { return m_generation; }
+    
+    static std::string getISAName(ISA isa);
+    static bool getISAForName(std::string name, ISA &isa);
+
+private:
+    static ISA detect();
+    static std::atomic<int> m_forced; // -1 for none
+    static std::atomic<int> m_generation;
+};
+
+#endif
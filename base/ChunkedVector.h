@@ -0,0 +1,381 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef SV_CHUNKED_VECTOR_H
+#define SV_CHUNKED_VECTOR_H
+
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <iterator>
+#include <functional>
+#include <cstddef>
+
+/**
+ * Summary type for a ChunkedVector whose chunks need no summary.
+ */
+template <typename T>
+struct ChunkedVectorNoSummary
+{
+    void recalculate(const std::vector<T> &) { }
+    void added(const T &) { }
+    void removed(const T &, const std::vector<T> &) { }
+};
+
+/**
+ * A sequence of items stored in a series of separately allocated
+ * chunks of limited size, each of which is shared between copies of
+ * the sequence until one of them modifies it. Copying a ChunkedVector
+ * copies only a pointer per chunk, and modifying a shared chunk
+ * copies only that chunk, so a copy can serve as a snapshot of a long
+ * sequence that is still being edited without either the copy or the
+ * next edit costing time proportional to the length of the sequence.
+ *
+ * Each chunk also carries a Summary of its items, maintained while
+ * the vector is summarised (see setSummarised) so that a search can
+ * skip chunks that cannot contain what it is looking for. A Summary
+ * is default-constructible and has the same methods as
+ * ChunkedVectorNoSummary: recalculate() from all the items of a
+ * chunk, added() after an item has been inserted into it, and
+ * removed() after an item has been erased from it, given the items
+ * that remain.
+ *
+ * The container does not order its items itself, but lowerBound
+ * requires them to have been inserted in order of the comparator it
+ * is given.
+ *
+ * ChunkedVector is not thread-safe, but copies of it may be used and
+ * modified in different threads, provided that no copy is made while
+ * the vector being copied is being modified.
+ */
+template <typename T, typename Summary = ChunkedVectorNoSummary<T>>
+class ChunkedVector
+{
+public:
+    struct Chunk {
+        std::vector<T> items;
+        Summary summary;
+    };
+
+    explicit ChunkedVector(size_t maxChunkSize) :
+        m_maxChunkSize(std::max(maxChunkSize, size_t(2))),
+        m_size(0),
+        m_summarised(false) { }
+
+    class const_iterator
+    {
+    public:
+        typedef std::bidirectional_iterator_tag iterator_category;
+        typedef T value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef const T *pointer;
+        typedef const T &reference;
+
+        const_iterator() : m_v(nullptr), m_chunk(0), m_index(0) { }
+
+        reference operator*() const {
+            return m_v->m_chunks[m_chunk]->items[m_index];
+        }
+        pointer operator->() const {
+            return &(m_v->m_chunks[m_chunk]->items[m_index]);
+        }
+
+        const_iterator &operator++() {
+            if (++m_index == m_v->m_chunks[m_chunk]->items.size()) {
+                ++m_chunk;
+                m_index = 0;
+            }
+            return *this;
+        }
+        const_iterator operator++(int) {
+            const_iterator i(*this);
+            ++(*this);
+            return i;
+        }
+        const_iterator &operator--() {
+            if (m_index == 0) {
+                --m_chunk;
+                m_index = m_v->m_chunks[m_chunk]->items.size() - 1;
+            } else {
+                --m_index;
+            }
+            return *this;
+        }
+        const_iterator operator--(int) {
+            const_iterator i(*this);
+            --(*this);
+            return i;
+        }
+
+        bool operator==(const const_iterator &i) const {
+            return m_chunk == i.m_chunk && m_index == i.m_index;
+        }
+        bool operator!=(const const_iterator &i) const {
+            return !(*this == i);
+        }
+
+        /**
+         * Return the index of the chunk this iterator refers to.
+         */
+        size_t getChunk() const { return m_chunk; }
+
+        /**
+         * Return the index within its chunk of the item this iterator
+         * refers to.
+         */
+        size_t getIndexInChunk() const { return m_index; }
+
+        /**
+         * Return the position of the item in the whole vector, with
+         * the end position equal to size(). This takes time
+         * proportional to the number of chunks.
+         */
+        size_t getPosition() const {
+            size_t p = m_index;
+            for (size_t c = 0; c < m_chunk; ++c) {
+                p += m_v->m_chunks[c]->items.size();
+            }
+            return p;
+        }
+
+    private:
+        friend class ChunkedVector;
+        const_iterator(const ChunkedVector *v, size_t chunk, size_t index) :
+            m_v(v), m_chunk(chunk), m_index(index) { }
+
+        const ChunkedVector *m_v;
+        size_t m_chunk;
+        size_t m_index;
+    };
+
+    size_t size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+
+    const_iterator begin() const {
+        return const_iterator(this, 0, 0);
+    }
+    const_iterator end() const {
+        return const_iterator(this, m_chunks.size(), 0);
+    }
+
+    const T &front() const {
+        return m_chunks.front()->items.front();
+    }
+    const T &back() const {
+        return m_chunks.back()->items.back();
+    }
+
+    /**
+     * Return an iterator to the item at the given position, or end()
+     * if it is out of range. This takes time proportional to the
+     * number of chunks.
+     */
+    const_iterator at(size_t position) const {
+        for (size_t c = 0; c < m_chunks.size(); ++c) {
+            size_t n = m_chunks[c]->items.size();
+            if (position < n) {
+                return const_iterator(this, c, position);
+            }
+            position -= n;
+        }
+        return end();
+    }
+
+    /**
+     * Return an iterator to the first item that is not less than the
+     * given key, or end() if there is none.
+     */
+    template <typename K, typename Less>
+    const_iterator lowerBound(const K &key, Less less) const {
+        auto citr = std::partition_point
+            (m_chunks.begin(), m_chunks.end(),
+             [&](const std::shared_ptr<Chunk> &c) {
+                 return less(c->items.back(), key);
+             });
+        if (citr == m_chunks.end()) {
+            return end();
+        }
+        const std::vector<T> &items = (*citr)->items;
+        auto iitr = std::lower_bound(items.begin(), items.end(), key, less);
+        return const_iterator(this,
+                              size_t(citr - m_chunks.begin()),
+                              size_t(iitr - items.begin()));
+    }
+
+    const_iterator lowerBound(const T &item) const {
+        return lowerBound(item, std::less<T>());
+    }
+
+    size_t getChunkCount() const {
+        return m_chunks.size();
+    }
+
+    /**
+     * Return the given chunk, which is never empty.
+     */
+    const Chunk &getChunk(size_t chunk) const {
+        return *m_chunks[chunk];
+    }
+
+    /**
+     * Insert the item before the given position, and return an
+     * iterator to it. Invalidates all other iterators.
+     */
+    const_iterator insert(const_iterator pos, const T &item) {
+
+        size_t c = pos.m_chunk, i = pos.m_index;
+
+        if (m_chunks.empty()) {
+            m_chunks.push_back(std::make_shared<Chunk>());
+            c = 0;
+            i = 0;
+        } else if (c == m_chunks.size()) {
+            --c;
+            i = m_chunks[c]->items.size();
+        }
+
+        Chunk &chunk = detach(c);
+        chunk.items.insert(chunk.items.begin() + i, item);
+        ++m_size;
+        if (m_summarised) {
+            chunk.summary.added(item);
+        }
+
+        if (chunk.items.size() > m_maxChunkSize) {
+            split(c, i);
+        }
+
+        return const_iterator(this, c, i);
+    }
+
+    /**
+     * Erase the item at the given position, and return an iterator
+     * to the one that followed it. Invalidates all other iterators.
+     */
+    const_iterator erase(const_iterator pos) {
+
+        size_t c = pos.m_chunk, i = pos.m_index;
+
+        Chunk &chunk = detach(c);
+        if (m_summarised) {
+            T item(std::move(chunk.items[i]));
+            chunk.items.erase(chunk.items.begin() + i);
+            chunk.summary.removed(item, chunk.items);
+        } else {
+            chunk.items.erase(chunk.items.begin() + i);
+        }
+        --m_size;
+
+        if (chunk.items.empty()) {
+            m_chunks.erase(m_chunks.begin() + c);
+            return const_iterator(this, c, 0);
+        }
+        if (i == chunk.items.size()) {
+            return const_iterator(this, c + 1, 0);
+        }
+        return const_iterator(this, c, i);
+    }
+
+    /**
+     * Return a modifiable reference to the item at the given
+     * position, copying its chunk first if it is shared. The caller
+     * must not change the item's place in the ordering, and the
+     * chunk's summary is not updated, so this is only for vectors
+     * that are not summarised. Does not invalidate any iterators.
+     */
+    T &modify(const_iterator pos) {
+        return detach(pos.m_chunk).items[pos.m_index];
+    }
+
+    void clear() {
+        m_chunks.clear();
+        m_size = 0;
+    }
+
+    /**
+     * Set whether to maintain the chunk summaries. Switching them on
+     * calculates the summaries of (and so copies) every chunk.
+     */
+    void setSummarised(bool summarised) {
+        if (summarised == m_summarised) {
+            return;
+        }
+        m_summarised = summarised;
+        for (size_t c = 0; c < m_chunks.size(); ++c) {
+            Chunk &chunk = detach(c);
+            chunk.summary = Summary();
+            if (summarised) {
+                chunk.summary.recalculate(chunk.items);
+            }
+        }
+    }
+
+    bool isSummarised() const {
+        return m_summarised;
+    }
+
+    bool operator==(const ChunkedVector &other) const {
+        return m_size == other.m_size &&
+            std::equal(begin(), end(), other.begin());
+    }
+
+private:
+    std::vector<std::shared_ptr<Chunk>> m_chunks;
+    size_t m_maxChunkSize;
+    size_t m_size;
+    bool m_summarised;
+
+    Chunk &detach(size_t c) {
+        if (m_chunks[c].use_count() > 1) {
+            m_chunks[c] = std::make_shared<Chunk>(*m_chunks[c]);
+        }
+        return *m_chunks[c];
+    }
+
+    // Split the overfull (and already detached) chunk c, updating c
+    // and i to the new location of the item at index i in it
+    void split(size_t &c, size_t &i) {
+
+        Chunk &chunk = *m_chunks[c];
+        size_t n = chunk.items.size();
+
+        // When appending at the very end, as when building a vector
+        // in order, leave the full chunk full and start a new one;
+        // otherwise split it in half
+        size_t at = n / 2;
+        if (c + 1 == m_chunks.size() && i + 1 == n) {
+            at = n - 1;
+        }
+
+        auto tail = std::make_shared<Chunk>();
+        tail->items.assign(std::make_move_iterator(chunk.items.begin() + at),
+                           std::make_move_iterator(chunk.items.end()));
+        chunk.items.erase(chunk.items.begin() + at, chunk.items.end());
+
+        if (m_summarised) {
+            chunk.summary = Summary();
+            chunk.summary.recalculate(chunk.items);
+            tail->summary.recalculate(tail->items);
+        }
+
+        m_chunks.insert(m_chunks.begin() + c + 1, tail);
+
+        if (i >= at) {
+            ++c;
+            i -= at;
+        }
+    }
+};
+
+#endif
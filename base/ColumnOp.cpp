@@ -57,16 +57,9 @@ ColumnOp::normalize(const Column &in, ColumnNormalization n) {
 
         float min = 0.f;
         float max = 0.f;
-        bool have = false;
-        for (auto v: in) {
-            if (v < min || !have) {
-                min = v;
-            }
-            if (v > max || !have) {
-                max = v;
-            }
-            have = true;
-        }
+        float sum = 0.f;
+        NumericKernels::minMaxSumAbs(in.data(), sv_frame_t(in.size()),
+                                     min, max, sum);
         if (min != 0.f) {
             shift = -min;
             max -= min;
@@ -77,11 +70,7 @@ ColumnOp::normalize(const Column &in, ColumnNormalization n) {
 
     } else if (n == ColumnNormalization::Sum1) {
 
-        float sum = 0.f;
-
-        for (auto v: in) {
-            sum += fabsf(v);
-        }
+        float sum = NumericKernels::sumAbs(in.data(), sv_frame_t(in.size()));
 
         if (sum != 0.f) {
             scale = 1.f / sum;
@@ -89,14 +78,7 @@ ColumnOp::normalize(const Column &in, ColumnNormalization n) {
 
     } else {
 
-        float max = 0.f;
-
-        for (auto v: in) {
-            v = fabsf(v);
-            if (v > max) {
-                max = v;
-            }
-        }
+        float max = NumericKernels::maxAbs(in.data(), sv_frame_t(in.size()));
 
         if (n == ColumnNormalization::Max1) {
             if (max != 0.f) {
@@ -17,6 +17,7 @@
 #define COLUMN_OP_H
 
 #include "BaseTypes.h"
+#include "NumericKernels.h"
 
 #include <vector>
 
@@ -60,9 +61,8 @@ public:
      */
     static Column applyGain(const Column &in, double gain) {
         if (gain == 1.0) return in;
-        Column out;
-        out.reserve(in.size());
-        for (auto v: in) out.push_back(float(v * gain));
+        Column out(in);
+        NumericKernels::scale(out.data(), sv_frame_t(out.size()), float(gain));
         return out;
     }
 
@@ -0,0 +1,271 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#include "EventBoxIndex.h"
+
+#include "Profiler.h"
+
+#include <QMutexLocker>
+
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+const int EventBoxIndex::NodeCapacity = 16;
+
+EventBoxIndex::EventBoxIndex() :
+    m_removedCount(0)
+{
+}
+
+EventBoxIndex::Box
+EventBoxIndex::boxFor(const Event &e)
+{
+    Box b;
+    b.t0 = e.getFrame();
+    b.t1 = b.t0 + std::max(e.getDuration(), sv_frame_t(1));
+    b.v0 = e.getValue();
+    b.v1 = b.v0 + fabsf(e.getLevel());
+    return b;
+}
+
+void
+EventBoxIndex::add(const Event &e)
+{
+    QMutexLocker locker(&m_mutex);
+    m_added.push_back({ boxFor(e), e });
+}
+
+void
+EventBoxIndex::remove(const Event &e)
+{
+    QMutexLocker locker(&m_mutex);
+
+    for (auto itr = m_added.rbegin(); itr != m_added.rend(); ++itr) {
+        if (itr->event == e) {
+            m_added.erase(std::next(itr).base());
+            return;
+        }
+    }
+
+    // Not added since the last build, so it must be in the tree
+    ++m_removed[e];
+    ++m_removedCount;
+}
+
+void
+EventBoxIndex::clear()
+{
+    QMutexLocker locker(&m_mutex);
+    m_entries.clear();
+    m_levels.clear();
+    m_added.clear();
+    m_removed.clear();
+    m_removedCount = 0;
+}
+
+int
+EventBoxIndex::count() const
+{
+    QMutexLocker locker(&m_mutex);
+    return int(m_entries.size() + m_added.size()) - m_removedCount;
+}
+
+EventVector
+EventBoxIndex::getEventsSpanning(sv_frame_t frame,
+                                 sv_frame_t duration,
+                                 float minValue,
+                                 float maxValue) const
+{
+    QMutexLocker locker(&m_mutex);
+    rebuildIfNeeded();
+    return query({ frame, frame + duration, minValue, maxValue });
+}
+
+EventVector
+EventBoxIndex::getEventsCovering(sv_frame_t frame, float value) const
+{
+    QMutexLocker locker(&m_mutex);
+    rebuildIfNeeded();
+    return query({ frame, frame + 1, value, value });
+}
+
+void
+EventBoxIndex::rebuildIfNeeded() const
+{
+    // Rebuilding costs O(n log n), while each query costs time
+    // linear in the number of changes since the last build; rebuild
+    // when the changes reach a small fraction of the total
+    size_t changes = m_added.size() + size_t(m_removedCount);
+    if (changes > 256 + m_entries.size() / 32) {
+        rebuild();
+    }
+}
+
+void
+EventBoxIndex::rebuild() const
+{
+    Profiler profiler("EventBoxIndex::rebuild");
+
+    vector<Entry> entries;
+    entries.reserve(m_entries.size() + m_added.size());
+
+    for (auto &entry: m_entries) {
+        auto ritr = m_removed.find(entry.event);
+        if (ritr != m_removed.end() && ritr->second > 0) {
+            --ritr->second;
+            continue;
+        }
+        entries.push_back(std::move(entry));
+    }
+    for (auto &entry: m_added) {
+        entries.push_back(std::move(entry));
+    }
+
+    m_added.clear();
+    m_removed.clear();
+    m_removedCount = 0;
+    m_levels.clear();
+
+    // Sort-Tile-Recursive packing: sort by time, cut into vertical
+    // slices of about sqrt(leaves) leaves each, sort each slice by
+    // value, and fill the leaves in that order
+
+    const size_t n = entries.size();
+    const size_t leaves = (n + NodeCapacity - 1) / NodeCapacity;
+    const size_t slices = size_t(ceil(sqrt(double(leaves))));
+    const size_t sliceSize = std::max(slices, size_t(1)) * NodeCapacity;
+
+    auto timeCentre = [](const Entry &e) {
+        return e.box.t0 + (e.box.t1 - e.box.t0) / 2;
+    };
+    auto valueCentre = [](const Entry &e) {
+        return e.box.v0 + (e.box.v1 - e.box.v0) / 2;
+    };
+
+    sort(entries.begin(), entries.end(),
+         [&](const Entry &a, const Entry &b) {
+             return timeCentre(a) < timeCentre(b);
+         });
+
+    for (size_t i = 0; i < n; i += sliceSize) {
+        auto end = entries.begin() + std::min(i + sliceSize, n);
+        sort(entries.begin() + i, end,
+             [&](const Entry &a, const Entry &b) {
+                 return valueCentre(a) < valueCentre(b);
+             });
+    }
+
+    m_entries = std::move(entries);
+    if (n == 0) return;
+
+    // Leaf level, then each level above it until there is one node
+
+    vector<Node> level;
+    for (size_t i = 0; i < n; i += NodeCapacity) {
+        Node node;
+        node.first = int(i);
+        node.count = int(std::min(size_t(NodeCapacity), n - i));
+        node.bounds = m_entries[i].box;
+        for (int j = 1; j < node.count; ++j) {
+            const Box &b = m_entries[i + j].box;
+            node.bounds.t0 = std::min(node.bounds.t0, b.t0);
+            node.bounds.t1 = std::max(node.bounds.t1, b.t1);
+            node.bounds.v0 = std::min(node.bounds.v0, b.v0);
+            node.bounds.v1 = std::max(node.bounds.v1, b.v1);
+        }
+        level.push_back(node);
+    }
+    m_levels.push_back(level);
+
+    while (m_levels.back().size() > 1) {
+        const vector<Node> &below = m_levels.back();
+        vector<Node> above;
+        for (size_t i = 0; i < below.size(); i += NodeCapacity) {
+            Node node;
+            node.first = int(i);
+            node.count = int(std::min(size_t(NodeCapacity), below.size() - i));
+            node.bounds = below[i].bounds;
+            for (int j = 1; j < node.count; ++j) {
+                const Box &b = below[i + j].bounds;
+                node.bounds.t0 = std::min(node.bounds.t0, b.t0);
+                node.bounds.t1 = std::max(node.bounds.t1, b.t1);
+                node.bounds.v0 = std::min(node.bounds.v0, b.v0);
+                node.bounds.v1 = std::max(node.bounds.v1, b.v1);
+            }
+            above.push_back(node);
+        }
+        m_levels.push_back(above);
+    }
+}
+
+EventVector
+EventBoxIndex::query(const Box &box) const
+{
+    EventVector result;
+
+    if (!m_levels.empty()) {
+
+        // Depth-first search from the root, as a stack of (level,
+        // node index) pairs
+
+        vector<pair<int, int>> stack;
+        stack.push_back({ int(m_levels.size()) - 1, 0 });
+
+        while (!stack.empty()) {
+            auto top = stack.back();
+            stack.pop_back();
+            const Node &node = m_levels[top.first][top.second];
+            if (!node.bounds.intersects(box)) {
+                continue;
+            }
+            if (top.first == 0) {
+                for (int i = 0; i < node.count; ++i) {
+                    const Entry &entry = m_entries[node.first + i];
+                    if (entry.box.intersects(box)) {
+                        result.push_back(entry.event);
+                    }
+                }
+            } else {
+                for (int i = 0; i < node.count; ++i) {
+                    stack.push_back({ top.first - 1, node.first + i });
+                }
+            }
+        }
+
+        if (m_removedCount > 0) {
+            map<Event, int> dropped;
+            EventVector kept;
+            for (const auto &e: result) {
+                auto ritr = m_removed.find(e);
+                if (ritr != m_removed.end() && dropped[e] < ritr->second) {
+                    ++dropped[e];
+                } else {
+                    kept.push_back(e);
+                }
+            }
+            result = kept;
+        }
+    }
+
+    for (const auto &entry: m_added) {
+        if (entry.box.intersects(box)) {
+            result.push_back(entry.event);
+        }
+    }
+
+    sort(result.begin(), result.end());
+    return result;
+}
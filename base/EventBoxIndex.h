@@ -0,0 +1,124 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef SV_EVENT_BOX_INDEX_H
+#define SV_EVENT_BOX_INDEX_H
+
+#include "Event.h"
+
+#include <QMutex>
+
+#include <vector>
+#include <map>
+
+/**
+ * A two-dimensional index of events treated as boxes in time and
+ * value, as in BoxModel: each event covers the frames from its frame
+ * up to (not including) its frame plus duration, and the values from
+ * its value up to its value plus the absolute value of its level. An
+ * event with no duration covers its own frame only.
+ *
+ * The index is a packed R-tree, bulk-loaded using the
+ * Sort-Tile-Recursive method, so that a query visits only those
+ * parts of the tree whose bounds intersect the query rectangle on
+ * both axes. Events added or removed since the tree was built are
+ * held to one side and merged into the results of each query; the
+ * tree is rebuilt, on the next query, once these make up more than a
+ * small proportion of the whole.
+ *
+ * All methods are thread-safe.
+ */
+class EventBoxIndex
+{
+public:
+    EventBoxIndex();
+
+    /**
+     * Add an event. Identical events may be added more than once.
+     */
+    void add(const Event &e);
+
+    /**
+     * Remove one instance of an event. The event must have been
+     * added (and not since removed) -- unlike EventSeries, this does
+     * not check whether the event is present.
+     */
+    void remove(const Event &e);
+
+    void clear();
+
+    int count() const;
+
+    /**
+     * Return all events that overlap the given frame range (from
+     * frame up to but not including frame + duration) and also the
+     * given value range (from minValue to maxValue inclusive), in
+     * event order.
+     */
+    EventVector getEventsSpanning(sv_frame_t frame,
+                                  sv_frame_t duration,
+                                  float minValue,
+                                  float maxValue) const;
+
+    /**
+     * Return all events that cover the given frame and value, in
+     * event order.
+     */
+    EventVector getEventsCovering(sv_frame_t frame, float value) const;
+
+private:
+    struct Box {
+        sv_frame_t t0; // first frame covered
+        sv_frame_t t1; // frame after the last one covered
+        float v0;
+        float v1;
+        bool intersects(const Box &b) const {
+            return t0 < b.t1 && b.t0 < t1 && v0 <= b.v1 && b.v0 <= v1;
+        }
+    };
+
+    struct Entry {
+        Box box;
+        Event event;
+    };
+
+    struct Node {
+        Box bounds;
+        int first; // index of first entry (for leaves) or child node
+        int count;
+    };
+
+    static const int NodeCapacity;
+
+    mutable QMutex m_mutex;
+
+    // The tree: m_entries in leaf order, and m_levels[0] the leaf
+    // nodes up to m_levels.back() which contains only the root
+    mutable std::vector<Entry> m_entries;
+    mutable std::vector<std::vector<Node>> m_levels;
+
+    // Changes since the tree was built
+    mutable std::vector<Entry> m_added;
+    mutable std::map<Event, int> m_removed; // event -> instance count
+    mutable int m_removedCount;
+
+    static Box boxFor(const Event &e);
+
+    // Call these with m_mutex held
+    void rebuildIfNeeded() const;
+    void rebuild() const;
+    EventVector query(const Box &box) const;
+};
+
+#endif
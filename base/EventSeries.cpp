@@ -13,49 +13,105 @@
 */
 
 #include "EventSeries.h"
+#include "EventXmlWriter.h"
 
 #include <QMutexLocker>
 
+#include <cmath>
+#include <limits>
+
 using std::vector;
 using std::string;
 
+std::atomic<int64_t> EventSeries::m_lastRevision(0);
+
+EventSeries::EventChunkSummary::EventChunkSummary() :
+    values({ std::numeric_limits<float>::infinity(),
+            -std::numeric_limits<float>::infinity() })
+{
+}
+
+void
+EventSeries::EventChunkSummary::recalculate(const vector<Event> &events)
+{
+    *this = EventChunkSummary();
+    for (const auto &e: events) {
+        added(e);
+    }
+}
+
+void
+EventSeries::EventChunkSummary::added(const Event &e)
+{
+    ++labels[e.getLabel()];
+    extendValues(e);
+}
+
+void
+EventSeries::EventChunkSummary::removed(const Event &e,
+                                        const vector<Event> &remaining)
+{
+    auto itr = labels.find(e.getLabel());
+    if (itr != labels.end() && --itr->second <= 0) {
+        labels.erase(itr);
+    }
+
+    // The extents only change if the event was at one of them
+    if (!e.hasValue()) return;
+    float v = e.getValue();
+    if (std::isnan(v) || (v > values.min && v < values.max)) return;
+
+    values = EventChunkSummary().values;
+    for (const auto &r: remaining) {
+        extendValues(r);
+    }
+}
+
+void
+EventSeries::EventChunkSummary::extendValues(const Event &e)
+{
+    if (!e.hasValue()) return;
+    float v = e.getValue();
+    if (std::isnan(v)) return;
+    values.min = std::min(values.min, v);
+    values.max = std::max(values.max, v);
+}
+
 EventSeries::EventSeries(const EventSeries &other) :
     EventSeries(other, QMutexLocker(&other.m_mutex))
 {
 }
 
 EventSeries::EventSeries(const EventSeries &other, const QMutexLocker &) :
-    m_events(other.m_events),
-    m_seams(other.m_seams),
-    m_finalDurationlessEventFrame(other.m_finalDurationlessEventFrame)
+    m_contents(other.m_contents)
 {
 }
 
 EventSeries &
 EventSeries::operator=(const EventSeries &other)
 {
-    QMutexLocker locker(&m_mutex), otherLocker(&other.m_mutex);
-    m_events = other.m_events;
-    m_seams = other.m_seams;
-    m_finalDurationlessEventFrame = other.m_finalDurationlessEventFrame;
+    if (&other == this) return *this;
+    auto contents = other.getContents();
+    QMutexLocker locker(&m_mutex);
+    m_contents = std::const_pointer_cast<Contents>(contents);
     return *this;
 }
 
 EventSeries &
 EventSeries::operator=(EventSeries &&other)
 {
+    if (&other == this) return *this;
     QMutexLocker locker(&m_mutex), otherLocker(&other.m_mutex);
-    m_events = std::move(other.m_events);
-    m_seams = std::move(other.m_seams);
-    m_finalDurationlessEventFrame = std::move(other.m_finalDurationlessEventFrame);
+    m_contents = std::move(other.m_contents);
+    other.m_contents = std::make_shared<Contents>();
     return *this;
 }
 
 bool
 EventSeries::operator==(const EventSeries &other) const
 {
-    QMutexLocker locker(&m_mutex);
-    return m_events == other.m_events;
+    auto a = getContents(), b = other.getContents();
+    return a == b || a->events == b->events;
 }
 
 EventSeries
@@ -72,34 +128,41 @@ bool
 EventSeries::isEmpty() const
 {
     QMutexLocker locker(&m_mutex);
-    return m_events.empty();
+    const Events &events = m_contents->events;
+    return events.empty();
 }
 
 int
 EventSeries::count() const
 {
     QMutexLocker locker(&m_mutex);
-    if (m_events.size() > INT_MAX) {
+    const Events &events = m_contents->events;
+    if (events.size() > INT_MAX) {
         throw std::logic_error("too many events");
     }
-    return int(m_events.size());
+    return int(events.size());
 }
 
 void
 EventSeries::add(const Event &p)
 {
     QMutexLocker locker(&m_mutex);
+    detach();
+    Events &events = m_contents->events;
+    Seams &seams = m_contents->seams;
 
     bool isUnique = true;
 
-    auto pitr = lower_bound(m_events.begin(), m_events.end(), p);
-    if (pitr != m_events.end() && *pitr == p) {
+    auto pitr = events.lowerBound(p);
+    if (pitr != events.end() && *pitr == p) {
         isUnique = false;
     }
-    m_events.insert(pitr, p);
+    events.insert(pitr, p);
+    m_contents->revision = ++m_lastRevision;
 
-    if (!p.hasDuration() && p.getFrame() > m_finalDurationlessEventFrame) {
-        m_finalDurationlessEventFrame = p.getFrame();
+    sv_frame_t &finalDurationless = m_contents->finalDurationlessEventFrame;
+    if (!p.hasDuration() && p.getFrame() > finalDurationless) {
+        finalDurationless = p.getFrame();
     }
     
     if (p.hasDuration() && isUnique) {
@@ -110,18 +173,11 @@ EventSeries::add(const Event &p)
         createSeam(frame);
         createSeam(endFrame);
 
-        // These calls must both succeed after calling createSeam above
-        const auto i0 = m_seams.find(frame);
-        const auto i1 = m_seams.find(endFrame);
-
-        for (auto i = i0; i != i1; ++i) {
-            if (i == m_seams.end()) {
-                SVCERR << "ERROR: EventSeries::add: "
-                       << "reached end of seam map"
-                       << endl;
-                break;
-            }
-            i->second.push_back(p);
+        // The seam at frame must exist after calling createSeam
+        // above, and modify() does not invalidate the iterator
+        for (auto i = seams.lowerBound(frame, seamBefore);
+             i != seams.end() && i->frame < endFrame; ++i) {
+            seams.modify(i).events.push_back(p);
         }
     }
 
@@ -136,32 +192,37 @@ void
 EventSeries::remove(const Event &p)
 {
     QMutexLocker locker(&m_mutex);
+    detach();
+    Events &events = m_contents->events;
+    Seams &seams = m_contents->seams;
 
     // If we are removing the last (unique) example of an event,
-    // then we also need to remove it from the seam map. If this
-    // is only one of multiple identical events, then we don't.
+    // then we also need to remove it from the seams. If this is
+    // only one of multiple identical events, then we don't.
     bool isUnique = true;
         
-    auto pitr = lower_bound(m_events.begin(), m_events.end(), p);
-    if (pitr == m_events.end() || *pitr != p) {
+    auto pitr = events.lowerBound(p);
+    if (pitr == events.end() || *pitr != p) {
         // we don't know this event
         return;
     } else {
         auto nitr = pitr;
         ++nitr;
-        if (nitr != m_events.end() && *nitr == p) {
+        if (nitr != events.end() && *nitr == p) {
             isUnique = false;
         }
     }
 
-    m_events.erase(pitr);
+    events.erase(pitr);
+    m_contents->revision = ++m_lastRevision;
 
     if (!p.hasDuration() && isUnique &&
-        p.getFrame() == m_finalDurationlessEventFrame) {
-        m_finalDurationlessEventFrame = 0;
-        for (auto ritr = m_events.rbegin(); ritr != m_events.rend(); ++ritr) {
+        p.getFrame() == m_contents->finalDurationlessEventFrame) {
+        m_contents->finalDurationlessEventFrame = 0;
+        for (auto ritr = events.end(); ritr != events.begin(); ) {
+            --ritr;
             if (!ritr->hasDuration()) {
-                m_finalDurationlessEventFrame = ritr->getFrame();
+                m_contents->finalDurationlessEventFrame = ritr->getFrame();
                 break;
             }
         }
@@ -172,69 +233,63 @@ EventSeries::remove(const Event &p)
         const sv_frame_t frame = p.getFrame();
         const sv_frame_t endFrame = p.getFrame() + p.getDuration();
 
-        const auto i0 = m_seams.find(frame);
-        const auto i1 = m_seams.find(endFrame);
+        const auto i0 = seams.lowerBound(frame, seamBefore);
 
 #ifdef DEBUG_EVENT_SERIES
-        // This should be impossible if we found p in m_events above
-        if (i0 == m_seams.end() || i1 == m_seams.end()) {
-            SVCERR << "ERROR: EventSeries::remove: either frame " << frame
-                   << " or endFrame " << endFrame
-                   << " for event not found in seam map: event is "
+        // This should be impossible if we found p in events above
+        if (i0 == seams.end() || i0->frame != frame) {
+            SVCERR << "ERROR: EventSeries::remove: frame " << frame
+                   << " for event not found in seams: event is "
                    << p.toXmlString() << endl;
         }
 #endif
 
-        // Remove any and all instances of p from the seam map; we
-        // are only supposed to get here if we are removing the
-        // last instance of p from the series anyway
+        // Remove any and all instances of p from the seams; we are
+        // only supposed to get here if we are removing the last
+        // instance of p from the series anyway
             
-        for (auto i = i0; i != i1; ++i) {
-            if (i == m_seams.end()) {
-                // This can happen only if we have a negative
-                // duration, which Event forbids
-                throw std::logic_error("unexpectedly reached end of map");
-            }
-            for (size_t j = 0; j < i->second.size(); ) {
-                if (i->second[j] == p) {
-                    i->second.erase(i->second.begin() + j);
+        for (auto i = i0; i != seams.end() && i->frame < endFrame; ++i) {
+            std::vector<Event> &active = seams.modify(i).events;
+            for (size_t j = 0; j < active.size(); ) {
+                if (active[j] == p) {
+                    active.erase(active.begin() + j);
                 } else {
                     ++j;
                 }
             }
         }
 
-        // Tidy up by removing any entries that are now identical
-        // to their predecessors
+        // Tidy up by removing any seams, up to and including the one
+        // at the end frame, that are now identical to their
+        // predecessors
             
         std::vector<sv_frame_t> redundant;
 
-        auto pitr = m_seams.end();
-        if (i0 != m_seams.begin()) {
-            pitr = i0;
-            --pitr;
+        auto prev = seams.end();
+        if (i0 != seams.begin()) {
+            prev = i0;
+            --prev;
         }
 
-        for (auto i = i0; i != m_seams.end(); ++i) {
-            if (pitr != m_seams.end() &&
-                seamsEqual(i->second, pitr->second)) {
-                redundant.push_back(i->first);
+        for (auto i = i0; i != seams.end(); ++i) {
+            if (prev != seams.end() &&
+                seamsEqual(i->events, prev->events)) {
+                redundant.push_back(i->frame);
             }
-            pitr = i;
-            if (i == i1) {
+            prev = i;
+            if (i->frame >= endFrame) {
                 break;
             }
         }
 
         for (sv_frame_t f: redundant) {
-            m_seams.erase(f);
+            seams.erase(seams.lowerBound(f, seamBefore));
         }
 
-        // And remove any empty seams from the start of the map
+        // And remove any empty seams from the start
             
-        while (m_seams.begin() != m_seams.end() &&
-               m_seams.begin()->second.empty()) {
-            m_seams.erase(m_seams.begin());
+        while (!seams.empty() && seams.front().events.empty()) {
+            seams.erase(seams.begin());
         }
     }
 
@@ -245,44 +300,56 @@ EventSeries::remove(const Event &p)
 #endif
 }
 
+int64_t
+EventSeries::getRevision() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_contents->revision;
+}
+
 bool
 EventSeries::contains(const Event &p) const
 {
     QMutexLocker locker(&m_mutex);
-    return binary_search(m_events.begin(), m_events.end(), p);
+    const Events &events = m_contents->events;
+    auto pitr = events.lowerBound(p);
+    return pitr != events.end() && *pitr == p;
 }
 
 void
 EventSeries::clear()
 {
     QMutexLocker locker(&m_mutex);
-    m_events.clear();
-    m_seams.clear();
-    m_finalDurationlessEventFrame = 0;
+    bool indexed = m_contents->events.isSummarised();
+    m_contents = std::make_shared<Contents>();
+    m_contents->events.setSummarised(indexed);
 }
 
 sv_frame_t
 EventSeries::getStartFrame() const
 {
     QMutexLocker locker(&m_mutex);
-    if (m_events.empty()) return 0;
-    return m_events.begin()->getFrame();
+    const Events &events = m_contents->events;
+    if (events.empty()) return 0;
+    return events.front().getFrame();
 }
 
 sv_frame_t
 EventSeries::getEndFrame() const
 {
     QMutexLocker locker(&m_mutex);
+    const Events &events = m_contents->events;
+    const Seams &seams = m_contents->seams;
 
     sv_frame_t latest = 0;
 
-    if (m_events.empty()) return latest;
+    if (events.empty()) return latest;
     
-    latest = m_finalDurationlessEventFrame;
+    latest = m_contents->finalDurationlessEventFrame;
 
-    if (m_seams.empty()) return latest;
+    if (seams.empty()) return latest;
     
-    sv_frame_t lastSeam = m_seams.rbegin()->first;
+    sv_frame_t lastSeam = seams.back().frame;
     if (lastSeam > latest) {
         latest = lastSeam;
     }
@@ -295,47 +362,78 @@ EventSeries::getEventsSpanning(sv_frame_t frame,
                                sv_frame_t duration) const
 {
     QMutexLocker locker(&m_mutex);
-
     EventVector span;
-    
+    visitSpanning(*m_contents, frame, duration,
+                  [&](const Event &e) {
+                      span.push_back(e);
+                      return true;
+                  });
+    return span;
+}
+
+bool
+EventSeries::visitEventsSpanning(sv_frame_t frame,
+                                 sv_frame_t duration,
+                                 const EventVisitor &visitor) const
+{
+    auto contents = getContents();
+    return visitSpanning(*contents, frame, duration, visitor);
+}
+
+bool
+EventSeries::visitSpanning(const Contents &contents,
+                           sv_frame_t frame,
+                           sv_frame_t duration,
+                           const EventVisitor &visitor)
+{
+    const Events &events = contents.events;
+    const Seams &seams = contents.seams;
+
     const sv_frame_t start = frame;
     const sv_frame_t end = frame + duration;
         
     // first find any zero-duration events
 
-    auto pitr = lower_bound(m_events.begin(), m_events.end(),
-                            Event(start));
-    while (pitr != m_events.end() && pitr->getFrame() < end) {
+    auto pitr = events.lowerBound(Event(start));
+    while (pitr != events.end() && pitr->getFrame() < end) {
         if (!pitr->hasDuration()) {
-            span.push_back(*pitr);
+            if (!visitor(*pitr)) return false;
         }
         ++pitr;
     }
 
-    // now any non-zero-duration ones from the seam map
+    // now any non-zero-duration ones from the seams
 
-    std::set<Event> found;
-    auto sitr = m_seams.lower_bound(start);
-    if (sitr == m_seams.end() || sitr->first > start) {
-        if (sitr != m_seams.begin()) {
+    EventAddressSet found;
+    auto sitr = seams.lowerBound(start, seamBefore);
+    if (sitr == seams.end() || sitr->frame > start) {
+        if (sitr != seams.begin()) {
             --sitr;
         }                
     }
-    while (sitr != m_seams.end() && sitr->first < end) {
-        for (const auto &p: sitr->second) {
-            found.insert(p);
+    while (sitr != seams.end() && sitr->frame < end) {
+        for (const auto &p: sitr->events) {
+            found.insert(&p);
         }
         ++sitr;
     }
-    for (const auto &p: found) {
-        auto pitr = lower_bound(m_events.begin(), m_events.end(), p);
-        while (pitr != m_events.end() && *pitr == p) {
-            span.push_back(p);
+
+    return visitInstances(events, found, visitor);
+}
+
+bool
+EventSeries::visitInstances(const Events &events,
+                            const EventAddressSet &found,
+                            const EventVisitor &visitor)
+{
+    for (const Event *p: found) {
+        auto pitr = events.lowerBound(*p);
+        while (pitr != events.end() && *pitr == *p) {
+            if (!visitor(*pitr)) return false;
             ++pitr;
         }
     }
-            
-    return span;
+    return true;
 }
 
 EventVector
@@ -344,6 +442,7 @@ EventSeries::getEventsWithin(sv_frame_t frame,
                              int overspill) const
 {
     QMutexLocker locker(&m_mutex);
+    const Events &events = m_contents->events;
 
     EventVector span;
     
@@ -351,16 +450,15 @@ EventSeries::getEventsWithin(sv_frame_t frame,
     const sv_frame_t end = frame + duration;
 
     // because we don't need to "look back" at events that end within
-    // but started without, we can do this entirely from m_events.
+    // but started without, we can do this entirely from events.
     // The core operation is very simple, it's just overspill that
     // complicates it.
 
-    Events::const_iterator reference = 
-        lower_bound(m_events.begin(), m_events.end(), Event(start));
+    Events::const_iterator reference = events.lowerBound(Event(start));
 
     Events::const_iterator first = reference;
     for (int i = 0; i < overspill; ++i) {
-        if (first == m_events.begin()) break;
+        if (first == events.begin()) break;
         --first;
     }
     for (int i = 0; i < overspill; ++i) {
@@ -372,7 +470,7 @@ EventSeries::getEventsWithin(sv_frame_t frame,
     Events::const_iterator pitr = reference;
     Events::const_iterator last = reference;
 
-    while (pitr != m_events.end() && pitr->getFrame() < end) {
+    while (pitr != events.end() && pitr->getFrame() < end) {
         if (!pitr->hasDuration() ||
             (pitr->getFrame() + pitr->getDuration() <= end)) {
             span.push_back(*pitr);
@@ -383,7 +481,7 @@ EventSeries::getEventsWithin(sv_frame_t frame,
     }
 
     for (int i = 0; i < overspill; ++i) {
-        if (last == m_events.end()) break;
+        if (last == events.end()) break;
         span.push_back(*last);
         ++last;
     }
@@ -391,93 +489,162 @@ EventSeries::getEventsWithin(sv_frame_t frame,
     return span;
 }
 
+bool
+EventSeries::visitEventsWithin(sv_frame_t frame,
+                               sv_frame_t duration,
+                               const EventVisitor &visitor) const
+{
+    auto contents = getContents();
+    const Events &events = contents->events;
+
+    const sv_frame_t start = frame;
+    const sv_frame_t end = frame + duration;
+
+    auto pitr = events.lowerBound(Event(start));
+    while (pitr != events.end() && pitr->getFrame() < end) {
+        if (!pitr->hasDuration() ||
+            (pitr->getFrame() + pitr->getDuration() <= end)) {
+            if (!visitor(*pitr)) return false;
+        }
+        ++pitr;
+    }
+
+    return true;
+}
+
 EventVector
 EventSeries::getEventsStartingWithin(sv_frame_t frame,
                                      sv_frame_t duration) const
 {
     QMutexLocker locker(&m_mutex);
-
     EventVector span;
-    
+    visitStartingWithin(*m_contents, frame, duration,
+                        [&](const Event &e) {
+                            span.push_back(e);
+                            return true;
+                        });
+    return span;
+}
+
+bool
+EventSeries::visitEventsStartingWithin(sv_frame_t frame,
+                                       sv_frame_t duration,
+                                       const EventVisitor &visitor) const
+{
+    auto contents = getContents();
+    return visitStartingWithin(*contents, frame, duration, visitor);
+}
+
+bool
+EventSeries::visitStartingWithin(const Contents &contents,
+                                 sv_frame_t frame,
+                                 sv_frame_t duration,
+                                 const EventVisitor &visitor)
+{
+    const Events &events = contents.events;
+
     const sv_frame_t start = frame;
     const sv_frame_t end = frame + duration;
 
     // because we don't need to "look back" at events that started
     // earlier than the start of the given range, we can do this
-    // entirely from m_events
+    // entirely from events
 
-    auto pitr = lower_bound(m_events.begin(), m_events.end(),
-                            Event(start));
-    while (pitr != m_events.end() && pitr->getFrame() < end) {
-        span.push_back(*pitr);
+    auto pitr = events.lowerBound(Event(start));
+    while (pitr != events.end() && pitr->getFrame() < end) {
+        if (!visitor(*pitr)) return false;
         ++pitr;
     }
             
-    return span;
+    return true;
 }
 
 EventVector
 EventSeries::getEventsCovering(sv_frame_t frame) const
 {
     QMutexLocker locker(&m_mutex);
-
     EventVector cover;
+    visitCovering(*m_contents, frame,
+                  [&](const Event &e) {
+                      cover.push_back(e);
+                      return true;
+                  });
+    return cover;
+}
+
+bool
+EventSeries::visitEventsCovering(sv_frame_t frame,
+                                 const EventVisitor &visitor) const
+{
+    auto contents = getContents();
+    return visitCovering(*contents, frame, visitor);
+}
+
+bool
+EventSeries::visitCovering(const Contents &contents,
+                           sv_frame_t frame,
+                           const EventVisitor &visitor)
+{
+    const Events &events = contents.events;
+    const Seams &seams = contents.seams;
 
     // first find any zero-duration events
 
-    auto pitr = lower_bound(m_events.begin(), m_events.end(),
-                            Event(frame));
-    while (pitr != m_events.end() && pitr->getFrame() == frame) {
+    auto pitr = events.lowerBound(Event(frame));
+    while (pitr != events.end() && pitr->getFrame() == frame) {
         if (!pitr->hasDuration()) {
-            cover.push_back(*pitr);
+            if (!visitor(*pitr)) return false;
         }
         ++pitr;
     }
         
-    // now any non-zero-duration ones from the seam map
+    // now any non-zero-duration ones from the seams
         
-    std::set<Event> found;
-    auto sitr = m_seams.lower_bound(frame);
-    if (sitr == m_seams.end() || sitr->first > frame) {
-        if (sitr != m_seams.begin()) {
+    EventAddressSet found;
+    auto sitr = seams.lowerBound(frame, seamBefore);
+    if (sitr == seams.end() || sitr->frame > frame) {
+        if (sitr != seams.begin()) {
             --sitr;
         }                
     }
-    if (sitr != m_seams.end() && sitr->first <= frame) {
-        for (const auto &p: sitr->second) {
-            found.insert(p);
-        }
-        ++sitr;
-    }
-    for (const auto &p: found) {
-        auto pitr = lower_bound(m_events.begin(), m_events.end(), p);
-        while (pitr != m_events.end() && *pitr == p) {
-            cover.push_back(p);
-            ++pitr;
+    if (sitr != seams.end() && sitr->frame <= frame) {
+        for (const auto &p: sitr->events) {
+            found.insert(&p);
         }
     }
-        
-    return cover;
+
+    return visitInstances(events, found, visitor);
 }
 
 EventVector
 EventSeries::getAllEvents() const
 {
     QMutexLocker locker(&m_mutex);
+    const Events &events = m_contents->events;
+    return EventVector(events.begin(), events.end());
+}
 
-    return m_events;
+bool
+EventSeries::visitAllEvents(const EventVisitor &visitor) const
+{
+    auto contents = getContents();
+    for (const auto &e: contents->events) {
+        if (!visitor(e)) return false;
+    }
+    return true;
 }
 
 bool
 EventSeries::getEventPreceding(const Event &e, Event &preceding) const
 {
     QMutexLocker locker(&m_mutex);
+    const Events &events = m_contents->events;
 
-    auto pitr = lower_bound(m_events.begin(), m_events.end(), e);
-    if (pitr == m_events.end() || *pitr != e) {
+    auto pitr = events.lowerBound(e);
+    if (pitr == events.end() || *pitr != e) {
         return false;
     }
-    if (pitr == m_events.begin()) {
+    if (pitr == events.begin()) {
         return false;
     }
     --pitr;
@@ -489,14 +656,15 @@ bool
 EventSeries::getEventFollowing(const Event &e, Event &following) const
 {
     QMutexLocker locker(&m_mutex);
+    const Events &events = m_contents->events;
 
-    auto pitr = lower_bound(m_events.begin(), m_events.end(), e);
-    if (pitr == m_events.end() || *pitr != e) {
+    auto pitr = events.lowerBound(e);
+    if (pitr == events.end() || *pitr != e) {
         return false;
     }
     while (*pitr == e) {
         ++pitr;
-        if (pitr == m_events.end()) {
+        if (pitr == events.end()) {
             return false;
         }
     }
@@ -510,56 +678,176 @@ EventSeries::getNearestEventMatching(sv_frame_t startSearchAt,
                                      Direction direction,
                                      Event &found) const
 {
-    QMutexLocker locker(&m_mutex);
+    // The predicate may call back into the series, so search a
+    // snapshot without holding the lock
+    auto contents = getContents();
+    return findNearestMatching(*contents, startSearchAt, predicate,
+                               direction, found);
+}
 
-    auto pitr = lower_bound(m_events.begin(), m_events.end(),
-                            Event(startSearchAt));
+bool
+EventSeries::findNearestMatching(const Contents &contents,
+                                 sv_frame_t startSearchAt,
+                                 std::function<bool(const Event &)> predicate,
+                                 Direction direction,
+                                 Event &found,
+                                 const ChunkFilter &filter)
+{
+    const Events &events = contents.events;
+    const size_t chunks = events.getChunkCount();
+
+    auto pitr = events.lowerBound(Event(startSearchAt));
+    size_t c = pitr.getChunk();
+    size_t i = pitr.getIndexInChunk();
 
+    // Search forward from (c, i) inclusive, or backward from (c, i)
+    // exclusive, a chunk at a time
+    
     while (true) {
 
-        if (direction == Backward) {
-            if (pitr == m_events.begin()) {
-                break;
-            } else {
-                --pitr;
-            }
-        } else {
-            if (pitr == m_events.end()) {
-                break;
+        if (c < chunks) {
+            const auto &chunk = events.getChunk(c);
+            if (!filter || filter(chunk.summary)) {
+                const auto &items = chunk.items;
+                if (direction == Forward) {
+                    for (size_t j = i; j < items.size(); ++j) {
+                        if (predicate(items[j])) {
+                            found = items[j];
+                            return true;
+                        }
+                    }
+                } else {
+                    for (size_t j = i; j > 0; ) {
+                        --j;
+                        if (predicate(items[j])) {
+                            found = items[j];
+                            return true;
+                        }
+                    }
+                }
             }
         }
 
-        const Event &e = *pitr;
-        if (predicate(e)) {
-            found = e;
-            return true;
-        }
-
         if (direction == Forward) {
-            ++pitr;
+            if (++c >= chunks) break;
+            i = 0;
+        } else {
+            if (c == 0) break;
+            --c;
+            i = events.getChunk(c).items.size();
         }
     }
 
     return false;
 }
 
+void
+EventSeries::setSearchIndexed(bool indexed)
+{
+    QMutexLocker locker(&m_mutex);
+    if (m_contents->events.isSummarised() == indexed) return;
+    detach();
+    m_contents->events.setSummarised(indexed);
+}
+
+bool
+EventSeries::isSearchIndexed() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_contents->events.isSummarised();
+}
+
+bool
+EventSeries::getNearestEventWithLabel(sv_frame_t startSearchAt,
+                                      QString label,
+                                      Direction direction,
+                                      Event &found) const
+{
+    QMutexLocker locker(&m_mutex);
+    const Contents &contents = *m_contents;
+
+    ChunkFilter filter;
+    if (contents.events.isSummarised()) {
+        filter = [&](const EventChunkSummary &summary) {
+                     return summary.labels.find(label) !=
+                         summary.labels.end();
+                 };
+    }
+    
+    return findNearestMatching
+        (contents, startSearchAt,
+         [&](const Event &e) { return e.getLabel() == label; },
+         direction, found, filter);
+}
+
+bool
+EventSeries::getNearestEventWithValueAbove(sv_frame_t startSearchAt,
+                                           float threshold,
+                                           Direction direction,
+                                           Event &found) const
+{
+    return getNearestEventWithValue
+        (startSearchAt, true, threshold, direction, found);
+}
+
+bool
+EventSeries::getNearestEventWithValueBelow(sv_frame_t startSearchAt,
+                                           float threshold,
+                                           Direction direction,
+                                           Event &found) const
+{
+    return getNearestEventWithValue
+        (startSearchAt, false, threshold, direction, found);
+}
+
+bool
+EventSeries::getNearestEventWithValue(sv_frame_t startSearchAt,
+                                      bool above, float threshold,
+                                      Direction direction,
+                                      Event &found) const
+{
+    QMutexLocker locker(&m_mutex);
+    const Contents &contents = *m_contents;
+
+    // The extents are exact, so a chunk that fails this test has no
+    // matching event
+    ChunkFilter filter;
+    if (contents.events.isSummarised()) {
+        filter = [&](const EventChunkSummary &summary) {
+                     return above ?
+                         summary.values.max > threshold :
+                         summary.values.min < threshold;
+                 };
+    }
+
+    return findNearestMatching
+        (contents, startSearchAt,
+         [&](const Event &e) {
+             if (!e.hasValue()) return false;
+             float v = e.getValue();
+             return above ? v > threshold : v < threshold;
+         },
+         direction, found, filter);
+}
+
 Event
 EventSeries::getEventByIndex(int index) const
 {
     QMutexLocker locker(&m_mutex);
-    if (!in_range_for(m_events, index)) {
+    const Events &events = m_contents->events;
+    if (index < 0 || size_t(index) >= events.size()) {
         throw std::logic_error("index out of range");
     }
-    return m_events[index];
+    return *events.at(size_t(index));
 }
 
 int
 EventSeries::getIndexForEvent(const Event &e) const
 {
     QMutexLocker locker(&m_mutex);
-    auto pitr = lower_bound(m_events.begin(), m_events.end(), e);
-    auto d = distance(m_events.begin(), pitr);
-    if (d < 0 || d > INT_MAX) return 0;
+    const Events &events = m_contents->events;
+    size_t d = events.lowerBound(e).getPosition();
+    if (d > INT_MAX) return 0;
     return int(d);
 }
 
@@ -568,17 +856,7 @@ EventSeries::toXml(QTextStream &out,
                    QString indent,
                    QString extraAttributes) const
 {
-    QMutexLocker locker(&m_mutex);
-
-    out << indent << QString("<dataset id=\"%1\" %2>\n")
-        .arg(getExportId())
-        .arg(extraAttributes);
-    
-    for (const auto &p: m_events) {
-        p.toXml(out, indent + "  ", "", {});
-    }
-    
-    out << indent << "</dataset>\n";
+    toXml(out, indent, extraAttributes, {});
 }
 
 void
@@ -587,15 +865,20 @@ EventSeries::toXml(QTextStream &out,
                    QString extraAttributes,
                    Event::ExportNameOptions options) const
 {
-    QMutexLocker locker(&m_mutex);
+    // Write from a snapshot, so that edits can proceed meanwhile
+    auto contents = getContents();
 
     out << indent << QString("<dataset id=\"%1\" %2>\n")
         .arg(getExportId())
         .arg(extraAttributes);
     
-    for (const auto &p: m_events) {
-        p.toXml(out, indent + "  ", "", options);
+    const Events &events = contents->events;
+    EventXmlWriter::EventRanges ranges;
+    for (size_t c = 0; c < events.getChunkCount(); ++c) {
+        const auto &items = events.getChunk(c).items;
+        ranges.push_back({ items.data(), items.data() + items.size() });
     }
+    EventXmlWriter(indent + "  ", options).write(out, ranges);
     
     out << indent << "</dataset>\n";
 }
@@ -604,10 +887,12 @@ QVector<QString>
 EventSeries::getStringExportHeaders(DataExportOptions opts,
                                     Event::ExportNameOptions nopts) const
 {
-    if (m_events.empty()) {
+    QMutexLocker locker(&m_mutex);
+    const Events &events = m_contents->events;
+    if (events.empty()) {
         return {};
     } else {
-        return m_events.begin()->getStringExportHeaders(opts, nopts);
+        return events.front().getStringExportHeaders(opts, nopts);
     }
 }
 
@@ -619,18 +904,19 @@ EventSeries::toStringExportRows(DataExportOptions options,
                                 sv_frame_t resolution,
                                 Event fillEvent) const
 {
-    QMutexLocker locker(&m_mutex);
+    // Export from a snapshot, so that edits can proceed meanwhile
+    auto contents = getContents();
+    const Events &events = contents->events;
 
     QVector<QVector<QString>> rows;
 
     const sv_frame_t end = startFrame + duration;
 
-    auto pitr = lower_bound(m_events.begin(), m_events.end(),
-                            Event(startFrame));
+    auto pitr = events.lowerBound(Event(startFrame));
             
     if (!(options & DataExportFillGaps)) {
         
-        while (pitr != m_events.end() && pitr->getFrame() < end) {
+        while (pitr != events.end() && pitr->getFrame() < end) {
             rows.push_back(pitr->toStringExportRow(options, sampleRate));
             ++pitr;
         }
@@ -639,7 +925,7 @@ EventSeries::toStringExportRows(DataExportOptions options,
         
         // find frame time of first point in range (if any)
         sv_frame_t first = startFrame;
-        if (pitr != m_events.end()) {
+        if (pitr != events.end()) {
             first = pitr->getFrame();
         }
 
@@ -654,7 +940,7 @@ EventSeries::toStringExportRows(DataExportOptions options,
         // now progress, either writing the next point (if within
         // distance) or a default fill point
         while (f < end) {
-            if (pitr != m_events.end() && pitr->getFrame() <= f) {
+            if (pitr != events.end() && pitr->getFrame() <= f) {
                 rows.push_back(pitr->toStringExportRow
                                (options & ~DataExportFillGaps,
                                 sampleRate));
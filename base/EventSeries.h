@@ -17,11 +17,15 @@
 
 #include "Event.h"
 #include "XmlExportable.h"
+#include "ChunkedVector.h"
 
 #include <set>
+#include <map>
 #include <string>
 #include <vector>
 #include <functional>
+#include <memory>
+#include <atomic>
 
 #include <QMutex>
 
@@ -44,12 +48,24 @@
  * does work, and should be acceptable in interactive use, but it is
  * very slow in bulk.
  *
- * EventSeries is thread-safe.
+ * EventSeries is thread-safe. Copying an EventSeries is cheap because
+ * the contents are shared between the copies until one of them is
+ * modified. A copy can therefore serve as a consistent snapshot of a
+ * series that is still being edited: a long-running reader such as an
+ * exporter can query the copy without seeing, or blocking, subsequent
+ * edits.
+ *
+ * The events and seams are stored in chunks of a few hundred entries
+ * each, and it is the chunks that are shared. An edit to a series
+ * whose contents are shared copies the list of chunks (one pointer
+ * per chunk) and then only the chunks that the edit touches, not the
+ * whole series. The same applies to the visit methods, which share
+ * the contents for as long as the visit lasts.
  */
 class EventSeries : public XmlExportable
 {
 public:
-    EventSeries() : m_finalDurationlessEventFrame(0) { }
+    EventSeries() : m_contents(std::make_shared<Contents>()) { }
     ~EventSeries() =default;
 
     EventSeries(const EventSeries &);
@@ -68,6 +84,16 @@ public:
     bool isEmpty() const;
     int count() const;
 
+    /**
+     * Return a number identifying the current contents of the
+     * series. This changes whenever an event is added or removed, or
+     * the series is cleared or assigned to, and two series only ever
+     * have the same revision if they have the same contents. A reader
+     * that caches something derived from the events can compare
+     * revisions to find out cheaply whether its cache is stale.
+     */
+    int64_t getRevision() const;
+
     /**
      * Return the frame of the first event in the series. If there are
      * no events, return 0.
@@ -148,6 +174,61 @@ public:
      * Retrieve all events, in their natural order.
      */
     EventVector getAllEvents() const;
+
+    /**
+     * A function called for each event found by one of the visit
+     * methods below. Return true to continue to the next event, or
+     * false to stop.
+     */
+    typedef std::function<bool(const Event &)> EventVisitor;
+
+    /**
+     * Call the visitor for each event that getEventsSpanning would
+     * return for the same arguments, in the same order, without
+     * copying the events into a vector. Return false if the visitor
+     * stopped early, true otherwise.
+     *
+     * The visitor is called without any lock held, on the contents
+     * of the series as they were when this method was called: it may
+     * safely call back into the series, and any edits it makes will
+     * not be seen by the visit in progress. Those contents are kept
+     * alive until the visit returns, so an edit made to the series
+     * meanwhile (from any thread) has to copy the chunks it touches,
+     * as described above. The get methods hold the lock instead, and
+     * have no such cost.
+     */
+    bool visitEventsSpanning(sv_frame_t frame,
+                             sv_frame_t duration,
+                             const EventVisitor &visitor) const;
+
+    /**
+     * Call the visitor for each event that getEventsCovering would
+     * return, as for visitEventsSpanning.
+     */
+    bool visitEventsCovering(sv_frame_t frame,
+                             const EventVisitor &visitor) const;
+
+    /**
+     * Call the visitor for each event that getEventsWithin would
+     * return (with no overspill), as for visitEventsSpanning.
+     */
+    bool visitEventsWithin(sv_frame_t frame,
+                           sv_frame_t duration,
+                           const EventVisitor &visitor) const;
+
+    /**
+     * Call the visitor for each event that getEventsStartingWithin
+     * would return, as for visitEventsSpanning.
+     */
+    bool visitEventsStartingWithin(sv_frame_t frame,
+                                   sv_frame_t duration,
+                                   const EventVisitor &visitor) const;
+
+    /**
+     * Call the visitor for every event, in their natural order, as
+     * for visitEventsSpanning.
+     */
+    bool visitAllEvents(const EventVisitor &visitor) const;
     
     /**
      * If e is in the series and is not the first event in it, set
@@ -188,12 +269,65 @@ public:
      * the given frame in the given direction. If the direction is
      * Forward then the search includes events starting at the given
      * frame, otherwise it does not.
+     *
+     * The predicate is called without any lock held, on the contents
+     * of the series as they were when this method was called, as for
+     * visitEventsSpanning.
      */
     bool getNearestEventMatching(sv_frame_t startSearchAt,
                                  std::function<bool(const Event &)> predicate,
                                  Direction direction,
                                  Event &found) const;
-    
+
+    /**
+     * Set whether to maintain search indexes for the series. If
+     * indexed, each chunk of events records the labels it contains
+     * and the range of its values, updated as events are added and
+     * removed. The label and value searches below then skip any chunk
+     * that cannot contain a match, so that a search for something
+     * rare takes time proportional to the number of chunks rather
+     * than the number of events, at the cost of some memory and of a
+     * little extra work on each edit. The default is not to index.
+     *
+     * The searches return the same results whether the series is
+     * indexed or not.
+     */
+    void setSearchIndexed(bool indexed);
+
+    /**
+     * Return true if the series maintains search indexes.
+     */
+    bool isSearchIndexed() const;
+
+    /**
+     * Return the nearest event with exactly the given label, as for
+     * getNearestEventMatching.
+     */
+    bool getNearestEventWithLabel(sv_frame_t startSearchAt,
+                                  QString label,
+                                  Direction direction,
+                                  Event &found) const;
+
+    /**
+     * Return the nearest event that has a value greater than the
+     * given threshold, as for getNearestEventMatching. Events with
+     * no value, or a NaN value, never match.
+     */
+    bool getNearestEventWithValueAbove(sv_frame_t startSearchAt,
+                                       float threshold,
+                                       Direction direction,
+                                       Event &found) const;
+
+    /**
+     * Return the nearest event that has a value less than the given
+     * threshold, as for getNearestEventMatching. Events with no
+     * value, or a NaN value, never match.
+     */
+    bool getNearestEventWithValueBelow(sv_frame_t startSearchAt,
+                                       float threshold,
+                                       Direction direction,
+                                       Event &found) const;
+
     /**
      * Return the event at the given numerical index in the series,
      * where 0 = the first event and count()-1 = the last.
@@ -248,75 +382,222 @@ private:
     EventSeries(const EventSeries &other, const QMutexLocker &);
     
     /**
-     * This vector contains all events in the series, in the normal
-     * sort order. For backward compatibility we must support series
+     * The extents of the values of a set of events. Events with no
+     * value, or a NaN value, have no effect on the extents; a set
+     * with no such events has min > max.
+     */
+    struct ValueExtents {
+        float min;
+        float max;
+    };
+
+    /**
+     * Summary of a chunk of events, used to skip chunks in the label
+     * and value searches: the extents of the values of the events
+     * in the chunk, and the number of events with each label.
+     */
+    struct EventChunkSummary {
+        EventChunkSummary();
+        ValueExtents values;
+        std::map<QString, int> labels;
+        void recalculate(const std::vector<Event> &events);
+        void added(const Event &e);
+        void removed(const Event &e, const std::vector<Event> &remaining);
+    private:
+        void extendValues(const Event &e);
+    };
+
+    /**
+     * This contains all events in the series, in the normal sort
+     * order. For backward compatibility we must support series
      * containing multiple instances of identical events, so
-     * consecutive events in this vector will not always be distinct.
-     * The vector is used in preference to a multiset or map<Event,
+     * consecutive events in it will not always be distinct. A
+     * sequence is used in preference to a multiset or map<Event,
      * int> in order to allow indexing by "row number" as well as by
      * properties such as frame.
      * 
      * Because events are immutable, we do not have to worry about the
      * order changing once an event is inserted - we only add or
      * delete them.
+     *
+     * The chunks are summarised only if the series is search indexed.
      */
-    typedef std::vector<Event> Events;
-    Events m_events;
-    
+    typedef ChunkedVector<Event, EventChunkSummary> Events;
+
     /**
-     * The FrameEventMap maps from frame number to a set of events. In
-     * the seam map this is used to represent the events that are
-     * active at that frame, either because they begin at that frame
-     * or because they are continuing from an earlier frame. There is
-     * an entry here for each frame at which an event starts or ends,
-     * with the event appearing in all entries from its start time
+     * A seam is a frame together with the events that are active at
+     * that frame, either because they begin at that frame or because
+     * they are continuing from an earlier frame. There is a seam for
+     * each frame at which an event starts or ends, in order of frame,
+     * with the event appearing in all seams from its start time
      * onward and disappearing again at its end frame.
      *
-     * Only events with duration appear in this map; point events
-     * appear only in m_events. Note that unlike m_events, we only
-     * store one instance of each event here, even if we hold many -
-     * we refer back to m_events when we need to know how many
-     * identical copies of a given event we have.
+     * Only events with duration appear in seams; point events appear
+     * only in events. Note that unlike events, we only store one
+     * instance of each event here, even if we hold many - we refer
+     * back to events when we need to know how many identical copies
+     * of a given event we have.
+     */
+    struct Seam {
+        sv_frame_t frame;
+        std::vector<Event> events;
+    };
+    typedef ChunkedVector<Seam> Seams;
+
+    static bool seamBefore(const Seam &s, sv_frame_t frame) {
+        return s.frame < frame;
+    }
+
+    /**
+     * Maximum numbers of events and of seams in a chunk. A seam may
+     * hold several events, so their chunks are smaller.
+     */
+    static const size_t eventChunkSize = 512;
+    static const size_t seamChunkSize = 128;
+
+    /**
+     * A set of events found in the seams, by address, ordered (and
+     * made unique) by event ordering. Used to gather the events with
+     * duration that are active across a range without copying them.
+     */
+    struct EventAddressLess {
+        bool operator()(const Event *a, const Event *b) const {
+            return *a < *b;
+        }
+    };
+    typedef std::set<const Event *, EventAddressLess> EventAddressSet;
+
+    struct Contents {
+        Contents() :
+            events(eventChunkSize), seams(seamChunkSize),
+            finalDurationlessEventFrame(0),
+            revision(++m_lastRevision) { }
+
+        Events events;
+        Seams seams;
+
+        /**
+         * The frame of the last durationless event we have in the
+         * series. This is to support a fast-ish getEndFrame(): we
+         * can easily keep this up-to-date when events are added or
+         * removed, and we can easily find the end frame of the last
+         * with-duration event from the seams, but it's not so easy to
+         * continuously update an overall end frame or to find the
+         * last frame of all events without this.
+         */
+        sv_frame_t finalDurationlessEventFrame;
+
+        /**
+         * Set from m_lastRevision on creation and on every edit.
+         */
+        int64_t revision;
+    };
+
+    static std::atomic<int64_t> m_lastRevision;
+
+    /**
+     * The contents may be shared with copies of this series, and
+     * must not be modified without calling detach() first.
+     */
+    std::shared_ptr<Contents> m_contents;
+
+    /**
+     * Ensure that our contents are not shared with any other series,
+     * taking a private copy of them if they are. This copies only the
+     * lists of chunks: the chunks themselves remain shared until they
+     * are modified.
+     *
+     * Call with m_mutex locked.
      */
-    typedef std::map<sv_frame_t, std::vector<Event>> FrameEventMap;
-    FrameEventMap m_seams;
+    void detach() {
+        if (m_contents.use_count() > 1) {
+            m_contents = std::make_shared<Contents>(*m_contents);
+        }
+    }
 
     /**
-     * The frame of the last durationless event we have in the series.
-     * This is to support a fast-ish getEndFrame(): we can easily keep
-     * this up-to-date when events are added or removed, and we can
-     * easily find the end frame of the last with-duration event from
-     * the seam map, but it's not so easy to continuously update an
-     * overall end frame or to find the last frame of all events
-     * without this.
+     * Return our contents, for a reader that wants to work on them
+     * without holding m_mutex. Because every modification detaches
+     * first, the returned contents will not change while the caller
+     * holds them - but that also means that any edit made while they
+     * are held has to copy the chunks it touches. Use this only for
+     * snapshots and for calling out to visitors; plain queries should
+     * hold m_mutex.
      */
-    sv_frame_t m_finalDurationlessEventFrame;
+    std::shared_ptr<const Contents> getContents() const {
+        QMutexLocker locker(&m_mutex);
+        return m_contents;
+    }
+
+    /**
+     * Call the visitor for every instance in events of each of the
+     * events in found, in order. Return false if the visitor stopped
+     * early.
+     */
+    static bool visitInstances(const Events &events,
+                               const EventAddressSet &found,
+                               const EventVisitor &visitor);
+
+    /**
+     * A function that returns false for the summary of a chunk of
+     * events if no event in the chunk can match a search.
+     */
+    typedef std::function<bool(const EventChunkSummary &)> ChunkFilter;
+
+    /**
+     * The queries behind the corresponding get and visit methods,
+     * run on the given contents. The get methods call these with
+     * m_mutex held and m_contents, the visit methods without the
+     * lock and with contents from getContents(). findNearestMatching
+     * skips chunks rejected by the filter, if one is given.
+     */
+    static bool visitSpanning(const Contents &contents,
+                              sv_frame_t frame,
+                              sv_frame_t duration,
+                              const EventVisitor &visitor);
+    static bool visitCovering(const Contents &contents,
+                              sv_frame_t frame,
+                              const EventVisitor &visitor);
+    static bool visitStartingWithin(const Contents &contents,
+                                    sv_frame_t frame,
+                                    sv_frame_t duration,
+                                    const EventVisitor &visitor);
+    static bool findNearestMatching(const Contents &contents,
+                                    sv_frame_t startSearchAt,
+                                    std::function<bool(const Event &)> predicate,
+                                    Direction direction,
+                                    Event &found,
+                                    const ChunkFilter &filter = {});
+
+    bool getNearestEventWithValue(sv_frame_t startSearchAt,
+                                  bool above, float threshold,
+                                  Direction direction,
+                                  Event &found) const;
     
     /** 
      * Create a seam at the given frame, copying from the prior seam
      * if there is one. If a seam already exists at the given frame,
      * leave it untouched.
      *
-     * Call with m_mutex locked.
+     * Call with m_mutex locked, after detach().
      */
     void createSeam(sv_frame_t frame) {
-        auto itr = m_seams.lower_bound(frame);
-        if (itr == m_seams.end() || itr->first > frame) {
-            if (itr != m_seams.begin()) {
-                --itr;
-            }
+        Seams &seams = m_contents->seams;
+        auto itr = seams.lowerBound(frame, seamBefore);
+        if (itr != seams.end() && itr->frame == frame) {
+            return;
         }
-        if (itr == m_seams.end()) {
-            m_seams[frame] = {};
-        } else if (itr->first < frame) {
-            m_seams[frame] = itr->second;
-        } else if (itr->first > frame) { // itr must be begin()
-            m_seams[frame] = {};
+        Seam seam { frame, {} };
+        if (itr != seams.begin()) {
+            auto prev = itr;
+            --prev;
+            seam.events = prev->events;
         }
+        seams.insert(itr, seam);
     }
 
     /** 
-     * Return true if the two seam map entries contain the same set of
+     * Return true if the two seams contain the same set of
      * events.
      *
      * Precondition: no duplicates, i.e. no event appears more than
@@ -356,18 +637,18 @@ private:
 
 #ifdef DEBUG_EVENT_SERIES
     void dumpEvents() const {
-        std::cerr << "EVENTS (" << m_events.size() << ") [" << std::endl;
-        for (const auto &i: m_events) {
+        std::cerr << "EVENTS (" << m_contents->events.size() << ") [" << std::endl;
+        for (const auto &i: m_contents->events) {
             std::cerr << "  " << i.toXmlString();
         }
         std::cerr << "]" << std::endl;
     }
     
     void dumpSeams() const {
-        std::cerr << "SEAMS (" << m_seams.size() << ") [" << std::endl;
-        for (const auto &s: m_seams) {
-            std::cerr << "  " << s.first << " -> {" << std::endl;
-            for (const auto &p: s.second) {
+        std::cerr << "SEAMS (" << m_contents->seams.size() << ") [" << std::endl;
+        for (const auto &s: m_contents->seams) {
+            std::cerr << "  " << s.frame << " -> {" << std::endl;
+            for (const auto &p: s.events) {
                 std::cerr << p.toXmlString("    ");
             }
             std::cerr << "  }" << std::endl;
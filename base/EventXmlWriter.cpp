@@ -0,0 +1,293 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#include "EventXmlWriter.h"
+
+#include "Profiler.h"
+
+#include <QTextCodec>
+#include <QThread>
+
+#include <thread>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+using namespace std;
+
+// Events per chunk when formatting in parallel. Sequences of fewer
+// than two chunks are formatted on the calling thread.
+static const size_t chunkSize = 8192;
+
+EventXmlWriter::EventXmlWriter(QString indent,
+                               Event::ExportNameOptions options) :
+    m_pointStart((indent + "<point frame=\"").toUtf8()),
+    m_valueStart((options.valueAttributeName + "=\"").toUtf8()),
+    m_levelStart((options.levelAttributeName + "=\"").toUtf8()),
+    m_uriStart((options.uriAttributeName + "=\"").toUtf8())
+{
+}
+
+void
+EventXmlWriter::appendInteger(QByteArray &buffer, long long value)
+{
+    char digits[24];
+    int n = 0;
+    
+    // Work in unsigned so that the most negative value is handled
+    unsigned long long u = (value < 0 ?
+                            0ull - (unsigned long long)value :
+                            (unsigned long long)value);
+    do {
+        digits[n++] = char('0' + u % 10);
+        u /= 10;
+    } while (u > 0);
+    
+    if (value < 0) {
+        buffer.append('-');
+    }
+    while (n > 0) {
+        buffer.append(digits[--n]);
+    }
+}
+
+void
+EventXmlWriter::appendFloat(QByteArray &buffer, double value)
+{
+    // QString::arg(double) formats with 'g' and precision 6, which
+    // is the same as printf's %g except for non-finite values
+
+    if (std::isnan(value)) {
+        buffer.append("nan");
+        return;
+    }
+    if (std::isinf(value)) {
+        buffer.append(value < 0 ? "-inf" : "inf");
+        return;
+    }
+
+    // Integral values of modest size are common (frame-like values,
+    // MIDI pitches, levels of 0 or 1) and need no printf
+    if (fabs(value) < 1e6 && value == double((long long)(value)) &&
+        !(value == 0.0 && std::signbit(value))) {
+        appendInteger(buffer, (long long)(value));
+        return;
+    }
+    
+    char text[32];
+    int n = snprintf(text, sizeof(text), "%g", value);
+
+    // Apart from digits, sign and exponent, the only thing %g can
+    // produce is the decimal point, which is locale-dependent while
+    // QString::arg always uses '.'
+    bool inPoint = false;
+    for (int i = 0; i < n; ++i) {
+        char c = text[i];
+        if ((c >= '0' && c <= '9') || c == '-' || c == '+' || c == 'e') {
+            buffer.append(c);
+            inPoint = false;
+        } else if (!inPoint) {
+            buffer.append('.');
+            inPoint = true;
+        }
+    }
+}
+
+void
+EventXmlWriter::appendEscaped(QByteArray &buffer, const QString &s)
+{
+    // The escaped characters are all ASCII, and so cannot appear
+    // within a multi-byte UTF-8 sequence, so it doesn't matter that
+    // we escape after encoding rather than before
+    
+    QByteArray utf8 = s.toUtf8();
+    const char *data = utf8.constData();
+    int n = utf8.size();
+    int from = 0;
+    
+    for (int i = 0; i < n; ++i) {
+        const char *entity = nullptr;
+        switch (data[i]) {
+        case '&': entity = "&amp;"; break;
+        case '<': entity = "&lt;"; break;
+        case '>': entity = "&gt;"; break;
+        case '"': entity = "&quot;"; break;
+        case '\'': entity = "&apos;"; break;
+        default: break;
+        }
+        if (entity) {
+            buffer.append(data + from, i - from);
+            buffer.append(entity);
+            from = i + 1;
+        }
+    }
+    
+    buffer.append(data + from, n - from);
+}
+
+void
+EventXmlWriter::append(QByteArray &buffer, const Event &e) const
+{
+    // This must match Event::toXml exactly
+
+    buffer.append(m_pointStart);
+    appendInteger(buffer, e.getFrame());
+    buffer.append("\" ");
+    
+    if (e.hasValue()) {
+        buffer.append(m_valueStart);
+        appendFloat(buffer, e.getValue());
+        buffer.append("\" ");
+    }
+    if (e.hasDuration()) {
+        buffer.append("duration=\"");
+        appendInteger(buffer, e.getDuration());
+        buffer.append("\" ");
+    }
+    if (e.hasLevel()) {
+        buffer.append(m_levelStart);
+        appendFloat(buffer, e.getLevel());
+        buffer.append("\" ");
+    }
+    if (e.hasReferenceFrame()) {
+        buffer.append("referenceFrame=\"");
+        appendInteger(buffer, e.getReferenceFrame());
+        buffer.append("\" ");
+    }
+
+    buffer.append("label=\"");
+    appendEscaped(buffer, e.getLabel());
+    buffer.append("\" ");
+
+    if (e.hasUri()) {
+        buffer.append(m_uriStart);
+        appendEscaped(buffer, e.getURI());
+        buffer.append("\" ");
+    }
+    
+    buffer.append("/>\n");
+}
+
+void
+EventXmlWriter::formatRanges(QByteArray &buffer,
+                             const EventRanges &ranges) const
+{
+    size_t n = 0;
+    for (const auto &r: ranges) {
+        n += size_t(r.second - r.first);
+    }
+    buffer.clear();
+    buffer.reserve(int(n) * (m_pointStart.size() + 64));
+    for (const auto &r: ranges) {
+        for (const Event *e = r.first; e != r.second; ++e) {
+            append(buffer, *e);
+        }
+    }
+}
+
+void
+EventXmlWriter::write(QTextStream &out, const vector<Event> &events) const
+{
+    if (events.empty()) return;
+    write(out, EventRanges { { events.data(), events.data() + events.size() } });
+}
+
+void
+EventXmlWriter::write(QTextStream &out, const EventRanges &ranges) const
+{
+    Profiler profiler("EventXmlWriter::write");
+
+    // Regroup the ranges into chunks of chunkSize events, splitting
+    // and joining them as necessary
+    
+    vector<EventRanges> chunks(1);
+    size_t inChunk = 0;
+    for (const auto &r: ranges) {
+        const Event *e = r.first;
+        while (e != r.second) {
+            size_t count = std::min(size_t(r.second - e), chunkSize - inChunk);
+            chunks.back().push_back({ e, e + count });
+            e += count;
+            inChunk += count;
+            if (inChunk == chunkSize) {
+                chunks.push_back({});
+                inChunk = 0;
+            }
+        }
+    }
+    if (chunks.back().empty()) {
+        chunks.pop_back();
+    }
+    
+    if (chunks.empty()) return;
+
+    // Writing straight to the device is only equivalent to writing
+    // through the stream if the stream would encode as UTF-8 and has
+    // nothing to add of its own
+    QIODevice *device = out.device();
+    bool direct = (device &&
+                   out.codec() &&
+                   out.codec()->mibEnum() == 106 && // UTF-8
+                   !out.generateByteOrderMark());
+    if (direct) {
+        out.flush();
+    }
+
+    auto writeBuffer = [&](const QByteArray &buffer) {
+        if (direct) {
+            device->write(buffer);
+        } else {
+            out << QString::fromUtf8(buffer);
+        }
+    };
+
+    size_t threads = size_t(std::max(QThread::idealThreadCount(), 1));
+
+    if (chunks.size() < 2 || threads < 2) {
+        QByteArray buffer;
+        for (const auto &chunk: chunks) {
+            formatRanges(buffer, chunk);
+            writeBuffer(buffer);
+        }
+        return;
+    }
+
+    // Format one chunk per thread at a time and write the results in
+    // order, so that no more than that many chunks are held at once
+
+    vector<QByteArray> buffers(threads);
+    
+    for (size_t first = 0; first < chunks.size(); first += threads) {
+
+        size_t count = std::min(threads, chunks.size() - first);
+        vector<std::thread> workers;
+
+        // The calling thread formats the first chunk of each round
+        for (size_t j = 1; j < count; ++j) {
+            const EventRanges &chunk = chunks[first + j];
+            workers.push_back(std::thread([=, &buffers, &chunk]() {
+                        formatRanges(buffers[j], chunk);
+                    }));
+        }
+
+        formatRanges(buffers[0], chunks[first]);
+
+        for (auto &w: workers) {
+            w.join();
+        }
+        for (size_t j = 0; j < count; ++j) {
+            writeBuffer(buffers[j]);
+        }
+    }
+}
@@ -0,0 +1,93 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef SV_EVENT_XML_WRITER_H
+#define SV_EVENT_XML_WRITER_H
+
+#include "Event.h"
+
+#include <QTextStream>
+#include <QByteArray>
+
+#include <vector>
+#include <utility>
+
+/**
+ * Write many events as XML <point> elements, producing the same
+ * output as calling Event::toXml for each of them in turn, but much
+ * faster. Each element is formatted directly into a UTF-8 byte
+ * buffer, without the QString::arg calls and intermediate strings
+ * that Event::toXml uses, and long sequences are formatted in chunks
+ * on several threads at once and then written out in order.
+ *
+ * If the target stream writes to a device using the UTF-8 codec, the
+ * formatted bytes are written straight to the device; otherwise they
+ * are converted back to a QString and written to the stream.
+ */
+class EventXmlWriter
+{
+public:
+    EventXmlWriter(QString indent,
+                   Event::ExportNameOptions options =
+                   Event::ExportNameOptions());
+
+    /**
+     * Write all of the given events to the stream, in order.
+     */
+    void write(QTextStream &out, const std::vector<Event> &events) const;
+
+    /**
+     * A list of contiguous arrays of events, each given by its begin
+     * and end pointers.
+     */
+    typedef std::vector<std::pair<const Event *, const Event *>> EventRanges;
+
+    /**
+     * Write all of the events in the given ranges to the stream, one
+     * range after another, as if they were a single sequence. This is
+     * for events that are stored in several separate arrays.
+     */
+    void write(QTextStream &out, const EventRanges &ranges) const;
+
+    /**
+     * Append the element for a single event to the given buffer, as
+     * UTF-8.
+     */
+    void append(QByteArray &buffer, const Event &e) const;
+
+    /**
+     * Append a number to the given buffer, formatted as QString::arg
+     * would format it with default arguments.
+     */
+    static void appendInteger(QByteArray &buffer, long long value);
+    static void appendFloat(QByteArray &buffer, double value);
+
+    /**
+     * Append a string to the given buffer, as UTF-8 with the
+     * entities escaped as XmlExportable::encodeEntities would.
+     */
+    static void appendEscaped(QByteArray &buffer, const QString &s);
+
+private:
+    // Pre-encoded fixed parts, e.g. indent + "<point frame=\"" and
+    // value attribute name + "=\""
+    QByteArray m_pointStart;
+    QByteArray m_valueStart;
+    QByteArray m_levelStart;
+    QByteArray m_uriStart;
+
+    void formatRanges(QByteArray &buffer, const EventRanges &ranges) const;
+};
+
+#endif
@@ -0,0 +1,180 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#include "NoteCursor.h"
+#include "NoteExportable.h"
+#include "EventSeries.h"
+
+#include <algorithm>
+#include <limits>
+
+using namespace std;
+
+NoteCursor::NoteCursor(const NoteExportable *exportable) :
+    m_exportable(exportable),
+    m_series(nullptr),
+    m_revision(0),
+    m_sampleRate(0),
+    m_valueIsMidiPitch(true),
+    m_windowStart(0),
+    m_windowEnd(0),
+    m_index(0),
+    m_position(0)
+{
+}
+
+bool
+NoteCursor::refresh()
+{
+    sv_samplerate_t sampleRate = 0;
+    bool valueIsMidiPitch = true;
+    const EventSeries *series =
+        m_exportable->getNoteEvents(sampleRate, valueIsMidiPitch);
+
+    if (!series) {
+        m_series = nullptr;
+        return false;
+    }
+
+    int64_t revision = series->getRevision();
+
+    if (series != m_series ||
+        revision != m_revision ||
+        sampleRate != m_sampleRate ||
+        valueIsMidiPitch != m_valueIsMidiPitch) {
+
+        m_series = series;
+        m_revision = revision;
+        m_sampleRate = sampleRate;
+        m_valueIsMidiPitch = valueIsMidiPitch;
+
+        // Discard the window, to be refilled from the current
+        // position when next needed
+        m_window.clear();
+        m_index = 0;
+        m_windowStart = m_position;
+        m_windowEnd = m_position;
+    }
+
+    return true;
+}
+
+void
+NoteCursor::fill(sv_frame_t from)
+{
+    // Convert the next windowSize or so notes from the given frame
+    // onward. We never end the window partway through the notes at
+    // a single frame, so that the window always holds every note
+    // starting between its start and end
+
+    const sv_frame_t maxFrame = numeric_limits<sv_frame_t>::max();
+
+    m_window.clear(); // retaining its capacity for reuse
+    m_index = 0;
+    m_windowStart = from;
+    m_windowEnd = maxFrame;
+
+    sv_frame_t lastFrame = from;
+
+    m_series->visitEventsStartingWithin
+        (from, from < 0 ? maxFrame : maxFrame - from,
+         [&](const Event &e) {
+             if (m_window.size() >= windowSize && e.getFrame() > lastFrame) {
+                 m_windowEnd = e.getFrame();
+                 return false;
+             }
+             m_window.push_back(e.toNoteData(m_sampleRate,
+                                             m_valueIsMidiPitch));
+             lastFrame = e.getFrame();
+             return true;
+         });
+}
+
+void
+NoteCursor::moveTo(sv_frame_t frame)
+{
+    if (frame >= m_windowStart && frame <= m_windowEnd) {
+        m_index = size_t(lower_bound(m_window.begin(), m_window.end(), frame,
+                                     [](const NoteData &n, sv_frame_t f) {
+                                         return n.start < f;
+                                     }) - m_window.begin());
+    } else {
+        m_window.clear();
+        m_index = 0;
+        m_windowStart = frame;
+        m_windowEnd = frame;
+    }
+    m_position = frame;
+}
+
+void
+NoteCursor::getNotesStartingWithin(sv_frame_t startFrame,
+                                   sv_frame_t duration,
+                                   NoteList &notes)
+{
+    if (!refresh()) {
+        NoteList found =
+            m_exportable->getNotesStartingWithin(startFrame, duration);
+        notes.insert(notes.end(), found.begin(), found.end());
+        m_position = startFrame + duration;
+        return;
+    }
+
+    if (startFrame != m_position) {
+        moveTo(startFrame);
+    }
+
+    const sv_frame_t endFrame = startFrame + duration;
+
+    while (true) {
+        while (m_index < m_window.size() &&
+               m_window[m_index].start < endFrame) {
+            notes.push_back(m_window[m_index]);
+            ++m_index;
+        }
+        if (m_index < m_window.size() || m_windowEnd >= endFrame) {
+            break;
+        }
+        fill(m_windowEnd);
+    }
+
+    m_position = endFrame;
+}
+
+void
+NoteCursor::getNotesActiveAt(sv_frame_t frame, NoteList &notes)
+{
+    if (!refresh()) {
+        NoteList found = m_exportable->getNotesActiveAt(frame);
+        notes.insert(notes.end(), found.begin(), found.end());
+        m_position = frame;
+        return;
+    }
+
+    m_series->visitEventsCovering
+        (frame,
+         [&](const Event &e) {
+             notes.push_back(e.toNoteData(m_sampleRate, m_valueIsMidiPitch));
+             return true;
+         });
+
+    moveTo(frame);
+}
+
+void
+NoteCursor::seek(sv_frame_t frame)
+{
+    refresh();
+    moveTo(frame);
+}
@@ -0,0 +1,104 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef SV_NOTE_CURSOR_H
+#define SV_NOTE_CURSOR_H
+
+#include "NoteData.h"
+
+class EventSeries;
+class NoteExportable;
+
+/**
+ * A playback cursor over the notes of a NoteExportable, for a caller
+ * (such as an audio generator) that asks for the notes starting
+ * within each of a succession of adjacent blocks of frames.
+ *
+ * The cursor keeps a window of notes, already converted to NoteData,
+ * from the current position onward, and hands them out in order as
+ * successive blocks are requested: advancing by one block costs
+ * nothing more than the notes it returns, apart from refilling the
+ * window every few hundred notes. A request for a block that does
+ * not start where the previous one ended is treated as a seek.
+ *
+ * If the exportable makes its notes from an EventSeries (see
+ * NoteExportable::getNoteEvents), the cursor checks the revision of
+ * the series at the start of each request and notices any edit to
+ * it, or any change to how its events are converted, reloading its
+ * window from the current position only. Otherwise it falls back to
+ * asking the exportable for the notes in each block.
+ *
+ * A cursor is not thread-safe, and must not outlive its exportable;
+ * the exportable may be edited from another thread while the cursor
+ * is in use.
+ */
+class NoteCursor
+{
+public:
+    NoteCursor(const NoteExportable *exportable);
+
+    /**
+     * Append to notes those notes that start within the range in
+     * frames defined by the given start frame and duration, in order
+     * of start frame. This is fast if startFrame is the end of the
+     * range passed to the previous call.
+     */
+    void getNotesStartingWithin(sv_frame_t startFrame,
+                                sv_frame_t duration,
+                                NoteList &notes);
+
+    /**
+     * Append to notes those notes that are active at the given frame,
+     * i.e. that start before or at this frame and have not ended by
+     * it, and move the cursor to that frame. Call this when starting
+     * playback, or seeking, in the middle of the notes.
+     */
+    void getNotesActiveAt(sv_frame_t frame, NoteList &notes);
+
+    /**
+     * Move the cursor to the given frame, so that the next call to
+     * getNotesStartingWithin starting at that frame is fast.
+     */
+    void seek(sv_frame_t frame);
+
+private:
+    const NoteExportable *m_exportable;
+
+    const EventSeries *m_series;
+    int64_t m_revision;
+    sv_samplerate_t m_sampleRate;
+    bool m_valueIsMidiPitch;
+
+    /**
+     * The notes starting at or after m_windowStart and before
+     * m_windowEnd, in order, and the index of the next one to return.
+     */
+    NoteList m_window;
+    sv_frame_t m_windowStart;
+    sv_frame_t m_windowEnd;
+    size_t m_index;
+
+    /**
+     * The frame at which the next block is expected to start.
+     */
+    sv_frame_t m_position;
+
+    static const size_t windowSize = 256;
+
+    bool refresh();
+    void fill(sv_frame_t from);
+    void moveTo(sv_frame_t frame);
+};
+
+#endif
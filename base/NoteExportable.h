@@ -17,6 +17,8 @@
 
 #include "NoteData.h"
 
+class EventSeries;
+
 class NoteExportable
 {
 public:
@@ -39,6 +41,22 @@ public:
      */
     virtual NoteList getNotesStartingWithin(sv_frame_t startFrame,
                                             sv_frame_t duration) const = 0;
+
+    /**
+     * If the notes are simply the events in an EventSeries, each
+     * converted using Event::toNoteData, return that series and set
+     * sampleRate and valueIsMidiPitch to the arguments to pass to
+     * toNoteData. The series must live as long as this object.
+     * Otherwise return nullptr, as this default implementation does.
+     *
+     * NoteCursor uses this to convert events to notes only once
+     * during playback, rather than on every call.
+     */
+    virtual const EventSeries *getNoteEvents
+    (sv_samplerate_t & /* sampleRate */,
+     bool & /* valueIsMidiPitch */) const {
+        return nullptr;
+    }
 };
 
 #endif
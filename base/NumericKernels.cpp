@@ -0,0 +1,588 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#include "NumericKernels.h"
+
+#include <cmath>
+#include <atomic>
+#include <algorithm>
+
+// The instruction-set-specific implementations are compiled with
+// per-function target attributes (GCC and Clang) or rely on the
+// compiler accepting any intrinsic (MSVC), so that this file can be
+// built for the baseline architecture and still contain them
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SV_KERNELS_X86 1
+#define SV_TARGET(t) __attribute__((target(t)))
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#define SV_KERNELS_X86 1
+#define SV_TARGET(t)
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define SV_KERNELS_NEON 1
+#endif
+
+#ifdef SV_KERNELS_X86
+#include <immintrin.h>
+#endif
+
+#ifdef SV_KERNELS_NEON
+#include <arm_neon.h>
+#endif
+
+typedef CPUFeatures::ISA ISA;
+typedef NumericKernels::Implementations Implementations;
+
+namespace scalar {
+
+static void scale(float *data, sv_frame_t n, float gain)
+{
+    for (sv_frame_t i = 0; i < n; ++i) {
+        data[i] *= gain;
+    }
+}
+
+static void addScaled(float *dst, const float *src, float gain, sv_frame_t n)
+{
+    for (sv_frame_t i = 0; i < n; ++i) {
+        dst[i] += src[i] * gain;
+    }
+}
+
+static float sumAbs(const float *src, sv_frame_t n)
+{
+    float sum = 0.f;
+    for (sv_frame_t i = 0; i < n; ++i) {
+        sum += fabsf(src[i]);
+    }
+    return sum;
+}
+
+static float maxAbs(const float *src, sv_frame_t n)
+{
+    float max = 0.f;
+    for (sv_frame_t i = 0; i < n; ++i) {
+        float v = fabsf(src[i]);
+        if (v > max) max = v;
+    }
+    return max;
+}
+
+static void minMaxSumAbs(const float *src, sv_frame_t n,
+                         float &min, float &max, float &sumAbs)
+{
+    min = max = src[0];
+    sumAbs = 0.f;
+    for (sv_frame_t i = 0; i < n; ++i) {
+        float v = src[i];
+        if (v < min) min = v;
+        if (v > max) max = v;
+        sumAbs += fabsf(v);
+    }
+}
+
+}
+
+#ifdef SV_KERNELS_X86
+
+namespace sse2 {
+
+SV_TARGET("sse2")
+static inline __m128 absMask()
+{
+    return _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+}
+
+SV_TARGET("sse2")
+static inline float hsum(__m128 v)
+{
+    __m128 sh = _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1));
+    v = _mm_add_ps(v, sh);
+    sh = _mm_movehl_ps(sh, v);
+    v = _mm_add_ss(v, sh);
+    return _mm_cvtss_f32(v);
+}
+
+SV_TARGET("sse2")
+static inline float hmax(__m128 v)
+{
+    v = _mm_max_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1)));
+    v = _mm_max_ps(v, _mm_movehl_ps(v, v));
+    return _mm_cvtss_f32(v);
+}
+
+SV_TARGET("sse2")
+static inline float hmin(__m128 v)
+{
+    v = _mm_min_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1)));
+    v = _mm_min_ps(v, _mm_movehl_ps(v, v));
+    return _mm_cvtss_f32(v);
+}
+
+SV_TARGET("sse2")
+static void scale(float *data, sv_frame_t n, float gain)
+{
+    __m128 g = _mm_set1_ps(gain);
+    sv_frame_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        _mm_storeu_ps(data + i, _mm_mul_ps(_mm_loadu_ps(data + i), g));
+    }
+    scalar::scale(data + i, n - i, gain);
+}
+
+SV_TARGET("sse2")
+static void addScaled(float *dst, const float *src, float gain, sv_frame_t n)
+{
+    __m128 g = _mm_set1_ps(gain);
+    sv_frame_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128 p = _mm_mul_ps(_mm_loadu_ps(src + i), g);
+        _mm_storeu_ps(dst + i, _mm_add_ps(_mm_loadu_ps(dst + i), p));
+    }
+    scalar::addScaled(dst + i, src + i, gain, n - i);
+}
+
+SV_TARGET("sse2")
+static float sumAbs(const float *src, sv_frame_t n)
+{
+    __m128 mask = absMask();
+    __m128 acc = _mm_setzero_ps();
+    sv_frame_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        acc = _mm_add_ps(acc, _mm_and_ps(_mm_loadu_ps(src + i), mask));
+    }
+    return hsum(acc) + scalar::sumAbs(src + i, n - i);
+}
+
+SV_TARGET("sse2")
+static float maxAbs(const float *src, sv_frame_t n)
+{
+    __m128 mask = absMask();
+    __m128 acc = _mm_setzero_ps();
+    sv_frame_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        acc = _mm_max_ps(acc, _mm_and_ps(_mm_loadu_ps(src + i), mask));
+    }
+    return std::max(hmax(acc), scalar::maxAbs(src + i, n - i));
+}
+
+SV_TARGET("sse2")
+static void minMaxSumAbs(const float *src, sv_frame_t n,
+                         float &min, float &max, float &sumAbs)
+{
+    if (n < 4) {
+        scalar::minMaxSumAbs(src, n, min, max, sumAbs);
+        return;
+    }
+    __m128 mask = absMask();
+    __m128 vmin = _mm_loadu_ps(src), vmax = vmin;
+    __m128 acc = _mm_setzero_ps();
+    sv_frame_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128 v = _mm_loadu_ps(src + i);
+        vmin = _mm_min_ps(vmin, v);
+        vmax = _mm_max_ps(vmax, v);
+        acc = _mm_add_ps(acc, _mm_and_ps(v, mask));
+    }
+    min = hmin(vmin);
+    max = hmax(vmax);
+    sumAbs = hsum(acc);
+    for (; i < n; ++i) {
+        float v = src[i];
+        if (v < min) min = v;
+        if (v > max) max = v;
+        sumAbs += fabsf(v);
+    }
+}
+
+}
+
+namespace avx2 {
+
+SV_TARGET("avx2,fma")
+static inline __m256 absMask()
+{
+    return _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+}
+
+SV_TARGET("avx2,fma")
+static inline float hsum(__m256 v)
+{
+    return sse2::hsum(_mm_add_ps(_mm256_castps256_ps128(v),
+                                 _mm256_extractf128_ps(v, 1)));
+}
+
+SV_TARGET("avx2,fma")
+static inline float hmax(__m256 v)
+{
+    return sse2::hmax(_mm_max_ps(_mm256_castps256_ps128(v),
+                                 _mm256_extractf128_ps(v, 1)));
+}
+
+SV_TARGET("avx2,fma")
+static inline float hmin(__m256 v)
+{
+    return sse2::hmin(_mm_min_ps(_mm256_castps256_ps128(v),
+                                 _mm256_extractf128_ps(v, 1)));
+}
+
+SV_TARGET("avx2,fma")
+static void scale(float *data, sv_frame_t n, float gain)
+{
+    __m256 g = _mm256_set1_ps(gain);
+    sv_frame_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        _mm256_storeu_ps(data + i, _mm256_mul_ps(_mm256_loadu_ps(data + i), g));
+    }
+    scalar::scale(data + i, n - i, gain);
+}
+
+SV_TARGET("avx2,fma")
+static void addScaled(float *dst, const float *src, float gain, sv_frame_t n)
+{
+    __m256 g = _mm256_set1_ps(gain);
+    sv_frame_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        _mm256_storeu_ps(dst + i, _mm256_fmadd_ps(_mm256_loadu_ps(src + i), g,
+                                                  _mm256_loadu_ps(dst + i)));
+    }
+    scalar::addScaled(dst + i, src + i, gain, n - i);
+}
+
+SV_TARGET("avx2,fma")
+static float sumAbs(const float *src, sv_frame_t n)
+{
+    __m256 mask = absMask();
+    __m256 acc = _mm256_setzero_ps();
+    sv_frame_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        acc = _mm256_add_ps(acc, _mm256_and_ps(_mm256_loadu_ps(src + i), mask));
+    }
+    return hsum(acc) + scalar::sumAbs(src + i, n - i);
+}
+
+SV_TARGET("avx2,fma")
+static float maxAbs(const float *src, sv_frame_t n)
+{
+    __m256 mask = absMask();
+    __m256 acc = _mm256_setzero_ps();
+    sv_frame_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        acc = _mm256_max_ps(acc, _mm256_and_ps(_mm256_loadu_ps(src + i), mask));
+    }
+    return std::max(hmax(acc),
+                    scalar::maxAbs(src + i, n - i));
+}
+
+SV_TARGET("avx2,fma")
+static void minMaxSumAbs(const float *src, sv_frame_t n,
+                         float &min, float &max, float &sumAbs)
+{
+    if (n < 8) {
+        sse2::minMaxSumAbs(src, n, min, max, sumAbs);
+        return;
+    }
+    __m256 mask = absMask();
+    __m256 vmin = _mm256_loadu_ps(src), vmax = vmin;
+    __m256 acc = _mm256_setzero_ps();
+    sv_frame_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256 v = _mm256_loadu_ps(src + i);
+        vmin = _mm256_min_ps(vmin, v);
+        vmax = _mm256_max_ps(vmax, v);
+        acc = _mm256_add_ps(acc, _mm256_and_ps(v, mask));
+    }
+    min = hmin(vmin);
+    max = hmax(vmax);
+    sumAbs = hsum(acc);
+    for (; i < n; ++i) {
+        float v = src[i];
+        if (v < min) min = v;
+        if (v > max) max = v;
+        sumAbs += fabsf(v);
+    }
+}
+
+}
+
+// GCC's own AVX-512 intrinsic headers provoke spurious warnings
+// about uninitialised variables when inlined here
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+
+namespace avx512 {
+
+SV_TARGET("avx512f")
+static void scale(float *data, sv_frame_t n, float gain)
+{
+    __m512 g = _mm512_set1_ps(gain);
+    sv_frame_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        _mm512_storeu_ps(data + i, _mm512_mul_ps(_mm512_loadu_ps(data + i), g));
+    }
+    scalar::scale(data + i, n - i, gain);
+}
+
+SV_TARGET("avx512f")
+static void addScaled(float *dst, const float *src, float gain, sv_frame_t n)
+{
+    __m512 g = _mm512_set1_ps(gain);
+    sv_frame_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        _mm512_storeu_ps(dst + i, _mm512_fmadd_ps(_mm512_loadu_ps(src + i), g,
+                                                  _mm512_loadu_ps(dst + i)));
+    }
+    scalar::addScaled(dst + i, src + i, gain, n - i);
+}
+
+SV_TARGET("avx512f")
+static float sumAbs(const float *src, sv_frame_t n)
+{
+    __m512 acc = _mm512_setzero_ps();
+    sv_frame_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        acc = _mm512_add_ps(acc, _mm512_abs_ps(_mm512_loadu_ps(src + i)));
+    }
+    return _mm512_reduce_add_ps(acc) + scalar::sumAbs(src + i, n - i);
+}
+
+SV_TARGET("avx512f")
+static float maxAbs(const float *src, sv_frame_t n)
+{
+    __m512 acc = _mm512_setzero_ps();
+    sv_frame_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        acc = _mm512_max_ps(acc, _mm512_abs_ps(_mm512_loadu_ps(src + i)));
+    }
+    return std::max(_mm512_reduce_max_ps(acc), scalar::maxAbs(src + i, n - i));
+}
+
+SV_TARGET("avx512f")
+static void minMaxSumAbs(const float *src, sv_frame_t n,
+                         float &min, float &max, float &sumAbs)
+{
+    if (n < 16) {
+        sse2::minMaxSumAbs(src, n, min, max, sumAbs);
+        return;
+    }
+    __m512 vmin = _mm512_loadu_ps(src), vmax = vmin;
+    __m512 acc = _mm512_setzero_ps();
+    sv_frame_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m512 v = _mm512_loadu_ps(src + i);
+        vmin = _mm512_min_ps(vmin, v);
+        vmax = _mm512_max_ps(vmax, v);
+        acc = _mm512_add_ps(acc, _mm512_abs_ps(v));
+    }
+    min = _mm512_reduce_min_ps(vmin);
+    max = _mm512_reduce_max_ps(vmax);
+    sumAbs = _mm512_reduce_add_ps(acc);
+    for (; i < n; ++i) {
+        float v = src[i];
+        if (v < min) min = v;
+        if (v > max) max = v;
+        sumAbs += fabsf(v);
+    }
+}
+
+}
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+#endif // SV_KERNELS_X86
+
+#ifdef SV_KERNELS_NEON
+
+namespace neon {
+
+static void scale(float *data, sv_frame_t n, float gain)
+{
+    sv_frame_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        vst1q_f32(data + i, vmulq_n_f32(vld1q_f32(data + i), gain));
+    }
+    scalar::scale(data + i, n - i, gain);
+}
+
+static void addScaled(float *dst, const float *src, float gain, sv_frame_t n)
+{
+    sv_frame_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        vst1q_f32(dst + i, vmlaq_n_f32(vld1q_f32(dst + i),
+                                       vld1q_f32(src + i), gain));
+    }
+    scalar::addScaled(dst + i, src + i, gain, n - i);
+}
+
+static float sumAbs(const float *src, sv_frame_t n)
+{
+    float32x4_t acc = vdupq_n_f32(0.f);
+    sv_frame_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        acc = vaddq_f32(acc, vabsq_f32(vld1q_f32(src + i)));
+    }
+    return vaddvq_f32(acc) + scalar::sumAbs(src + i, n - i);
+}
+
+static float maxAbs(const float *src, sv_frame_t n)
+{
+    float32x4_t acc = vdupq_n_f32(0.f);
+    sv_frame_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        acc = vmaxq_f32(acc, vabsq_f32(vld1q_f32(src + i)));
+    }
+    return std::max(vmaxvq_f32(acc), scalar::maxAbs(src + i, n - i));
+}
+
+static void minMaxSumAbs(const float *src, sv_frame_t n,
+                         float &min, float &max, float &sumAbs)
+{
+    if (n < 4) {
+        scalar::minMaxSumAbs(src, n, min, max, sumAbs);
+        return;
+    }
+    float32x4_t vmin = vld1q_f32(src), vmax = vmin;
+    float32x4_t acc = vdupq_n_f32(0.f);
+    sv_frame_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        float32x4_t v = vld1q_f32(src + i);
+        vmin = vminq_f32(vmin, v);
+        vmax = vmaxq_f32(vmax, v);
+        acc = vaddq_f32(acc, vabsq_f32(v));
+    }
+    min = vminvq_f32(vmin);
+    max = vmaxvq_f32(vmax);
+    sumAbs = vaddvq_f32(acc);
+    for (; i < n; ++i) {
+        float v = src[i];
+        if (v < min) min = v;
+        if (v > max) max = v;
+        sumAbs += fabsf(v);
+    }
+}
+
+}
+
+#endif // SV_KERNELS_NEON
+
+static const int isaCount = int(ISA::NEON) + 1;
+
+struct Registry {
+
+    Implementations resolved[isaCount];
+    bool specific[isaCount];
+
+    Registry() {
+
+        Implementations none = { nullptr, nullptr, nullptr, nullptr, nullptr };
+        Implementations own[isaCount];
+        for (int i = 0; i < isaCount; ++i) {
+            own[i] = none;
+            specific[i] = false;
+        }
+
+        own[int(ISA::Scalar)] = {
+            scalar::scale, scalar::addScaled, scalar::sumAbs,
+            scalar::maxAbs, scalar::minMaxSumAbs
+        };
+
+#ifdef SV_KERNELS_X86
+        own[int(ISA::SSE2)] = {
+            sse2::scale, sse2::addScaled, sse2::sumAbs,
+            sse2::maxAbs, sse2::minMaxSumAbs
+        };
+        own[int(ISA::AVX2)] = {
+            avx2::scale, avx2::addScaled, avx2::sumAbs,
+            avx2::maxAbs, avx2::minMaxSumAbs
+        };
+        own[int(ISA::AVX512)] = {
+            avx512::scale, avx512::addScaled, avx512::sumAbs,
+            avx512::maxAbs, avx512::minMaxSumAbs
+        };
+        specific[int(ISA::SSE2)] = true;
+        specific[int(ISA::AVX2)] = true;
+        specific[int(ISA::AVX512)] = true;
+#endif
+#ifdef SV_KERNELS_NEON
+        own[int(ISA::NEON)] = {
+            neon::scale, neon::addScaled, neon::sumAbs,
+            neon::maxAbs, neon::minMaxSumAbs
+        };
+        specific[int(ISA::NEON)] = true;
+#endif
+
+        // Fill in each kernel missing for an instruction set from
+        // the one below it in its chain of fallbacks
+
+        for (int i = 0; i < isaCount; ++i) {
+            ISA isa = ISA(i);
+            Implementations &r = resolved[i];
+            r = own[i];
+            ISA fallback = isa;
+            while (fallback != ISA::Scalar) {
+                if (fallback == ISA::NEON) fallback = ISA::Scalar;
+                else fallback = ISA(int(fallback) - 1);
+                const Implementations &f = own[int(fallback)];
+                if (!r.scale) r.scale = f.scale;
+                if (!r.addScaled) r.addScaled = f.addScaled;
+                if (!r.sumAbs) r.sumAbs = f.sumAbs;
+                if (!r.maxAbs) r.maxAbs = f.maxAbs;
+                if (!r.minMaxSumAbs) r.minMaxSumAbs = f.minMaxSumAbs;
+            }
+        }
+    }
+};
+
+static const Registry &
+getRegistry()
+{
+    static Registry registry;
+    return registry;
+}
+
+const Implementations *
+NumericKernels::getImplementations(ISA isa)
+{
+    return &getRegistry().resolved[int(isa)];
+}
+
+bool
+NumericKernels::hasImplementationsFor(ISA isa)
+{
+    return getRegistry().specific[int(isa)];
+}
+
+static std::atomic<const Implementations *> activeImplementations(nullptr);
+static std::atomic<int> activeGeneration(-1);
+
+const Implementations *
+NumericKernels::active()
+{
+    // Two threads may race to resolve this after a change of ISA,
+    // but they will arrive at the same answer, and every table is
+    // valid for the lifetime of the program
+    int generation = CPUFeatures::getGeneration();
+    const Implementations *impl = activeImplementations;
+    if (!impl || activeGeneration != generation) {
+        impl = getImplementations(CPUFeatures::getActiveISA());
+        activeImplementations = impl;
+        activeGeneration = generation;
+    }
+    return impl;
+}
@@ -0,0 +1,112 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef SV_NUMERIC_KERNELS_H
+#define SV_NUMERIC_KERNELS_H
+
+#include "BaseTypes.h"
+#include "CPUFeatures.h"
+
+/**
+ * Numeric inner loops with implementations for more than one
+ * instruction set, of which the one to use is chosen at run time
+ * according to CPUFeatures::getActiveISA(). This means a single
+ * binary built for the baseline architecture can still use e.g. AVX2
+ * where it is available.
+ *
+ * Every kernel has a scalar reference implementation, which is what
+ * the others are tested against. An instruction set for which a
+ * kernel has no specific implementation falls back to the next lower
+ * one that has (ending with the scalar one).
+ *
+ * Results from the vector implementations may differ from the scalar
+ * ones in the last bits of floating-point sums, because they add in
+ * a different order.
+ */
+class NumericKernels
+{
+public:
+    /**
+     * Multiply n values in place by gain.
+     */
+    static void scale(float *data, sv_frame_t n, float gain) {
+        active()->scale(data, n, gain);
+    }
+
+    /**
+     * Add each of n values from src, multiplied by gain, to the
+     * corresponding value in dst.
+     */
+    static void addScaled(float *dst, const float *src, float gain,
+                          sv_frame_t n) {
+        active()->addScaled(dst, src, gain, n);
+    }
+
+    /**
+     * Return the sum of the absolute values of n values.
+     */
+    static float sumAbs(const float *src, sv_frame_t n) {
+        return active()->sumAbs(src, n);
+    }
+
+    /**
+     * Return the largest absolute value of n values, or zero if n is
+     * zero.
+     */
+    static float maxAbs(const float *src, sv_frame_t n) {
+        return active()->maxAbs(src, n);
+    }
+
+    /**
+     * Find the minimum, maximum, and sum of absolute values, of n
+     * values. n must be greater than zero.
+     */
+    static void minMaxSumAbs(const float *src, sv_frame_t n,
+                             float &min, float &max, float &sumAbs) {
+        active()->minMaxSumAbs(src, n, min, max, sumAbs);
+    }
+
+    /**
+     * A complete set of kernel implementations for one instruction
+     * set.
+     */
+    struct Implementations {
+        void (*scale)(float *, sv_frame_t, float);
+        void (*addScaled)(float *, const float *, float, sv_frame_t);
+        float (*sumAbs)(const float *, sv_frame_t);
+        float (*maxAbs)(const float *, sv_frame_t);
+        void (*minMaxSumAbs)(const float *, sv_frame_t,
+                             float &, float &, float &);
+    };
+
+    /**
+     * Return the implementations that would be used if the given
+     * instruction set were active (including fallbacks for kernels
+     * it has no specific implementation of). This is intended for
+     * tests and benchmarks; the caller must check that the
+     * instruction set is supported before calling any of them.
+     */
+    static const Implementations *getImplementations(CPUFeatures::ISA isa);
+
+    /**
+     * Return true if the given instruction set has its own
+     * implementation of at least one kernel in this build.
+     */
+    static bool hasImplementationsFor(CPUFeatures::ISA isa);
+
+private:
+    static const Implementations *active();
+};
+
+#endif
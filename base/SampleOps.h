@@ -0,0 +1,222 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef SV_SAMPLE_OPS_H
+#define SV_SAMPLE_OPS_H
+
+#include "BaseTypes.h"
+#include "NumericKernels.h"
+
+#include <cstdint>
+
+/**
+ * Class containing static functions for moving audio sample data
+ * between interleaved and per-channel layouts, for mixing
+ * interleaved channels down to one, and for converting samples to
+ * and from 16-bit integers for compact storage, as used on the audio
+ * read path.
+ *
+ * These are plain loops rather than hand-vectorised code. The common
+ * channel counts (1, 2, 4 and 8) are handled by specialisations in
+ * which the channel count is a compile-time constant, so that the
+ * compiler can unroll the loop over channels; other channel counts go
+ * through a generic path. Operations on contiguous samples, such as
+ * scaling, belong in NumericKernels, which selects an
+ * instruction-set-specific implementation at run time. All functions
+ * accept a frame count of zero.
+ */
+class SampleOps
+{
+public:
+    /**
+     * Copy the single channel at index channel out of frames frames
+     * of interleaved data having the given number of channels, into
+     * out, which must have room for frames samples.
+     */
+    static void extractChannel(const float *in, int channels, int channel,
+                               float *out, sv_frame_t frames) {
+        switch (channels) {
+        case 1: copy(in, out, frames); break;
+        case 2: extractFixed<2>(in, channel, out, frames); break;
+        case 4: extractFixed<4>(in, channel, out, frames); break;
+        case 8: extractFixed<8>(in, channel, out, frames); break;
+        default:
+            for (sv_frame_t i = 0; i < frames; ++i) {
+                out[i] = in[i * channels + channel];
+            }
+        }
+    }
+
+    /**
+     * De-interleave the contiguous range of channels starting at
+     * fromchannel and reqchannels long, from frames frames of
+     * interleaved data having the given number of channels. out must
+     * contain reqchannels pointers, each with room for frames
+     * samples.
+     */
+    static void deinterleave(const float *in, int channels,
+                             int fromchannel, int reqchannels,
+                             float *const *out, sv_frame_t frames) {
+        if (fromchannel == 0 && reqchannels == channels) {
+            switch (channels) {
+            case 1: copy(in, out[0], frames); return;
+            case 2: deinterleaveFixed<2>(in, out, frames); return;
+            case 4: deinterleaveFixed<4>(in, out, frames); return;
+            case 8: deinterleaveFixed<8>(in, out, frames); return;
+            default: break;
+            }
+        }
+        for (int c = 0; c < reqchannels; ++c) {
+            extractChannel(in, channels, fromchannel + c, out[c], frames);
+        }
+    }
+
+    /**
+     * Interleave frames frames from the given number of separate
+     * channel buffers into out, which must have room for frames *
+     * channels samples.
+     */
+    static void interleave(const float *const *in, int channels,
+                           float *out, sv_frame_t frames) {
+        switch (channels) {
+        case 1: copy(in[0], out, frames); break;
+        case 2: interleaveFixed<2>(in, out, frames); break;
+        case 4: interleaveFixed<4>(in, out, frames); break;
+        case 8: interleaveFixed<8>(in, out, frames); break;
+        default:
+            for (int c = 0; c < channels; ++c) {
+                const float *src = in[c];
+                for (sv_frame_t i = 0; i < frames; ++i) {
+                    out[i * channels + c] = src[i];
+                }
+            }
+        }
+    }
+
+    /**
+     * Mix frames frames of interleaved data having the given number
+     * of channels down to a single channel in out, multiplying the
+     * sum of the channels by gain. Pass a gain of 1.0 for a plain
+     * sum, or 1.0 / channels for a mean.
+     */
+    static void mixdown(const float *in, int channels,
+                        float *out, sv_frame_t frames, float gain) {
+        switch (channels) {
+        case 1:
+            copy(in, out, frames);
+            if (gain != 1.f) NumericKernels::scale(out, frames, gain);
+            break;
+        case 2: mixdownFixed<2>(in, out, frames, gain); break;
+        case 4: mixdownFixed<4>(in, out, frames, gain); break;
+        case 8: mixdownFixed<8>(in, out, frames, gain); break;
+        default:
+            for (sv_frame_t i = 0; i < frames; ++i) {
+                const float *frame = in + i * channels;
+                float sum = 0.f;
+                for (int c = 0; c < channels; ++c) {
+                    sum += frame[c];
+                }
+                out[i] = sum * gain;
+            }
+        }
+    }
+
+    /**
+     * Convert n samples to 16-bit integers, multiplying each by gain
+     * and rounding to the nearest integer. Values outside the range
+     * of a 16-bit integer after scaling are clamped to it.
+     */
+    static void toInt16(const float *in, int16_t *out, sv_frame_t n,
+                        float gain) {
+        for (sv_frame_t i = 0; i < n; ++i) {
+            float v = in[i] * gain;
+            v = (v < -32768.f ? -32768.f : (v > 32767.f ? 32767.f : v));
+            // Round half away from zero, explicitly, so as not to
+            // depend on the rounding mode
+            out[i] = int16_t(v < 0.f ? v - 0.5f : v + 0.5f);
+        }
+    }
+
+    /**
+     * Convert n 16-bit integer samples to float, multiplying each by
+     * gain.
+     */
+    static void fromInt16(const int16_t *in, float *out, sv_frame_t n,
+                          float gain) {
+        for (sv_frame_t i = 0; i < n; ++i) {
+            out[i] = float(in[i]) * gain;
+        }
+    }
+
+private:
+    static void copy(const float *in, float *out, sv_frame_t n) {
+        for (sv_frame_t i = 0; i < n; ++i) {
+            out[i] = in[i];
+        }
+    }
+
+    template <int Channels>
+    static void extractFixed(const float *in, int channel,
+                             float *out, sv_frame_t frames) {
+        const float *src = in + channel;
+        for (sv_frame_t i = 0; i < frames; ++i) {
+            out[i] = src[i * Channels];
+        }
+    }
+
+    template <int Channels>
+    static void deinterleaveFixed(const float *in, float *const *out,
+                                  sv_frame_t frames) {
+        float *dest[Channels];
+        for (int c = 0; c < Channels; ++c) {
+            dest[c] = out[c];
+        }
+        for (sv_frame_t i = 0; i < frames; ++i) {
+            const float *frame = in + i * Channels;
+            for (int c = 0; c < Channels; ++c) {
+                dest[c][i] = frame[c];
+            }
+        }
+    }
+
+    template <int Channels>
+    static void interleaveFixed(const float *const *in, float *out,
+                                sv_frame_t frames) {
+        const float *src[Channels];
+        for (int c = 0; c < Channels; ++c) {
+            src[c] = in[c];
+        }
+        for (sv_frame_t i = 0; i < frames; ++i) {
+            float *frame = out + i * Channels;
+            for (int c = 0; c < Channels; ++c) {
+                frame[c] = src[c][i];
+            }
+        }
+    }
+
+    template <int Channels>
+    static void mixdownFixed(const float *in, float *out,
+                             sv_frame_t frames, float gain) {
+        for (sv_frame_t i = 0; i < frames; ++i) {
+            const float *frame = in + i * Channels;
+            float sum = 0.f;
+            for (int c = 0; c < Channels; ++c) {
+                sum += frame[c];
+            }
+            out[i] = sum * gain;
+        }
+    }
+};
+
+#endif
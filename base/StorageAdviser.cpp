@@ -20,7 +20,12 @@
 
 #include "system/System.h"
 
+#include <QMutex>
+#include <QMutexLocker>
+#include <QSettings>
+
 #include <iostream>
+#include <algorithm>
 
 QString
 StorageAdviser::criteriaToString(int criteria)
@@ -92,33 +97,12 @@ StorageAdviser::recommend(Criteria criteria,
     }
     ssize_t discFree = GetDiscSpaceMBAvailable(path.toLocal8Bit());
     ssize_t memoryFree, memoryTotal;
-    GetRealMemoryMBAvailable(memoryFree, memoryTotal);
+    getMemoryAvailable(memoryFree, memoryTotal);
 
     SVDEBUG << "StorageAdviser: disc space: " << discFree
-            << "M, memory free: " << memoryFree
+            << "M, memory free after planned allocations: " << memoryFree
             << "M, memory total: " << memoryTotal << "M" << endl;
 
-    // In 32-bit addressing mode we can't address more than 4Gb.
-    // If the total memory is reported as more than 4Gb, we should
-    // reduce the available amount by the difference between 4Gb
-    // and the total. This won't give us an accurate idea of the
-    // amount of memory available any more, but it should be enough
-    // to prevent us from trying to allocate more for our own use
-    // than can be addressed at all!
-    if (sizeof(void *) < 8) {
-        if (memoryTotal > 4096) {
-            ssize_t excess = memoryTotal - 4096;
-            if (memoryFree > excess) {
-                memoryFree -= excess;
-            } else {
-                memoryFree = 0;
-            }
-            SVDEBUG << "StorageAdviser: more real memory found than we "
-                    << "can address in a 32-bit process, reducing free "
-                    << "estimate to " << memoryFree << "M accordingly" << endl;
-        }
-    }
-
     SVDEBUG << "StorageAdviser: disc planned: " << (m_discPlanned / 1024)
             << "K, memory planned: " << (m_memoryPlanned / 1024) << "K" << endl;
     SVDEBUG << "StorageAdviser: min requested: " << minimumSize
@@ -130,31 +114,18 @@ StorageAdviser::recommend(Criteria criteria,
         discFree = 0;
     }
 
-    if (memoryFree > ssize_t(m_memoryPlanned / 1024 + 1)) {
-        memoryFree -= m_memoryPlanned / 1024 + 1;
-    } else if (memoryFree > 0) { // can also be -1 for unknown
-        memoryFree = 0;
-    }
-
     //!!! We have a potentially serious problem here if multiple
     //recommendations are made in advance of any of the resulting
     //allocations, as the allocations that have been recommended for
     //won't be taken into account in subsequent recommendations.
 
-    StorageStatus memoryStatus = Unknown;
     StorageStatus discStatus = Unknown;
 
     ssize_t minmb = ssize_t(minimumSize / 1024 + 1);
     ssize_t maxmb = ssize_t(maximumSize / 1024 + 1);
 
-    if (memoryFree == -1) memoryStatus = Unknown;
-    else if (memoryFree < memoryTotal / 3 && memoryFree < 512) memoryStatus = Insufficient;
-    else if (minmb > (memoryFree * 3) / 4) memoryStatus = Insufficient;
-    else if (maxmb > (memoryFree * 3) / 4) memoryStatus = Marginal;
-    else if (minmb > (memoryFree / 3)) memoryStatus = Marginal;
-    else if (memoryTotal == -1 ||
-             minmb > (memoryTotal / 10)) memoryStatus = Marginal;
-    else memoryStatus = Sufficient;
+    StorageStatus memoryStatus =
+        getMemoryStatus(memoryFree, memoryTotal, minmb, maxmb);
 
     if (discFree == -1) discStatus = Unknown;
     else if (minmb > (discFree * 3) / 4) discStatus = Insufficient;
@@ -244,6 +215,73 @@ StorageAdviser::recommend(Criteria criteria,
     return Recommendation(recommendation);
 }
 
+bool
+StorageAdviser::isMemoryConstrained(size_t size)
+{
+    if (m_baseRecommendation != NoRecommendation) {
+        return (m_baseRecommendation & ConserveSpace);
+    }
+
+    ssize_t memoryFree, memoryTotal;
+    getMemoryAvailable(memoryFree, memoryTotal);
+
+    ssize_t mb = ssize_t(size / 1024 + 1);
+    StorageStatus status = getMemoryStatus(memoryFree, memoryTotal, mb, mb);
+
+    SVDEBUG << "StorageAdviser::isMemoryConstrained: size " << size
+            << "K, memory free " << memoryFree << "M, status " << status
+            << " (" << storageStatusToString(status) << ")" << endl;
+
+    return (status == Marginal || status == Insufficient);
+}
+
+void
+StorageAdviser::getMemoryAvailable(ssize_t &memoryFree, ssize_t &memoryTotal)
+{
+    GetRealMemoryMBAvailable(memoryFree, memoryTotal);
+
+    // In 32-bit addressing mode we can't address more than 4Gb.
+    // If the total memory is reported as more than 4Gb, we should
+    // reduce the available amount by the difference between 4Gb
+    // and the total. This won't give us an accurate idea of the
+    // amount of memory available any more, but it should be enough
+    // to prevent us from trying to allocate more for our own use
+    // than can be addressed at all!
+    if (sizeof(void *) < 8) {
+        if (memoryTotal > 4096) {
+            ssize_t excess = memoryTotal - 4096;
+            if (memoryFree > excess) {
+                memoryFree -= excess;
+            } else {
+                memoryFree = 0;
+            }
+            SVDEBUG << "StorageAdviser: more real memory found than we "
+                    << "can address in a 32-bit process, reducing free "
+                    << "estimate to " << memoryFree << "M accordingly" << endl;
+        }
+    }
+
+    if (memoryFree > ssize_t(m_memoryPlanned / 1024 + 1)) {
+        memoryFree -= m_memoryPlanned / 1024 + 1;
+    } else if (memoryFree > 0) { // can also be -1 for unknown
+        memoryFree = 0;
+    }
+}
+
+StorageAdviser::StorageStatus
+StorageAdviser::getMemoryStatus(ssize_t memoryFree, ssize_t memoryTotal,
+                                ssize_t minmb, ssize_t maxmb)
+{
+    if (memoryFree == -1) return Unknown;
+    else if (memoryFree < memoryTotal / 3 && memoryFree < 512) return Insufficient;
+    else if (minmb > (memoryFree * 3) / 4) return Insufficient;
+    else if (maxmb > (memoryFree * 3) / 4) return Marginal;
+    else if (minmb > (memoryFree / 3)) return Marginal;
+    else if (memoryTotal == -1 ||
+             minmb > (memoryTotal / 10)) return Marginal;
+    else return Sufficient;
+}
+
 void
 StorageAdviser::notifyPlannedAllocation(AllocationArea area, size_t size)
 {
@@ -273,3 +311,157 @@ StorageAdviser::setFixedRecommendation(Recommendation recommendation)
     m_baseRecommendation = recommendation;
 }
 
+
+size_t StorageAdviser::m_tierUsage[StorageAdviser::TierCount] = { 0, 0, 0 };
+size_t StorageAdviser::m_tierCapacity[StorageAdviser::TierCount] = { 0, 0, 0 };
+bool StorageAdviser::m_tierCapacityOverridden[StorageAdviser::TierCount] = {
+    false, false, false
+};
+
+static QMutex tierMutex;
+
+QString
+StorageAdviser::tierToString(StorageTier tier)
+{
+    if (tier == MemoryTier) return "memory";
+    if (tier == FastDiscTier) return "fast";
+    return "bulk";
+}
+
+StorageAdviser::StorageTier
+StorageAdviser::getPreferredTier(CacheType type)
+{
+    StorageTier tier = BulkDiscTier;
+    QString key;
+
+    switch (type) {
+    case SummaryCache: tier = MemoryTier; key = "summary"; break;
+    case AnalysisCache: tier = MemoryTier; key = "analysis"; break;
+    case DecodeCache: tier = FastDiscTier; key = "decode"; break;
+    case TemporaryCache: tier = FastDiscTier; key = "temporary"; break;
+    case PersistentCache: tier = BulkDiscTier; key = "persistent"; break;
+    }
+
+    QSettings settings;
+    settings.beginGroup("StorageAdviser");
+    QString placement =
+        settings.value("placement-" + key, tierToString(tier)).toString();
+    settings.endGroup();
+
+    if (placement == "memory") tier = MemoryTier;
+    else if (placement == "fast") tier = FastDiscTier;
+    else if (placement == "bulk") tier = BulkDiscTier;
+    
+    return tier;
+}
+
+StorageAdviser::StorageTier
+StorageAdviser::recommendTier(CacheType type, size_t size, Criteria criteria)
+{
+    int tier = getPreferredTier(type);
+
+    if (criteria & FrequentLookupLikely) {
+        if (tier > MemoryTier) --tier;
+    } else if (criteria & LongRetentionLikely) {
+        if (tier < BulkDiscTier) ++tier;
+    }
+
+    // A fixed recommendation of UseDisc rules out the memory tier,
+    // as it does for recommend()
+    if (tier == MemoryTier && (m_baseRecommendation & UseDisc)) {
+        ++tier;
+    }
+
+    while (tier < BulkDiscTier) {
+        size_t capacity = getTierCapacity(StorageTier(tier));
+        size_t usage = getTierUsage(StorageTier(tier));
+        if (capacity == 0 || usage + size <= capacity) {
+            break;
+        }
+        SVDEBUG << "StorageAdviser::recommendTier: " << size << "K would "
+                << "exceed capacity of " << tierToString(StorageTier(tier))
+                << " tier (" << usage << "K of " << capacity
+                << "K in use), demoting" << endl;
+        ++tier;
+    }
+
+    SVDEBUG << "StorageAdviser::recommendTier: cache type " << type
+            << ", size " << size << "K, criteria " << criteria << " ("
+            << criteriaToString(criteria) << "): recommending "
+            << tierToString(StorageTier(tier)) << " tier" << endl;
+    
+    return StorageTier(tier);
+}
+
+size_t
+StorageAdviser::getTierCapacity(StorageTier tier)
+{
+    size_t capacity = 0;
+
+    {
+        QMutexLocker locker(&tierMutex);
+        if (m_tierCapacityOverridden[tier]) {
+            capacity = m_tierCapacity[tier];
+        } else {
+            QSettings settings;
+            settings.beginGroup("StorageAdviser");
+            QString key = tierToString(tier) + "-tier-mb";
+            capacity = settings.value(key, 0).toULongLong() * 1024;
+            settings.endGroup();
+        }
+    }
+
+    if (tier == MemoryTier && m_baseRecommendation == NoRecommendation) {
+
+        // Never recommend more memory than would leave us short, as
+        // with getMemoryStatus: at most three quarters of what is
+        // free, counting what is in use in the tier as available to
+        // it
+        
+        ssize_t memoryFree, memoryTotal;
+        getMemoryAvailable(memoryFree, memoryTotal);
+        if (memoryFree >= 0) {
+            size_t available = size_t(memoryFree) * 1024 * 3 / 4 +
+                getTierUsage(MemoryTier);
+            if (capacity == 0 || available < capacity) {
+                capacity = std::max(available, size_t(1));
+            }
+        }
+    }
+
+    return capacity;
+}
+
+void
+StorageAdviser::setTierCapacity(StorageTier tier, size_t size)
+{
+    QMutexLocker locker(&tierMutex);
+    m_tierCapacity[tier] = size;
+    m_tierCapacityOverridden[tier] = true;
+}
+
+size_t
+StorageAdviser::getTierUsage(StorageTier tier)
+{
+    QMutexLocker locker(&tierMutex);
+    return m_tierUsage[tier];
+}
+
+void
+StorageAdviser::notifyTierAllocation(StorageTier tier, size_t size)
+{
+    QMutexLocker locker(&tierMutex);
+    m_tierUsage[tier] += size;
+    SVDEBUG << "StorageAdviser: " << tierToString(tier) << " tier usage up: now "
+            << m_tierUsage[tier] << "K" << endl;
+}
+
+void
+StorageAdviser::notifyTierRelease(StorageTier tier, size_t size)
+{
+    QMutexLocker locker(&tierMutex);
+    if (m_tierUsage[tier] > size) m_tierUsage[tier] -= size;
+    else m_tierUsage[tier] = 0;
+    SVDEBUG << "StorageAdviser: " << tierToString(tier) << " tier usage down: now "
+            << m_tierUsage[tier] << "K" << endl;
+}
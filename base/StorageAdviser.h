@@ -17,6 +17,8 @@
 #ifndef SV_STORAGE_ADVISER_H
 #define SV_STORAGE_ADVISER_H
 
+#include "system/System.h"
+
 #include <cstdlib>
 
 #include <QString>
@@ -64,6 +66,17 @@ public:
                                     size_t minimumSize,
                                     size_t maximumSize);
 
+    /**
+     * Return true if memory is tight enough that storing the given
+     * amount of data (in kilobytes) there would leave little to
+     * spare, so that a caller that has already decided to use memory
+     * should use a more compact representation if it has one. This
+     * is false if the amount of free memory can't be determined. If
+     * a fixed recommendation has been set, this is true only if that
+     * recommendation includes ConserveSpace.
+     */
+    static bool isMemoryConstrained(size_t size);
+
     enum AllocationArea {
         MemoryAllocation,
         DiscAllocation
@@ -89,11 +102,100 @@ public:
      */
     static void setFixedRecommendation(Recommendation recommendation);
 
+    /**
+     * Storage tiers, fastest first. FastDiscTier corresponds to the
+     * TempDirectory::FastDisc temporary directory and BulkDiscTier to
+     * the default one; if no fast disc location is configured, the
+     * two are the same place.
+     */
+    enum StorageTier {
+        MemoryTier,
+        FastDiscTier,
+        BulkDiscTier
+    };
+
+    /**
+     * Kinds of cache, for placement in tiers.
+     */
+    enum CacheType {
+        SummaryCache,    // Small, hot data, e.g. waveform summaries
+        AnalysisCache,   // FFT, peak and similar derived caches
+        DecodeCache,     // Decoded audio from compressed files
+        TemporaryCache,  // Intermediate files from temporary writers
+        PersistentCache  // Data kept between sessions
+    };
+
+    /**
+     * Recommend a tier in which to store a cache of the given type
+     * and approximate size (in kilobytes, or zero if not yet known).
+     *
+     * Each cache type has a preferred tier: memory for summary and
+     * analysis caches, fast disc for decode and temporary caches,
+     * and bulk disc for persistent caches. These may be overridden
+     * using the "placement-summary", "placement-analysis",
+     * "placement-decode", "placement-temporary" and
+     * "placement-persistent" settings in the StorageAdviser settings
+     * group, with a value of "memory", "fast" or "bulk".
+     *
+     * The criteria adjust the preferred tier for the expected access
+     * pattern: FrequentLookupLikely promotes to the next faster tier,
+     * while LongRetentionLikely without FrequentLookupLikely demotes
+     * to the next slower one. The result is then demoted further for
+     * as long as the cache would not fit in the capacity remaining
+     * in the chosen tier. The bulk disc tier is always accepted as a
+     * last resort.
+     *
+     * A cache that can only be held in memory, or only on disc,
+     * should use the nearest tier to the recommended one that it
+     * can.
+     */
+    static StorageTier recommendTier(CacheType type,
+                                     size_t size,
+                                     Criteria criteria = NoCriteria);
+
+    /**
+     * Return the capacity (in kilobytes) of the given tier, or zero
+     * if it is unlimited. Capacities are taken from the
+     * "memory-tier-mb", "fast-tier-mb" and "bulk-tier-mb" settings
+     * in the StorageAdviser settings group, unless overridden with
+     * setTierCapacity. The memory tier is additionally limited by
+     * the amount of memory actually available.
+     */
+    static size_t getTierCapacity(StorageTier tier);
+
+    /**
+     * Override the configured capacity (in kilobytes) of the given
+     * tier. Zero means unlimited.
+     */
+    static void setTierCapacity(StorageTier tier, size_t size);
+
+    /**
+     * Return the amount (in kilobytes) currently recorded as in use
+     * in the given tier.
+     */
+    static size_t getTierUsage(StorageTier tier);
+
+    /**
+     * Record that the given amount of storage (in kilobytes) has
+     * been allocated in, or released from, the given tier.
+     */
+    static void notifyTierAllocation(StorageTier tier, size_t size);
+    static void notifyTierRelease(StorageTier tier, size_t size);
+
+    static QString tierToString(StorageTier);
+
 private:
     static size_t m_discPlanned;
     static size_t m_memoryPlanned;
     static Recommendation m_baseRecommendation;
 
+    static const int TierCount = 3;
+    static size_t m_tierUsage[TierCount];
+    static size_t m_tierCapacity[TierCount];
+    static bool m_tierCapacityOverridden[TierCount];
+
+    static StorageTier getPreferredTier(CacheType type);
+
     enum StorageStatus {
         Unknown,
         Insufficient,
@@ -101,6 +203,13 @@ private:
         Sufficient
     };
 
+    static void getMemoryAvailable(ssize_t &memoryFree,
+                                   ssize_t &memoryTotal);
+    static StorageStatus getMemoryStatus(ssize_t memoryFree,
+                                         ssize_t memoryTotal,
+                                         ssize_t minmb,
+                                         ssize_t maxmb);
+
     static QString criteriaToString(int);
     static QString recommendationToString(int);
     static QString storageStatusToString(StorageStatus);
@@ -38,7 +38,9 @@ TempDirectory::getInstance()
 }
 
 TempDirectory::TempDirectory() :
-    m_tmpdir("")
+    m_tmpdir(""),
+    m_fastTmpdir(""),
+    m_fastUnavailable(false)
 {
 }
 
@@ -52,7 +54,17 @@ TempDirectory::~TempDirectory()
 void
 TempDirectory::cleanup()
 {
-    cleanupDirectory("");
+    QMutexLocker locker(&m_mutex);
+
+    if (m_fastTmpdir != "") {
+        cleanupDirectory(m_fastTmpdir);
+        m_fastTmpdir = "";
+    }
+
+    if (m_tmpdir != "") {
+        cleanupDirectory(m_tmpdir);
+        m_tmpdir = "";
+    }
 }
 
 QString
@@ -65,6 +77,14 @@ TempDirectory::getContainingPath()
     QString svDirParent = settings.value("create-in", "$HOME").toString();
     settings.endGroup();
 
+    return getContainingPathIn(svDirParent);
+}
+
+QString
+TempDirectory::getContainingPathIn(QString svDirParent)
+{
+    // Entered with mutex held.
+
     QString svDir = ResourceFinder().getUserResourcePrefix();
     if (svDirParent != "$HOME") {
         //!!! iffy
@@ -86,12 +106,75 @@ TempDirectory::getContainingPath()
     return svDir;
 }    
 
+QString
+TempDirectory::getFastContainingPath()
+{
+    // Entered with mutex held. Returns "" if no fast location has
+    // been configured.
+
+    QSettings settings;
+    settings.beginGroup("TempDirectory");
+    QString fastDirParent = settings.value("fast-create-in", "").toString();
+    settings.endGroup();
+
+    if (fastDirParent == "") return "";
+
+    return getContainingPathIn(fastDirParent);
+}
+
+bool
+TempDirectory::haveFastDisc()
+{
+    QMutexLocker locker(&m_mutex);
+
+    if (m_fastTmpdir != "") return true;
+    if (m_fastUnavailable) return false;
+
+    QSettings settings;
+    settings.beginGroup("TempDirectory");
+    QString fastDirParent = settings.value("fast-create-in", "").toString();
+    settings.endGroup();
+
+    return fastDirParent != "";
+}
+
 QString
 TempDirectory::getPath()
 {
     if (m_tmpdir != "") return m_tmpdir;
 
-    return createTempDirectoryIn(getContainingPath());
+    m_tmpdir = createTempDirectoryIn(getContainingPath());
+    return m_tmpdir;
+}
+
+QString
+TempDirectory::getPath(DiscTier tier)
+{
+    if (tier == DefaultDisc) return getPath();
+
+    {
+        QMutexLocker locker(&m_mutex);
+
+        if (m_fastTmpdir != "") return m_fastTmpdir;
+
+        if (!m_fastUnavailable) {
+            try {
+                QString containing = getFastContainingPath();
+                if (containing != "") {
+                    m_fastTmpdir = createTempDirectoryIn(containing);
+                    return m_fastTmpdir;
+                }
+            } catch (const DirectoryCreationFailed &f) {
+                SVCERR << "WARNING: TempDirectory::getPath: Failed to create "
+                       << "temporary directory in fast location ("
+                       << f.what() << "), using default location instead"
+                       << endl;
+            }
+            m_fastUnavailable = true;
+        }
+    }
+
+    return getPath();
 }
 
 QString
@@ -100,6 +183,7 @@ TempDirectory::createTempDirectoryIn(QString dir)
     // Entered with mutex held.
 
     QDir tempDirBase(dir);
+    QString tmpdir;
 
     // Generate a temporary directory.  Qt4.1 doesn't seem to be able
     // to do this for us, and mkdtemp is not standard.  This method is
@@ -128,35 +212,41 @@ TempDirectory::createTempDirectoryIn(QString dir)
         QString candidate = QString("sv_%1").arg(suffix);
 
         if (tempDirBase.mkpath(candidate)) {
-            m_tmpdir = tempDirBase.filePath(candidate);
+            tmpdir = tempDirBase.filePath(candidate);
             break;
         }
 
         r = r + 7777;
     }
 
-    if (m_tmpdir == "") {
+    if (tmpdir == "") {
         throw DirectoryCreationFailed(QString("temporary subdirectory in %1")
                                       .arg(tempDirBase.canonicalPath()));
     }
 
-    QString pidpath = QDir(m_tmpdir).filePath(QString("%1.pid").arg(getpid()));
+    QString pidpath = QDir(tmpdir).filePath(QString("%1.pid").arg(getpid()));
     QFile pidfile(pidpath);
 
     if (!pidfile.open(QIODevice::WriteOnly)) {
         throw DirectoryCreationFailed(QString("pid file creation in %1")
-                                      .arg(m_tmpdir));
+                                      .arg(tmpdir));
     } else {
         pidfile.close();
     }
 
-    return m_tmpdir;
+    return tmpdir;
 }
 
 QString
 TempDirectory::getSubDirectoryPath(QString subdir)
 {
-    QString tmpdirpath = getPath();
+    return getSubDirectoryPath(subdir, DefaultDisc);
+}
+
+QString
+TempDirectory::getSubDirectoryPath(QString subdir, DiscTier tier)
+{
+    QString tmpdirpath = getPath(tier);
     
     QMutexLocker locker(&m_mutex);
 
@@ -179,20 +269,7 @@ TempDirectory::getSubDirectoryPath(QString subdir)
 void
 TempDirectory::cleanupDirectory(QString tmpdir)
 {
-    bool isRoot = false;
-
-    if (tmpdir == "") {
-
-        m_mutex.lock();
-
-        isRoot = true;
-        tmpdir = m_tmpdir;
-
-        if (tmpdir == "") {
-            m_mutex.unlock();
-            return;
-        }
-    }
+    // Entered with mutex held.
 
     QDir dir(tmpdir);
     dir.setFilter(QDir::Dirs | QDir::Files);
@@ -228,11 +305,6 @@ TempDirectory::cleanupDirectory(QString tmpdir)
                       << dirname << endl;
         } 
     }
-
-    if (isRoot) {
-        m_tmpdir = "";
-        m_mutex.unlock();
-    }
 }
 
 void
@@ -27,6 +27,14 @@
  * root temporary directory for the program, created on demand and
  * deleted when the program exits.
  *
+ * Optionally a second root temporary directory may be used on a
+ * separate, faster volume (such as a local SSD where the containing
+ * path is on a larger but slower disc) for cache data that is read
+ * intensively. This is configured using the "fast-create-in" setting
+ * in the TempDirectory settings group, alongside the "create-in"
+ * setting for the containing path. If no fast location is set, the
+ * fast tier is the same as the default one.
+ *
  * This class is thread safe.
  */
 
@@ -34,6 +42,11 @@ class TempDirectory
 {
 public:
     static TempDirectory *getInstance();
+
+    enum DiscTier {
+        DefaultDisc,
+        FastDisc
+    };
     
     virtual ~TempDirectory();
 
@@ -60,6 +73,22 @@ public:
      */
     QString getPath();
 
+    /**
+     * Create the root temporary directory for the given tier if
+     * necessary, and return its path. For DefaultDisc, or if no fast
+     * location has been configured, this is the same as getPath().
+     *
+     * Throw DirectoryCreationFailed if the directory cannot be
+     * created.
+     */
+    QString getPath(DiscTier tier);
+
+    /**
+     * Return true if a fast location has been configured, distinct
+     * from the default one.
+     */
+    bool haveFastDisc();
+
     /** 
      * Create an immediate subdirectory of the root temporary
      * directory of the given name, if it doesn't already exist, and
@@ -71,19 +100,29 @@ public:
      */
     QString getSubDirectoryPath(QString subdir);
 
+    /** 
+     * As getSubDirectoryPath(QString), but within the root temporary
+     * directory for the given tier.
+     */
+    QString getSubDirectoryPath(QString subdir, DiscTier tier);
+
     /**
-     * Delete the temporary directory (before exiting).
+     * Delete the temporary directories (before exiting).
      */
     void cleanup();
 
 protected:
     TempDirectory();
 
+    QString getContainingPathIn(QString svDirParent);
+    QString getFastContainingPath();
     QString createTempDirectoryIn(QString inDir);
     void cleanupDirectory(QString tmpDir);
     void cleanupAbandonedDirectories(QString svDir);
 
     QString m_tmpdir;
+    QString m_fastTmpdir;
+    bool m_fastUnavailable;
     QMutex m_mutex;
 
     static TempDirectory *m_instance;
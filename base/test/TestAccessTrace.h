@@ -0,0 +1,230 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+    
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef TEST_ACCESS_TRACE_H
+#define TEST_ACCESS_TRACE_H
+
+#include "../AccessTracer.h"
+#include "../AccessTraceSimulator.h"
+
+#include <QObject>
+#include <QtTest>
+#include <QTemporaryDir>
+
+#include <iostream>
+#include <map>
+#include <thread>
+
+using namespace std;
+
+class TestAccessTrace : public QObject
+{
+    Q_OBJECT
+
+    static AccessTracer::Record column(uint64_t object, int64_t n) {
+        AccessTracer::Record r;
+        r.time = 0;
+        r.object = object;
+        r.start = n;
+        r.count = 1;
+        r.thread = 1;
+        r.channel = 0;
+        r.source = AccessTracer::FFTColumn;
+        r.outcome = AccessTracer::Unknown;
+        return r;
+    }
+
+private slots:
+    void roundTrip() {
+
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        QString path = dir.filePath("trace.svtrace");
+
+        auto tracer = AccessTracer::getInstance();
+        QVERIFY(tracer->start(path));
+        QVERIFY(AccessTracer::isActive());
+
+        AccessTracer::record(AccessTracer::FFTColumn, 7, 1, 42, 1,
+                             AccessTracer::Hit);
+        AccessTracer::record(AccessTracer::AudioFileRead, 9, -1, 1024, 512,
+                             AccessTracer::Partial);
+
+        tracer->stop();
+        QVERIFY(!AccessTracer::isActive());
+
+        // Not recorded, as tracing has stopped
+        AccessTracer::record(AccessTracer::FFTColumn, 7, 1, 43, 1);
+
+        vector<AccessTracer::Record> records;
+        QVERIFY(AccessTracer::readTrace(path, records));
+        QCOMPARE(int(records.size()), 2);
+
+        QCOMPARE(int(records[0].source), int(AccessTracer::FFTColumn));
+        QCOMPARE(records[0].object, uint64_t(7));
+        QCOMPARE(int(records[0].channel), 1);
+        QCOMPARE(records[0].start, int64_t(42));
+        QCOMPARE(records[0].count, int64_t(1));
+        QCOMPARE(int(records[0].outcome), int(AccessTracer::Hit));
+
+        QCOMPARE(int(records[1].source), int(AccessTracer::AudioFileRead));
+        QCOMPARE(records[1].object, uint64_t(9));
+        QCOMPARE(int(records[1].channel), -1);
+        QCOMPARE(records[1].start, int64_t(1024));
+        QCOMPARE(records[1].count, int64_t(512));
+        QCOMPARE(int(records[1].outcome), int(AccessTracer::Partial));
+
+        QVERIFY(records[0].time <= records[1].time);
+        QCOMPARE(records[0].thread, records[1].thread);
+    }
+
+    void threads() {
+
+        // Enough records from each thread to fill its ring several
+        // times over, all of which should arrive, in order for each
+        // thread and in time order overall
+
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        QString path = dir.filePath("threads.svtrace");
+
+        auto tracer = AccessTracer::getInstance();
+        QVERIFY(tracer->start(path));
+
+        const int threadCount = 4, perThread = 50000;
+        vector<thread> threads;
+        for (int i = 0; i < threadCount; ++i) {
+            threads.push_back(thread([=]() {
+                        for (int j = 0; j < perThread; ++j) {
+                            AccessTracer::record(AccessTracer::FFTColumn,
+                                                 uint64_t(i), 0, j, 1);
+                        }
+                    }));
+        }
+        for (auto &t: threads) {
+            t.join();
+        }
+
+        tracer->stop();
+
+        vector<AccessTracer::Record> records;
+        QVERIFY(AccessTracer::readTrace(path, records));
+        QCOMPARE(int(records.size()), threadCount * perThread);
+
+        map<uint64_t, int64_t> next;
+        map<uint64_t, uint32_t> serial;
+        for (int i = 0; i < int(records.size()); ++i) {
+            const auto &r = records[i];
+            QCOMPARE(r.start, next[r.object]);
+            ++next[r.object];
+            if (serial.find(r.object) == serial.end()) {
+                serial[r.object] = r.thread;
+            }
+            QCOMPARE(r.thread, serial[r.object]);
+            if (i > 0) {
+                QVERIFY(records[i-1].time <= r.time);
+            }
+        }
+        QCOMPARE(int(serial.size()), threadCount);
+    }
+
+    void notATrace() {
+
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        QString path = dir.filePath("other");
+
+        QFile file(path);
+        QVERIFY(file.open(QFile::WriteOnly));
+        file.write("This is not a trace file");
+        file.close();
+
+        vector<AccessTracer::Record> records;
+        QVERIFY(!AccessTracer::readTrace(path, records));
+        QVERIFY(records.empty());
+    }
+
+    void lruVersusFifo() {
+
+        // Columns 0, 1, 0, 2, 0: with two slots, LRU keeps column 0
+        // throughout, while FIFO evicts it when column 2 arrives
+
+        vector<AccessTracer::Record> records;
+        for (auto n: { 0, 1, 0, 2, 0 }) {
+            records.push_back(column(1, n));
+        }
+
+        auto lru = AccessTraceSimulator(AccessTraceSimulator::LRU, 2)
+            .replay(records)[AccessTracer::FFTColumn];
+        QCOMPARE(lru.hits, int64_t(2));
+        QCOMPARE(lru.misses, int64_t(3));
+
+        auto fifo = AccessTraceSimulator(AccessTraceSimulator::FIFO, 2)
+            .replay(records)[AccessTracer::FFTColumn];
+        QCOMPARE(fifo.hits, int64_t(1));
+        QCOMPARE(fifo.misses, int64_t(4));
+    }
+
+    void separateObjects() {
+
+        // The same column from two different models never hits
+        vector<AccessTracer::Record> records;
+        records.push_back(column(1, 5));
+        records.push_back(column(2, 5));
+        records.push_back(column(1, 5));
+
+        auto result = AccessTraceSimulator(AccessTraceSimulator::LRU, 10)
+            .replay(records)[AccessTracer::FFTColumn];
+        QCOMPARE(result.hits, int64_t(1));
+        QCOMPARE(result.misses, int64_t(2));
+    }
+
+    void frameBlocks() {
+
+        // With 100-frame blocks, frames 0-249 cover blocks 0-2, and a
+        // following read of 150-199 falls entirely within block 1
+        AccessTracer::Record r = column(1, 0);
+        r.source = AccessTracer::AudioFileRead;
+        r.count = 250;
+        vector<AccessTracer::Record> records { r };
+        r.start = 150;
+        r.count = 50;
+        records.push_back(r);
+
+        auto result = AccessTraceSimulator(AccessTraceSimulator::LRU, 10, 100)
+            .replay(records)[AccessTracer::AudioFileRead];
+        QCOMPARE(result.hits, int64_t(1));
+        QCOMPARE(result.misses, int64_t(3));
+        QCOMPARE(result.getHitRate(), 0.25);
+    }
+
+    void recorded() {
+
+        vector<AccessTracer::Record> records;
+        for (auto outcome: { AccessTracer::Hit, AccessTracer::Hit,
+                             AccessTracer::Partial, AccessTracer::Miss,
+                             AccessTracer::Unknown }) {
+            auto r = column(1, 0);
+            r.outcome = outcome;
+            records.push_back(r);
+        }
+
+        auto result = AccessTraceSimulator::getRecordedResults
+            (records)[AccessTracer::FFTColumn];
+        QCOMPARE(result.hits, int64_t(2));
+        QCOMPARE(result.misses, int64_t(2));
+    }
+};
+
+#endif
@@ -0,0 +1,154 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+    
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef TEST_EVENT_BOX_INDEX_H
+#define TEST_EVENT_BOX_INDEX_H
+
+#include "../EventBoxIndex.h"
+
+#include <QObject>
+#include <QtTest>
+
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+class TestEventBoxIndex : public QObject
+{
+    Q_OBJECT
+
+    static bool spans(const Event &e, sv_frame_t f, sv_frame_t d,
+                      float v0, float v1) {
+        sv_frame_t t1 = e.getFrame() + std::max(e.getDuration(), sv_frame_t(1));
+        float ev1 = e.getValue() + fabsf(e.getLevel());
+        return e.getFrame() < f + d && t1 > f &&
+            e.getValue() <= v1 && ev1 >= v0;
+    }
+
+    static EventVector bruteForce(const EventVector &events,
+                                  sv_frame_t f, sv_frame_t d,
+                                  float v0, float v1) {
+        EventVector result;
+        for (const auto &e: events) {
+            if (spans(e, f, d, v0, v1)) result.push_back(e);
+        }
+        sort(result.begin(), result.end());
+        return result;
+    }
+
+private slots:
+    void empty() {
+
+        EventBoxIndex ix;
+        QCOMPARE(ix.count(), 0);
+        QCOMPARE(ix.getEventsSpanning(0, 100, 0.f, 100.f), EventVector());
+        QCOMPARE(ix.getEventsCovering(10, 10.f), EventVector());
+    }
+
+    void singleBox() {
+
+        EventBoxIndex ix;
+        Event e(10, 100.f, 20, 50.f, QString());
+        ix.add(e);
+        QCOMPARE(ix.count(), 1);
+
+        EventVector expected { e };
+
+        QCOMPARE(ix.getEventsCovering(10, 100.f), expected);
+        QCOMPARE(ix.getEventsCovering(29, 150.f), expected);
+        QCOMPARE(ix.getEventsCovering(30, 120.f), EventVector());
+        QCOMPARE(ix.getEventsCovering(9, 120.f), EventVector());
+        QCOMPARE(ix.getEventsCovering(20, 99.f), EventVector());
+        QCOMPARE(ix.getEventsCovering(20, 151.f), EventVector());
+
+        QCOMPARE(ix.getEventsSpanning(0, 11, 0.f, 100.f), expected);
+        QCOMPARE(ix.getEventsSpanning(0, 10, 0.f, 1000.f), EventVector());
+        QCOMPARE(ix.getEventsSpanning(0, 1000, 151.f, 1000.f), EventVector());
+
+        ix.remove(e);
+        QCOMPARE(ix.count(), 0);
+        QCOMPARE(ix.getEventsCovering(20, 120.f), EventVector());
+    }
+
+    void negativeLevel() {
+
+        // The box extends by the absolute value of the level, as in
+        // BoxModel
+
+        EventBoxIndex ix;
+        Event e(10, 100.f, 20, -50.f, QString());
+        ix.add(e);
+        QCOMPARE(ix.getEventsCovering(20, 140.f), EventVector({ e }));
+        QCOMPARE(ix.getEventsCovering(20, 60.f), EventVector());
+    }
+
+    void duplicates() {
+
+        EventBoxIndex ix;
+        Event e(10, 100.f, 20, 50.f, QString("a"));
+        ix.add(e);
+        ix.add(e);
+        QCOMPARE(ix.getEventsCovering(20, 120.f), EventVector({ e, e }));
+        ix.remove(e);
+        QCOMPARE(ix.getEventsCovering(20, 120.f), EventVector({ e }));
+        ix.remove(e);
+        QCOMPARE(ix.getEventsCovering(20, 120.f), EventVector());
+    }
+
+    void randomAgainstBruteForce() {
+
+        // Enough edits to pass through several rebuilds, with queries
+        // interleaved so that some see pending changes and some not
+
+        EventBoxIndex ix;
+        EventVector events;
+        srand(19);
+
+        for (int i = 0; i < 20000; ++i) {
+
+            int r = rand() % 10;
+
+            if (r < 6 || events.empty()) {
+                Event e(rand() % 100000,
+                        float(rand() % 8000),
+                        (rand() % 3 == 0) ? 0 : rand() % 2000,
+                        float(rand() % 2000 - 1000),
+                        QString("%1").arg(rand() % 3));
+                events.push_back(e);
+                ix.add(e);
+
+            } else if (r < 8) {
+                int k = rand() % int(events.size());
+                ix.remove(events[k]);
+                events.erase(events.begin() + k);
+
+            } else {
+                sv_frame_t f = rand() % 100000;
+                sv_frame_t d = rand() % 5000;
+                float v0 = float(rand() % 8000);
+                float v1 = v0 + float(rand() % 2000);
+                QCOMPARE(ix.getEventsSpanning(f, d, v0, v1),
+                         bruteForce(events, f, d, v0, v1));
+                QCOMPARE(ix.getEventsCovering(f, v0),
+                         bruteForce(events, f, 1, v0, v0));
+            }
+
+            QCOMPARE(ix.count(), int(events.size()));
+        }
+    }
+};
+
+#endif
@@ -16,11 +16,15 @@
 #define TEST_EVENT_SERIES_H
 
 #include "../EventSeries.h"
+#include "../EventXmlWriter.h"
 
 #include <QObject>
 #include <QtTest>
+#include <QBuffer>
+#include <QTextStream>
 
 #include <iostream>
+#include <algorithm>
 
 using namespace std;
 
@@ -742,6 +746,281 @@ private slots:
                   EventSeries::Backward, p), true);
         QCOMPARE(p, dd);
     }
+
+    void snapshotUnaffectedByEdits() {
+
+        EventSeries s;
+        Event a(0, 1.0f, 18, QString("a"));
+        Event b(3, 2.0f, 6, QString("b"));
+        Event c(5, 3.0f, 2, QString("c"));
+        s.add(a);
+        s.add(b);
+        EventSeries snapshot(s);
+        s.add(c);
+        s.remove(a);
+        QCOMPARE(snapshot.count(), 2);
+        QCOMPARE(snapshot.getEventsCovering(4), EventVector({ a, b }));
+        QCOMPARE(s.count(), 2);
+        QCOMPARE(s.getEventsCovering(5), EventVector({ b, c }));
+        snapshot.clear();
+        QCOMPARE(s.count(), 2);
+    }
+
+    void snapshotsAcrossChunks() {
+
+        // A series long enough to be stored in many chunks, edited
+        // throughout after snapshots have been taken, with each
+        // snapshot checked against the events it was taken from
+        auto covering = [](const EventVector &events, sv_frame_t frame) {
+            EventVector cover;
+            for (const auto &e: events) {
+                if (!e.hasDuration() && e.getFrame() == frame) {
+                    cover.push_back(e);
+                }
+            }
+            for (const auto &e: events) {
+                if (e.hasDuration() && e.getFrame() <= frame &&
+                    e.getFrame() + e.getDuration() > frame) {
+                    cover.push_back(e);
+                }
+            }
+            return cover;
+        };
+        
+        auto check = [&](const EventSeries &s, const EventVector &events) {
+            QCOMPARE(s.getAllEvents(), events);
+            QCOMPARE(s.count(), int(events.size()));
+            for (int i = 0; i < int(events.size()); i += 97) {
+                QCOMPARE(s.getEventByIndex(i), events[i]);
+                QCOMPARE(s.getIndexForEvent(events[i]),
+                         int(lower_bound(events.begin(), events.end(),
+                                         events[i]) - events.begin()));
+            }
+            for (sv_frame_t frame = 0; frame < 20100; frame += 37) {
+                QCOMPARE(s.getEventsCovering(frame), covering(events, frame));
+            }
+        };
+        
+        EventSeries s;
+        EventVector events;
+        for (int i = 0; i < 5000; ++i) {
+            Event e(i * 4, float(i % 50), QString("%1").arg(i));
+            if (i % 3 != 0) {
+                e = e.withDuration(1 + i % 60);
+            }
+            s.add(e);
+            events.push_back(e);
+        }
+
+        vector<pair<EventSeries, EventVector>> snapshots;
+        snapshots.push_back({ s, events });
+
+        srand(7);
+        for (int round = 0; round < 4; ++round) {
+            for (int i = 0; i < 400; ++i) {
+                if (rand() % 2 && !events.empty()) {
+                    size_t index = size_t(rand()) % events.size();
+                    s.remove(events[index]);
+                    events.erase(events.begin() + index);
+                } else {
+                    Event e(rand() % 20000, 1.f, 1 + rand() % 100,
+                            QString("new%1").arg(i));
+                    s.add(e);
+                    events.insert(upper_bound(events.begin(), events.end(), e),
+                                  e);
+                }
+            }
+            check(s, events);
+            snapshots.push_back({ s, events });
+        }
+
+        for (const auto &snapshot: snapshots) {
+            check(snapshot.first, snapshot.second);
+        }
+    }
+
+    void visitors() {
+
+        EventSeries s;
+        Event a(0, 1.0f, 18, QString("a"));
+        Event b(3, 2.0f, 6, QString("b"));
+        Event c(5, 3.0f, 2, QString("c"));
+        Event d(5, 4.0f, QString("d"));
+        s.add(a);
+        s.add(b);
+        s.add(b);
+        s.add(c);
+        s.add(d);
+
+        auto collect = [](EventVector &v) {
+            return [&v](const Event &e) { v.push_back(e); return true; };
+        };
+
+        EventVector v;
+        QCOMPARE(s.visitEventsSpanning(4, 2, collect(v)), true);
+        QCOMPARE(v, s.getEventsSpanning(4, 2));
+        v.clear();
+        QCOMPARE(s.visitEventsCovering(5, collect(v)), true);
+        QCOMPARE(v, s.getEventsCovering(5));
+        v.clear();
+        QCOMPARE(s.visitEventsWithin(3, 6, collect(v)), true);
+        QCOMPARE(v, s.getEventsWithin(3, 6));
+        v.clear();
+        QCOMPARE(s.visitEventsStartingWithin(3, 3, collect(v)), true);
+        QCOMPARE(v, s.getEventsStartingWithin(3, 3));
+        v.clear();
+        QCOMPARE(s.visitAllEvents(collect(v)), true);
+        QCOMPARE(v, s.getAllEvents());
+
+        // Early exit, after the first instance of the duplicated b
+        v.clear();
+        QCOMPARE(s.visitEventsCovering(5, [&](const Event &e) {
+                    v.push_back(e);
+                    return !(e == b);
+                }), false);
+        QCOMPARE(v, EventVector({ d, a, b }));
+
+        // The visitor may edit the series without affecting the visit
+        int n = 0;
+        s.visitAllEvents([&](const Event &e) {
+                s.remove(e);
+                ++n;
+                return true;
+            });
+        QCOMPARE(n, 5);
+        QCOMPARE(s.isEmpty(), true);
+    }
+
+    void indexedSearches() {
+
+        // Compare indexed against unindexed (linear) searches over a
+        // series long enough to be stored in many chunks, with
+        // duplicates, events without values, and some removals
+        EventSeries indexed, linear;
+        indexed.setSearchIndexed(true);
+        QCOMPARE(indexed.isSearchIndexed(), true);
+        QCOMPARE(linear.isSearchIndexed(), false);
+
+        srand(42);
+        EventVector added;
+        for (int i = 0; i < 10000; ++i) {
+            sv_frame_t frame = rand() % 20000;
+            Event e(frame);
+            if (rand() % 5 != 0) {
+                e = Event(frame, float(rand() % 1000) / 10.f,
+                          QString(QChar('a' + rand() % 5)));
+            }
+            int copies = (rand() % 20 == 0 ? 2 : 1);
+            for (int j = 0; j < copies; ++j) {
+                indexed.add(e);
+                linear.add(e);
+                added.push_back(e);
+            }
+        }
+        for (int i = 0; i < 2000; ++i) {
+            Event e = added[rand() % added.size()];
+            indexed.remove(e);
+            linear.remove(e);
+        }
+
+        for (int i = 0; i < 2000; ++i) {
+            sv_frame_t frame = rand() % 21000;
+            auto direction = (rand() % 2 ? EventSeries::Forward :
+                              EventSeries::Backward);
+            QString label(QChar('a' + rand() % 6));
+            float threshold = float(rand() % 1100) / 10.f - 5.f;
+            Event p, q;
+            bool found = linear.getNearestEventMatching
+                (frame, [&](const Event &e) { return e.getLabel() == label; },
+                 direction, q);
+            QCOMPARE(indexed.getNearestEventWithLabel
+                     (frame, label, direction, p), found);
+            if (found) QCOMPARE(p, q);
+            QCOMPARE(linear.getNearestEventWithLabel
+                     (frame, label, direction, p), found);
+            if (found) QCOMPARE(p, q);
+            found = linear.getNearestEventMatching
+                (frame, [&](const Event &e) {
+                    return e.hasValue() && e.getValue() > threshold;
+                }, direction, q);
+            QCOMPARE(indexed.getNearestEventWithValueAbove
+                     (frame, threshold, direction, p), found);
+            if (found) QCOMPARE(p, q);
+            found = linear.getNearestEventMatching
+                (frame, [&](const Event &e) {
+                    return e.hasValue() && e.getValue() < threshold;
+                }, direction, q);
+            QCOMPARE(indexed.getNearestEventWithValueBelow
+                     (frame, threshold, direction, p), found);
+            if (found) QCOMPARE(p, q);
+        }
+
+        // Indexing survives clear, and the index of a snapshot is
+        // unaffected by edits to the original
+        EventSeries snapshot(indexed);
+        indexed.clear();
+        QCOMPARE(indexed.isSearchIndexed(), true);
+        Event p;
+        QCOMPARE(indexed.getNearestEventWithLabel
+                 (0, "a", EventSeries::Forward, p), false);
+        QCOMPARE(snapshot.getNearestEventWithLabel
+                 (0, "a", EventSeries::Forward, p), true);
+        QCOMPARE(p.getLabel(), QString("a"));
+    }
+
+    void xmlWriter() {
+
+        // EventXmlWriter must produce exactly what Event::toXml does,
+        // both for a few awkward events and for enough events to be
+        // formatted in parallel
+
+        EventVector events {
+            Event(0),
+            Event(-10, "<neg> & \"quoted\" 'label'"),
+            Event(10, 0.5f, "half"),
+            Event(20, -0.0f, 5, "negative zero"),
+            Event(30, 1e6f, 10, 0.25f, "million"),
+            Event(40, 3.14159265f, "\u00e9t\u00e9 \u266b").withURI("a&b<c>"),
+            Event(50, 1e-5f, 0, "tiny").withReferenceFrame(-3),
+            Event(60, 123456789.f, 1, 1.f, ""),
+            Event(70).withLevel(-2.5f)
+        };
+        for (int i = 0; i < 30000; ++i) {
+            events.push_back(Event(i * 37, float(i) / 7.f, i % 3,
+                                   QString("label %1").arg(i)));
+        }
+
+        Event::ExportNameOptions options;
+        options.valueAttributeName = "pitch";
+        options.levelAttributeName = "velocity";
+
+        QString expected;
+        QTextStream expectedStream(&expected);
+        for (const auto &e: events) {
+            e.toXml(expectedStream, "  ", "", options);
+        }
+        expectedStream.flush();
+
+        QString actual;
+        QTextStream actualStream(&actual);
+        EventXmlWriter("  ", options).write(actualStream, events);
+        actualStream.flush();
+
+        QCOMPARE(actual, expected);
+
+        // And when writing straight to a device
+        QBuffer buffer;
+        buffer.open(QIODevice::WriteOnly);
+        QTextStream deviceStream(&buffer);
+        deviceStream.setCodec("UTF-8");
+        deviceStream << "before\n";
+        EventXmlWriter("  ", options).write(deviceStream, events);
+        deviceStream << "after\n";
+        deviceStream.flush();
+
+        QCOMPARE(QString::fromUtf8(buffer.data()),
+                 "before\n" + expected + "after\n");
+    }
 };
 
 #endif
@@ -0,0 +1,148 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+    
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef TEST_NUMERIC_KERNELS_H
+#define TEST_NUMERIC_KERNELS_H
+
+#include "../NumericKernels.h"
+
+#include <QObject>
+#include <QtTest>
+
+#include <iostream>
+#include <cmath>
+
+using namespace std;
+
+// Each supported instruction set's kernels are compared against the
+// scalar reference implementations, over lengths chosen to exercise
+// both the vector bodies and the scalar tails of each
+
+class TestNumericKernels : public QObject
+{
+    Q_OBJECT
+
+    typedef CPUFeatures::ISA ISA;
+    typedef NumericKernels::Implementations Implementations;
+
+    vector<int> lengths() {
+        return { 1, 2, 3, 4, 5, 7, 8, 9, 15, 16, 17, 31, 32, 33, 100, 1027 };
+    }
+
+    vector<float> makeInput(int n) {
+        vector<float> v(n);
+        for (int i = 0; i < n; ++i) {
+            v[i] = sinf(float(i) * 0.37f) * float((i % 7) + 1) - 0.2f;
+        }
+        return v;
+    }
+
+    bool close(float a, float b, float magnitude) {
+        return fabsf(a - b) <= 1e-5f * (magnitude + 1.f);
+    }
+
+    void compareWithReference(ISA isa) {
+
+        if (!CPUFeatures::isSupported(isa)) {
+            QSKIP("Instruction set not supported on this processor");
+        }
+        
+        const Implementations *ref =
+            NumericKernels::getImplementations(ISA::Scalar);
+        const Implementations *impl =
+            NumericKernels::getImplementations(isa);
+
+        for (int n: lengths()) {
+
+            vector<float> in = makeInput(n);
+            float magnitude = ref->sumAbs(in.data(), n);
+
+            QVERIFY(close(impl->sumAbs(in.data(), n),
+                          ref->sumAbs(in.data(), n), magnitude));
+            QCOMPARE(impl->maxAbs(in.data(), n), ref->maxAbs(in.data(), n));
+
+            float min0, max0, sum0, min1, max1, sum1;
+            ref->minMaxSumAbs(in.data(), n, min0, max0, sum0);
+            impl->minMaxSumAbs(in.data(), n, min1, max1, sum1);
+            QCOMPARE(min1, min0);
+            QCOMPARE(max1, max0);
+            QVERIFY(close(sum1, sum0, magnitude));
+
+            vector<float> a(in), b(in);
+            ref->scale(a.data(), n, 0.7f);
+            impl->scale(b.data(), n, 0.7f);
+            QCOMPARE(b, a);
+
+            vector<float> src = makeInput(n + 3);
+            ref->addScaled(a.data(), src.data() + 3, -1.3f, n);
+            impl->addScaled(b.data(), src.data() + 3, -1.3f, n);
+            for (int i = 0; i < n; ++i) {
+                QVERIFY(close(b[i], a[i], fabsf(a[i])));
+            }
+        }
+    }
+
+private slots:
+    void init() {
+        CPUFeatures::clearForcedISA();
+    }
+
+    void cleanup() {
+        CPUFeatures::clearForcedISA();
+    }
+    
+    void scalar() { compareWithReference(ISA::Scalar); }
+    void sse2() { compareWithReference(ISA::SSE2); }
+    void avx2() { compareWithReference(ISA::AVX2); }
+    void avx512() { compareWithReference(ISA::AVX512); }
+    void neon() { compareWithReference(ISA::NEON); }
+
+    void emptyInputs() {
+        QCOMPARE(NumericKernels::sumAbs(nullptr, 0), 0.f);
+        QCOMPARE(NumericKernels::maxAbs(nullptr, 0), 0.f);
+        NumericKernels::scale(nullptr, 0, 2.f);
+        NumericKernels::addScaled(nullptr, nullptr, 2.f, 0);
+    }
+    
+    void forcing() {
+        ISA detected = CPUFeatures::getDetectedISA();
+        QCOMPARE(CPUFeatures::getActiveISA(), detected);
+        QVERIFY(CPUFeatures::forceISA(ISA::Scalar));
+        QCOMPARE(CPUFeatures::getActiveISA(), ISA::Scalar);
+        vector<float> in = makeInput(33);
+        QCOMPARE(NumericKernels::maxAbs(in.data(), 33),
+                 NumericKernels::getImplementations(ISA::Scalar)->
+                 maxAbs(in.data(), 33));
+        for (ISA isa: { ISA::SSE2, ISA::AVX2, ISA::AVX512, ISA::NEON }) {
+            QCOMPARE(CPUFeatures::forceISA(isa),
+                     CPUFeatures::isSupported(isa));
+        }
+        CPUFeatures::clearForcedISA();
+        QCOMPARE(CPUFeatures::getActiveISA(), detected);
+    }
+
+    void names() {
+        for (ISA isa: { ISA::Scalar, ISA::SSE2, ISA::AVX2,
+                        ISA::AVX512, ISA::NEON }) {
+            ISA other;
+            QVERIFY(CPUFeatures::getISAForName
+                    (CPUFeatures::getISAName(isa), other));
+            QCOMPARE(other, isa);
+        }
+        ISA other;
+        QVERIFY(!CPUFeatures::getISAForName("mmx", other));
+    }
+};
+
+#endif
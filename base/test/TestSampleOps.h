@@ -0,0 +1,117 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+    
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef TEST_SAMPLE_OPS_H
+#define TEST_SAMPLE_OPS_H
+
+#include "../SampleOps.h"
+
+#include <QObject>
+#include <QtTest>
+
+#include <iostream>
+#include <cmath>
+
+using namespace std;
+
+class TestSampleOps : public QObject
+{
+    Q_OBJECT
+
+    // Frame count deliberately not a multiple of any vector width
+    static const int frames = 37;
+
+    vector<float> makeInterleaved(int channels) {
+        vector<float> v(frames * channels);
+        for (int i = 0; in_range_for(v, i); ++i) {
+            v[i] = float(i) - float(frames);
+        }
+        return v;
+    }
+
+    void checkRoundTrip(int channels) {
+        vector<float> in = makeInterleaved(channels);
+        vector<vector<float>> planar(channels, vector<float>(frames, 0.f));
+        vector<float *> ptrs;
+        for (auto &p: planar) ptrs.push_back(p.data());
+        SampleOps::deinterleave(in.data(), channels, 0, channels,
+                                ptrs.data(), frames);
+        for (int c = 0; c < channels; ++c) {
+            for (int i = 0; i < frames; ++i) {
+                QCOMPARE(planar[c][i], in[i * channels + c]);
+            }
+        }
+        vector<const float *> cptrs(ptrs.begin(), ptrs.end());
+        vector<float> out(frames * channels, 0.f);
+        SampleOps::interleave(cptrs.data(), channels, out.data(), frames);
+        QCOMPARE(out, in);
+    }
+
+    void checkMixdown(int channels) {
+        vector<float> in = makeInterleaved(channels);
+        vector<float> out(frames, 0.f);
+        float gain = 1.f / float(channels);
+        SampleOps::mixdown(in.data(), channels, out.data(), frames, gain);
+        for (int i = 0; i < frames; ++i) {
+            float sum = 0.f;
+            for (int c = 0; c < channels; ++c) {
+                sum += in[i * channels + c];
+            }
+            QCOMPARE(out[i], sum * gain);
+        }
+    }
+    
+private slots:
+    void roundTrip1() { checkRoundTrip(1); }
+    void roundTrip2() { checkRoundTrip(2); }
+    void roundTrip3() { checkRoundTrip(3); }
+    void roundTrip4() { checkRoundTrip(4); }
+    void roundTrip8() { checkRoundTrip(8); }
+    void roundTrip11() { checkRoundTrip(11); }
+
+    void mixdown1() { checkMixdown(1); }
+    void mixdown2() { checkMixdown(2); }
+    void mixdown5() { checkMixdown(5); }
+    void mixdown8() { checkMixdown(8); }
+
+    void extractSubrange() {
+        vector<float> in = makeInterleaved(6);
+        vector<vector<float>> planar(3, vector<float>(frames, 0.f));
+        vector<float *> ptrs;
+        for (auto &p: planar) ptrs.push_back(p.data());
+        SampleOps::deinterleave(in.data(), 6, 2, 3, ptrs.data(), frames);
+        for (int c = 0; c < 3; ++c) {
+            for (int i = 0; i < frames; ++i) {
+                QCOMPARE(planar[c][i], in[i * 6 + c + 2]);
+            }
+        }
+    }
+
+    void int16() {
+        vector<float> in { 0.f, 0.5f, -0.5f, 1.f / 32768.f, -1.f, 1.f,
+                           -2.f, 0.3f };
+        vector<int16_t> q(in.size());
+        SampleOps::toInt16(in.data(), q.data(), q.size(), 32768.f);
+        QCOMPARE(q, vector<int16_t>({ 0, 16384, -16384, 1, -32768, 32767,
+                                      -32768, 9830 }));
+        vector<float> out(in.size());
+        SampleOps::fromInt16(q.data(), out.data(), q.size(), 1.f / 32768.f);
+        for (int i = 0; i < 5; ++i) {
+            QCOMPARE(out[i], in[i]);
+        }
+        QVERIFY(fabsf(out[7] - in[7]) < 1.f / 32768.f);
+    }
+};
+
+#endif
@@ -0,0 +1,249 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef TEST_STORAGE_ADVISER_H
+#define TEST_STORAGE_ADVISER_H
+
+#include "../StorageAdviser.h"
+#include "../TempDirectory.h"
+#include "../ResourceFinder.h"
+
+#include <QObject>
+#include <QtTest>
+#include <QSettings>
+#include <QTemporaryFile>
+#include <QDir>
+
+using namespace std;
+
+class TestStorageAdviser : public QObject
+{
+    Q_OBJECT
+
+    typedef StorageAdviser SA;
+
+    static void setSetting(QString group, QString key, QVariant value) {
+        QSettings settings;
+        settings.beginGroup(group);
+        settings.setValue(key, value);
+        settings.endGroup();
+    }
+
+    static void removeSettings(QString group) {
+        QSettings settings;
+        settings.beginGroup(group);
+        settings.remove("");
+        settings.endGroup();
+    }
+
+    static void setUnlimited() {
+        SA::setTierCapacity(SA::MemoryTier, 0);
+        SA::setTierCapacity(SA::FastDiscTier, 0);
+        SA::setTierCapacity(SA::BulkDiscTier, 0);
+    }
+
+private slots:
+    void initTestCase() {
+        removeSettings("StorageAdviser");
+        // With a fixed recommendation that allows memory, the memory
+        // tier is not limited by how much memory happens to be free
+        SA::setFixedRecommendation(SA::PreferMemory);
+    }
+
+    void cleanupTestCase() {
+        setUnlimited();
+        SA::setFixedRecommendation(SA::NoRecommendation);
+        removeSettings("StorageAdviser");
+    }
+
+    void capacityOverrides() {
+        // This must run before any capacity has been overridden
+        // with setTierCapacity, as there is no way to undo that
+        setSetting("StorageAdviser", "fast-tier-mb", 2);
+        setSetting("StorageAdviser", "memory-tier-mb", 3);
+        QCOMPARE(SA::getTierCapacity(SA::FastDiscTier), size_t(2048));
+        QCOMPARE(SA::getTierCapacity(SA::MemoryTier), size_t(3072));
+        QCOMPARE(SA::getTierCapacity(SA::BulkDiscTier), size_t(0));
+
+        SA::setTierCapacity(SA::FastDiscTier, 100);
+        SA::setTierCapacity(SA::MemoryTier, 0);
+        QCOMPARE(SA::getTierCapacity(SA::FastDiscTier), size_t(100));
+        QCOMPARE(SA::getTierCapacity(SA::MemoryTier), size_t(0));
+
+        // and the override wins over later changes to the settings
+        setSetting("StorageAdviser", "fast-tier-mb", 5);
+        QCOMPARE(SA::getTierCapacity(SA::FastDiscTier), size_t(100));
+
+        removeSettings("StorageAdviser");
+        setUnlimited();
+    }
+
+    void preferredTiers() {
+        setUnlimited();
+        QCOMPARE(SA::recommendTier(SA::SummaryCache, 1000), SA::MemoryTier);
+        QCOMPARE(SA::recommendTier(SA::AnalysisCache, 1000), SA::MemoryTier);
+        QCOMPARE(SA::recommendTier(SA::DecodeCache, 1000), SA::FastDiscTier);
+        QCOMPARE(SA::recommendTier(SA::TemporaryCache, 1000), SA::FastDiscTier);
+        QCOMPARE(SA::recommendTier(SA::PersistentCache, 1000), SA::BulkDiscTier);
+        // size unknown
+        QCOMPARE(SA::recommendTier(SA::DecodeCache, 0), SA::FastDiscTier);
+    }
+
+    void criteria() {
+        setUnlimited();
+        QCOMPARE(SA::recommendTier(SA::DecodeCache, 1000,
+                                   SA::FrequentLookupLikely),
+                 SA::MemoryTier);
+        QCOMPARE(SA::recommendTier(SA::DecodeCache, 1000,
+                                   SA::LongRetentionLikely),
+                 SA::BulkDiscTier);
+        QCOMPARE(SA::recommendTier(SA::AnalysisCache, 1000,
+                                   SA::LongRetentionLikely),
+                 SA::FastDiscTier);
+        QCOMPARE(SA::recommendTier(SA::PersistentCache, 1000,
+                                   SA::FrequentLookupLikely),
+                 SA::FastDiscTier);
+
+        // No promotion beyond memory or demotion beyond bulk disc
+        QCOMPARE(SA::recommendTier(SA::SummaryCache, 1000,
+                                   SA::FrequentLookupLikely),
+                 SA::MemoryTier);
+        QCOMPARE(SA::recommendTier(SA::PersistentCache, 1000,
+                                   SA::LongRetentionLikely),
+                 SA::BulkDiscTier);
+
+        // Frequent lookup outweighs long retention
+        QCOMPARE(SA::recommendTier(SA::TemporaryCache, 1000,
+                                   SA::Criteria(SA::FrequentLookupLikely |
+                                                SA::LongRetentionLikely)),
+                 SA::MemoryTier);
+
+        // Other criteria make no difference
+        QCOMPARE(SA::recommendTier(SA::DecodeCache, 1000,
+                                   SA::SpeedCritical),
+                 SA::FastDiscTier);
+    }
+
+    void placementSettings() {
+        setUnlimited();
+        setSetting("StorageAdviser", "placement-analysis", "bulk");
+        setSetting("StorageAdviser", "placement-persistent", "memory");
+        setSetting("StorageAdviser", "placement-summary", "fast");
+        setSetting("StorageAdviser", "placement-decode", "nonsense");
+        QCOMPARE(SA::recommendTier(SA::AnalysisCache, 1000), SA::BulkDiscTier);
+        QCOMPARE(SA::recommendTier(SA::PersistentCache, 1000), SA::MemoryTier);
+        QCOMPARE(SA::recommendTier(SA::SummaryCache, 1000), SA::FastDiscTier);
+        QCOMPARE(SA::recommendTier(SA::DecodeCache, 1000), SA::FastDiscTier);
+        // Criteria apply to the configured placement
+        QCOMPARE(SA::recommendTier(SA::AnalysisCache, 1000,
+                                   SA::FrequentLookupLikely),
+                 SA::FastDiscTier);
+        removeSettings("StorageAdviser");
+        QCOMPARE(SA::recommendTier(SA::AnalysisCache, 1000), SA::MemoryTier);
+    }
+
+    void demotion() {
+        SA::setTierCapacity(SA::MemoryTier, 100);
+        SA::setTierCapacity(SA::FastDiscTier, 200);
+        SA::setTierCapacity(SA::BulkDiscTier, 50);
+
+        size_t memoryUsage = SA::getTierUsage(SA::MemoryTier);
+        size_t fastUsage = SA::getTierUsage(SA::FastDiscTier);
+        QCOMPARE(memoryUsage, size_t(0));
+        QCOMPARE(fastUsage, size_t(0));
+
+        QCOMPARE(SA::recommendTier(SA::AnalysisCache, 100), SA::MemoryTier);
+        QCOMPARE(SA::recommendTier(SA::AnalysisCache, 101), SA::FastDiscTier);
+        // The bulk tier is accepted even when over capacity
+        QCOMPARE(SA::recommendTier(SA::AnalysisCache, 201), SA::BulkDiscTier);
+        QCOMPARE(SA::recommendTier(SA::DecodeCache, 201), SA::BulkDiscTier);
+
+        SA::notifyTierAllocation(SA::MemoryTier, 80);
+        QCOMPARE(SA::getTierUsage(SA::MemoryTier), size_t(80));
+        QCOMPARE(SA::recommendTier(SA::AnalysisCache, 20), SA::MemoryTier);
+        QCOMPARE(SA::recommendTier(SA::AnalysisCache, 21), SA::FastDiscTier);
+
+        SA::notifyTierAllocation(SA::FastDiscTier, 150);
+        QCOMPARE(SA::recommendTier(SA::AnalysisCache, 21), SA::FastDiscTier);
+        QCOMPARE(SA::recommendTier(SA::AnalysisCache, 51), SA::BulkDiscTier);
+        QCOMPARE(SA::recommendTier(SA::DecodeCache, 51), SA::BulkDiscTier);
+
+        // Releasing space in a faster tier makes it available again
+        SA::notifyTierRelease(SA::MemoryTier, 80);
+        QCOMPARE(SA::getTierUsage(SA::MemoryTier), size_t(0));
+        QCOMPARE(SA::recommendTier(SA::AnalysisCache, 51), SA::MemoryTier);
+
+        // Releasing more than was recorded leaves the usage at zero
+        SA::notifyTierRelease(SA::FastDiscTier, 1000);
+        QCOMPARE(SA::getTierUsage(SA::FastDiscTier), size_t(0));
+        QCOMPARE(SA::recommendTier(SA::DecodeCache, 51), SA::FastDiscTier);
+
+        setUnlimited();
+    }
+
+    void fixedRecommendation() {
+        setUnlimited();
+        // A fixed recommendation of disc rules out the memory tier
+        SA::setFixedRecommendation(SA::UseDisc);
+        QCOMPARE(SA::recommendTier(SA::SummaryCache, 10), SA::FastDiscTier);
+        QCOMPARE(SA::recommendTier(SA::DecodeCache, 10,
+                                   SA::FrequentLookupLikely),
+                 SA::FastDiscTier);
+        QCOMPARE(SA::recommendTier(SA::PersistentCache, 10),
+                 SA::BulkDiscTier);
+        SA::setFixedRecommendation(SA::PreferMemory);
+        QCOMPARE(SA::recommendTier(SA::SummaryCache, 10), SA::MemoryTier);
+    }
+
+    void fastDirectoryFallback() {
+        TempDirectory *td = TempDirectory::getInstance();
+
+        removeSettings("TempDirectory");
+        QVERIFY(!td->haveFastDisc());
+
+        // An unusable fast location: beneath a plain file. The fast
+        // location is derived from the user resource directory by
+        // substituting for the home directory, so that must be
+        // within it
+        if (!ResourceFinder().getUserResourcePrefix()
+            .startsWith(QDir::home().absolutePath())) {
+#if ( QT_VERSION >= 0x050000 )
+            QSKIP("User resource directory is outside home, skipping");
+#else
+            QSKIP("User resource directory is outside home, skipping",
+                  SkipSingle);
+#endif
+        }
+
+        QTemporaryFile file;
+        QVERIFY(file.open());
+        setSetting("TempDirectory", "fast-create-in", file.fileName());
+        QVERIFY(td->haveFastDisc());
+
+        QString defaultPath = td->getPath();
+        QVERIFY(defaultPath != "");
+        QCOMPARE(td->getPath(TempDirectory::FastDisc), defaultPath);
+        QCOMPARE(td->getPath(TempDirectory::DefaultDisc), defaultPath);
+
+        // Having failed, the fast location is no longer reported as
+        // available, and subdirectories go in the default location
+        QVERIFY(!td->haveFastDisc());
+        QCOMPARE(td->getSubDirectoryPath("fallback", TempDirectory::FastDisc),
+                 td->getSubDirectoryPath("fallback"));
+
+        removeSettings("TempDirectory");
+    }
+};
+
+#endif
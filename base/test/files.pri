@@ -1,14 +1,19 @@
 TEST_HEADERS = \
+	     TestAccessTrace.h \
 	     TestById.h \
 	     TestColumnOp.h \
 	     TestLogRange.h \
 	     TestMovingMedian.h \
+	     TestNumericKernels.h \
 	     TestOurRealTime.h \
 	     TestPitch.h \
 	     TestEventSeries.h \
+	     TestEventBoxIndex.h \
 	     TestRangeMapper.h \
+	     TestSampleOps.h \
 	     TestScaleTickIntervals.h \
 	     TestStringBits.h \
+	     TestStorageAdviser.h \
 	     TestVampRealTime.h \
 	     StressEventSeries.h
 	     
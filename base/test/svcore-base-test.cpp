@@ -19,9 +19,14 @@
 #include "TestOurRealTime.h"
 #include "TestVampRealTime.h"
 #include "TestColumnOp.h"
+#include "TestSampleOps.h"
+#include "TestNumericKernels.h"
 #include "TestMovingMedian.h"
 #include "TestById.h"
 #include "TestEventSeries.h"
+#include "TestEventBoxIndex.h"
+#include "TestAccessTrace.h"
+#include "TestStorageAdviser.h"
 #include "StressEventSeries.h"
 
 #include "system/Init.h"
@@ -72,6 +77,16 @@ int main(int argc, char *argv[])
         if (QTest::qExec(&t, argc, argv) == 0) ++good;
         else ++bad;
     }
+    {
+        TestSampleOps t;
+        if (QTest::qExec(&t, argc, argv) == 0) ++good;
+        else ++bad;
+    }
+    {
+        TestNumericKernels t;
+        if (QTest::qExec(&t, argc, argv) == 0) ++good;
+        else ++bad;
+    }
     {
         TestLogRange t;
         if (QTest::qExec(&t, argc, argv) == 0) ++good;
@@ -92,11 +107,26 @@ int main(int argc, char *argv[])
         if (QTest::qExec(&t, argc, argv) == 0) ++good;
         else ++bad;
     }
+    {
+        TestEventBoxIndex t;
+        if (QTest::qExec(&t, argc, argv) == 0) ++good;
+        else ++bad;
+    }
+    {
+        TestAccessTrace t;
+        if (QTest::qExec(&t, argc, argv) == 0) ++good;
+        else ++bad;
+    }
     {
         TestById t;
         if (QTest::qExec(&t, argc, argv) == 0) ++good;
         else ++bad;
     }
+    {
+        TestStorageAdviser t;
+        if (QTest::qExec(&t, argc, argv) == 0) ++good;
+        else ++bad;
+    }
 
 #ifdef NOT_DEFINED
     {
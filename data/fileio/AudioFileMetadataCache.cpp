@@ -0,0 +1,343 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#include "AudioFileMetadataCache.h"
+
+#include "CachedFile.h"
+#include "FileSource.h"
+
+#include "base/Exceptions.h"
+#include "base/StorageAdviser.h"
+#include "base/Profiler.h"
+#include "base/Debug.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QDataStream>
+#include <QSaveFile>
+#include <QUrl>
+#include <QMutexLocker>
+
+using namespace std;
+
+static const quint32 cacheMagic = 0x53564d44; // "SVMD"
+static const quint32 cacheVersion = 1;
+
+// Save automatically after this many changes, as well as on exit
+static const int changesPerSave = 64;
+
+AudioFileMetadataCache *
+AudioFileMetadataCache::getInstance()
+{
+    static AudioFileMetadataCache *instance = nullptr;
+    static QMutex instanceMutex;
+
+    QMutexLocker locker(&instanceMutex);
+    if (!instance) {
+        QString file;
+        try {
+            file = QDir(CachedFile::getCacheDirectory())
+                .filePath("audio-metadata");
+        } catch (const DirectoryCreationFailed &f) {
+            SVCERR << "WARNING: AudioFileMetadataCache: Failed to find cache "
+                   << "directory (" << f.what() << "), metadata will not be "
+                   << "saved" << endl;
+        }
+        // Either disc tier means the persistent cache directory, as
+        // the fast tier has only a temporary directory. A placement
+        // in memory means the cache lasts only for this session
+        if (file != "" &&
+            StorageAdviser::recommendTier
+            (StorageAdviser::PersistentCache,
+             size_t(QFileInfo(file).size() / 1024)) ==
+            StorageAdviser::MemoryTier) {
+            SVDEBUG << "AudioFileMetadataCache: Placed in memory, metadata "
+                    << "will not be saved" << endl;
+            file = "";
+        }
+        static AudioFileMetadataCache cache(file);
+        instance = &cache;
+    }
+    return instance;
+}
+
+AudioFileMetadataCache::AudioFileMetadataCache(QString cacheFile) :
+    m_cacheFile(cacheFile),
+    m_loaded(false),
+    m_changes(0)
+{
+}
+
+AudioFileMetadataCache::~AudioFileMetadataCache()
+{
+    save();
+}
+
+QString
+AudioFileMetadataCache::getCanonicalPath(QString location)
+{
+    if (location.startsWith("file:", Qt::CaseInsensitive)) {
+        location = QUrl(location).toLocalFile();
+    } else if (FileSource::isRemote(location)) {
+        return "";
+    }
+    if (location == "") return "";
+    return QFileInfo(location).canonicalFilePath();
+}
+
+bool
+AudioFileMetadataCache::lookup(QString location, Metadata &metadata)
+{
+    Profiler profiler("AudioFileMetadataCache::lookup");
+
+    QString path = getCanonicalPath(location);
+    if (path == "") return false;
+
+    QFileInfo fi(path);
+
+    QMutexLocker locker(&m_mutex);
+    loadIfNecessary();
+
+    auto itr = m_entries.find(path);
+    if (itr == m_entries.end()) {
+        return false;
+    }
+
+    if (itr->second.size != fi.size() ||
+        itr->second.modified != fi.lastModified().toMSecsSinceEpoch()) {
+        SVDEBUG << "AudioFileMetadataCache::lookup: File \"" << path
+                << "\" has changed since its metadata was cached" << endl;
+        return false;
+    }
+
+    metadata = itr->second.metadata;
+    return true;
+}
+
+void
+AudioFileMetadataCache::store(QString location, const Metadata &metadata)
+{
+    QString path = getCanonicalPath(location);
+    if (path == "") return;
+
+    QFileInfo fi(path);
+
+    Entry entry;
+    entry.size = fi.size();
+    entry.modified = fi.lastModified().toMSecsSinceEpoch();
+    entry.metadata = metadata;
+
+    QMutexLocker locker(&m_mutex);
+    loadIfNecessary();
+
+    m_entries[path] = entry;
+    m_forgotten.erase(path);
+
+    if (++m_changes >= changesPerSave) {
+        write();
+    }
+}
+
+void
+AudioFileMetadataCache::storeFromReader(QString location,
+                                        const AudioFileReader *reader,
+                                        bool exactFrameCount,
+                                        float peak)
+{
+    if (!reader || !reader->isOK()) return;
+
+    Metadata metadata;
+    metadata.format = QFileInfo(location).suffix().toLower();
+    metadata.channels = reader->getChannelCount();
+    metadata.sampleRate = reader->getNativeRate();
+    if (exactFrameCount &&
+        reader->getSampleRate() == reader->getNativeRate()) {
+        metadata.frameCount = reader->getFrameCount();
+    }
+    metadata.title = reader->getTitle();
+    metadata.maker = reader->getMaker();
+    metadata.tags = reader->getTags();
+    if (peak >= 0.f) {
+        metadata.peak = peak;
+    }
+
+    // Don't lose a known frame count or peak when storing from a
+    // reader that doesn't know them, e.g. a gappy MP3 reader
+    Metadata previous;
+    if (lookup(location, previous)) {
+        if (metadata.frameCount < 0) metadata.frameCount = previous.frameCount;
+        if (metadata.peak < 0.f) metadata.peak = previous.peak;
+    }
+    
+    store(location, metadata);
+}
+
+void
+AudioFileMetadataCache::forget(QString location)
+{
+    QString path = getCanonicalPath(location);
+    if (path == "") return;
+
+    QMutexLocker locker(&m_mutex);
+    loadIfNecessary();
+
+    if (m_entries.erase(path) > 0) {
+        m_forgotten.insert(path);
+        ++m_changes;
+    }
+}
+
+void
+AudioFileMetadataCache::save()
+{
+    QMutexLocker locker(&m_mutex);
+    if (m_changes > 0) {
+        write();
+    }
+}
+
+void
+AudioFileMetadataCache::loadIfNecessary()
+{
+    if (m_loaded) return;
+    m_loaded = true;
+
+    EntryMap entries;
+    if (read(entries)) {
+        m_entries = entries;
+        SVDEBUG << "AudioFileMetadataCache: Loaded " << m_entries.size()
+                << " entries from \"" << m_cacheFile << "\"" << endl;
+    }
+}
+
+static QDataStream &
+operator<<(QDataStream &out, const AudioFileMetadataCache::Metadata &m)
+{
+    out << m.format << qint32(m.channels) << double(m.sampleRate)
+        << qint64(m.frameCount) << m.title << m.maker;
+    out << quint32(m.tags.size());
+    for (const auto &t: m.tags) {
+        out << t.first << t.second;
+    }
+    out << m.peak;
+    return out;
+}
+
+static QDataStream &
+operator>>(QDataStream &in, AudioFileMetadataCache::Metadata &m)
+{
+    qint32 channels = 0;
+    double sampleRate = 0.0;
+    qint64 frameCount = -1;
+    quint32 tagCount = 0;
+    in >> m.format >> channels >> sampleRate >> frameCount
+       >> m.title >> m.maker >> tagCount;
+    m.channels = channels;
+    m.sampleRate = sampleRate;
+    m.frameCount = frameCount;
+    m.tags.clear();
+    for (quint32 i = 0; i < tagCount && in.status() == QDataStream::Ok; ++i) {
+        QString key, value;
+        in >> key >> value;
+        m.tags[key] = value;
+    }
+    in >> m.peak;
+    return in;
+}
+
+bool
+AudioFileMetadataCache::read(EntryMap &entries)
+{
+    if (m_cacheFile == "") return false;
+
+    QFile file(m_cacheFile);
+    if (!file.exists()) return false;
+    if (!file.open(QFile::ReadOnly)) {
+        SVCERR << "WARNING: AudioFileMetadataCache: Failed to open cache file \""
+               << m_cacheFile << "\" for reading" << endl;
+        return false;
+    }
+
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_5_0);
+    in.setFloatingPointPrecision(QDataStream::SinglePrecision);
+
+    quint32 magic = 0, version = 0, count = 0;
+    in >> magic >> version >> count;
+    if (magic != cacheMagic || version != cacheVersion) {
+        SVDEBUG << "AudioFileMetadataCache: Cache file \"" << m_cacheFile
+                << "\" has wrong magic or version, ignoring it" << endl;
+        return false;
+    }
+
+    for (quint32 i = 0; i < count; ++i) {
+        QString path;
+        Entry entry;
+        in >> path >> entry.size >> entry.modified >> entry.metadata;
+        if (in.status() != QDataStream::Ok) {
+            SVCERR << "WARNING: AudioFileMetadataCache: Cache file \""
+                   << m_cacheFile << "\" is truncated or corrupt, ignoring "
+                   << "it" << endl;
+            entries.clear();
+            return false;
+        }
+        entries[path] = entry;
+    }
+
+    return true;
+}
+
+void
+AudioFileMetadataCache::write()
+{
+    m_changes = 0;
+    
+    if (m_cacheFile == "") return;
+
+    // Merge in anything another instance has saved since we loaded,
+    // but that we haven't since changed or removed
+    EntryMap saved;
+    if (read(saved)) {
+        for (const auto &e: saved) {
+            if (m_forgotten.find(e.first) == m_forgotten.end()) {
+                m_entries.insert(e); // does not replace existing keys
+            }
+        }
+    }
+    m_forgotten.clear();
+
+    QSaveFile file(m_cacheFile);
+    if (!file.open(QFile::WriteOnly)) {
+        SVCERR << "WARNING: AudioFileMetadataCache: Failed to open cache file \""
+               << m_cacheFile << "\" for writing" << endl;
+        return;
+    }
+
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_5_0);
+    out.setFloatingPointPrecision(QDataStream::SinglePrecision);
+
+    out << cacheMagic << cacheVersion << quint32(m_entries.size());
+    for (const auto &e: m_entries) {
+        out << e.first << e.second.size << e.second.modified
+            << e.second.metadata;
+    }
+
+    if (!file.commit()) {
+        SVCERR << "WARNING: AudioFileMetadataCache: Failed to write cache file \""
+               << m_cacheFile << "\"" << endl;
+    }
+}
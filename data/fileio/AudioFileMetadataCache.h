@@ -0,0 +1,144 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef SV_AUDIO_FILE_METADATA_CACHE_H
+#define SV_AUDIO_FILE_METADATA_CACHE_H
+
+#include "AudioFileReader.h"
+
+#include <QString>
+#include <QMutex>
+
+#include <map>
+#include <set>
+
+/**
+ * A persistent cache of basic properties of local audio files, so
+ * that the channel count, sample rate, length and tags of a file can
+ * be found without opening it with an AudioFileReader (which for
+ * some formats means decoding the whole file).
+ *
+ * Entries are keyed by canonical file path and are only returned if
+ * the file's size and modification time are unchanged since the
+ * entry was stored. The cache is populated as a side effect of
+ * opening files fully through AudioFileReaderFactory, and is saved
+ * to a file in the CachedFile cache directory, which is shared
+ * between runs (and between concurrently running instances, with
+ * entries merged on save).
+ *
+ * This class is thread-safe.
+ */
+class AudioFileMetadataCache
+{
+public:
+    struct Metadata {
+        Metadata() :
+            channels(0), sampleRate(0), frameCount(-1), peak(-1.f) { }
+
+        QString format;          // lower-case file extension
+        int channels;
+        sv_samplerate_t sampleRate; // native rate of the file
+        sv_frame_t frameCount;   // exact, at native rate; -1 if unknown
+        QString title;
+        QString maker;
+        AudioFileReader::TagMap tags;
+        float peak;              // absolute peak sample; -1 if unknown
+    };
+
+    /**
+     * Return the cache shared by the whole application, stored in
+     * the CachedFile cache directory. If StorageAdviser places
+     * persistent caches in memory, the shared cache is neither
+     * loaded from nor saved to a file.
+     */
+    static AudioFileMetadataCache *getInstance();
+
+    /**
+     * Construct a cache stored in the given file, which need not
+     * exist yet.
+     */
+    AudioFileMetadataCache(QString cacheFile);
+
+    /**
+     * Save any changes and destroy the cache object.
+     */
+    ~AudioFileMetadataCache();
+
+    /**
+     * Look up the metadata for the given local file path or file
+     * URL. Return false if there is no entry, or if the file has
+     * been changed since the entry was stored.
+     */
+    bool lookup(QString location, Metadata &metadata);
+
+    /**
+     * Store metadata for the given local file path or file URL,
+     * tagged with the file's current size and modification time.
+     * Remote locations and missing files are ignored.
+     */
+    void store(QString location, const Metadata &metadata);
+
+    /**
+     * Store what is known from a reader that has finished opening
+     * (and, if necessary, decoding) the given location.
+     * exactFrameCount should be true only if the reader's frame
+     * count is what AudioFileReaderFactory would produce from the
+     * file with default parameters and no resampling; otherwise the
+     * frame count is not stored. The peak is stored only if
+     * non-negative.
+     */
+    void storeFromReader(QString location, const AudioFileReader *reader,
+                         bool exactFrameCount, float peak = -1.f);
+
+    /**
+     * Remove any entry for the given location.
+     */
+    void forget(QString location);
+
+    /**
+     * Write any changes to the cache file now.
+     */
+    void save();
+
+    /**
+     * Return the canonical path used as the key for a location, or
+     * an empty string if the location is remote or does not exist.
+     */
+    static QString getCanonicalPath(QString location);
+
+private:
+    struct Entry {
+        qint64 size;
+        qint64 modified; // ms since epoch
+        Metadata metadata;
+    };
+    typedef std::map<QString, Entry> EntryMap;
+
+    QString m_cacheFile;
+    QMutex m_mutex;
+    bool m_loaded;
+    int m_changes;
+    EntryMap m_entries;
+    std::set<QString> m_forgotten; // since last save, so as not to merge
+
+    // Call these with m_mutex held
+    void loadIfNecessary();
+    bool read(EntryMap &entries);
+    void write();
+
+    AudioFileMetadataCache(const AudioFileMetadataCache &) =delete;
+    AudioFileMetadataCache &operator=(const AudioFileMetadataCache &) =delete;
+};
+
+#endif
@@ -15,26 +15,40 @@
 
 #include "AudioFileReader.h"
 
+#include "base/SampleOps.h"
+
 using std::vector;
 
 vector<floatvec_t>
 AudioFileReader::getDeInterleavedFrames(sv_frame_t start, sv_frame_t count) const
 {
-    floatvec_t interleaved = getInterleavedFrames(start, count);
-    
+    return getChannelFrames(0, getChannelCount() - 1, start, count);
+}
+
+vector<floatvec_t>
+AudioFileReader::getChannelFrames(int fromchannel, int tochannel,
+                                  sv_frame_t start, sv_frame_t count) const
+{
     int channels = getChannelCount();
+    if (fromchannel < 0 || fromchannel > tochannel || tochannel >= channels) {
+        return {};
+    }
+    
+    floatvec_t interleaved = getInterleavedFrames(start, count);
     if (channels == 1) return { interleaved };
     
     sv_frame_t rc = interleaved.size() / channels;
+    int reqchannels = tochannel - fromchannel + 1;
 
-    vector<floatvec_t> frames(channels, floatvec_t(rc, 0.f));
-    
-    for (int c = 0; c < channels; ++c) {
-        for (sv_frame_t i = 0; i < rc; ++i) {
-            frames[c][i] = interleaved[i * channels + c];
-        }
+    vector<floatvec_t> frames(reqchannels, floatvec_t(rc, 0.f));
+    vector<float *> ptrs(reqchannels);
+    for (int c = 0; c < reqchannels; ++c) {
+        ptrs[c] = frames[c].data();
     }
 
+    SampleOps::deinterleave(interleaved.data(), channels,
+                            fromchannel, reqchannels,
+                            ptrs.data(), rc);
+
     return frames;
 }
-
@@ -162,6 +162,24 @@ public:
     virtual std::vector<floatvec_t> getDeInterleavedFrames(sv_frame_t start,
                                                            sv_frame_t count) const;
 
+    /**
+     * Return de-interleaved samples for count frames from index
+     * start, for the contiguous range of channels from fromchannel
+     * to tochannel inclusive. The resulting vector will contain
+     * (tochannel - fromchannel + 1) sample blocks of count samples
+     * each (or fewer if end of file is reached).
+     *
+     * The default implementation calls getInterleavedFrames and
+     * picks out the requested channels. Subclasses that store their
+     * data channel by channel should override it so as to read only
+     * the channels asked for. Like getInterleavedFrames, this must
+     * be thread-safe.
+     */
+    virtual std::vector<floatvec_t> getChannelFrames(int fromchannel,
+                                                     int tochannel,
+                                                     sv_frame_t start,
+                                                     sv_frame_t count) const;
+
 signals:
     void frameCountChanged();
     
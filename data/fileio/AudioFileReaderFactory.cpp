@@ -20,6 +20,7 @@
 #include "MP3FileReader.h"
 #include "BQAFileReader.h"
 #include "AudioFileSizeEstimator.h"
+#include "AudioFileMetadataCache.h"
 
 #include "base/StorageAdviser.h"
 
@@ -106,8 +107,13 @@ AudioFileReaderFactory::createReader(FileSource source,
             StorageAdviser::recommend(StorageAdviser::SpeedCritical, kb, kb);
         if ((rec & StorageAdviser::UseMemory) ||
             (rec & StorageAdviser::PreferMemory)) {
-            SVDEBUG << "AudioFileReaderFactory: cacheing (if at all) in memory" << endl;
-            cacheMode = CodedAudioFileReader::CacheInMemory;
+            if (StorageAdviser::isMemoryConstrained(kb)) {
+                SVDEBUG << "AudioFileReaderFactory: cacheing (if at all) in memory, compactly" << endl;
+                cacheMode = CodedAudioFileReader::CacheInMemoryCompact;
+            } else {
+                SVDEBUG << "AudioFileReaderFactory: cacheing (if at all) in memory" << endl;
+                cacheMode = CodedAudioFileReader::CacheInMemory;
+            }
         } else {
             SVDEBUG << "AudioFileReaderFactory: cacheing (if at all) on disc" << endl;
         }
@@ -155,7 +161,7 @@ AudioFileReaderFactory::createReader(FileSource source,
             
                 reader = new MP3FileReader
                     (source, decodeMode, cacheMode, gapless,
-                     targetRate, normalised, reporter);
+                     targetRate, normalised, reporter, estimatedSamples);
 
                 if (reader->isOK()) {
                     SVDEBUG << "AudioFileReaderFactory: MP3 file reader is OK, returning it" << endl;
@@ -187,7 +193,15 @@ AudioFileReaderFactory::createReader(FileSource source,
                      decodeMode, cacheMode,
                      targetRate ? targetRate : fileRate,
                      normalised,
-                     reporter);
+                     reporter,
+                     estimatedSamples);
+
+            } else if (reader->isOK()) {
+                // Reading directly, so the header has told us all we
+                // will learn (a decoding reader records its own
+                // metadata when it finishes)
+                AudioFileMetadataCache::getInstance()->storeFromReader
+                    (source.getLocation(), reader, true);
             }
 
             if (reader->isOK()) {
@@ -202,7 +216,7 @@ AudioFileReaderFactory::createReader(FileSource source,
 
             reader = new BQAFileReader
                 (source, decodeMode, cacheMode, 
-                 targetRate, normalised, reporter);
+                 targetRate, normalised, reporter, estimatedSamples);
 
             if (reader->isOK()) {
                 SVDEBUG << "AudioFileReaderFactory: BQA reader is OK, returning it" << endl;
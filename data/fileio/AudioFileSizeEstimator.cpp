@@ -15,6 +15,7 @@
 #include "AudioFileSizeEstimator.h"
 
 #include "WavFileReader.h"
+#include "AudioFileMetadataCache.h"
 
 #include <QFile>
 
@@ -29,6 +30,25 @@ AudioFileSizeEstimator::estimate(FileSource source,
     SVDEBUG << "AudioFileSizeEstimator: Sample count estimate requested for file \""
             << source.getLocalFilename() << "\"" << endl;
 
+    // If the file has been read in full before, its metadata may
+    // give the exact count without opening it at all
+
+    AudioFileMetadataCache::Metadata metadata;
+    if (AudioFileMetadataCache::getInstance()->lookup
+        (source.getLocation(), metadata) &&
+        metadata.frameCount > 0 &&
+        metadata.channels > 0 &&
+        metadata.sampleRate > 0) {
+        sv_frame_t samples = metadata.frameCount * metadata.channels;
+        if (targetRate != 0.0 && targetRate != metadata.sampleRate) {
+            samples = sv_frame_t(double(samples) * targetRate /
+                                 metadata.sampleRate);
+        }
+        SVDEBUG << "AudioFileSizeEstimator: metadata cache reports "
+                << samples << " samples" << endl;
+        return samples;
+    }
+
     // Most of our file readers don't know the sample count until
     // after they've finished decoding. This is an exception:
 
@@ -30,8 +30,10 @@ BQAFileReader::BQAFileReader(FileSource source,
 			     CacheMode mode,
 			     sv_samplerate_t targetRate,
 			     bool normalised,
-			     ProgressReporter *reporter) :
-    CodedAudioFileReader(mode, targetRate, normalised),
+			     ProgressReporter *reporter,
+			     sv_frame_t estimatedSamples) :
+    CodedAudioFileReader(mode, targetRate, normalised,
+                         estimatedSamples),
     m_source(source),
     m_path(source.getLocalFilename()),
     m_cancelled(false),
@@ -99,6 +101,10 @@ BQAFileReader::BQAFileReader(FileSource source,
         if (isDecodeCacheInitialised()) finishDecodeCache();
         endSerialised();
 
+        if (!m_cancelled) {
+            storeMetadata(m_source.getLocation(), true);
+        }
+
         if (m_reporter) m_reporter->setProgress(100);
 
         delete m_stream;
@@ -171,6 +177,10 @@ BQAFileReader::DecodeThread::run()
 
     m_reader->endSerialised();
 
+    if (!m_reader->m_cancelled) {
+        m_reader->storeMetadata(m_reader->m_source.getLocation(), true);
+    }
+
     delete m_reader->m_stream;
     m_reader->m_stream = 0;
 } 
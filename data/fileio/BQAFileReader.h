@@ -39,7 +39,8 @@ public:
                   CacheMode cacheMode,
                   sv_samplerate_t targetRate = 0,
                   bool normalised = false,
-                  ProgressReporter *reporter = 0);
+                  ProgressReporter *reporter = 0,
+                  sv_frame_t estimatedSamples = 0);
     virtual ~BQAFileReader();
 
     QString getError() const override { return m_error; }
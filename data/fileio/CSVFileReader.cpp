@@ -371,11 +371,19 @@ CSVFileReader::load() const
                     bool normalise = (m_format.getAudioSampleRange()
                                       == CSVFormat::SampleRangeOther);
                     QString path = getConvertedAudioFilePath();
+                    // Each frame is a line with at least a digit and
+                    // a separator per channel, so this is an upper
+                    // bound on the frame count
+                    sv_frame_t expectedFrames = 0;
+                    if (m_fileSize > 0 && valueColumns > 0) {
+                        expectedFrames = m_fileSize / (2 * valueColumns);
+                    }
                     modelW = new WritableWaveFileModel
                         (path, sampleRate, valueColumns,
                          normalise ?
                          WritableWaveFileModel::Normalisation::Peak :
-                         WritableWaveFileModel::Normalisation::None);
+                         WritableWaveFileModel::Normalisation::None,
+                         expectedFrames);
                     modelName = QFileInfo(path).fileName();
                     model = modelW;
                     break;
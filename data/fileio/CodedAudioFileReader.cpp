@@ -16,28 +16,45 @@
 #include "CodedAudioFileReader.h"
 
 #include "WavFileReader.h"
+#include "AudioFileMetadataCache.h"
 #include "base/TempDirectory.h"
 #include "base/Exceptions.h"
 #include "base/Profiler.h"
 #include "base/Serialiser.h"
 #include "base/StorageAdviser.h"
+#include "base/SampleOps.h"
+#include "base/AccessTracer.h"
 
 #include <bqresample/Resampler.h>
 
 #include <stdint.h>
 #include <iostream>
+#include <algorithm>
 #include <QDir>
+#include <QFileInfo>
 #include <QMutexLocker>
 
 using namespace std;
 
+const int CodedAudioFileReader::PlanarChannelThreshold;
+const sv_frame_t CodedAudioFileReader::PlanarChunkFrames;
+const sv_frame_t CodedAudioFileReader::CompactBlockSamples;
+
 CodedAudioFileReader::CodedAudioFileReader(CacheMode cacheMode,
                                            sv_samplerate_t targetRate,
-                                           bool normalised) :
-    m_cacheMode(cacheMode),
+                                           bool normalised,
+                                           sv_frame_t estimatedSamples) :
+    m_cacheMode(cacheMode == CacheInMemoryCompact ? CacheInMemory : cacheMode),
+    m_cacheLayout(CacheInterleaved),
+    m_cacheSampleFormat(cacheMode == CacheInMemoryCompact ?
+                        CacheCompact : CacheFloat),
+    m_planarFrames(0),
     m_initialised(false),
     m_serialiser(nullptr),
     m_fileRate(0),
+    m_estimatedSamples(estimatedSamples),
+    m_cacheTier(StorageAdviser::MemoryTier),
+    m_cacheTierKB(0),
     m_cacheFileWritePtr(nullptr),
     m_cacheFileReader(nullptr),
     m_cacheWriteBuffer(nullptr),
@@ -58,7 +75,9 @@ CodedAudioFileReader::CodedAudioFileReader(CacheMode cacheMode,
 {
     SVDEBUG << "CodedAudioFileReader:: cache mode: " << cacheMode
             << " (" << (cacheMode == CacheInTemporaryFile
-                        ? "CacheInTemporaryFile" : "CacheInMemory") << ")"
+                        ? "CacheInTemporaryFile" :
+                        cacheMode == CacheInMemoryCompact
+                        ? "CacheInMemoryCompact" : "CacheInMemory") << ")"
             << ", rate: " << targetRate
             << (targetRate == 0 ? " (use source rate)" : "")
             << ", normalised: " << normalised << endl;
@@ -90,13 +109,25 @@ CodedAudioFileReader::~CodedAudioFileReader()
     delete m_resampler;
     delete[] m_resampleBuffer;
 
-    if (!m_data.empty()) {
+    size_t kb = getMemoryCacheKB();
+    if (kb > 0) {
         StorageAdviser::notifyDoneAllocation
-            (StorageAdviser::MemoryAllocation,
-             (m_data.size() * sizeof(float)) / 1024);
+            (StorageAdviser::MemoryAllocation, kb);
+    }
+
+    if (m_cacheTierKB > 0) {
+        StorageAdviser::notifyTierRelease(m_cacheTier, m_cacheTierKB);
     }
 }
 
+size_t
+CodedAudioFileReader::getMemoryCacheKB() const
+{
+    return (m_data.size() * sizeof(float) +
+            m_compactData.size() * sizeof(int16_t) +
+            m_compactRanges.size() * sizeof(float)) / 1024;
+}
+
 void
 CodedAudioFileReader::setFramesToTrim(sv_frame_t fromStart, sv_frame_t fromEnd)
 {
@@ -164,7 +195,23 @@ CodedAudioFileReader::initialiseDecodeCache()
     if (m_cacheMode == CacheInTemporaryFile) {
 
         try {
-            QDir dir(TempDirectory::getInstance()->getPath());
+            // The actual size is not known until decoding is
+            // complete, so the tier is chosen using the estimate (of
+            // float samples, as written below). A decode cache is
+            // always a file, so a placement in memory means the
+            // fastest disc available
+            size_t kb = 0;
+            if (m_estimatedSamples > 0) {
+                kb = size_t(m_estimatedSamples * sizeof(float) / 1024);
+            }
+            m_cacheTier = StorageAdviser::recommendTier
+                (StorageAdviser::DecodeCache, kb);
+            if (m_cacheTier == StorageAdviser::MemoryTier) {
+                m_cacheTier = StorageAdviser::FastDiscTier;
+            }
+            QDir dir(TempDirectory::getInstance()->getPath
+                     (m_cacheTier == StorageAdviser::FastDiscTier ?
+                      TempDirectory::FastDisc : TempDirectory::DefaultDisc));
             m_cacheFileName = dir.filePath(QString("decoded_%1.w64")
                                            .arg((intptr_t)this));
 
@@ -237,6 +284,24 @@ CodedAudioFileReader::initialiseDecodeCache()
 
     if (m_cacheMode == CacheInMemory) {
         m_data.clear();
+        m_compactData.clear();
+        m_compactRanges.clear();
+        m_planarFrames = 0;
+        if (m_channelCount >= PlanarChannelThreshold) {
+            SVDEBUG << "CodedAudioFileReader::initialiseDecodeCache: "
+                    << m_channelCount << " channels, using planar cache layout"
+                    << endl;
+            m_cacheLayout = CachePlanar;
+            m_cacheSampleFormat = CacheFloat;
+        } else {
+            m_cacheLayout = CacheInterleaved;
+        }
+        if (m_cacheSampleFormat == CacheCompact) {
+            SVDEBUG << "CodedAudioFileReader::initialiseDecodeCache: "
+                    << "using compact 16-bit cache format" << endl;
+        }
+    } else {
+        m_cacheSampleFormat = CacheFloat;
     }
 
     if (m_trimFromEnd >= (m_cacheWriteBufferFrames * m_channelCount)) {
@@ -346,11 +411,19 @@ CodedAudioFileReader::finishDecodeCache()
         m_cacheFileWritePtr = nullptr;
         if (m_cacheFileReader) m_cacheFileReader->updateFrameCount();
 
+        m_cacheTierKB = size_t(QFileInfo(m_cacheFileName).size() / 1024);
+
     } else {
         // I know, I know, we already allocated it...
         StorageAdviser::notifyPlannedAllocation
-            (StorageAdviser::MemoryAllocation,
-             (m_data.size() * sizeof(float)) / 1024);
+            (StorageAdviser::MemoryAllocation, getMemoryCacheKB());
+
+        m_cacheTier = StorageAdviser::MemoryTier;
+        m_cacheTierKB = getMemoryCacheKB();
+    }
+
+    if (m_cacheTierKB > 0) {
+        StorageAdviser::notifyTierAllocation(m_cacheTier, m_cacheTierKB);
     }
 
     SVDEBUG << "CodedAudioFileReader: File decodes to " << m_fileFrameCount
@@ -368,6 +441,20 @@ CodedAudioFileReader::finishDecodeCache()
     }
 }
 
+void
+CodedAudioFileReader::storeMetadata(QString location, bool exactFrameCount)
+{
+    // m_max is measured after resampling, so it is only the file's
+    // own peak if there was none
+    float peak = -1.f;
+    if (m_sampleRate == m_fileRate) {
+        peak = m_max;
+    }
+    
+    AudioFileMetadataCache::getInstance()->storeFromReader
+        (location, this, exactFrameCount, peak);
+}
+
 void
 CodedAudioFileReader::pushCacheWriteBufferMaybe(bool final)
 {
@@ -480,9 +567,18 @@ CodedAudioFileReader::pushBufferNonResampling(float *buffer, sv_frame_t sz)
     case CacheInMemory:
         m_dataLock.lock();
         try {
-            m_data.insert(m_data.end(), buffer, buffer + count);
+            if (m_cacheLayout == CachePlanar) {
+                appendToPlanarCache(buffer, sz);
+            } else if (m_cacheSampleFormat == CacheCompact) {
+                appendToCompactCache(buffer, count);
+            } else {
+                m_data.insert(m_data.end(), buffer, buffer + count);
+            }
         } catch (const std::bad_alloc &e) {
             m_data.clear();
+            m_compactData.clear();
+            m_compactRanges.clear();
+            m_planarFrames = 0;
             SVCERR << "CodedAudioFileReader: Caught bad_alloc when trying to add " << count << " elements to buffer" << endl;
             m_dataLock.unlock();
             throw e;
@@ -492,6 +588,101 @@ CodedAudioFileReader::pushBufferNonResampling(float *buffer, sv_frame_t sz)
     }
 }
 
+void
+CodedAudioFileReader::appendToPlanarCache(const float *buffer, sv_frame_t sz)
+{
+    // Each chunk is allocated in full (zero-filled) when its first
+    // frame is written, so that the frames written so far can be read
+    // back while decoding is still under way
+
+    const sv_frame_t chunkSize = PlanarChunkFrames * m_channelCount;
+    
+    sv_frame_t i = 0;
+
+    while (i < sz) {
+
+        sv_frame_t offset = m_planarFrames % PlanarChunkFrames;
+        if (offset == 0) {
+            m_data.resize(m_data.size() + chunkSize, 0.f);
+        }
+
+        sv_frame_t n = std::min(sz - i, PlanarChunkFrames - offset);
+        float *chunk = m_data.data() + m_data.size() - chunkSize;
+
+        for (int c = 0; c < m_channelCount; ++c) {
+            SampleOps::extractChannel(buffer + i * m_channelCount,
+                                      m_channelCount, c,
+                                      chunk + c * PlanarChunkFrames + offset,
+                                      n);
+        }
+
+        i += n;
+        m_planarFrames += n;
+    }
+}
+
+void
+CodedAudioFileReader::appendToCompactCache(const float *buffer,
+                                           sv_frame_t count)
+{
+    // Each block's range starts at 1, which is enough for any sample
+    // unless we are normalising (otherwise samples have been clipped
+    // already). If a larger value arrives, the range is widened and
+    // the samples already stored in the block are requantised to it
+
+    sv_frame_t i = 0;
+
+    while (i < count) {
+
+        sv_frame_t offset = sv_frame_t(m_compactData.size()) %
+            CompactBlockSamples;
+        if (offset == 0) {
+            m_compactRanges.push_back(1.f);
+        }
+
+        sv_frame_t n = std::min(count - i, CompactBlockSamples - offset);
+
+        float &range = m_compactRanges[m_compactRanges.size() - 1];
+        float peak = range;
+        for (sv_frame_t j = 0; j < n; ++j) {
+            float v = fabsf(buffer[i + j]);
+            if (v > peak) peak = v;
+        }
+
+        if (peak > range) {
+            int16_t *block = m_compactData.data() +
+                m_compactData.size() - offset;
+            vector<float> existing(offset);
+            SampleOps::fromInt16(block, existing.data(), offset,
+                                 range / 32768.f);
+            SampleOps::toInt16(existing.data(), block, offset,
+                               32768.f / peak);
+            range = peak;
+        }
+
+        size_t base = m_compactData.size();
+        m_compactData.resize(base + n);
+        SampleOps::toInt16(buffer + i, m_compactData.data() + base, n,
+                           32768.f / range);
+
+        i += n;
+    }
+}
+
+void
+CodedAudioFileReader::readFromCompactCache(sv_frame_t ix0, sv_frame_t ix1,
+                                           float *out) const
+{
+    for (sv_frame_t i = ix0; i < ix1; ) {
+        sv_frame_t block = i / CompactBlockSamples;
+        sv_frame_t run = std::min(ix1 - i,
+                                  (block + 1) * CompactBlockSamples - i);
+        SampleOps::fromInt16(m_compactData.data() + i, out + (i - ix0), run,
+                             m_compactRanges[block] / 32768.f);
+        i += run;
+    }
+}
+
 void
 CodedAudioFileReader::pushBufferResampling(float *buffer, sv_frame_t sz,
                                            double ratio, bool final)
@@ -575,6 +766,10 @@ CodedAudioFileReader::getInterleavedFrames(sv_frame_t start, sv_frame_t count) c
         if (!isOK()) return {};
         if (count == 0) return {};
 
+        AccessTracer::record(AccessTracer::AudioFileRead,
+                             uint64_t(uintptr_t(this)), -1, start, count,
+                             AccessTracer::Hit);
+
         sv_frame_t ix0 = start * m_channelCount;
         sv_frame_t ix1 = ix0 + (count * m_channelCount);
 
@@ -583,10 +778,38 @@ CodedAudioFileReader::getInterleavedFrames(sv_frame_t start, sv_frame_t count) c
         // it's not a good idea in cases like this where we don't
         // really have threads taking a long time to read concurrently
         m_dataLock.lock();
-        sv_frame_t n = sv_frame_t(m_data.size());
-        if (ix0 > n) ix0 = n;
-        if (ix1 > n) ix1 = n;
-        frames = floatvec_t(m_data.begin() + ix0, m_data.begin() + ix1);
+        if (m_cacheLayout == CachePlanar) {
+            sv_frame_t n = m_planarFrames;
+            if (start > n) start = n;
+            if (start + count > n) count = n - start;
+            frames = floatvec_t(count * m_channelCount, 0.f);
+            vector<const float *> src(m_channelCount);
+            for (sv_frame_t i = 0; i < count; ) {
+                sv_frame_t f = start + i;
+                sv_frame_t offset = f % PlanarChunkFrames;
+                sv_frame_t run = std::min(count - i, PlanarChunkFrames - offset);
+                const float *chunk = m_data.data() +
+                    (f / PlanarChunkFrames) * PlanarChunkFrames * m_channelCount;
+                for (int c = 0; c < m_channelCount; ++c) {
+                    src[c] = chunk + c * PlanarChunkFrames + offset;
+                }
+                SampleOps::interleave(src.data(), m_channelCount,
+                                      frames.data() + i * m_channelCount,
+                                      run);
+                i += run;
+            }
+        } else if (m_cacheSampleFormat == CacheCompact) {
+            sv_frame_t n = sv_frame_t(m_compactData.size());
+            if (ix0 > n) ix0 = n;
+            if (ix1 > n) ix1 = n;
+            frames = floatvec_t(ix1 - ix0, 0.f);
+            readFromCompactCache(ix0, ix1, frames.data());
+        } else {
+            sv_frame_t n = sv_frame_t(m_data.size());
+            if (ix0 > n) ix0 = n;
+            if (ix1 > n) ix1 = n;
+            frames = floatvec_t(m_data.begin() + ix0, m_data.begin() + ix1);
+        }
         m_dataLock.unlock();
         break;
     }
@@ -599,3 +822,71 @@ CodedAudioFileReader::getInterleavedFrames(sv_frame_t start, sv_frame_t count) c
     return frames;
 }
 
+
+vector<floatvec_t>
+CodedAudioFileReader::getChannelFrames(int fromchannel, int tochannel,
+                                       sv_frame_t start, sv_frame_t count) const
+{
+    if (m_cacheMode != CacheInMemory || m_cacheLayout != CachePlanar) {
+        return AudioFileReader::getChannelFrames
+            (fromchannel, tochannel, start, count);
+    }
+    
+    Profiler profiler("CodedAudioFileReader::getChannelFrames");
+
+    if (!m_initialised) {
+        SVDEBUG << "CodedAudioFileReader::getChannelFrames: not initialised" << endl;
+        return {};
+    }
+
+    if (!isOK()) return {};
+    if (fromchannel < 0 || fromchannel > tochannel ||
+        tochannel >= m_channelCount) {
+        return {};
+    }
+
+    AccessTracer::record(AccessTracer::AudioFileRead,
+                         uint64_t(uintptr_t(this)),
+                         fromchannel == tochannel ? fromchannel : -1,
+                         start, count, AccessTracer::Hit);
+
+    int reqchannels = tochannel - fromchannel + 1;
+    vector<floatvec_t> result(reqchannels);
+    
+    // With the planar layout, each requested channel is a straight
+    // copy from each chunk it spans, and the other channels are not
+    // touched at all
+    
+    m_dataLock.lock();
+
+    sv_frame_t n = m_planarFrames;
+    if (start > n) start = n;
+    if (start + count > n) count = n - start;
+
+    for (int c = 0; c < reqchannels; ++c) {
+
+        floatvec_t &frames = result[c];
+        frames.reserve(count);
+        
+        for (sv_frame_t i = 0; i < count; ) {
+            sv_frame_t f = start + i;
+            sv_frame_t offset = f % PlanarChunkFrames;
+            sv_frame_t run = std::min(count - i, PlanarChunkFrames - offset);
+            const float *src = m_data.data() +
+                (f / PlanarChunkFrames) * PlanarChunkFrames * m_channelCount +
+                (fromchannel + c) * PlanarChunkFrames + offset;
+            frames.insert(frames.end(), src, src + run);
+            i += run;
+        }
+    }
+    
+    m_dataLock.unlock();
+
+    if (m_normalised) {
+        for (auto &frames: result) {
+            for (auto &f: frames) f *= m_gain;
+        }
+    }
+
+    return result;
+}
@@ -18,6 +18,8 @@
 
 #include "AudioFileReader.h"
 
+#include "base/StorageAdviser.h"
+
 #include <QMutex>
 #include <QReadWriteLock>
 
@@ -29,6 +31,8 @@
 #include <sndfile.h>
 
 #include <atomic>
+#include <vector>
+#include <cstdint>
 
 class WavFileReader;
 class Serialiser;
@@ -46,7 +50,8 @@ public:
 
     enum CacheMode {
         CacheInTemporaryFile,
-        CacheInMemory
+        CacheInMemory,
+        CacheInMemoryCompact // in memory, as CacheCompact where possible
     };
 
     enum DecodeMode {
@@ -54,8 +59,59 @@ public:
         DecodeThreaded // decode in a background thread after construction
     };
 
+    /**
+     * Arrangement of samples within an in-memory decode cache.
+     * Interleaved stores frames one after another, as read from the
+     * decoder. Planar stores the cache in fixed-size chunks of
+     * PlanarChunkFrames frames, with each chunk holding all of its
+     * frames for channel 0, then all for channel 1 and so on, so that
+     * a consumer of a single channel can read it without touching
+     * the others. The layout is selected automatically when the
+     * decode cache is initialised: planar is used for in-memory
+     * caches with at least PlanarChannelThreshold channels. It has
+     * no effect on a temporary file cache.
+     */
+    enum CacheLayout {
+        CacheInterleaved,
+        CachePlanar
+    };
+
+    static const int PlanarChannelThreshold = 8;
+    static const sv_frame_t PlanarChunkFrames = 4096;
+
+    CacheLayout getCacheLayout() const { return m_cacheLayout; }
+
+    /**
+     * Sample format of an in-memory decode cache. CacheFloat stores
+     * samples as floats. CacheCompact stores them as 16-bit integers,
+     * halving the memory used, with a scale factor for each block of
+     * CompactBlockSamples samples: this is 1/32768 unless the block
+     * contains values outside [-1, 1] (which can only happen when
+     * normalising), so samples that came from a 16-bit source are
+     * stored exactly. Conversion back to float happens on read.
+     *
+     * The compact format is used when the reader is constructed with
+     * CacheInMemoryCompact, except for caches with planar layout,
+     * which are always float. (The cache mode then reads back as
+     * CacheInMemory.)
+     */
+    enum CacheSampleFormat {
+        CacheFloat,
+        CacheCompact
+    };
+
+    static const sv_frame_t CompactBlockSamples = 4096;
+
+    CacheSampleFormat getCacheSampleFormat() const {
+        return m_cacheSampleFormat;
+    }
+    
     floatvec_t getInterleavedFrames(sv_frame_t start, sv_frame_t count) const override;
 
+    std::vector<floatvec_t> getChannelFrames(int fromchannel, int tochannel,
+                                             sv_frame_t start,
+                                             sv_frame_t count) const override;
+
     sv_samplerate_t getNativeRate() const override { return m_fileRate; }
 
     QString getLocalFilename() const override { return m_cacheFileName; }
@@ -67,9 +123,13 @@ signals:
     void progress(int);
 
 protected:
+    // estimatedSamples is an estimate of the decoded sample count
+    // across all channels (see AudioFileSizeEstimator), or 0 if
+    // unknown; it is used to choose a storage tier for the cache
     CodedAudioFileReader(CacheMode cacheMode, 
                          sv_samplerate_t targetRate,
-                         bool normalised);
+                         bool normalised,
+                         sv_frame_t estimatedSamples = 0);
 
     void initialiseDecodeCache(); // samplerate, channels must have been set
 
@@ -86,6 +146,12 @@ protected:
 
     bool isDecodeCacheInitialised() const { return m_initialised; }
 
+    // Record the properties of the decoded file in the
+    // AudioFileMetadataCache. Call after finishDecodeCache, and only
+    // if decoding completed without being cancelled; exactFrameCount
+    // is as for AudioFileMetadataCache::storeFromReader
+    void storeMetadata(QString location, bool exactFrameCount);
+
     void startSerialised(QString id, const std::atomic<bool> *cancelled);
     void endSerialised();
 
@@ -100,16 +166,34 @@ private:
     // to be called only by pushBuffer and pushBufferResampling
     void pushBufferNonResampling(float *interleaved, sv_frame_t sz);
 
+    // to be called only by pushBufferNonResampling, with m_dataLock held
+    void appendToPlanarCache(const float *interleaved, sv_frame_t sz);
+    void appendToCompactCache(const float *interleaved, sv_frame_t count);
+
+    // with m_dataLock held; ix0 and ix1 are sample (not frame) indices
+    void readFromCompactCache(sv_frame_t ix0, sv_frame_t ix1,
+                              float *out) const;
+
+    size_t getMemoryCacheKB() const;
+
 protected:
     QMutex m_cacheMutex;
     CacheMode m_cacheMode;
+    CacheLayout m_cacheLayout;
+    CacheSampleFormat m_cacheSampleFormat;
     floatvec_t m_data;
+    std::vector<int16_t> m_compactData;
+    std::vector<float> m_compactRanges; // largest magnitude, per block
+    sv_frame_t m_planarFrames; // frames written so far, in planar layout
     mutable QMutex m_dataLock;
     bool m_initialised;
     Serialiser *m_serialiser;
     sv_samplerate_t m_fileRate;
 
     QString m_cacheFileName;
+    sv_frame_t m_estimatedSamples;
+    StorageAdviser::StorageTier m_cacheTier;
+    size_t m_cacheTierKB; // amount notified to StorageAdviser for m_cacheTier
     SNDFILE *m_cacheFileWritePtr;
     WavFileReader *m_cacheFileReader;
     float *m_cacheWriteBuffer;
@@ -28,8 +28,10 @@ DecodingWavFileReader::DecodingWavFileReader(FileSource source,
                                              CacheMode mode,
                                              sv_samplerate_t targetRate,
                                              bool normalised,
-                                             ProgressReporter *reporter) :
-    CodedAudioFileReader(mode, targetRate, normalised),
+                                             ProgressReporter *reporter,
+                                             sv_frame_t estimatedSamples) :
+    CodedAudioFileReader(mode, targetRate, normalised,
+                         estimatedSamples),
     m_source(source),
     m_path(source.getLocalFilename()),
     m_cancelled(false),
@@ -90,6 +92,10 @@ DecodingWavFileReader::DecodingWavFileReader(FileSource source,
         if (isDecodeCacheInitialised()) finishDecodeCache();
         endSerialised();
 
+        if (!m_cancelled) {
+            storeMetadata(m_source.getLocation(), true);
+        }
+
         if (m_reporter) m_reporter->setProgress(100);
 
         delete m_original;
@@ -153,6 +159,10 @@ DecodingWavFileReader::DecodeThread::run()
 
     m_reader->endSerialised();
 
+    if (!m_reader->m_cancelled) {
+        m_reader->storeMetadata(m_reader->m_source.getLocation(), true);
+    }
+
     delete m_reader->m_original;
     m_reader->m_original = nullptr;
 } 
@@ -35,7 +35,8 @@ public:
                           CacheMode cacheMode,
                           sv_samplerate_t targetRate = 0,
                           bool normalised = false,
-                          ProgressReporter *reporter = 0);
+                          ProgressReporter *reporter = 0,
+                          sv_frame_t estimatedSamples = 0);
     virtual ~DecodingWavFileReader();
 
     QString getTitle() const override { return m_title; }
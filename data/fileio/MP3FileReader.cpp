@@ -53,8 +53,10 @@ MP3FileReader::MP3FileReader(FileSource source, DecodeMode decodeMode,
                              CacheMode mode, GaplessMode gaplessMode,
                              sv_samplerate_t targetRate,
                              bool normalised,
-                             ProgressReporter *reporter) :
-    CodedAudioFileReader(mode, targetRate, normalised),
+                             ProgressReporter *reporter,
+                             sv_frame_t estimatedSamples) :
+    CodedAudioFileReader(mode, targetRate, normalised,
+                         estimatedSamples),
     m_source(source),
     m_path(source.getLocalFilename()),
     m_gaplessMode(gaplessMode),
@@ -152,6 +154,11 @@ MP3FileReader::MP3FileReader(FileSource source, DecodeMode decodeMode,
         if (isDecodeCacheInitialised()) finishDecodeCache();
         endSerialised();
 
+        if (!m_cancelled) {
+            storeMetadata(m_source.getLocation(),
+                          m_gaplessMode == GaplessMode::Gapless);
+        }
+
     } else {
 
         if (m_reporter) m_reporter->setProgress(100);
@@ -313,6 +320,12 @@ MP3FileReader::DecodeThread::run()
     m_reader->m_completion = 100;
 
     m_reader->endSerialised();
+
+    if (!m_reader->m_cancelled) {
+        m_reader->storeMetadata(m_reader->m_source.getLocation(),
+                                m_reader->m_gaplessMode ==
+                                GaplessMode::Gapless);
+    }
 } 
 
 bool
@@ -72,7 +72,8 @@ public:
                   GaplessMode gaplessMode,
                   sv_samplerate_t targetRate = 0,
                   bool normalised = false,
-                  ProgressReporter *reporter = 0);
+                  ProgressReporter *reporter = 0,
+                  sv_frame_t estimatedSamples = 0);
     virtual ~MP3FileReader();
 
     QString getError() const override { return m_error; }
@@ -0,0 +1,572 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#include "SpectrogramExporter.h"
+
+#include "model/DenseThreeDimensionalModel.h"
+#include "model/EditableDenseThreeDimensionalModel.h"
+#include "model/BasicCompressedDenseThreeDimensionalModel.h"
+#include "model/Dense3DModelPeakCache.h"
+#include "model/FFTModel.h"
+
+#include "base/EventXmlWriter.h"
+#include "base/TempWriteFile.h"
+#include "base/Exceptions.h"
+#include "base/ProgressReporter.h"
+#include "base/RealTime.h"
+#include "base/StringBits.h"
+#include "base/Profiler.h"
+#include "base/Debug.h"
+
+#include <QFile>
+#include <QThread>
+
+#include <thread>
+#include <memory>
+#include <exception>
+#include <cstring>
+
+using namespace std;
+
+static const char matrixMagic[8] = { 'S', 'V', 'S', 'P', 'E', 'C', 'M', 0 };
+static const uint32_t matrixVersion = 1;
+
+namespace {
+
+// Reads runs of whole columns, column by column, into a buffer. Each
+// reader is used by only one thread at a time.
+class ColumnReader
+{
+public:
+    virtual ~ColumnReader() { }
+    virtual void read(int x0, int count, float *dest) = 0;
+};
+
+// For models that are safe to read from several threads at once, or
+// when only one thread is in use
+class DirectColumnReader : public ColumnReader
+{
+public:
+    DirectColumnReader(const DenseThreeDimensionalModel *model) :
+        m_model(model), m_height(model->getHeight()) { }
+
+    void read(int x0, int count, float *dest) override {
+        m_model->getColumns(x0, count, 0, m_height, dest);
+    }
+
+private:
+    const DenseThreeDimensionalModel *m_model;
+    int m_height;
+};
+
+// Reads from a private copy of an FFTModel, as FFTModel is not
+// thread-safe
+class FFTColumnReader : public ColumnReader
+{
+public:
+    FFTColumnReader(const FFTModel *model) {
+        m_fft.reset(new FFTModel(model->getInputModel(),
+                                 model->getChannel(),
+                                 model->getWindowType(),
+                                 model->getWindowSize(),
+                                 model->getWindowIncrement(),
+                                 model->getFFTSize()));
+        m_fft->setMaximumFrequency(model->getMaximumFrequency());
+        if (model->isZoomed()) {
+            m_fft->setZoomBand(model->getZoomMinFrequency(),
+                               model->getZoomMaxFrequency(),
+                               model->getZoomRequestedResolution());
+        }
+        m_height = m_fft->getHeight();
+    }
+
+    void read(int x0, int count, float *dest) override {
+        m_fft->getColumns(x0, count, 0, m_height, dest);
+    }
+
+private:
+    unique_ptr<FFTModel> m_fft;
+    int m_height;
+};
+
+// Calculates the columns of a Dense3DModelPeakCache from its source,
+// in the same way as the cache does, without going through the
+// (non-thread-safe) cache itself
+class PeakColumnReader : public ColumnReader
+{
+public:
+    PeakColumnReader(unique_ptr<ColumnReader> source,
+                     int columnsPerPeak, int sourceWidth, int height) :
+        m_source(std::move(source)),
+        m_columnsPerPeak(std::max(columnsPerPeak, 1)),
+        m_sourceWidth(sourceWidth),
+        m_height(height),
+        m_buffer(size_t(m_columnsPerPeak) * height) { }
+
+    void read(int x0, int count, float *dest) override {
+        for (int i = 0; i < count; ++i) {
+            float *out = dest + size_t(i) * m_height;
+            int sx0 = (x0 + i) * m_columnsPerPeak;
+            int n = std::min(m_columnsPerPeak, m_sourceWidth - sx0);
+            if (n <= 0) {
+                std::fill(out, out + m_height, 0.f);
+                continue;
+            }
+            m_source->read(sx0, n, m_buffer.data());
+            std::copy(m_buffer.begin(), m_buffer.begin() + m_height, out);
+            for (int j = 1; j < n; ++j) {
+                const float *in = m_buffer.data() + size_t(j) * m_height;
+                for (int k = 0; k < m_height; ++k) {
+                    out[k] = std::max(out[k], in[k]);
+                }
+            }
+        }
+    }
+
+private:
+    unique_ptr<ColumnReader> m_source;
+    int m_columnsPerPeak;
+    int m_sourceWidth;
+    int m_height;
+    vector<float> m_buffer;
+};
+
+// Return a reader for the given model that may be used on a thread
+// of its own alongside other readers made by this function, or null
+// if the model can only be read on the calling thread
+unique_ptr<ColumnReader>
+makeThreadReader(const DenseThreeDimensionalModel *model)
+{
+    if (auto fft = dynamic_cast<const FFTModel *>(model)) {
+        return unique_ptr<ColumnReader>(new FFTColumnReader(fft));
+    }
+
+    if (auto peaks = dynamic_cast<const Dense3DModelPeakCache *>(model)) {
+        auto source = ModelById::getAs<DenseThreeDimensionalModel>
+            (peaks->getPeakSourceModel());
+        if (!source) return {};
+        auto sourceReader = makeThreadReader(source.get());
+        if (!sourceReader) return {};
+        return unique_ptr<ColumnReader>
+            (new PeakColumnReader(std::move(sourceReader),
+                                  peaks->getColumnsPerPeak(),
+                                  source->getWidth(),
+                                  source->getHeight()));
+    }
+
+    // These lock internally
+    if (dynamic_cast<const EditableDenseThreeDimensionalModel *>(model) ||
+        dynamic_cast<const BasicCompressedDenseThreeDimensionalModel *>
+        (model)) {
+        return unique_ptr<ColumnReader>(new DirectColumnReader(model));
+    }
+
+    return {};
+}
+
+// The worker threads of one round of batches. Each worker catches
+// anything thrown while processing its batch, to be rethrown on the
+// calling thread by join(); and the destructor joins any workers
+// still running, so that an exception on the calling thread cannot
+// leave a joinable thread behind (which would terminate the process)
+class Workers
+{
+public:
+    Workers(int count) : m_errors(count) {
+        m_threads.reserve(count); // so push_back cannot throw
+    }
+
+    ~Workers() {
+        for (auto &t: m_threads) {
+            if (t.joinable()) t.join();
+        }
+    }
+
+    template <typename F>
+    void start(int index, F f) {
+        exception_ptr &error = m_errors[index];
+        m_threads.push_back(std::thread([f, &error]() {
+                    try {
+                        f();
+                    } catch (...) {
+                        error = current_exception();
+                    }
+                }));
+    }
+
+    void join() {
+        for (auto &t: m_threads) {
+            t.join();
+        }
+        m_threads.clear();
+        for (auto &e: m_errors) {
+            if (e) rethrow_exception(e);
+        }
+    }
+
+    Workers(const Workers &) =delete;
+    Workers &operator=(const Workers &) =delete;
+
+private:
+    vector<std::thread> m_threads;
+    vector<exception_ptr> m_errors;
+};
+
+}
+
+SpectrogramExporter::SpectrogramExporter(QString path,
+                                         const DenseThreeDimensionalModel *model,
+                                         Format format,
+                                         QString delimiter,
+                                         DataExportOptions options) :
+    m_path(path),
+    m_model(model),
+    m_format(format),
+    m_delimiter(delimiter),
+    m_options(options),
+    m_batchSize(256),
+    m_threadCount(0),
+    m_reporter(nullptr)
+{
+}
+
+SpectrogramExporter::~SpectrogramExporter()
+{
+}
+
+void
+SpectrogramExporter::setBatchSize(int columns)
+{
+    m_batchSize = std::max(columns, 1);
+}
+
+void
+SpectrogramExporter::setThreadCount(int threads)
+{
+    m_threadCount = std::max(threads, 0);
+}
+
+void
+SpectrogramExporter::setProgressReporter(ProgressReporter *reporter)
+{
+    m_reporter = reporter;
+}
+
+bool
+SpectrogramExporter::isOK() const
+{
+    return m_error == "";
+}
+
+QString
+SpectrogramExporter::getError() const
+{
+    return m_error;
+}
+
+void
+SpectrogramExporter::write()
+{
+    if (!m_model) {
+        m_error = tr("No model to export");
+        return;
+    }
+    write(m_model->getStartFrame(),
+          m_model->getEndFrame() - m_model->getStartFrame());
+}
+
+void
+SpectrogramExporter::write(sv_frame_t startFrame, sv_frame_t duration)
+{
+    Profiler profiler("SpectrogramExporter::write");
+
+    if (!m_model || !m_model->isOK()) {
+        m_error = tr("No model to export");
+        return;
+    }
+
+    int x0 = 0, width = 0;
+    m_model->getColumnRange(startFrame, duration, x0, width);
+    int height = m_model->getHeight();
+    int resolution = m_model->getResolution();
+    sv_frame_t firstFrame = m_model->getStartFrame() +
+        sv_frame_t(x0) * resolution;
+    sv_samplerate_t sampleRate = m_model->getSampleRate();
+
+    int threads = m_threadCount;
+    if (threads == 0) {
+        threads = std::max(QThread::idealThreadCount(), 1);
+    }
+    int batches = (width + m_batchSize - 1) / m_batchSize;
+    threads = std::max(std::min(threads, batches), 1);
+
+    // One reader per thread, or just the model itself if it can't be
+    // read concurrently
+    vector<unique_ptr<ColumnReader>> readers;
+    if (threads > 1) {
+        for (int i = 0; i < threads; ++i) {
+            auto reader = makeThreadReader(m_model);
+            if (!reader) break;
+            readers.push_back(std::move(reader));
+        }
+        if (int(readers.size()) < threads) {
+            readers.clear();
+        }
+    }
+    if (readers.empty()) {
+        threads = 1;
+        readers.push_back(unique_ptr<ColumnReader>
+                          (new DirectColumnReader(m_model)));
+    }
+
+    SVDEBUG << "SpectrogramExporter::write: writing " << width
+            << " columns of " << height << " bins to \"" << m_path
+            << "\" using " << threads << " thread(s)" << endl;
+
+    try {
+        TempWriteFile temp(m_path);
+
+        QFile file(temp.getTemporaryFilename());
+        if (!file.open(QIODevice::WriteOnly)) {
+            m_error = tr("Failed to open file %1 for writing")
+                .arg(temp.getTemporaryFilename());
+            return;
+        }
+
+        bool csv = (m_format == CSVFormat);
+        QByteArray delimiter = m_delimiter.toUtf8();
+        bool includeTime = (m_options & DataExportAlwaysIncludeTimestamp);
+        bool timeInFrames = (m_options & DataExportWriteTimeInFrames);
+
+        QByteArray preamble;
+
+        if (csv) {
+            if (m_options & DataExportIncludeHeader) {
+                if (includeTime) {
+                    preamble.append(timeInFrames ? "FRAME" : "TIME");
+                    preamble.append(delimiter);
+                }
+                preamble.append(StringBits::joinDelimited
+                                (m_model->getStringExportHeaders(m_options),
+                                 m_delimiter).toUtf8());
+                preamble.append('\n');
+            }
+        } else {
+            uint32_t w = uint32_t(width), h = uint32_t(height);
+            uint32_t r = uint32_t(resolution);
+            int64_t f = int64_t(firstFrame);
+            double rate = double(sampleRate);
+            preamble.append(matrixMagic, sizeof(matrixMagic));
+            preamble.append(reinterpret_cast<const char *>(&matrixVersion),
+                            sizeof(matrixVersion));
+            preamble.append(reinterpret_cast<const char *>(&w), sizeof(w));
+            preamble.append(reinterpret_cast<const char *>(&h), sizeof(h));
+            preamble.append(reinterpret_cast<const char *>(&r), sizeof(r));
+            preamble.append(reinterpret_cast<const char *>(&f), sizeof(f));
+            preamble.append(reinterpret_cast<const char *>(&rate),
+                            sizeof(rate));
+            bool haveBinValues = m_model->hasBinValues();
+            for (int i = 0; i < height; ++i) {
+                float v = haveBinValues ? m_model->getBinValue(i) : float(i);
+                preamble.append(reinterpret_cast<const char *>(&v),
+                                sizeof(v));
+            }
+        }
+
+        if (file.write(preamble) != preamble.size()) {
+            m_error = tr("Failed to write to file %1").arg(m_path);
+            return;
+        }
+
+        // Each thread calculates a batch of columns into its own
+        // buffer and, for CSV, formats them too. Each round of
+        // batches is then written out in order.
+
+        vector<vector<float>> values(threads);
+        vector<QByteArray> formatted(threads);
+
+        auto process = [&](int j, int b0, int n) {
+            vector<float> &v = values[j];
+            v.resize(size_t(n) * height);
+            readers[j]->read(b0, n, v.data());
+            if (!csv) return;
+            QByteArray &buffer = formatted[j];
+            buffer.clear();
+            for (int i = 0; i < n; ++i) {
+                if (includeTime) {
+                    sv_frame_t frame = m_model->getStartFrame() +
+                        sv_frame_t(b0 + i) * resolution;
+                    if (timeInFrames) {
+                        EventXmlWriter::appendInteger(buffer, frame);
+                    } else {
+                        buffer.append(RealTime::frame2RealTime
+                                      (frame, sampleRate).toString().c_str());
+                    }
+                    if (height > 0) buffer.append(delimiter);
+                }
+                const float *column = v.data() + size_t(i) * height;
+                for (int k = 0; k < height; ++k) {
+                    if (k > 0) buffer.append(delimiter);
+                    EventXmlWriter::appendFloat(buffer, column[k]);
+                }
+                buffer.append('\n');
+            }
+        };
+
+        int written = 0;
+        int previousProgress = 0;
+        bool cancelled = false;
+
+        for (int first = 0; first < batches; first += threads) {
+
+            if (m_reporter && m_reporter->wasCancelled()) {
+                cancelled = true;
+                break;
+            }
+
+            int count = std::min(threads, batches - first);
+            Workers workers(count);
+
+            auto batchStart = [&](int j) {
+                return x0 + (first + j) * m_batchSize;
+            };
+            auto batchCount = [&](int j) {
+                return std::min(m_batchSize,
+                                width - (first + j) * m_batchSize);
+            };
+
+            // The calling thread does the first batch of each round
+            for (int j = 1; j < count; ++j) {
+                int b0 = batchStart(j), n = batchCount(j);
+                workers.start(j, [=, &process]() {
+                        process(j, b0, n);
+                    });
+            }
+
+            process(0, batchStart(0), batchCount(0));
+
+            workers.join();
+
+            for (int j = 0; j < count; ++j) {
+                qint64 bytes = 0, wrote = 0;
+                if (csv) {
+                    bytes = formatted[j].size();
+                    wrote = file.write(formatted[j]);
+                } else {
+                    bytes = qint64(size_t(batchCount(j)) * height *
+                                   sizeof(float));
+                    wrote = file.write(reinterpret_cast<const char *>
+                                       (values[j].data()), bytes);
+                }
+                if (wrote != bytes) {
+                    m_error = tr("Failed to write to file %1").arg(m_path);
+                    return;
+                }
+                written += batchCount(j);
+            }
+
+            int progress = width > 0 ? int((100.0 * written) / width) : 100;
+            if (m_reporter && progress > previousProgress) {
+                m_reporter->setProgress(progress);
+                previousProgress = progress;
+            }
+        }
+
+        file.close();
+
+        if (cancelled) {
+            m_error = tr("Export cancelled");
+        } else {
+            temp.moveToTarget();
+        }
+
+    } catch (FileOperationFailed &f) {
+        m_error = f.what();
+    } catch (const std::exception &e) { // ProgressReporter could throw
+        m_error = e.what();
+    } catch (...) {
+        m_error = tr("Failed to export to file %1").arg(m_path);
+    }
+}
+
+bool
+SpectrogramExporter::readMatrix(QString path, MatrixHeader &header,
+                                vector<float> *values)
+{
+    QFile file(path);
+    if (!file.open(QFile::ReadOnly)) {
+        SVCERR << "SpectrogramExporter::readMatrix: Failed to open file \""
+               << path << "\"" << endl;
+        return false;
+    }
+
+    char magic[sizeof(matrixMagic)];
+    uint32_t version = 0, w = 0, h = 0, r = 0;
+    int64_t f = 0;
+    double rate = 0.0;
+
+    auto readInto = [&](void *dest, qint64 bytes) {
+        return file.read(reinterpret_cast<char *>(dest), bytes) == bytes;
+    };
+
+    if (!readInto(magic, sizeof(magic)) ||
+        memcmp(magic, matrixMagic, sizeof(magic)) != 0 ||
+        !readInto(&version, sizeof(version))) {
+        SVCERR << "SpectrogramExporter::readMatrix: File \"" << path
+               << "\" is not a spectrogram matrix" << endl;
+        return false;
+    }
+
+    if (version != matrixVersion) {
+        SVCERR << "SpectrogramExporter::readMatrix: File \"" << path
+               << "\" has unsupported version " << version << endl;
+        return false;
+    }
+
+    if (!readInto(&w, sizeof(w)) ||
+        !readInto(&h, sizeof(h)) ||
+        !readInto(&r, sizeof(r)) ||
+        !readInto(&f, sizeof(f)) ||
+        !readInto(&rate, sizeof(rate))) {
+        SVCERR << "SpectrogramExporter::readMatrix: File \"" << path
+               << "\" has a truncated header" << endl;
+        return false;
+    }
+
+    header.width = int(w);
+    header.height = int(h);
+    header.resolution = int(r);
+    header.startFrame = sv_frame_t(f);
+    header.sampleRate = sv_samplerate_t(rate);
+    header.binValues.resize(h);
+
+    if (!readInto(header.binValues.data(), qint64(h) * sizeof(float))) {
+        SVCERR << "SpectrogramExporter::readMatrix: File \"" << path
+               << "\" has a truncated header" << endl;
+        return false;
+    }
+
+    if (values) {
+        values->resize(size_t(w) * h);
+        if (!readInto(values->data(),
+                      qint64(values->size() * sizeof(float)))) {
+            SVCERR << "SpectrogramExporter::readMatrix: File \"" << path
+                   << "\" is truncated" << endl;
+            values->clear();
+            return false;
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,145 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef SV_SPECTROGRAM_EXPORTER_H
+#define SV_SPECTROGRAM_EXPORTER_H
+
+#include <QObject>
+#include <QString>
+
+#include "base/BaseTypes.h"
+#include "base/DataExportOptions.h"
+
+#include <vector>
+
+class DenseThreeDimensionalModel;
+class ProgressReporter;
+
+/**
+ * Write the columns of a dense 3-D model (typically an FFTModel or a
+ * Dense3DModelPeakCache over one) to a file in bulk, either as CSV
+ * with one row per column or as a binary matrix of 32-bit floats.
+ *
+ * Columns are calculated in batches on several threads at once and
+ * written out in order as each round of batches completes, so memory
+ * use is bounded by the batch size and thread count rather than the
+ * length of the model. An FFTModel is not thread-safe, so each
+ * thread works from its own copy of it, with the same parameters;
+ * a peak cache is computed by each thread directly from its source.
+ * Other models are read on a single thread unless they are known to
+ * be safe to read concurrently.
+ *
+ * The binary matrix format consists of a header:
+ *
+ *   8 bytes   magic "SVSPECM\0"
+ *   uint32    format version (1)
+ *   uint32    width (number of columns)
+ *   uint32    height (number of bins per column)
+ *   uint32    resolution (frames per column)
+ *   int64     frame of the first column
+ *   float64   sample rate
+ *   float32   the value of each bin (e.g. its frequency in Hz), or
+ *             its index if the model has no bin values: height of
+ *             these
+ *
+ * followed by width * height float32 values, column by column. All
+ * values are in host byte order (little-endian on every platform we
+ * build for).
+ */
+class SpectrogramExporter : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum Format {
+        CSVFormat,
+        Float32MatrixFormat
+    };
+
+    /**
+     * Construct an exporter writing the given model to the given
+     * path. The delimiter and options apply to CSV only: the options
+     * honoured are DataExportIncludeHeader,
+     * DataExportAlwaysIncludeTimestamp (which adds a first column
+     * with the time of each column) and DataExportWriteTimeInFrames.
+     */
+    SpectrogramExporter(QString path,
+                        const DenseThreeDimensionalModel *model,
+                        Format format,
+                        QString delimiter = ",",
+                        DataExportOptions options = DataExportDefaults);
+
+    virtual ~SpectrogramExporter();
+
+    /**
+     * Set the number of columns calculated by each thread at a time
+     * (default 256).
+     */
+    void setBatchSize(int columns);
+
+    /**
+     * Set the number of threads to use (default 0, meaning the ideal
+     * thread count for the machine).
+     */
+    void setThreadCount(int threads);
+
+    void setProgressReporter(ProgressReporter *reporter);
+
+    bool isOK() const;
+    QString getError() const;
+
+    /**
+     * Write all columns of the model.
+     */
+    void write();
+
+    /**
+     * Write the columns whose frames fall within the given range.
+     */
+    void write(sv_frame_t startFrame, sv_frame_t duration);
+
+    struct MatrixHeader {
+        MatrixHeader() :
+            width(0), height(0), resolution(0), startFrame(0),
+            sampleRate(0) { }
+        int width;
+        int height;
+        int resolution;
+        sv_frame_t startFrame;
+        sv_samplerate_t sampleRate;
+        std::vector<float> binValues;
+    };
+
+    /**
+     * Read a file written in Float32MatrixFormat. If values is
+     * non-null, also read the matrix into it, column by column.
+     * Return false if the file cannot be read or is not in this
+     * format.
+     */
+    static bool readMatrix(QString path, MatrixHeader &header,
+                           std::vector<float> *values = nullptr);
+
+private:
+    QString m_path;
+    const DenseThreeDimensionalModel *m_model;
+    Format m_format;
+    QString m_delimiter;
+    DataExportOptions m_options;
+    int m_batchSize;
+    int m_threadCount;
+    ProgressReporter *m_reporter;
+    QString m_error;
+};
+
+#endif
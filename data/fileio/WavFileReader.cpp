@@ -16,6 +16,7 @@
 #include "WavFileReader.h"
 
 #include "base/HitCount.h"
+#include "base/AccessTracer.h"
 #include "base/Profiler.h"
 
 #include <iostream>
@@ -207,6 +208,9 @@ WavFileReader::getInterleavedFramesUnnormalised(sv_frame_t start,
     // repeatedly for the same data. So this is worth cacheing.
     if (start == m_lastStart && count == m_lastCount) {
         lastRead.hit();
+        AccessTracer::record(AccessTracer::AudioFileRead,
+                             uint64_t(uintptr_t(this)), -1, start, count,
+                             AccessTracer::Hit);
         return m_buffer;
     }
 
@@ -215,8 +219,14 @@ WavFileReader::getInterleavedFramesUnnormalised(sv_frame_t start,
     // backward seek to be a miss
     if (start >= m_lastStart) {
         lastRead.partial();
+        AccessTracer::record(AccessTracer::AudioFileRead,
+                             uint64_t(uintptr_t(this)), -1, start, count,
+                             AccessTracer::Partial);
     } else {
         lastRead.miss();
+        AccessTracer::record(AccessTracer::AudioFileRead,
+                             uint64_t(uintptr_t(this)), -1, start, count,
+                             AccessTracer::Miss);
     }
     
     if (sf_seek(m_file, start, SEEK_SET) < 0) {
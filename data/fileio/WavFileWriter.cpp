@@ -20,6 +20,7 @@
 #include "base/TempWriteFile.h"
 #include "base/Exceptions.h"
 #include "base/Debug.h"
+#include "base/SampleOps.h"
 
 #include <bqvec/Allocators.h>
 #include <bqvec/VectorOps.h>
@@ -182,11 +183,7 @@ WavFileWriter::writeSamples(const float *const *samples, sv_frame_t count)
     }
 
     float *b = new float[count * m_channels];
-    for (sv_frame_t i = 0; i < count; ++i) {
-        for (int c = 0; c < int(m_channels); ++c) {
-            b[i * m_channels + c] = samples[c][i];
-        }
-    }
+    SampleOps::interleave(samples, int(m_channels), b, count);
 
     sv_frame_t written = sf_writef_float(m_file, b, count);
 
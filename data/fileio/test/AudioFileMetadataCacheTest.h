@@ -0,0 +1,187 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+    
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef SV_AUDIO_FILE_METADATA_CACHE_TEST_H
+#define SV_AUDIO_FILE_METADATA_CACHE_TEST_H
+
+#include "../AudioFileMetadataCache.h"
+
+#include <QObject>
+#include <QtTest>
+#include <QTemporaryDir>
+#include <QFile>
+#include <QUrl>
+
+class AudioFileMetadataCacheTest : public QObject
+{
+    Q_OBJECT
+
+    static void writeFile(QString path, QByteArray contents) {
+        QFile f(path);
+        if (!f.open(QIODevice::WriteOnly)) {
+            throw std::runtime_error("Failed to create temporary file");
+        }
+        f.write(contents);
+        f.close();
+    }
+
+    static AudioFileMetadataCache::Metadata example() {
+        AudioFileMetadataCache::Metadata md;
+        md.format = "mp3";
+        md.channels = 2;
+        md.sampleRate = 44100;
+        md.frameCount = 1234567;
+        md.title = "Title";
+        md.maker = "Maker";
+        md.tags["TITLE"] = "Title";
+        md.tags["ALBUM"] = "Album";
+        md.peak = 0.5f;
+        return md;
+    }
+
+    static void compare(const AudioFileMetadataCache::Metadata &a,
+                        const AudioFileMetadataCache::Metadata &b) {
+        QCOMPARE(a.format, b.format);
+        QCOMPARE(a.channels, b.channels);
+        QCOMPARE(a.sampleRate, b.sampleRate);
+        QCOMPARE(a.frameCount, b.frameCount);
+        QCOMPARE(a.title, b.title);
+        QCOMPARE(a.maker, b.maker);
+        QVERIFY(a.tags == b.tags);
+        QCOMPARE(a.peak, b.peak);
+    }
+
+private slots:
+    void missing()
+    {
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+
+        AudioFileMetadataCache cache(dir.filePath("cache"));
+        AudioFileMetadataCache::Metadata md;
+        QVERIFY(!cache.lookup(dir.filePath("nonexistent.wav"), md));
+
+        // Storing for a file that doesn't exist does nothing
+        cache.store(dir.filePath("nonexistent.wav"), example());
+        QVERIFY(!cache.lookup(dir.filePath("nonexistent.wav"), md));
+
+        // Nor does storing for a remote location
+        cache.store("http://example.com/remote.wav", example());
+        QVERIFY(!cache.lookup("http://example.com/remote.wav", md));
+    }
+    
+    void storeAndLookup()
+    {
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        QString audio = dir.filePath("audio.mp3");
+        writeFile(audio, "not really audio");
+
+        AudioFileMetadataCache cache(dir.filePath("cache"));
+        cache.store(audio, example());
+
+        AudioFileMetadataCache::Metadata md;
+        QVERIFY(cache.lookup(audio, md));
+        compare(md, example());
+
+        // The same file by file URL
+        md = {};
+        QVERIFY(cache.lookup(QUrl::fromLocalFile(audio).toString(), md));
+        compare(md, example());
+
+        cache.forget(audio);
+        QVERIFY(!cache.lookup(audio, md));
+    }
+
+    void persistence()
+    {
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        QString audio = dir.filePath("audio.mp3");
+        writeFile(audio, "not really audio");
+
+        {
+            AudioFileMetadataCache cache(dir.filePath("cache"));
+            cache.store(audio, example());
+        } // saved on destruction
+
+        AudioFileMetadataCache cache(dir.filePath("cache"));
+        AudioFileMetadataCache::Metadata md;
+        QVERIFY(cache.lookup(audio, md));
+        compare(md, example());
+    }
+
+    void merge()
+    {
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        QString audio1 = dir.filePath("audio1.mp3");
+        QString audio2 = dir.filePath("audio2.mp3");
+        writeFile(audio1, "not really audio");
+        writeFile(audio2, "not really audio either");
+
+        // Two caches sharing a file, as two instances of the program
+        // would: each should end up with what the other saved
+        AudioFileMetadataCache cache1(dir.filePath("cache"));
+        AudioFileMetadataCache cache2(dir.filePath("cache"));
+
+        AudioFileMetadataCache::Metadata md;
+        QVERIFY(!cache1.lookup(audio1, md));
+        QVERIFY(!cache2.lookup(audio2, md));
+
+        cache1.store(audio1, example());
+        cache1.save();
+        cache2.store(audio2, example());
+        cache2.save();
+
+        AudioFileMetadataCache cache3(dir.filePath("cache"));
+        QVERIFY(cache3.lookup(audio1, md));
+        QVERIFY(cache3.lookup(audio2, md));
+    }
+
+    void invalidation()
+    {
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        QString audio = dir.filePath("audio.mp3");
+        writeFile(audio, "not really audio");
+
+        AudioFileMetadataCache cache(dir.filePath("cache"));
+        cache.store(audio, example());
+
+        AudioFileMetadataCache::Metadata md;
+        QVERIFY(cache.lookup(audio, md));
+
+        writeFile(audio, "not really audio, and a different length");
+        QVERIFY(!cache.lookup(audio, md));
+    }
+
+    void corrupt()
+    {
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        QString audio = dir.filePath("audio.mp3");
+        writeFile(audio, "not really audio");
+        writeFile(dir.filePath("cache"), "not really a metadata cache");
+
+        AudioFileMetadataCache cache(dir.filePath("cache"));
+        AudioFileMetadataCache::Metadata md;
+        QVERIFY(!cache.lookup(audio, md));
+
+        cache.store(audio, example());
+        QVERIFY(cache.lookup(audio, md));
+    }
+};
+
+#endif
@@ -19,6 +19,8 @@
 #include "../AudioFileReaderFactory.h"
 #include "../AudioFileReader.h"
 #include "../WavFileWriter.h"
+#include "../WavFileReader.h"
+#include "../DecodingWavFileReader.h"
 
 #include "AudioTestData.h"
 #include "UnsupportedFormat.h"
@@ -28,11 +30,42 @@
 #include <QObject>
 #include <QtTest>
 #include <QDir>
+#include <QTemporaryDir>
 
 #include <iostream>
 
 using namespace std;
 
+// A reader that decodes from samples passed to it in memory, while
+// trimming frames from the end as a decoder compensating for encoder
+// padding would. Mono, compact in-memory cache.
+class TrimmingTestReader : public CodedAudioFileReader
+{
+public:
+    TrimmingTestReader(sv_frame_t trimFromEnd, bool normalised) :
+        CodedAudioFileReader(CacheInMemoryCompact, 0, normalised) {
+        m_channelCount = 1;
+        m_fileRate = 44100;
+        setFramesToTrim(0, trimFromEnd);
+        initialiseDecodeCache();
+    }
+
+    void decode(const floatvec_t &samples) {
+        addSamplesToDecodeCache(samples);
+        finishDecodeCache();
+    }
+
+    // The number of frames in the first push to the cache
+    sv_frame_t getFirstPushFrames() const {
+        return m_cacheWriteBufferFrames - m_trimFromEnd;
+    }
+
+    QString getLocation() const override { return ""; }
+    QString getLocalFilename() const override { return ""; }
+    QString getTitle() const override { return ""; }
+    QString getMaker() const override { return ""; }
+};
+
 class AudioFileReaderTest : public QObject
 {
     Q_OBJECT
@@ -204,6 +237,39 @@ private:
             .arg(gapless ? "" : " non-gapless");
     }
 
+    // Write a float WAV file whose sample for each frame and channel
+    // is given by f(frame, channel)
+    template <typename F>
+    static bool writeTestFile(QString path, int channels, sv_frame_t frames,
+                              F f) {
+        vector<vector<float>> data(channels, vector<float>(frames));
+        vector<const float *> ptrs;
+        for (int c = 0; c < channels; ++c) {
+            for (sv_frame_t i = 0; i < frames; ++i) {
+                data[c][i] = f(i, c);
+            }
+            ptrs.push_back(data[c].data());
+        }
+        WavFileWriter writer(path, 44100, channels,
+                             WavFileWriter::WriteToTemporary);
+        if (!writer.isOK()) return false;
+        if (!writer.writeSamples(ptrs.data(), frames)) return false;
+        return writer.close();
+    }
+
+    // Deinterleave channels [fromchannel, tochannel] of frames
+    static vector<floatvec_t> deinterleave(const floatvec_t &frames,
+                                           int channels,
+                                           int fromchannel, int tochannel) {
+        vector<floatvec_t> result(tochannel - fromchannel + 1);
+        for (size_t i = 0; i + channels <= frames.size(); i += channels) {
+            for (int c = fromchannel; c <= tochannel; ++c) {
+                result[c - fromchannel].push_back(frames[i + c]);
+            }
+        }
+        return result;
+    }
+
 private slots:
     void init()
     {
@@ -541,6 +607,301 @@ private slots:
             }
         }
     }
+
+    void planarCache()
+    {
+        // Enough channels for the in-memory decode cache to use the
+        // planar layout, and a length that leaves a partial final
+        // chunk. The reference is a WavFileReader of the same file,
+        // whose channel reads go through the interleaved path
+
+        const int channels = CodedAudioFileReader::PlanarChannelThreshold + 2;
+        const sv_frame_t chunk = CodedAudioFileReader::PlanarChunkFrames;
+        const sv_frame_t frames = chunk * 3 + 1234;
+
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        QString path = dir.path() + "/planar.wav";
+        QVERIFY(writeTestFile(path, channels, frames,
+                              [](sv_frame_t i, int c) {
+                                  return float(int((i * 7 + c * 131) % 2001)
+                                               - 1000) / 1024.f;
+                              }));
+
+        WavFileReader reference(path);
+        QVERIFY(reference.isOK());
+        QCOMPARE(reference.getFrameCount(), frames);
+        
+        DecodingWavFileReader reader(path,
+                                     CodedAudioFileReader::DecodeAtOnce,
+                                     CodedAudioFileReader::CacheInMemory);
+        QVERIFY(reader.isOK());
+        QCOMPARE(reader.getCacheLayout(), CodedAudioFileReader::CachePlanar);
+        QCOMPARE(reader.getChannelCount(), channels);
+        QCOMPARE(reader.getFrameCount(), frames);
+
+        // Ranges starting and ending within, at, and either side of
+        // chunk boundaries, including the partial final chunk and a
+        // range that runs past the end
+        vector<pair<sv_frame_t, sv_frame_t>> ranges {
+            { 0, frames },
+            { 0, 1 },
+            { 100, 200 },
+            { chunk - 1, 2 },
+            { chunk - 100, 200 },
+            { chunk, chunk },
+            { chunk + 1, chunk * 2 },
+            { chunk * 3 - 5, 1000 },
+            { frames - 10, 100 },
+            { frames, 10 }
+        };
+
+        for (auto r: ranges) {
+
+            floatvec_t expected =
+                reference.getInterleavedFrames(r.first, r.second);
+
+            // Re-interleaving from the planar chunks
+            floatvec_t actual = reader.getInterleavedFrames(r.first, r.second);
+            QCOMPARE(actual.size(), expected.size());
+            QVERIFY(actual == expected);
+
+            // Reading channels directly from the planar chunks
+            vector<pair<int, int>> channelRanges {
+                { 0, channels - 1 },
+                { 0, 0 },
+                { 3, 3 },
+                { channels - 3, channels - 1 }
+            };
+            for (auto cr: channelRanges) {
+                auto expectedChannels = deinterleave
+                    (expected, channels, cr.first, cr.second);
+                auto referenceChannels = reference.getChannelFrames
+                    (cr.first, cr.second, r.first, r.second);
+                QVERIFY(referenceChannels == expectedChannels);
+                auto actualChannels = reader.getChannelFrames
+                    (cr.first, cr.second, r.first, r.second);
+                QCOMPARE(actualChannels.size(), expectedChannels.size());
+                QVERIFY(actualChannels == expectedChannels);
+            }
+        }
+
+        // Invalid channel ranges
+        QVERIFY(reader.getChannelFrames(2, 1, 0, 10).empty());
+        QVERIFY(reader.getChannelFrames(0, channels, 0, 10).empty());
+    }
+
+    void planarCacheNotUsed()
+    {
+        // Below the channel threshold, and for a temporary file
+        // cache, the layout stays interleaved
+        
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        QString path = dir.path() + "/interleaved.wav";
+        const int channels = CodedAudioFileReader::PlanarChannelThreshold - 1;
+        QVERIFY(writeTestFile(path, channels, 5000,
+                              [](sv_frame_t i, int c) {
+                                  return float(i % 100 + c) / 128.f;
+                              }));
+        
+        DecodingWavFileReader reader(path,
+                                     CodedAudioFileReader::DecodeAtOnce,
+                                     CodedAudioFileReader::CacheInMemory);
+        QVERIFY(reader.isOK());
+        QCOMPARE(reader.getCacheLayout(),
+                 CodedAudioFileReader::CacheInterleaved);
+
+        path = dir.path() + "/manychannels.wav";
+        QVERIFY(writeTestFile(path, channels + 2, 5000,
+                              [](sv_frame_t i, int c) {
+                                  return float(i % 100 + c) / 128.f;
+                              }));
+
+        DecodingWavFileReader fileReader
+            (path, CodedAudioFileReader::DecodeAtOnce,
+             CodedAudioFileReader::CacheInTemporaryFile);
+        QVERIFY(fileReader.isOK());
+        QCOMPARE(fileReader.getCacheLayout(),
+                 CodedAudioFileReader::CacheInterleaved);
+    }
+
+    void compactCacheExact()
+    {
+        // Samples that are exact multiples of 1/32768, as from a
+        // 16-bit source, should read back from the compact cache
+        // exactly, including the extremes of the 16-bit range
+
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        QString path = dir.path() + "/sixteen.wav";
+        const sv_frame_t frames = CodedAudioFileReader::CompactBlockSamples * 2
+            + 777;
+        QVERIFY(writeTestFile(path, 2, frames,
+                              [](sv_frame_t i, int c) -> float {
+                                  if (i == 10) return c ? 32767.f / 32768.f : -1.f;
+                                  return float(int((i * 37 + c * 1009) % 65536)
+                                               - 32768) / 32768.f;
+                              }));
+
+        WavFileReader reference(path);
+        QVERIFY(reference.isOK());
+
+        DecodingWavFileReader reader(path,
+                                     CodedAudioFileReader::DecodeAtOnce,
+                                     CodedAudioFileReader::CacheInMemoryCompact);
+        QVERIFY(reader.isOK());
+        QCOMPARE(reader.getCacheSampleFormat(),
+                 CodedAudioFileReader::CacheCompact);
+        QCOMPARE(reader.getFrameCount(), frames);
+
+        floatvec_t expected = reference.getInterleavedFrames(0, frames);
+        floatvec_t actual = reader.getInterleavedFrames(0, frames);
+        QCOMPARE(actual.size(), expected.size());
+        QVERIFY(actual == expected);
+
+        // And a real 16-bit file, against the direct reader
+        path = audioDir + "/wav/44100-2-16.wav";
+        WavFileReader fileReference(path);
+        QVERIFY(fileReference.isOK());
+        DecodingWavFileReader fileReader
+            (path, CodedAudioFileReader::DecodeAtOnce,
+             CodedAudioFileReader::CacheInMemoryCompact);
+        QVERIFY(fileReader.isOK());
+        QCOMPARE(fileReader.getCacheSampleFormat(),
+                 CodedAudioFileReader::CacheCompact);
+        sv_frame_t n = fileReference.getFrameCount();
+        QCOMPARE(fileReader.getFrameCount(), n);
+        QVERIFY(fileReader.getInterleavedFrames(0, n) ==
+                fileReference.getInterleavedFrames(0, n));
+    }
+
+    void compactCacheBlockBoundaries()
+    {
+        // With three channels, frames straddle the compact cache's
+        // blocks (which are counted in interleaved samples), so reads
+        // starting and ending near a block boundary split frames
+        // between two block scales
+
+        const int channels = 3;
+        const sv_frame_t block = CodedAudioFileReader::CompactBlockSamples;
+        const sv_frame_t frames = (block * 4) / channels + 100;
+
+        QTemporaryDir dir;
+        QVERIFY(dir.isValid());
+        QString path = dir.path() + "/blocks.wav";
+        QVERIFY(writeTestFile(path, channels, frames,
+                              [](sv_frame_t i, int c) {
+                                  return float(int((i * 13 + c * 4001) % 60001)
+                                               - 30000) / 32768.f;
+                              }));
+
+        WavFileReader reference(path);
+        QVERIFY(reference.isOK());
+
+        DecodingWavFileReader reader(path,
+                                     CodedAudioFileReader::DecodeAtOnce,
+                                     CodedAudioFileReader::CacheInMemoryCompact);
+        QVERIFY(reader.isOK());
+        QCOMPARE(reader.getCacheSampleFormat(),
+                 CodedAudioFileReader::CacheCompact);
+
+        // Frame block / channels is the one split by the first
+        // boundary, and so on
+        const sv_frame_t b1 = block / channels, b2 = (block * 2) / channels;
+        vector<pair<sv_frame_t, sv_frame_t>> ranges {
+            { 0, frames },
+            { b1, 1 },
+            { b1 - 1, 3 },
+            { b1 + 1, 1 },
+            { b1 - 50, 100 },
+            { b1, b2 - b1 + 1 },
+            { b2 - 1, block },
+            { frames - 10, 100 },
+            { frames, 10 }
+        };
+
+        for (auto r: ranges) {
+            floatvec_t expected =
+                reference.getInterleavedFrames(r.first, r.second);
+            floatvec_t actual = reader.getInterleavedFrames(r.first, r.second);
+            QCOMPARE(actual.size(), expected.size());
+            QVERIFY(actual == expected);
+        }
+    }
+
+    void compactCacheNormalised()
+    {
+        // When normalising, samples are not clipped, so a block that
+        // receives one beyond [-1, 1] after it already holds samples
+        // has to widen its range and requantise them. Those samples
+        // are then only accurate to half of the wider block's step,
+        // while other blocks stay exact. Reads are scaled by the
+        // normalisation gain throughout.
+        //
+        // Samples reach the cache in pushes of the cache write
+        // buffer, which end on block boundaries unless frames are
+        // being trimmed from the end, so we use a reader that trims
+        // and put the peak just after the end of the first push
+
+        const sv_frame_t block = CodedAudioFileReader::CompactBlockSamples;
+        const sv_frame_t trim = 1000;
+        const float peak = 2.5f;
+
+        TrimmingTestReader reader(trim, true);
+        QVERIFY(reader.isOK());
+        QCOMPARE(reader.getCacheSampleFormat(),
+                 CodedAudioFileReader::CacheCompact);
+
+        const sv_frame_t pushed = reader.getFirstPushFrames();
+        QVERIFY(pushed % block != 0);
+        const sv_frame_t peakAt = pushed + (block - pushed % block) / 2;
+        const sv_frame_t peakBlock = peakAt / block;
+        QCOMPARE(pushed / block, peakBlock);
+        const sv_frame_t frames = (peakBlock + 2) * block + 100;
+
+        floatvec_t source(frames + trim);
+        for (sv_frame_t i = 0; i < frames + trim; ++i) {
+            source[i] = float(int((i * 101) % 32001) - 16000) / 32768.f;
+        }
+        source[peakAt] = peak;
+        
+        reader.decode(source);
+        QCOMPARE(reader.getFrameCount(), frames);
+
+        floatvec_t actual = reader.getInterleavedFrames(0, frames);
+        QCOMPARE(sv_frame_t(actual.size()), frames);
+
+        const float gain = 1.f / peak;
+        const float tolerance = (0.51f * peak / 32768.f) * gain;
+        int requantised = 0;
+        
+        for (sv_frame_t i = 0; i < frames; ++i) {
+            float expected = source[i] * gain;
+            if (i / block != peakBlock) {
+                QCOMPARE(actual[i], expected);
+                continue;
+            }
+            if (i == peakAt) {
+                continue; // clamped to 32767, checked below
+            }
+            if (fabsf(actual[i] - expected) > tolerance) {
+                SVCERR << "at " << i << ": expected " << expected
+                       << ", actual " << actual[i] << endl;
+            }
+            QVERIFY(fabsf(actual[i] - expected) <= tolerance);
+            if (i < pushed && actual[i] != expected) {
+                // Stored exactly at first, so must have been
+                // requantised when the peak arrived
+                ++requantised;
+            }
+        }
+        QVERIFY(requantised > 0);
+
+        // The peak is stored as the largest 16-bit value, one step
+        // below the block's range
+        QVERIFY(fabsf(actual[peakAt] - 1.f) <= 1.5f / 32768.f);
+    }
 };
 
 #endif
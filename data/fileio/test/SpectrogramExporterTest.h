@@ -0,0 +1,127 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef SV_SPECTROGRAM_EXPORTER_TEST_H
+#define SV_SPECTROGRAM_EXPORTER_TEST_H
+
+#include "../SpectrogramExporter.h"
+
+#include "../../model/test/MockWaveModel.h"
+#include "../../model/FFTModel.h"
+#include "../../model/Dense3DModelPeakCache.h"
+
+#include <QObject>
+#include <QtTest>
+#include <QTemporaryDir>
+#include <QFile>
+
+#include <vector>
+
+class SpectrogramExporterTest : public QObject
+{
+    Q_OBJECT
+
+    ModelId m_wave;
+    ModelId m_fft;
+
+    // All columns of the model, read serially, for comparison
+    static std::vector<float> readAll(const DenseThreeDimensionalModel &m) {
+        std::vector<float> values(size_t(m.getWidth()) * m.getHeight());
+        m.getColumns(0, m.getWidth(), 0, m.getHeight(), values.data());
+        return values;
+    }
+
+    void checkMatrix(const DenseThreeDimensionalModel &m, int threads) {
+        QTemporaryDir dir;
+        QString path = dir.path() + "/out.bin";
+        SpectrogramExporter exporter
+            (path, &m, SpectrogramExporter::Float32MatrixFormat);
+        exporter.setThreadCount(threads);
+        exporter.setBatchSize(7); // not a divisor of the width
+        exporter.write();
+        QVERIFY(exporter.isOK());
+
+        SpectrogramExporter::MatrixHeader header;
+        std::vector<float> values;
+        QVERIFY(SpectrogramExporter::readMatrix(path, header, &values));
+        QCOMPARE(header.width, m.getWidth());
+        QCOMPARE(header.height, m.getHeight());
+        QCOMPARE(header.resolution, m.getResolution());
+        QCOMPARE(header.startFrame, m.getStartFrame());
+        QCOMPARE(header.sampleRate, m.getSampleRate());
+        QCOMPARE(int(header.binValues.size()), m.getHeight());
+        QCOMPARE(header.binValues[1], m.getBinValue(1));
+        QVERIFY(values == readAll(m));
+    }
+
+private slots:
+    void init() {
+        m_wave = ModelById::add
+            (std::make_shared<MockWaveModel>
+             (std::vector<Sort>({ Sine }), 8192, 256));
+        m_fft = ModelById::add
+            (std::make_shared<FFTModel>
+             (m_wave, 0, HanningWindow, 256, 64, 256));
+    }
+
+    void cleanup() {
+        ModelById::release(m_fft);
+        ModelById::release(m_wave);
+    }
+
+    void fftMatrix() {
+        auto fft = ModelById::getAs<FFTModel>(m_fft);
+        checkMatrix(*fft, 1);
+        checkMatrix(*fft, 4);
+    }
+
+    void peakCacheMatrix() {
+        auto peaks = std::make_shared<Dense3DModelPeakCache>(m_fft, 3);
+        checkMatrix(*peaks, 1);
+        checkMatrix(*peaks, 4);
+    }
+
+    void csv() {
+        auto fft = ModelById::getAs<FFTModel>(m_fft);
+        QTemporaryDir dir;
+        QString path = dir.path() + "/out.csv";
+        SpectrogramExporter exporter
+            (path, fft.get(), SpectrogramExporter::CSVFormat, ",",
+             DataExportIncludeHeader | DataExportAlwaysIncludeTimestamp |
+             DataExportWriteTimeInFrames);
+        exporter.setThreadCount(3);
+        exporter.setBatchSize(5);
+        exporter.write(640, 640); // columns 10 to 19
+        QVERIFY(exporter.isOK());
+
+        QFile f(path);
+        QVERIFY(f.open(QFile::ReadOnly));
+        QList<QByteArray> lines = f.readAll().split('\n');
+        QCOMPARE(lines.size(), 12); // header, 10 rows, empty remainder
+        QVERIFY(lines[0].startsWith("FRAME,Bin1,Bin2,"));
+        QCOMPARE(lines[11], QByteArray());
+
+        // Rows match the model's own export rows, with the frame added
+        auto rows = fft->toStringExportRows(DataExportDefaults, 640, 640);
+        QCOMPARE(rows.size(), 10);
+        for (int i = 0; i < rows.size(); ++i) {
+            QStringList expected;
+            expected << QString("%1").arg(640 + i * 64);
+            for (auto s: rows[i]) expected << s;
+            QCOMPARE(QString::fromUtf8(lines[i+1]), expected.join(","));
+        }
+    }
+};
+
+#endif
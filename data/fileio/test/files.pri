@@ -2,6 +2,7 @@
 TEST_HEADERS += \
 	../../model/test/MockWaveModel.h \
 	AudioFileReaderTest.h \
+	AudioFileMetadataCacheTest.h \
 	UnsupportedFormat.h \
 	BogusAudioFileReaderTest.h \
 	AudioFileWriterTest.h \
@@ -10,7 +11,8 @@ TEST_HEADERS += \
 	MIDIFileReaderTest.h \
 	CSVFormatTest.h \
 	CSVReaderTest.h \
-	CSVStreamWriterTest.h
+	CSVStreamWriterTest.h \
+	SpectrogramExporterTest.h
      
 TEST_SOURCES += \
 	../../model/test/MockWaveModel.cpp \
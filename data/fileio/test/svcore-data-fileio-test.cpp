@@ -13,6 +13,7 @@
 */
 
 #include "AudioFileReaderTest.h"
+#include "AudioFileMetadataCacheTest.h"
 #include "BogusAudioFileReaderTest.h"
 #include "AudioFileWriterTest.h"
 #include "EncodingTest.h"
@@ -20,6 +21,7 @@
 #include "CSVFormatTest.h"
 #include "CSVReaderTest.h"
 #include "CSVStreamWriterTest.h"
+#include "SpectrogramExporterTest.h"
 
 #include "system/Init.h"
 
@@ -66,6 +68,12 @@ int main(int argc, char *argv[])
         else ++bad;
     }
 
+    {
+        AudioFileMetadataCacheTest t;
+        if (QTest::qExec(&t, argc, argv) == 0) ++good;
+        else ++bad;
+    }
+
     {
         BogusAudioFileReaderTest t;
         if (QTest::qExec(&t, argc, argv) == 0) ++good;
@@ -102,6 +110,12 @@ int main(int argc, char *argv[])
         else ++bad;
     }
 
+    {
+        SpectrogramExporterTest t;
+        if (QTest::qExec(&t, argc, argv) == 0) ++good;
+        else ++bad;
+    }
+
     if (bad > 0) {
         SVCERR << "\n********* " << bad << " test suite(s) failed!\n" << endl;
         return 1;
@@ -204,22 +204,97 @@ AggregateWaveModel::getMultiChannelData(int fromchannel, int tochannel,
 int
 AggregateWaveModel::getSummaryBlockSize(int desired) const
 {
-    //!!! complete
+    // All components are expected to share a zoom constraint, so we
+    // ask the first one that is present
+    for (const auto &c: m_components) {
+        auto model = ModelById::getAs<RangeSummarisableTimeValueModel>
+            (c.model);
+        if (model) return model->getSummaryBlockSize(desired);
+    }
     return desired;
 }
         
 void
-AggregateWaveModel::getSummaries(int, sv_frame_t, sv_frame_t,
-                                 RangeBlock &, int &) const
+AggregateWaveModel::getSummaries(int channel, sv_frame_t start, sv_frame_t count,
+                                 RangeBlock &ranges, int &blockSize) const
 {
-    //!!! complete
+    ranges.clear();
+    if (!in_range_for(m_components, channel)) return;
+
+    auto model = ModelById::getAs<RangeSummarisableTimeValueModel>
+        (m_components[channel].model);
+    if (!model) return;
+
+    model->getSummaries(m_components[channel].channel, start, count,
+                        ranges, blockSize);
+}
+
+void
+AggregateWaveModel::getMultiChannelSummaries(int fromchannel, int tochannel,
+                                             sv_frame_t start, sv_frame_t count,
+                                             vector<RangeBlock> &ranges,
+                                             int &blockSize) const
+{
+    ranges.clear();
+    if (fromchannel > tochannel ||
+        !in_range_for(m_components, fromchannel) ||
+        !in_range_for(m_components, tochannel)) {
+        return;
+    }
+
+    ranges.resize(tochannel - fromchannel + 1);
+
+    // Settle on a block size up front so that every component is
+    // asked for (and returns) the same one
+    blockSize = getSummaryBlockSize(blockSize);
+
+    // Gather runs of our channels that map onto consecutive channels
+    // of the same component model, and request each run from that
+    // model in a single call, so that it only has to read its
+    // underlying data once
+
+    int c = fromchannel;
+    
+    while (c <= tochannel) {
+
+        ModelId runModel = m_components[c].model;
+        int runStart = m_components[c].channel;
+        int runLength = 1;
+
+        while (c + runLength <= tochannel &&
+               m_components[c + runLength].model == runModel &&
+               m_components[c + runLength].channel == runStart + runLength) {
+            ++runLength;
+        }
+
+        auto model = ModelById::getAs<RangeSummarisableTimeValueModel>
+            (runModel);
+        
+        if (model) {
+            vector<RangeBlock> runRanges;
+            int runBlockSize = blockSize;
+            model->getMultiChannelSummaries(runStart, runStart + runLength - 1,
+                                            start, count,
+                                            runRanges, runBlockSize);
+            for (int i = 0; i < runLength && in_range_for(runRanges, i); ++i) {
+                ranges[c - fromchannel + i] = std::move(runRanges[i]);
+            }
+        }
+
+        c += runLength;
+    }
 }
 
 AggregateWaveModel::Range
-AggregateWaveModel::getSummary(int, sv_frame_t, sv_frame_t) const
+AggregateWaveModel::getSummary(int channel, sv_frame_t start, sv_frame_t count) const
 {
-    //!!! complete
-    return Range();
+    if (!in_range_for(m_components, channel)) return Range();
+
+    auto model = ModelById::getAs<RangeSummarisableTimeValueModel>
+        (m_components[channel].model);
+    if (!model) return Range();
+
+    return model->getSummary(m_components[channel].channel, start, count);
 }
         
 int
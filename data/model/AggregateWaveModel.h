@@ -77,6 +77,11 @@ public:
                               RangeBlock &ranges,
                               int &blockSize) const override;
 
+    void getMultiChannelSummaries(int fromchannel, int tochannel,
+                                  sv_frame_t start, sv_frame_t count,
+                                  std::vector<RangeBlock> &ranges,
+                                  int &blockSize) const override;
+
     Range getSummary(int channel, sv_frame_t start, sv_frame_t count) const override;
 
     void toXml(QTextStream &out,
@@ -170,7 +170,7 @@ BasicCompressedDenseThreeDimensionalModel::setValueUnit(QString unit)
 
 //static int given = 0, stored = 0;
 
-void
+bool
 BasicCompressedDenseThreeDimensionalModel::truncateAndStore(int index,
                                                      const Column &values)
 {
@@ -188,8 +188,7 @@ BasicCompressedDenseThreeDimensionalModel::truncateAndStore(int index,
         int(values.size()) != m_yBinCount) {
 //        given += values.size();
 //        stored += values.size();
-        m_data[index] = values;
-        return;
+        return false;
     }
 
     // Maximum distance between a column and the one we refer to as
@@ -254,7 +253,7 @@ BasicCompressedDenseThreeDimensionalModel::truncateAndStore(int index,
                 }
                 m_data[index] = tcol;
                 m_trunc[index] = (signed char)(-tdist);
-                return;
+                return true;
             } else {
                 // create a new column with h - tcount values from 0 up
                 Column tcol(h - tcount);
@@ -265,7 +264,7 @@ BasicCompressedDenseThreeDimensionalModel::truncateAndStore(int index,
                 }
                 m_data[index] = tcol;
                 m_trunc[index] = (signed char)(tdist);
-                return;
+                return true;
             }
         }
     }                
@@ -276,8 +275,7 @@ BasicCompressedDenseThreeDimensionalModel::truncateAndStore(int index,
 //              << ((float(stored) / float(given)) * 100.f) << "%)" << endl;
 
     // default case if nothing wacky worked out
-    m_data[index] = values;
-    return;
+    return false;
 }
 
 BasicCompressedDenseThreeDimensionalModel::Column
@@ -293,41 +291,89 @@ BasicCompressedDenseThreeDimensionalModel::rightHeight(const Column &c) const
 
 BasicCompressedDenseThreeDimensionalModel::Column
 BasicCompressedDenseThreeDimensionalModel::expandAndRetrieve(int index) const
+{
+    ExpansionCache cache;
+    return expandAndRetrieve(index, cache);
+}
+
+const BasicCompressedDenseThreeDimensionalModel::Column &
+BasicCompressedDenseThreeDimensionalModel::expandAndRetrieve
+(int index, ExpansionCache &cache) const
 {
     // See comment above m_trunc declaration in header
 
     assert(index >= 0 && index < int(m_data.size()));
-    Column c = m_data.at(index);
-    if (index == 0) {
-        return rightHeight(c);
+
+    auto itr = cache.find(index);
+    if (itr != cache.end()) {
+        return itr->second;
     }
-    int trunc = (int)m_trunc[index];
+    
+    const Column &c = m_data.at(index);
+    int trunc = (index == 0 ? 0 : (int)m_trunc[index]);
     if (trunc == 0) {
-        return rightHeight(c);
+        if (int(c.size()) == m_yBinCount) {
+            return c;
+        }
+        return cache[index] = rightHeight(c);
     }
     bool top = true;
     int tdist = trunc;
     if (trunc < 0) { top = false; tdist = -trunc; }
-    Column p = expandAndRetrieve(index - tdist);
+    const Column &p = expandAndRetrieve(index - tdist, cache);
     int psize = int(p.size()), csize = int(c.size());
     if (psize != m_yBinCount) {
         cerr << "WARNING: BasicCompressedDenseThreeDimensionalModel::expandAndRetrieve: Trying to expand from incorrectly sized column" << endl;
     }
+    Column &cc = cache[index];
     if (top) {
+        cc = c;
         for (int i = csize; i < psize; ++i) {
-            c.push_back(p.at(i));
+            cc.push_back(p.at(i));
         }
     } else {
-        Column cc(psize);
+        cc = Column(psize);
         for (int i = 0; i < psize - csize; ++i) {
             cc[i] = p.at(i);
         }
         for (int i = 0; i < csize; ++i) {
             cc[i + (psize - csize)] = c.at(i);
         }
-        return cc;
     }
-    return c;
+    return cc;
+}
+
+void
+BasicCompressedDenseThreeDimensionalModel::trimExpansionCache
+(ExpansionCache &cache, int index)
+{
+    // A reference distance is stored in a signed char, so no column
+    // refers back further than this
+    const int maxReference = 127;
+    cache.erase(cache.begin(), cache.lower_bound(index - maxReference));
+}
+
+void
+BasicCompressedDenseThreeDimensionalModel::getColumns(int x0, int count,
+                                                      int bin0, int binCount,
+                                                      float *dest,
+                                                      ColumnLayout layout) const
+{
+    QReadLocker locker(&m_lock);
+
+    ExpansionCache cache;
+    
+    for (int i = 0; i < count; ++i) {
+        int x = x0 + i;
+        if (!in_range_for(m_data, x)) {
+            copyToColumns(nullptr, 0, i, count, bin0, binCount, dest, layout);
+            continue;
+        }
+        const Column &c = expandAndRetrieve(x, cache);
+        copyToColumns(c.data(), int(c.size()),
+                      i, count, bin0, binCount, dest, layout);
+        trimExpansionCache(cache, x);
+    }
 }
 
 void
@@ -336,6 +382,34 @@ BasicCompressedDenseThreeDimensionalModel::setColumn(int index,
 {
     QWriteLocker locker(&m_lock);
 
+    bool allChange = prepareColumn(index, values);
+
+    if (!truncateAndStore(index, values)) {
+        m_data[index] = values;
+    }
+
+    notifyColumnChanged(index, allChange);
+}
+
+void
+BasicCompressedDenseThreeDimensionalModel::setColumn(int index,
+                                                     Column &&values)
+{
+    QWriteLocker locker(&m_lock);
+
+    bool allChange = prepareColumn(index, values);
+
+    if (!truncateAndStore(index, values)) {
+        m_data[index] = std::move(values);
+    }
+
+    notifyColumnChanged(index, allChange);
+}
+
+bool
+BasicCompressedDenseThreeDimensionalModel::prepareColumn(int index,
+                                                         const Column &values)
+{
     while (index >= int(m_data.size())) {
         m_data.push_back(Column());
         m_trunc.push_back(0);
@@ -359,10 +433,13 @@ BasicCompressedDenseThreeDimensionalModel::setColumn(int index,
         m_haveExtents = true;
     }
 
-    truncateAndStore(index, values);
-
-//    assert(values == expandAndRetrieve(index));
+    return allChange;
+}
 
+void
+BasicCompressedDenseThreeDimensionalModel::notifyColumnChanged(int index,
+                                                               bool allChange)
+{
     sv_frame_t windowStart = index;
     windowStart *= m_resolution;
 
@@ -532,10 +609,13 @@ BasicCompressedDenseThreeDimensionalModel::toStringExportRows(DataExportOptions,
 
     QVector<QVector<QString>> rows;
 
+    ExpansionCache cache;
+
     for (int i = 0; in_range_for(m_data, i); ++i) {
-        Column c = getColumn(i);
         sv_frame_t fr = m_startFrame + i * m_resolution;
         if (fr >= startFrame && fr < startFrame + duration) {
+            const Column &c = expandAndRetrieve(i, cache);
+            trimExpansionCache(cache, i);
             QVector<QString> row;
             for (int j = 0; in_range_for(c, j); ++j) {
                 row << QString("%1").arg(c.at(j));
@@ -585,8 +665,11 @@ BasicCompressedDenseThreeDimensionalModel::toXml(QTextStream &out,
         }
     }
 
+    ExpansionCache cache;
+
     for (int i = 0; in_range_for(m_data, i); ++i) {
-        Column c = getColumn(i);
+        const Column &c = expandAndRetrieve(i, cache);
+        trimExpansionCache(cache, i);
         out << indent + "  ";
         out << QString("<row n=\"%1\">").arg(i);
         for (int j = 0; in_range_for(c, j); ++j) {
@@ -21,6 +21,7 @@
 #include <QReadWriteLock>
 
 #include <vector>
+#include <map>
 
 class BasicCompressedDenseThreeDimensionalModel : public DenseThreeDimensionalModel
 {
@@ -117,6 +118,15 @@ public:
      */
     float getValueAt(int x, int n) const override;
 
+    /**
+     * Get a range of bins from a range of columns, taking the lock
+     * only once and expanding each truncated column from the
+     * already-expanded column it refers to.
+     */
+    void getColumns(int x0, int count, int bin0, int binCount,
+                    float *dest,
+                    ColumnLayout layout = ColumnMajor) const override;
+
     /**
      * Obtain the name of the unit of the values returned from
      * getValueAt(), if any.
@@ -134,6 +144,13 @@ public:
      */
     virtual void setColumn(int x, const Column &values);
 
+    /**
+     * Set the entire set of bin values at the given column, taking
+     * over the storage of the given vector where the column is stored
+     * untruncated.
+     */
+    virtual void setColumn(int x, Column &&values);
+
     /**
      * Return the name of bin n. This is a single label per bin that
      * does not vary from one column to the next.
@@ -219,10 +236,35 @@ protected:
     // value).  If m_trunc[x] is 0 then the whole of column x is
     // stored.
     std::vector<signed char> m_trunc;
-    void truncateAndStore(int index, const Column & values);
+
+    // Truncate and store the column if it can be truncated and
+    // return true; otherwise only reset m_trunc[index] and return
+    // false, leaving the caller to store the whole column
+    bool truncateAndStore(int index, const Column & values);
+
+    // Helpers for setColumn, to be called with m_lock held
+    bool prepareColumn(int index, const Column &values);
+    void notifyColumnChanged(int index, bool allChange);
+
     Column expandAndRetrieve(int index) const;
     Column rightHeight(const Column &c) const;
 
+    // Columns already expanded during a run of retrievals, by index.
+    // As each column refers back to at most one other, expanding
+    // columns in order through one of these expands each only once
+    typedef std::map<int, Column> ExpansionCache;
+
+    // Return the expanded column, either directly from m_data if it
+    // needs no expansion or else from the cache, adding it and any
+    // columns it refers to if they are not there already. The
+    // reference is valid until the cache is next trimmed. Call with
+    // m_lock held
+    const Column &expandAndRetrieve(int index, ExpansionCache &cache) const;
+
+    // Drop from the cache any columns too far before index to be
+    // referred to by it or any later column
+    static void trimExpansionCache(ExpansionCache &cache, int index);
+
     std::vector<QString> m_binNames;
     std::vector<float> m_binValues;
     QString m_binValueUnit;
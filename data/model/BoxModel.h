@@ -22,6 +22,7 @@
 
 #include "base/RealTime.h"
 #include "base/EventSeries.h"
+#include "base/EventBoxIndex.h"
 #include "base/UnitDatabase.h"
 
 #include "system/System.h"
@@ -143,12 +144,35 @@ public:
     EventVector getAllEvents() const {
         return m_events.getAllEvents();
     }
+    EventSeries getEventSnapshot() const {
+        return m_events; // cheap: shares chunks until they are edited
+    }
     EventVector getEventsSpanning(sv_frame_t f, sv_frame_t duration) const {
         return m_events.getEventsSpanning(f, duration);
     }
     EventVector getEventsCovering(sv_frame_t f) const {
         return m_events.getEventsCovering(f);
     }
+
+    /**
+     * Return all boxes that overlap the given frame range and also
+     * the given frequency (value) range, as when drawing a viewport.
+     * This uses a two-dimensional index, so it does not have to
+     * consider every box in the time range as the one-dimensional
+     * getEventsSpanning does.
+     */
+    EventVector getEventsSpanning(sv_frame_t f, sv_frame_t duration,
+                                  float minValue, float maxValue) const {
+        return m_index.getEventsSpanning(f, duration, minValue, maxValue);
+    }
+
+    /**
+     * Return all boxes that cover the given frame and frequency
+     * (value), as when hit-testing a mouse position.
+     */
+    EventVector getEventsCovering(sv_frame_t f, float value) const {
+        return m_index.getEventsCovering(f, value);
+    }
     EventVector getEventsWithin(sv_frame_t f, sv_frame_t duration) const {
         return m_events.getEventsWithin(f, duration);
     }
@@ -158,6 +182,27 @@ public:
     EventVector getEventsStartingAt(sv_frame_t f) const {
         return m_events.getEventsStartingAt(f);
     }
+
+    /**
+     * Visit events in place, without copying them; see the
+     * corresponding EventSeries methods.
+     */
+    bool visitEventsSpanning(sv_frame_t f, sv_frame_t duration,
+                             const EventSeries::EventVisitor &visitor) const {
+        return m_events.visitEventsSpanning(f, duration, visitor);
+    }
+    bool visitEventsCovering(sv_frame_t f,
+                             const EventSeries::EventVisitor &visitor) const {
+        return m_events.visitEventsCovering(f, visitor);
+    }
+    bool visitEventsWithin(sv_frame_t f, sv_frame_t duration,
+                           const EventSeries::EventVisitor &visitor) const {
+        return m_events.visitEventsWithin(f, duration, visitor);
+    }
+    bool visitEventsStartingWithin(sv_frame_t f, sv_frame_t duration,
+                                   const EventSeries::EventVisitor &visitor) const {
+        return m_events.visitEventsStartingWithin(f, duration, visitor);
+    }
     bool getNearestEventMatching(sv_frame_t startSearchAt,
                                  std::function<bool(Event)> predicate,
                                  EventSeries::Direction direction,
@@ -176,6 +221,7 @@ public:
         {
             QMutexLocker locker(&m_mutex);
             m_events.add(e);
+            m_index.add(e);
 
             float f0 = e.getValue();
             float f1 = f0 + fabsf(e.getLevel());
@@ -199,7 +245,10 @@ public:
     void remove(Event e) override {
         {
             QMutexLocker locker(&m_mutex);
-            m_events.remove(e);
+            if (m_events.contains(e)) {
+                m_events.remove(e);
+                m_index.remove(e);
+            }
         }
         emit modelChangedWithin(getId(),
                                 e.getFrame(),
@@ -379,40 +428,40 @@ public:
 
         // We need a custom format here
 
-        EventVector ee = m_events.getEventsSpanning(startFrame, duration);
-
         QVector<QVector<QString>> rows;
-        
-        for (auto e: ee) {
 
-            QVector<QString> list;
+        m_events.visitEventsSpanning
+            (startFrame, duration, [&](const Event &e) {
+
+                QVector<QString> list;
 
-            if (opts & DataExportWriteTimeInFrames) {
+                if (opts & DataExportWriteTimeInFrames) {
                 
-                list << QString("%1").arg(e.getFrame());
-                list << QString("%1").arg(e.getFrame() + e.getDuration());
+                    list << QString("%1").arg(e.getFrame());
+                    list << QString("%1").arg(e.getFrame() + e.getDuration());
 
-            } else {
+                } else {
             
-                list << RealTime::frame2RealTime
-                    (e.getFrame(), getSampleRate())
-                    .toString().c_str();
+                    list << RealTime::frame2RealTime
+                        (e.getFrame(), getSampleRate())
+                        .toString().c_str();
 
-                list << RealTime::frame2RealTime
-                    (e.getFrame() + e.getDuration(), getSampleRate())
-                    .toString().c_str();
-            }
+                    list << RealTime::frame2RealTime
+                        (e.getFrame() + e.getDuration(), getSampleRate())
+                        .toString().c_str();
+                }
 
-            list << QString("%1").arg(e.getValue());
+                list << QString("%1").arg(e.getValue());
 
-            list << QString("%1").arg(e.getValue() + fabsf(e.getLevel()));
+                list << QString("%1").arg(e.getValue() + fabsf(e.getLevel()));
             
-            if (e.getLabel() != "") {
-                list << e.getLabel();
-            }
+                if (e.getLabel() != "") {
+                    list << e.getLabel();
+                }
 
-            rows.push_back(list);
-        }
+                rows.push_back(list);
+                return true;
+            });
 
         return rows;
     }
@@ -429,6 +478,7 @@ protected:
     int m_completion;
 
     EventSeries m_events;
+    EventBoxIndex m_index;
 
     mutable QMutex m_mutex;
 };
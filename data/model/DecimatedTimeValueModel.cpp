@@ -0,0 +1,491 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#include "DecimatedTimeValueModel.h"
+
+#include "base/EventXmlWriter.h"
+#include "base/UnitDatabase.h"
+
+#include "system/System.h"
+
+#include <QTextStream>
+#include <QMutexLocker>
+
+#include <cmath>
+#include <algorithm>
+
+using namespace std;
+
+// Values per chunk. Holding values in chunks means that extending
+// the model never reallocates and copies the whole series
+static const sv_frame_t chunkSize = 65536;
+
+// Ratio between the block sizes of successive decimation levels
+static const sv_frame_t decimationFactor = 16;
+
+// Values per batch when writing XML, so that the lock is not held
+// throughout
+static const sv_frame_t exportBatchSize = 65536;
+
+void
+DecimatedTimeValueModel::Summary::sample(float v)
+{
+    if (ISNAN(v)) return;
+    if (count == 0) {
+        min = v;
+        max = v;
+    } else {
+        if (v < min) min = v;
+        if (v > max) max = v;
+    }
+    absSum += fabsf(v);
+    ++count;
+}
+
+void
+DecimatedTimeValueModel::Summary::merge(const Summary &s)
+{
+    if (s.count == 0) return;
+    if (count == 0) {
+        min = s.min;
+        max = s.max;
+    } else {
+        if (s.min < min) min = s.min;
+        if (s.max > max) max = s.max;
+    }
+    absSum += s.absSum;
+    count += s.count;
+}
+
+DecimatedTimeValueModel::Range
+DecimatedTimeValueModel::Summary::toRange() const
+{
+    if (count == 0) return Range();
+    return Range(min, max, absSum / float(count));
+}
+
+DecimatedTimeValueModel::DecimatedTimeValueModel(sv_samplerate_t sampleRate,
+                                                 int resolution,
+                                                 bool notifyOnAdd) :
+    m_sampleRate(sampleRate),
+    m_resolution(std::max(resolution, 1)),
+    m_valueMinimum(0.f),
+    m_valueMaximum(0.f),
+    m_haveExtents(false),
+    m_notifier(this,
+               getId(),
+               notifyOnAdd ?
+               DeferredNotifier::NOTIFY_ALWAYS :
+               DeferredNotifier::NOTIFY_DEFERRED),
+    m_completion(100),
+    m_count(0)
+{
+    m_levels.push_back(Level());
+}
+
+DecimatedTimeValueModel::DecimatedTimeValueModel(sv_samplerate_t sampleRate,
+                                                 int resolution,
+                                                 float valueMinimum,
+                                                 float valueMaximum,
+                                                 bool notifyOnAdd) :
+    m_sampleRate(sampleRate),
+    m_resolution(std::max(resolution, 1)),
+    m_valueMinimum(valueMinimum),
+    m_valueMaximum(valueMaximum),
+    m_haveExtents(true),
+    m_notifier(this,
+               getId(),
+               notifyOnAdd ?
+               DeferredNotifier::NOTIFY_ALWAYS :
+               DeferredNotifier::NOTIFY_DEFERRED),
+    m_completion(100),
+    m_count(0)
+{
+    m_levels.push_back(Level());
+}
+
+DecimatedTimeValueModel::~DecimatedTimeValueModel()
+{
+}
+
+sv_frame_t
+DecimatedTimeValueModel::getTrueEndFrame() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_count * m_resolution;
+}
+
+QString
+DecimatedTimeValueModel::getScaleUnits() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_units;
+}
+
+void
+DecimatedTimeValueModel::setScaleUnits(QString units)
+{
+    QMutexLocker locker(&m_mutex);
+    m_units = units;
+    UnitDatabase::getInstance()->registerUnit(units);
+}
+
+void
+DecimatedTimeValueModel::setCompletion(int completion, bool update)
+{
+    if (m_completion == completion) return;
+    m_completion = completion;
+
+    if (update) {
+        m_notifier.makeDeferredNotifications();
+    }
+
+    emit completionChanged(getId());
+
+    if (completion == 100) {
+        // henceforth:
+        m_notifier.switchMode(DeferredNotifier::NOTIFY_ALWAYS);
+        emit modelChanged(getId());
+        emit ready(getId());
+    }
+}
+
+sv_frame_t
+DecimatedTimeValueModel::getValueCount() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_count;
+}
+
+sv_frame_t
+DecimatedTimeValueModel::getIndexForFrame(sv_frame_t frame) const
+{
+    if (frame >= 0) {
+        return frame / m_resolution;
+    } else {
+        return -((-frame - 1) / m_resolution) - 1;
+    }
+}
+
+sv_frame_t
+DecimatedTimeValueModel::getFrameForIndex(sv_frame_t index) const
+{
+    return index * m_resolution;
+}
+
+float
+DecimatedTimeValueModel::getValue(sv_frame_t index) const
+{
+    QMutexLocker locker(&m_mutex);
+    if (index < 0 || index >= m_count) return NAN;
+    return valueAt(index);
+}
+
+vector<float>
+DecimatedTimeValueModel::getValues(sv_frame_t index, sv_frame_t count) const
+{
+    QMutexLocker locker(&m_mutex);
+
+    vector<float> values;
+    if (index < 0) {
+        count += index;
+        index = 0;
+    }
+    if (index + count > m_count) {
+        count = m_count - index;
+    }
+    if (count <= 0) {
+        return values;
+    }
+    values.reserve(count);
+
+    // Copy whole runs from each chunk in turn
+    sv_frame_t i = index, end = index + count;
+    while (i < end) {
+        const Chunk &chunk = m_chunks[i / chunkSize];
+        sv_frame_t offset = i % chunkSize;
+        sv_frame_t n = std::min(end - i, chunkSize - offset);
+        values.insert(values.end(),
+                      chunk.begin() + offset, chunk.begin() + offset + n);
+        i += n;
+    }
+
+    return values;
+}
+
+void
+DecimatedTimeValueModel::setValue(sv_frame_t index, float value)
+{
+    if (index < 0) return;
+
+    bool allChange = false;
+
+    {
+        QMutexLocker locker(&m_mutex);
+
+        if (index < m_count) {
+            m_chunks[index / chunkSize][index % chunkSize] = value;
+            resummarise(index);
+        } else {
+            while (m_count < index) {
+                append(NAN);
+            }
+            append(value);
+        }
+
+        // The extents are atomic so that they can be read without
+        // the lock, but two writers must not interleave their
+        // comparisons and updates
+        if (!ISNAN(value) && !ISINF(value)) {
+            if (!m_haveExtents || value < m_valueMinimum) {
+                m_valueMinimum = value; allChange = true;
+            }
+            if (!m_haveExtents || value > m_valueMaximum) {
+                m_valueMaximum = value; allChange = true;
+            }
+            m_haveExtents = true;
+        }
+    }
+
+    m_notifier.update(getFrameForIndex(index), m_resolution);
+
+    if (allChange) {
+        emit modelChanged(getId());
+    }
+}
+
+float
+DecimatedTimeValueModel::valueAt(sv_frame_t index) const
+{
+    return m_chunks[index / chunkSize][index % chunkSize];
+}
+
+sv_frame_t
+DecimatedTimeValueModel::getLevelBlockSize(int level) const
+{
+    sv_frame_t blockSize = decimationFactor;
+    for (int i = 0; i < level; ++i) {
+        blockSize *= decimationFactor;
+    }
+    return blockSize;
+}
+
+void
+DecimatedTimeValueModel::append(float value)
+{
+    sv_frame_t index = m_count;
+
+    if (index % chunkSize == 0) {
+        m_chunks.push_back(Chunk());
+    }
+    m_chunks.rbegin()->push_back(value);
+    ++m_count;
+
+    for (int level = 0; in_range_for(m_levels, level); ++level) {
+        Level &summaries = m_levels[level];
+        sv_frame_t block = index / getLevelBlockSize(level);
+        if (block == sv_frame_t(summaries.size())) {
+            summaries.push_back(Summary());
+        }
+        summaries[block].sample(value);
+    }
+
+    // Add a coarser level once the coarsest one has more than one
+    // block's worth of entries for it
+    while (sv_frame_t(m_levels.rbegin()->size()) > decimationFactor) {
+        const Level &finer = *m_levels.rbegin();
+        Level coarser((finer.size() + decimationFactor - 1) / decimationFactor);
+        for (int i = 0; in_range_for(finer, i); ++i) {
+            coarser[i / decimationFactor].merge(finer[i]);
+        }
+        m_levels.push_back(coarser);
+    }
+}
+
+void
+DecimatedTimeValueModel::resummarise(sv_frame_t index)
+{
+    // Rebuild the block containing index at each level, from the
+    // values for the first level and from the level below for the
+    // rest
+    for (int level = 0; in_range_for(m_levels, level); ++level) {
+        sv_frame_t blockSize = getLevelBlockSize(level);
+        sv_frame_t block = index / blockSize;
+        Summary s;
+        if (level == 0) {
+            sv_frame_t end = std::min((block + 1) * blockSize, m_count);
+            for (sv_frame_t i = block * blockSize; i < end; ++i) {
+                s.sample(valueAt(i));
+            }
+        } else {
+            const Level &finer = m_levels[level - 1];
+            sv_frame_t end = std::min((block + 1) * decimationFactor,
+                                      sv_frame_t(finer.size()));
+            for (sv_frame_t i = block * decimationFactor; i < end; ++i) {
+                s.merge(finer[i]);
+            }
+        }
+        m_levels[level][block] = s;
+    }
+}
+
+DecimatedTimeValueModel::Summary
+DecimatedTimeValueModel::summarise(sv_frame_t from, sv_frame_t to) const
+{
+    // Cover [from, to) using the coarsest whole blocks available at
+    // each point, so that only the ragged ends are taken from finer
+    // levels or from the values themselves
+    Summary s;
+    if (from < 0) from = 0;
+    if (to > m_count) to = m_count;
+
+    sv_frame_t i = from;
+    while (i < to) {
+        int level = -1;
+        sv_frame_t blockSize = 1;
+        while (level + 1 < int(m_levels.size())) {
+            sv_frame_t next = blockSize * decimationFactor;
+            if (i % next != 0 || i + next > to) break;
+            blockSize = next;
+            ++level;
+        }
+        if (level < 0) {
+            s.sample(valueAt(i));
+        } else {
+            s.merge(m_levels[level][i / blockSize]);
+        }
+        i += blockSize;
+    }
+
+    return s;
+}
+
+void
+DecimatedTimeValueModel::getSummaries(sv_frame_t start, sv_frame_t count,
+                                      RangeBlock &ranges,
+                                      int blockSize) const
+{
+    ranges.clear();
+    if (count <= 0 || blockSize <= 0) return;
+
+    QMutexLocker locker(&m_mutex);
+
+    ranges.reserve((count + blockSize - 1) / blockSize);
+
+    for (sv_frame_t f = start; f < start + count; f += blockSize) {
+        sv_frame_t to = std::min(f + blockSize, start + count);
+        sv_frame_t first = getIndexForFrame(f);
+        sv_frame_t last = getIndexForFrame(to - 1);
+        if (first >= m_count) break;
+        ranges.push_back(summarise(first, last + 1).toRange());
+    }
+}
+
+DecimatedTimeValueModel::Range
+DecimatedTimeValueModel::getSummary(sv_frame_t start, sv_frame_t count) const
+{
+    if (count <= 0) return Range();
+
+    QMutexLocker locker(&m_mutex);
+
+    return summarise(getIndexForFrame(start),
+                     getIndexForFrame(start + count - 1) + 1).toRange();
+}
+
+void
+DecimatedTimeValueModel::toXml(QTextStream &out,
+                               QString indent,
+                               QString extraAttributes) const
+{
+    // Written in the same form as a SparseTimeValueModel with one
+    // unlabelled point per non-NaN value, so that it can be loaded
+    // as one. Datasets aren't in the same id-space as models when
+    // re-read, so we can use our own export id for both.
+
+    Model::toXml
+        (out,
+         indent,
+         QString("type=\"sparse\" dimensions=\"2\" resolution=\"%1\" "
+                 "notifyOnAdd=\"true\" dataset=\"%2\" "
+                 "minimum=\"%3\" maximum=\"%4\" "
+                 "units=\"%5\" %6")
+         .arg(m_resolution)
+         .arg(getExportId())
+         .arg(m_valueMinimum)
+         .arg(m_valueMaximum)
+         .arg(encodeEntities(getScaleUnits()))
+         .arg(extraAttributes));
+
+    out << indent << QString("<dataset id=\"%1\" dimensions=\"2\">\n")
+        .arg(getExportId());
+
+    EventXmlWriter writer(indent + "  ");
+    sv_frame_t count = getValueCount();
+    vector<Event> events;
+
+    for (sv_frame_t index = 0; index < count; index += exportBatchSize) {
+        vector<float> values = getValues(index, exportBatchSize);
+        events.clear();
+        for (sv_frame_t i = 0; in_range_for(values, i); ++i) {
+            if (ISNAN(values[i])) continue;
+            events.push_back(Event(getFrameForIndex(index + i),
+                                   values[i], QString()));
+        }
+        writer.write(out, events);
+    }
+
+    out << indent << "</dataset>\n";
+}
+
+QVector<QString>
+DecimatedTimeValueModel::getStringExportHeaders(DataExportOptions options) const
+{
+    if (getValueCount() == 0) {
+        return {};
+    }
+    return Event(0, 0.f, QString()).getStringExportHeaders(options, {});
+}
+
+QVector<QVector<QString>>
+DecimatedTimeValueModel::toStringExportRows(DataExportOptions options,
+                                            sv_frame_t startFrame,
+                                            sv_frame_t duration) const
+{
+    QVector<QVector<QString>> rows;
+
+    // Values whose frames fall within the range; NaN values are gaps,
+    // written as zero-valued rows only if gap filling was requested,
+    // as for a SparseTimeValueModel
+    sv_frame_t first = getIndexForFrame(startFrame + m_resolution - 1);
+    sv_frame_t last = getIndexForFrame(startFrame + duration - 1);
+    if (last < first) {
+        return rows;
+    }
+
+    vector<float> values = getValues(first, last - first + 1);
+    DataExportOptions rowOptions = options & ~DataExportFillGaps;
+
+    for (sv_frame_t i = 0; in_range_for(values, i); ++i) {
+        sv_frame_t frame = getFrameForIndex(first + i);
+        if (!ISNAN(values[i])) {
+            rows.push_back(Event(frame, values[i], QString())
+                           .toStringExportRow(rowOptions, m_sampleRate));
+        } else if (options & DataExportFillGaps) {
+            rows.push_back(Event(frame, 0.f, QString())
+                           .toStringExportRow(rowOptions, m_sampleRate));
+        }
+    }
+
+    return rows;
+}
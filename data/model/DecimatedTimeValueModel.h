@@ -0,0 +1,186 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef SV_DECIMATED_TIME_VALUE_MODEL_H
+#define SV_DECIMATED_TIME_VALUE_MODEL_H
+
+#include "Model.h"
+#include "DeferredNotifier.h"
+#include "RangeSummarisableTimeValueModel.h"
+
+#include <vector>
+#include <atomic>
+
+/**
+ * A model holding a regularly-sampled series of values, one every
+ * resolution frames, for plugin outputs that return a value at a
+ * high rate (envelopes, per-sample pitch and the like). This holds
+ * the same data as a SparseTimeValueModel with one unlabelled point
+ * per resolution step would, but stores the values in fixed-size
+ * chunks of plain floats rather than as individual events, together
+ * with min/max summaries at a series of decimation levels (as for
+ * waveform summaries) so that ranges of any length can be
+ * summarised quickly for display.
+ *
+ * Values are expected to be set in order, from index zero upwards,
+ * as the output of a feature extraction transform would be; any
+ * indices skipped over are filled with NaN, which represents "no
+ * value" and is ignored when summarising. Values may also be
+ * overwritten, at a small cost for updating the summaries.
+ *
+ * When saved as XML, the model is written out as a sparse
+ * time-value model, so that existing readers can load it.
+ */
+class DecimatedTimeValueModel : public Model
+{
+    Q_OBJECT
+
+public:
+    typedef RangeSummarisableTimeValueModel::Range Range;
+    typedef RangeSummarisableTimeValueModel::RangeBlock RangeBlock;
+
+    DecimatedTimeValueModel(sv_samplerate_t sampleRate,
+                            int resolution,
+                            bool notifyOnAdd = true);
+
+    DecimatedTimeValueModel(sv_samplerate_t sampleRate,
+                            int resolution,
+                            float valueMinimum,
+                            float valueMaximum,
+                            bool notifyOnAdd = true);
+
+    virtual ~DecimatedTimeValueModel();
+
+    QString getTypeName() const override { return tr("Decimated Time-Value"); }
+    bool isOK() const override { return true; }
+
+    sv_frame_t getStartFrame() const override { return 0; }
+    sv_frame_t getTrueEndFrame() const override;
+
+    sv_samplerate_t getSampleRate() const override { return m_sampleRate; }
+    int getResolution() const { return m_resolution; }
+
+    QString getScaleUnits() const;
+    void setScaleUnits(QString units);
+
+    float getValueMinimum() const { return m_valueMinimum; }
+    float getValueMaximum() const { return m_valueMaximum; }
+
+    int getCompletion() const override { return m_completion; }
+    void setCompletion(int completion, bool update = true);
+
+    /**
+     * Return the number of values held, including any NaN values
+     * filling gaps.
+     */
+    sv_frame_t getValueCount() const;
+
+    /**
+     * Return the index of the value covering the given frame, or
+     * the frame of the value at the given index.
+     */
+    sv_frame_t getIndexForFrame(sv_frame_t frame) const;
+    sv_frame_t getFrameForIndex(sv_frame_t index) const;
+
+    /**
+     * Return the value at the given index, or NaN if there is none.
+     */
+    float getValue(sv_frame_t index) const;
+
+    /**
+     * Return up to count values at full resolution, starting at the
+     * given index. Fewer values are returned if the end of the model
+     * is reached.
+     */
+    std::vector<float> getValues(sv_frame_t index, sv_frame_t count) const;
+
+    /**
+     * Set the value at the given index. If the index is beyond the
+     * current end of the model, the model is extended, with NaN
+     * values filling any gap.
+     */
+    void setValue(sv_frame_t index, float value);
+
+    /**
+     * Return one range for each block of blockSize frames in the
+     * given frame range, summarising the values that cover any frame
+     * within that block (a value covers resolution frames from its
+     * own frame onwards). Any block size may be requested. Fewer
+     * ranges are returned if the end of the model is reached.
+     */
+    void getSummaries(sv_frame_t start, sv_frame_t count,
+                      RangeBlock &ranges, int blockSize) const;
+
+    /**
+     * Return a single range summarising all values that cover any
+     * frame within the given frame range.
+     */
+    Range getSummary(sv_frame_t start, sv_frame_t count) const;
+
+    void toXml(QTextStream &out,
+               QString indent = "",
+               QString extraAttributes = "") const override;
+
+    QVector<QString>
+    getStringExportHeaders(DataExportOptions options) const override;
+
+    QVector<QVector<QString>>
+    toStringExportRows(DataExportOptions options,
+                       sv_frame_t startFrame,
+                       sv_frame_t duration) const override;
+
+protected:
+    // Summary of a block of values at one decimation level. NaN
+    // values are not counted.
+    struct Summary {
+        Summary() : min(0.f), max(0.f), absSum(0.f), count(0) { }
+        float min;
+        float max;
+        float absSum;
+        int count;
+        void sample(float v);
+        void merge(const Summary &s);
+        Range toRange() const;
+    };
+
+    typedef std::vector<float> Chunk;
+    typedef std::vector<Summary> Level;
+
+    sv_samplerate_t m_sampleRate;
+    int m_resolution;
+
+    std::atomic<float> m_valueMinimum;
+    std::atomic<float> m_valueMaximum;
+    std::atomic<bool> m_haveExtents;
+    QString m_units;
+
+    DeferredNotifier m_notifier;
+    std::atomic<int> m_completion;
+
+    std::vector<Chunk> m_chunks;
+    sv_frame_t m_count;
+
+    // m_levels[i] holds one summary for each block of
+    // decimationFactor^(i+1) values
+    std::vector<Level> m_levels;
+
+    // Call these with m_mutex held
+    float valueAt(sv_frame_t index) const;
+    void append(float value);
+    void resummarise(sv_frame_t index);
+    Summary summarise(sv_frame_t from, sv_frame_t to) const;
+    sv_frame_t getLevelBlockSize(int level) const;
+};
+
+#endif
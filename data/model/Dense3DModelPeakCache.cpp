@@ -18,12 +18,15 @@
 #include "base/Profiler.h"
 
 #include "base/HitCount.h"
+#include "base/AccessTracer.h"
+#include "base/StorageAdviser.h"
 
 Dense3DModelPeakCache::Dense3DModelPeakCache(ModelId sourceId,
                                              int columnsPerPeak) :
     m_source(sourceId),
     m_columnsPerPeak(columnsPerPeak),
-    m_finalColumnIncomplete(false)
+    m_finalColumnIncomplete(false),
+    m_cacheTierKB(0)
 {
     auto source = ModelById::getAs<DenseThreeDimensionalModel>(m_source);
     if (!source) {
@@ -32,12 +35,33 @@ Dense3DModelPeakCache::Dense3DModelPeakCache(ModelId sourceId,
         return;
     }
 
+    // The planned size is that of the peaks of the source as it is
+    // now; a source still being calculated may grow beyond it
+    size_t kb = (size_t(getWidth()) * size_t(getHeight()) *
+                 sizeof(float)) / 1024;
+    StorageAdviser::StorageTier tier = StorageAdviser::recommendTier
+        (StorageAdviser::AnalysisCache, kb);
+    if (tier != StorageAdviser::MemoryTier) {
+        SVDEBUG << "Dense3DModelPeakCache: Peak cache can only be held "
+                << "in memory, ignoring advice of "
+                << StorageAdviser::tierToString(tier) << " tier" << endl;
+    }
+    m_cacheTierKB = kb;
+    if (m_cacheTierKB > 0) {
+        StorageAdviser::notifyTierAllocation(StorageAdviser::MemoryTier,
+                                             m_cacheTierKB);
+    }
+
     connect(source.get(), SIGNAL(modelChanged(ModelId)),
             this, SLOT(sourceModelChanged(ModelId)));
 }
 
 Dense3DModelPeakCache::~Dense3DModelPeakCache()
 {
+    if (m_cacheTierKB > 0) {
+        StorageAdviser::notifyTierRelease(StorageAdviser::MemoryTier,
+                                          m_cacheTierKB);
+    }
 }
 
 Dense3DModelPeakCache::Column
@@ -54,6 +78,23 @@ Dense3DModelPeakCache::getValueAt(int column, int n) const
     return m_cache.at(column).at(n);
 }
 
+void
+Dense3DModelPeakCache::getColumns(int x0, int count, int bin0, int binCount,
+                                  float *dest, ColumnLayout layout) const
+{
+    for (int i = 0; i < count; ++i) {
+        int col = x0 + i;
+        if (col >= 0 && !haveColumn(col)) fillColumn(col);
+        if (!in_range_for(m_cache, col)) {
+            copyToColumns(nullptr, 0, i, count, bin0, binCount, dest, layout);
+        } else {
+            const Column &c = m_cache[col];
+            copyToColumns(c.data(), int(c.size()),
+                          i, count, bin0, binCount, dest, layout);
+        }
+    }
+}
+
 QString
 Dense3DModelPeakCache::getValueUnit() const
 {
@@ -79,9 +120,13 @@ Dense3DModelPeakCache::haveColumn(int column) const
     static HitCount count("Dense3DModelPeakCache");
     if (in_range_for(m_coverage, column) && m_coverage[column]) {
         count.hit();
+        AccessTracer::record(AccessTracer::PeakCacheColumn, getId().untyped,
+                             -1, column, 1, AccessTracer::Hit);
         return true;
     } else {
         count.miss();
+        AccessTracer::record(AccessTracer::PeakCacheColumn, getId().untyped,
+                             -1, column, 1, AccessTracer::Miss);
         return false;
     }
 }
@@ -101,26 +146,43 @@ Dense3DModelPeakCache::fillColumn(int column) const
         m_coverage.resize(column + 1, false);
         m_cache.resize(column + 1, {});
     }
+
+    Column peak;
+    bool incomplete = false;
+    if (!calculateColumn(column, peak, incomplete)) {
+        return;
+    }
+    if (incomplete) {
+        m_finalColumnIncomplete = true;
+    }
     
+    m_cache[column] = peak;
+    m_coverage[column] = true;
+}
+
+bool
+Dense3DModelPeakCache::calculateColumn(int column, Column &peak,
+                                       bool &incomplete) const
+{
     auto source = ModelById::getAs<DenseThreeDimensionalModel>(m_source);
     if (!source) {
-        return;
+        return false;
     }
     
     int sourceWidth = source->getWidth();
     int sourceColumn = column * m_columnsPerPeak;
     if (sourceColumn >= sourceWidth) {
-        return;
+        return false;
     }
 
-    Column peak = source->getColumn(sourceColumn);
+    peak = source->getColumn(sourceColumn);
     int n = int(peak.size());
     
     for (int i = 1; i < m_columnsPerPeak; ++i) {
 
         ++sourceColumn;
         if (sourceColumn >= sourceWidth) {
-            m_finalColumnIncomplete = true;
+            incomplete = true;
             break;
         }
         
@@ -131,8 +193,7 @@ Dense3DModelPeakCache::fillColumn(int column) const
         }
     }
 
-    m_cache[column] = peak;
-    m_coverage[column] = true;
+    return true;
 }
 
 
@@ -26,6 +26,11 @@
  * the source. Each column is populated from the source model when
  * first requested, and is returned from cache on subsequent requests.
  *
+ * The cache is always held in memory. Its planned size is passed to
+ * StorageAdviser::recommendTier as an analysis cache and recorded in
+ * the memory tier, but there is no disc form to follow any other
+ * advice with.
+ *
  * Dense3DModelPeakCache is not thread-safe.
  */
 class Dense3DModelPeakCache : public DenseThreeDimensionalModel
@@ -65,6 +70,13 @@ public:
     virtual int getColumnsPerPeak() const {
         return m_columnsPerPeak;
     }
+
+    /**
+     * Return the id of the model whose columns are summarised.
+     */
+    virtual ModelId getPeakSourceModel() const {
+        return m_source;
+    }
     
     int getWidth() const override {
         auto source = ModelById::getAs<DenseThreeDimensionalModel>(m_source);
@@ -102,6 +114,10 @@ public:
 
     float getValueAt(int col, int n) const override;
 
+    void getColumns(int x0, int count, int bin0, int binCount,
+                    float *dest,
+                    ColumnLayout layout = ColumnMajor) const override;
+
     QString getValueUnit() const override;
 
     QString getBinName(int n) const override {
@@ -123,12 +139,14 @@ public:
 
     QVector<QString>
     getStringExportHeaders(DataExportOptions) const override {
-        return {};
+        return getBinExportHeaders();
     }
 
     QVector<QVector<QString>>
-    toStringExportRows(DataExportOptions, sv_frame_t, sv_frame_t) const override {
-        return {};
+    toStringExportRows(DataExportOptions,
+                       sv_frame_t startFrame,
+                       sv_frame_t duration) const override {
+        return getColumnExportRows(startFrame, duration);
     }
 
 protected slots:
@@ -142,9 +160,11 @@ private:
     mutable std::vector<bool> m_coverage; // bool for space efficiency
                                           // (vector of bool is a bitmap)
     mutable bool m_finalColumnIncomplete;
+    size_t m_cacheTierKB; // amount notified to StorageAdviser
 
     bool haveColumn(int column) const;
     void fillColumn(int column) const;
+    bool calculateColumn(int column, Column &peak, bool &incomplete) const;
 };
 
 
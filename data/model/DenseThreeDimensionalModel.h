@@ -25,6 +25,9 @@
 #include <QMutex>
 #include <QVector>
 
+#include <vector>
+#include <algorithm>
+
 class DenseThreeDimensionalModel : public Model,
                                    public TabularModel
 {
@@ -68,6 +71,52 @@ public:
      */
     virtual float getValueAt(int column, int n) const = 0;
 
+    enum ColumnLayout {
+        /// The bins of each column are adjacent: the value for column
+        /// x0 + i and bin bin0 + j is at dest[i * binCount + j]
+        ColumnMajor,
+        /// The columns of each bin are adjacent: the value for column
+        /// x0 + i and bin bin0 + j is at dest[j * count + i]
+        RowMajor
+    };
+
+    /**
+     * Get bins bin0 to bin0 + binCount - 1 of each of the columns x0
+     * to x0 + count - 1, writing them to dest (which must have room
+     * for count * binCount values) in the given layout. Any value
+     * that getColumn would not return, because the column or bin is
+     * out of range, is written as zero.
+     *
+     * The default implementation simply calls getColumn for each
+     * column. Subclasses should override it where they can retrieve
+     * a run of columns with less locking and allocation than that.
+     */
+    virtual void getColumns(int x0, int count, int bin0, int binCount,
+                            float *dest,
+                            ColumnLayout layout = ColumnMajor) const {
+        for (int i = 0; i < count; ++i) {
+            Column c = getColumn(x0 + i);
+            copyToColumns(c.data(), int(c.size()),
+                          i, count, bin0, binCount, dest, layout);
+        }
+    }
+
+    /**
+     * Find the columns whose frames fall within the given range,
+     * returning the first in x0 and the number of them in count.
+     */
+    void getColumnRange(sv_frame_t startFrame, sv_frame_t duration,
+                        int &x0, int &count) const {
+        sv_frame_t resolution = std::max(getResolution(), 1);
+        sv_frame_t from = startFrame - getStartFrame();
+        sv_frame_t to = from + duration;
+        sv_frame_t first = from > 0 ? (from + resolution - 1) / resolution : 0;
+        sv_frame_t last = to > 0 ? (to + resolution - 1) / resolution : 0;
+        last = std::min(last, sv_frame_t(getWidth()));
+        x0 = int(first);
+        count = int(std::max(last - first, sv_frame_t(0)));
+    }
+
     /**
      * Obtain the name of the unit of the values returned from
      * getValueAt(), if any.
@@ -188,6 +237,67 @@ public:
 
 protected:
     DenseThreeDimensionalModel() { }
+
+    /**
+     * Helper for models whose columns are computed on demand: return
+     * bin headings and export rows (one per column, of all bins, as
+     * other dense models export them), retrieving the columns in
+     * batches through getColumns.
+     */
+    QVector<QString> getBinExportHeaders() const {
+        QVector<QString> sv;
+        int height = getHeight();
+        for (int i = 0; i < height; ++i) {
+            sv.push_back(QString("Bin%1").arg(i+1));
+        }
+        return sv;
+    }
+    
+    QVector<QVector<QString>> getColumnExportRows(sv_frame_t startFrame,
+                                                  sv_frame_t duration) const {
+        static const int batchSize = 64;
+        QVector<QVector<QString>> rows;
+        int x0 = 0, count = 0;
+        getColumnRange(startFrame, duration, x0, count);
+        int height = getHeight();
+        if (count <= 0 || height <= 0) {
+            return rows;
+        }
+        std::vector<float> values(size_t(batchSize) * height);
+        for (int i = 0; i < count; i += batchSize) {
+            int n = std::min(batchSize, count - i);
+            getColumns(x0 + i, n, 0, height, values.data());
+            for (int j = 0; j < n; ++j) {
+                QVector<QString> row;
+                row.reserve(height);
+                for (int k = 0; k < height; ++k) {
+                    row.push_back(QString("%1")
+                                  .arg(values[size_t(j) * height + k]));
+                }
+                rows.push_back(row);
+            }
+        }
+        return rows;
+    }
+
+    /**
+     * Helper for getColumns: given the n values of column x0 + i
+     * starting from bin 0, write the requested bins of that column
+     * into dest.
+     */
+    static void copyToColumns(const float *values, int n,
+                              int i, int count, int bin0, int binCount,
+                              float *dest, ColumnLayout layout) {
+        for (int j = 0; j < binCount; ++j) {
+            int bin = bin0 + j;
+            float value = (bin >= 0 && bin < n) ? values[bin] : 0.f;
+            if (layout == ColumnMajor) {
+                dest[size_t(i) * binCount + j] = value;
+            } else {
+                dest[size_t(j) * count + i] = value;
+            }
+        }
+    }
 };
 
 #endif
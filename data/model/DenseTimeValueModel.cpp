@@ -15,10 +15,23 @@
 
 #include "DenseTimeValueModel.h"
 
+#include "base/NumericKernels.h"
+
 #include <QStringList>
 
 using namespace std;
 
+floatvec_t
+DenseTimeValueModel::getMixedData(sv_frame_t start, sv_frame_t count,
+                                  float gain) const
+{
+    floatvec_t data = getData(-1, start, count);
+    if (gain != 1.f) {
+        NumericKernels::scale(data.data(), sv_frame_t(data.size()), gain);
+    }
+    return data;
+}
+
 QVector<QString>
 DenseTimeValueModel::getStringExportHeaders(DataExportOptions) const
 {
@@ -73,6 +73,20 @@ public:
     virtual floatvec_t getData(int channel, sv_frame_t start, sv_frame_t count)
         const = 0;
 
+    /**
+     * Get the specified set of samples with all channels mixed down
+     * to one, multiplying the sum of the channels by gain (so pass
+     * 1.0 / getChannelCount() for their mean). Returned vector may
+     * have fewer samples than requested, if the end of file was
+     * reached.
+     *
+     * The default implementation scales the result of getData for
+     * channel -1. Subclasses that mix from interleaved data should
+     * override it to apply the gain while mixing.
+     */
+    virtual floatvec_t getMixedData(sv_frame_t start, sv_frame_t count,
+                                    float gain) const;
+
     /**
      * Get the specified set of samples from given contiguous range of
      * channels of the model in single-precision floating-point
@@ -22,6 +22,7 @@
 #include <QMutexLocker>
 
 #include <iostream>
+#include <algorithm>
 
 #include <cmath>
 #include <cassert>
@@ -30,10 +31,14 @@ using std::vector;
 
 #include "system/System.h"
 
+const int EditableDenseThreeDimensionalModel::ColumnChunkSize = 64;
+
 EditableDenseThreeDimensionalModel::EditableDenseThreeDimensionalModel(sv_samplerate_t sampleRate,
                                                                        int resolution,
                                                                        int yBinCount,
                                                                        bool notifyOnAdd) :
+    m_data(std::make_shared<ChunkTable>()),
+    m_width(0),
     m_startFrame(0),
     m_sampleRate(sampleRate),
     m_resolution(resolution),
@@ -82,7 +87,7 @@ EditableDenseThreeDimensionalModel::setStartFrame(sv_frame_t f)
 sv_frame_t
 EditableDenseThreeDimensionalModel::getTrueEndFrame() const
 {
-    return m_resolution * m_data.size() + (m_resolution - 1);
+    return m_resolution * sv_frame_t(m_width) + (m_resolution - 1);
 }
 
 int
@@ -100,7 +105,7 @@ EditableDenseThreeDimensionalModel::setResolution(int sz)
 int
 EditableDenseThreeDimensionalModel::getWidth() const
 {
-    return int(m_data.size());
+    return m_width;
 }
 
 int
@@ -143,31 +148,141 @@ EditableDenseThreeDimensionalModel::Column
 EditableDenseThreeDimensionalModel::getColumn(int index) const
 {
     QMutexLocker locker(&m_mutex);
-    if (!in_range_for(m_data, index)) {
+    const Column *c = findColumn(*m_data, m_width, index);
+    if (!c) {
         return {};
     }
-    Column c = m_data.at(index);
-    if (int(c.size()) == m_yBinCount) {
-        return c;
-    } else {
-        Column cc(c);
+    Column cc(*c);
+    if (int(cc.size()) != m_yBinCount) {
         cc.resize(m_yBinCount, 0.0);
-        return cc;
     }
+    return cc;
 }
 
 float
 EditableDenseThreeDimensionalModel::getValueAt(int index, int n) const
 {
     QMutexLocker locker(&m_mutex);
-    if (!in_range_for(m_data, index)) {
+    const Column *c = findColumn(*m_data, m_width, index);
+    if (!c || !in_range_for(*c, n)) {
         return m_minimum;
     }
-    const Column &c = m_data.at(index);
-    if (!in_range_for(c, n)) {
+    return c->at(n);
+}
+
+void
+EditableDenseThreeDimensionalModel::getColumns(int x0, int count,
+                                               int bin0, int binCount,
+                                               float *dest,
+                                               ColumnLayout layout) const
+{
+    // The snapshot holds the lock only while it is taken
+    getSnapshot().getColumns(x0, count, bin0, binCount, dest, layout);
+}
+
+const EditableDenseThreeDimensionalModel::Column *
+EditableDenseThreeDimensionalModel::findColumn(const ChunkTable &table,
+                                               int width, int index)
+{
+    if (index < 0 || index >= width) {
+        return nullptr;
+    }
+    const ColumnChunk &chunk = *table[index / ColumnChunkSize];
+    int offset = index % ColumnChunkSize;
+    if (!in_range_for(chunk, offset)) {
+        return nullptr;
+    }
+    return &chunk[offset];
+}
+
+EditableDenseThreeDimensionalModel::ChunkTable &
+EditableDenseThreeDimensionalModel::getWritableTable()
+{
+    // Any other reference to the table must belong to a snapshot,
+    // which we must leave unchanged. This only copies the pointers
+    // to the chunks, not the chunks themselves
+    if (m_data.use_count() > 1) {
+        m_data = std::make_shared<ChunkTable>(*m_data);
+    }
+    return *m_data;
+}
+
+EditableDenseThreeDimensionalModel::ColumnChunk &
+EditableDenseThreeDimensionalModel::getWritableChunk(int chunkIndex)
+{
+    std::shared_ptr<ColumnChunk> &chunk = getWritableTable()[chunkIndex];
+    if (chunk.use_count() > 1) {
+        chunk = std::make_shared<ColumnChunk>(*chunk);
+    }
+    return *chunk;
+}
+
+EditableDenseThreeDimensionalModel::Snapshot
+EditableDenseThreeDimensionalModel::getSnapshot() const
+{
+    QMutexLocker locker(&m_mutex);
+
+    Snapshot s;
+    s.m_chunks = m_data;
+    s.m_width = m_width;
+    s.m_height = m_yBinCount;
+    s.m_startFrame = m_startFrame;
+    s.m_resolution = m_resolution;
+    s.m_minimum = m_minimum;
+    s.m_maximum = m_maximum;
+    return s;
+}
+
+EditableDenseThreeDimensionalModel::Snapshot::Snapshot() :
+    m_chunks(std::make_shared<ChunkTable>()),
+    m_width(0),
+    m_height(0),
+    m_startFrame(0),
+    m_resolution(1),
+    m_minimum(0.f),
+    m_maximum(0.f)
+{
+}
+
+EditableDenseThreeDimensionalModel::Column
+EditableDenseThreeDimensionalModel::Snapshot::getColumn(int index) const
+{
+    const Column *c = findColumn(*m_chunks, m_width, index);
+    if (!c) {
+        return {};
+    }
+    Column cc(*c);
+    if (int(cc.size()) != m_height) {
+        cc.resize(m_height, 0.0);
+    }
+    return cc;
+}
+
+float
+EditableDenseThreeDimensionalModel::Snapshot::getValueAt(int index, int n) const
+{
+    const Column *c = findColumn(*m_chunks, m_width, index);
+    if (!c || !in_range_for(*c, n)) {
         return m_minimum;
     }
-    return c.at(n);
+    return c->at(n);
+}
+
+void
+EditableDenseThreeDimensionalModel::Snapshot::getColumns(int x0, int count,
+                                                         int bin0, int binCount,
+                                                         float *dest,
+                                                         ColumnLayout layout) const
+{
+    for (int i = 0; i < count; ++i) {
+        const Column *c = findColumn(*m_chunks, m_width, x0 + i);
+        if (!c) {
+            copyToColumns(nullptr, 0, i, count, bin0, binCount, dest, layout);
+        } else {
+            int n = std::min(int(c->size()), m_height);
+            copyToColumns(c->data(), n, i, count, bin0, binCount, dest, layout);
+        }
+    }
 }
 
 QString
@@ -193,8 +308,30 @@ EditableDenseThreeDimensionalModel::setColumn(int index,
     {
         QMutexLocker locker(&m_mutex);
 
-        while (index >= int(m_data.size())) {
-            m_data.push_back(Column());
+        const int chunkIndex = index / ColumnChunkSize;
+        const int offset = index % ColumnChunkSize;
+
+        if (index >= m_width) {
+            // Every chunk but the last must be full, so fill out the
+            // current last one if we are moving past it, then add
+            // any chunks needed to reach the one for this index
+            int lastChunk = int(m_data->size()) - 1;
+            if (lastChunk >= 0 && lastChunk < chunkIndex) {
+                getWritableChunk(lastChunk).resize(ColumnChunkSize);
+            }
+            ChunkTable &table = getWritableTable();
+            while (int(table.size()) < chunkIndex) {
+                table.push_back(std::make_shared<ColumnChunk>
+                                (ColumnChunkSize));
+            }
+            if (int(table.size()) == chunkIndex) {
+                table.push_back(std::make_shared<ColumnChunk>());
+            }
+            ColumnChunk &chunk = getWritableChunk(chunkIndex);
+            if (int(chunk.size()) <= offset) {
+                chunk.resize(offset + 1);
+            }
+            m_width = index + 1;
         }
 
         for (int i = 0; in_range_for(values, i); ++i) {
@@ -213,7 +350,7 @@ EditableDenseThreeDimensionalModel::setColumn(int index,
             m_haveExtents = true;
         }
 
-        m_data[index] = values;
+        getWritableChunk(chunkIndex)[offset] = values;
 
         if (allChange) {
             m_sinceLastNotifyMin = -1;
@@ -307,14 +444,14 @@ EditableDenseThreeDimensionalModel::shouldUseLogValueScale() const
     
     for (int i = 0; i < 10; ++i) {
         int index = i * 10;
-        if (in_range_for(m_data, index)) {
-            const Column &c = m_data.at(index);
-            while (c.size() > sample.size()) {
+        const Column *c = findColumn(*m_data, m_width, index);
+        if (c) {
+            while (c->size() > sample.size()) {
                 sample.push_back(0.0);
                 n.push_back(0);
             }
-            for (int j = 0; in_range_for(c, j); ++j) {
-                sample[j] += c.at(j);
+            for (int j = 0; in_range_for(*c, j); ++j) {
+                sample[j] += c->at(j);
                 ++n[j];
             }
         }
@@ -381,16 +518,20 @@ EditableDenseThreeDimensionalModel::toStringExportRows(DataExportOptions,
                                                        sv_frame_t duration)
     const
 {
-    QMutexLocker locker(&m_mutex);
-
+    // Export from a snapshot, so that columns can still be added
+    // meanwhile
+    Snapshot snapshot = getSnapshot();
+    
     QVector<QVector<QString>> rows;
 
-    for (int i = 0; in_range_for(m_data, i); ++i) {
-        sv_frame_t fr = m_startFrame + i * m_resolution;
+    for (int i = 0; i < snapshot.m_width; ++i) {
+        sv_frame_t fr = snapshot.m_startFrame + i * snapshot.m_resolution;
         if (fr >= startFrame && fr < startFrame + duration) {
+            const Column *c = findColumn(*snapshot.m_chunks,
+                                         snapshot.m_width, i);
             QVector<QString> row;
-            for (int j = 0; in_range_for(m_data.at(i), j); ++j) {
-                row.push_back(QString("%1").arg(m_data.at(i).at(j)));
+            for (int j = 0; c && in_range_for(*c, j); ++j) {
+                row.push_back(QString("%1").arg(c->at(j)));
             }
             rows.push_back(row);
         }
@@ -403,7 +544,9 @@ EditableDenseThreeDimensionalModel::toXml(QTextStream &out,
                                           QString indent,
                                           QString extraAttributes) const
 {
-    QMutexLocker locker(&m_mutex);
+    // Write from a snapshot, rather than holding the mutex
+    // throughout, so that columns can still be added meanwhile
+    Snapshot snapshot = getSnapshot();
 
     // For historical reasons we read and write "resolution" as "windowSize".
 
@@ -416,12 +559,12 @@ EditableDenseThreeDimensionalModel::toXml(QTextStream &out,
     Model::toXml
         (out, indent,
          QString("type=\"dense\" dimensions=\"3\" windowSize=\"%1\" yBinCount=\"%2\" minimum=\"%3\" maximum=\"%4\" dataset=\"%5\" startFrame=\"%6\" %7")
-         .arg(m_resolution)
-         .arg(m_yBinCount)
-         .arg(m_minimum)
-         .arg(m_maximum)
+         .arg(snapshot.getResolution())
+         .arg(snapshot.getHeight())
+         .arg(snapshot.getMinimumLevel())
+         .arg(snapshot.getMaximumLevel())
          .arg(getExportId())
-         .arg(m_startFrame)
+         .arg(snapshot.getStartFrame())
          .arg(extraAttributes));
 
     out << indent;
@@ -436,8 +579,8 @@ EditableDenseThreeDimensionalModel::toXml(QTextStream &out,
         }
     }
 
-    for (int i = 0; in_range_for(m_data, i); ++i) {
-        Column c = getColumn(i);
+    for (int i = 0; i < snapshot.getWidth(); ++i) {
+        Column c = snapshot.getColumn(i);
         out << indent + "  ";
         out << QString("<row n=\"%1\">").arg(i);
         for (int j = 0; in_range_for(c, j); ++j) {
@@ -21,6 +21,7 @@
 #include <QMutex>
 
 #include <vector>
+#include <memory>
 
 class EditableDenseThreeDimensionalModel : public DenseThreeDimensionalModel
 {
@@ -108,6 +109,14 @@ public:
      */
     float getValueAt(int x, int n) const override;
 
+    /**
+     * Get a range of bins from a range of columns, taking the lock
+     * only once.
+     */
+    void getColumns(int x0, int count, int bin0, int binCount,
+                    float *dest,
+                    ColumnLayout layout = ColumnMajor) const override;
+
     /**
      * Obtain the name of the unit of the values returned from
      * getValueAt(), if any.
@@ -125,6 +134,71 @@ public:
      */
     virtual void setColumn(int x, const Column &values);
 
+    /**
+     * Columns are stored in fixed-size chunks, which are shared
+     * between the model and any snapshots of it until one or the
+     * other is modified.
+     */
+    typedef std::vector<Column> ColumnChunk;
+    typedef std::vector<std::shared_ptr<ColumnChunk>> ChunkTable;
+
+    /**
+     * An unchanging view of the columns of the model as they were at
+     * the time the snapshot was taken. Reading from a snapshot
+     * requires no locking and does not block or get blocked by
+     * writers to the model, so this is the way to read large
+     * numbers of columns (e.g. for export) while the model is still
+     * being filled.
+     */
+    class Snapshot
+    {
+    public:
+        Snapshot();
+
+        int getWidth() const { return m_width; }
+        int getHeight() const { return m_height; }
+        sv_frame_t getStartFrame() const { return m_startFrame; }
+        int getResolution() const { return m_resolution; }
+        float getMinimumLevel() const { return m_minimum; }
+        float getMaximumLevel() const { return m_maximum; }
+
+        /**
+         * Get the set of bin values at the given column, resized to
+         * the height of the model.
+         */
+        Column getColumn(int x) const;
+
+        /**
+         * Get a single value, from the n'th bin of the given column.
+         */
+        float getValueAt(int x, int n) const;
+
+        /**
+         * Get a range of bins from a range of columns, as
+         * DenseThreeDimensionalModel::getColumns.
+         */
+        void getColumns(int x0, int count, int bin0, int binCount,
+                        float *dest, ColumnLayout layout = ColumnMajor) const;
+
+    private:
+        friend class EditableDenseThreeDimensionalModel;
+        std::shared_ptr<const ChunkTable> m_chunks;
+        int m_width;
+        int m_height;
+        sv_frame_t m_startFrame;
+        int m_resolution;
+        float m_minimum;
+        float m_maximum;
+    };
+
+    /**
+     * Return a snapshot of the current columns. This takes constant
+     * time: the column data is not copied, but shared until the next
+     * call to setColumn, which then copies only the chunk of columns
+     * it modifies.
+     */
+    Snapshot getSnapshot() const;
+
     /**
      * Return the name of bin n. This is a single label per bin that
      * does not vary from one column to the next.
@@ -197,8 +271,10 @@ public:
                        QString extraAttributes = "") const override;
 
 protected:
-    typedef std::vector<Column> ValueMatrix;
-    ValueMatrix m_data;
+    static const int ColumnChunkSize;
+
+    std::shared_ptr<ChunkTable> m_data;
+    int m_width;
     QString m_unit;
 
     std::vector<QString> m_binNames;
@@ -218,6 +294,13 @@ protected:
     int m_completion;
 
     mutable QMutex m_mutex;
+
+    static const Column *findColumn(const ChunkTable &, int width, int x);
+
+    // Call these with m_mutex locked. They copy the chunk table or
+    // chunk first if it is shared with a snapshot
+    ChunkTable &getWritableTable();
+    ColumnChunk &getWritableChunk(int chunkIndex);
 };
 
 #endif
@@ -0,0 +1,136 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#include "FFTFrequencyModel.h"
+
+#include "base/Profiler.h"
+#include "base/HitCount.h"
+
+#include <QMutexLocker>
+
+#include <algorithm>
+
+FFTFrequencyModel::FFTFrequencyModel(ModelId sourceId,
+                                     int cacheColumns) :
+    m_source(sourceId),
+    m_cacheColumns(std::max(cacheColumns, 1)),
+    m_cacheLayout({ 0, 0, 0.0, 0.0 })
+{
+    auto source = ModelById::getAs<FFTModel>(m_source);
+    if (!source) {
+        SVCERR << "WARNING: FFTFrequencyModel constructed for unknown or wrong-type source model id " << m_source << endl;
+        m_source = {};
+        return;
+    }
+
+    // The source's columns may change while its own source is still
+    // being read, in which case our cached estimates are stale
+    
+    connect(source.get(), SIGNAL(modelChanged(ModelId)),
+            this, SLOT(sourceModelChanged(ModelId)));
+    connect(source.get(), SIGNAL(modelChangedWithin(ModelId, sv_frame_t, sv_frame_t)),
+            this, SLOT(sourceModelChanged(ModelId)));
+    
+    connect(source.get(), SIGNAL(modelChanged(ModelId)),
+            this, SIGNAL(modelChanged(ModelId)));
+    connect(source.get(), SIGNAL(modelChangedWithin(ModelId, sv_frame_t, sv_frame_t)),
+            this, SIGNAL(modelChangedWithin(ModelId, sv_frame_t, sv_frame_t)));
+}
+
+FFTFrequencyModel::~FFTFrequencyModel()
+{
+}
+
+FFTFrequencyModel::Column
+FFTFrequencyModel::getColumn(int x) const
+{
+    QMutexLocker locker(&m_mutex);
+    return getCachedColumn(x);
+}
+
+float
+FFTFrequencyModel::getValueAt(int x, int n) const
+{
+    QMutexLocker locker(&m_mutex);
+    const Column &c = getCachedColumn(x);
+    if (!in_range_for(c, n)) return 0.f;
+    return c[n];
+}
+
+void
+FFTFrequencyModel::getColumns(int x0, int count, int bin0, int binCount,
+                              float *dest, ColumnLayout layout) const
+{
+    QMutexLocker locker(&m_mutex);
+    for (int i = 0; i < count; ++i) {
+        const Column &c = getCachedColumn(x0 + i);
+        copyToColumns(c.data(), int(c.size()),
+                      i, count, bin0, binCount, dest, layout);
+    }
+}
+
+void
+FFTFrequencyModel::sourceModelChanged(ModelId)
+{
+    QMutexLocker locker(&m_mutex);
+    m_cache.clear();
+    m_cacheOrder.clear();
+}
+
+const FFTFrequencyModel::Column &
+FFTFrequencyModel::getCachedColumn(int x) const
+{
+    static HitCount count("FFTFrequencyModel");
+    static const Column empty;
+
+    auto source = ModelById::getAs<FFTModel>(m_source);
+    if (!source) {
+        return empty;
+    }
+
+    BinLayout layout { source->getHeight(), source->getBinOffset(),
+                       source->getZoomResolution(),
+                       source->getMaximumFrequency() };
+    if (!(layout == m_cacheLayout)) {
+        m_cache.clear();
+        m_cacheOrder.clear();
+        m_cacheLayout = layout;
+    }
+    
+    auto itr = m_cache.find(x);
+    if (itr != m_cache.end()) {
+        count.hit();
+        return itr->second;
+    }
+    count.miss();
+    
+    if (x < 0 || x >= source->getWidth()) {
+        return empty;
+    }
+
+    Profiler profiler("FFTFrequencyModel::getCachedColumn (calculate)");
+
+    while (int(m_cacheOrder.size()) >= m_cacheColumns) {
+        m_cache.erase(m_cacheOrder.front());
+        m_cacheOrder.pop_front();
+    }
+    
+    Column &c = m_cache[x];
+    c.resize(source->getHeight());
+    if (!source->getInstantaneousFrequenciesAt(x, c.data(), 0, int(c.size()))) {
+        c.clear();
+    }
+    m_cacheOrder.push_back(x);
+    return c;
+}
@@ -0,0 +1,187 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef SV_FFT_FREQUENCY_MODEL_H
+#define SV_FFT_FREQUENCY_MODEL_H
+
+#include "FFTModel.h"
+
+#include <QMutex>
+
+#include <map>
+#include <deque>
+
+/**
+ * A DenseThreeDimensionalModel companion to an FFTModel, with the
+ * same columns and bins, whose values are instantaneous frequency
+ * estimates in Hz rather than magnitudes. The value for each bin is
+ * the frequency estimated from the phase advance of that bin between
+ * its column and the next, as FFTModel::estimateStableFrequency
+ * calculates it, but computed for a whole column at a time.
+ *
+ * Columns are calculated when first requested and kept in a cache
+ * of limited size, so that a display or analysis that consumes the
+ * same columns more than once (e.g. a peak-frequency spectrogram and
+ * a pitch tracker over the same region) only calculates them once.
+ * The cache is cleared when the source changes, and when its bin
+ * layout changes (through FFTModel::setZoomBand or
+ * setMaximumFrequency).
+ *
+ * The cache is thread-safe, but the FFTModel it reads from is not,
+ * so this should be used from the same thread as that model.
+ */
+class FFTFrequencyModel : public DenseThreeDimensionalModel
+{
+    Q_OBJECT
+
+public:
+    FFTFrequencyModel(ModelId source, // an FFTModel
+                      int cacheColumns = 512);
+    ~FFTFrequencyModel();
+
+    bool isOK() const override {
+        auto source = ModelById::get(m_source);
+        return source && source->isOK();
+    }
+
+    sv_samplerate_t getSampleRate() const override {
+        auto source = ModelById::get(m_source);
+        return source ? source->getSampleRate() : 0;
+    }
+
+    sv_frame_t getStartFrame() const override {
+        auto source = ModelById::get(m_source);
+        return source ? source->getStartFrame() : 0;
+    }
+
+    sv_frame_t getTrueEndFrame() const override {
+        auto source = ModelById::get(m_source);
+        return source ? source->getTrueEndFrame() : 0;
+    }
+
+    int getResolution() const override {
+        auto source = ModelById::getAs<FFTModel>(m_source);
+        return source ? source->getResolution() : 1;
+    }
+
+    int getWidth() const override {
+        auto source = ModelById::getAs<FFTModel>(m_source);
+        return source ? source->getWidth() : 0;
+    }
+
+    int getHeight() const override {
+        auto source = ModelById::getAs<FFTModel>(m_source);
+        return source ? source->getHeight() : 0;
+    }
+
+    float getMinimumLevel() const override {
+        return 0.f;
+    }
+
+    float getMaximumLevel() const override {
+        return float(getSampleRate() / 2.0);
+    }
+
+    /**
+     * Return the frequency estimates for all bins of the given
+     * column.
+     */
+    Column getColumn(int x) const override;
+
+    float getValueAt(int x, int n) const override;
+
+    void getColumns(int x0, int count, int bin0, int binCount,
+                    float *dest,
+                    ColumnLayout layout = ColumnMajor) const override;
+
+    QString getValueUnit() const override {
+        return "Hz";
+    }
+
+    QString getBinName(int n) const override {
+        auto source = ModelById::getAs<FFTModel>(m_source);
+        return source ? source->getBinName(n) : "";
+    }
+
+    bool hasBinValues() const override {
+        return true;
+    }
+
+    float getBinValue(int n) const override {
+        auto source = ModelById::getAs<FFTModel>(m_source);
+        return source ? source->getBinValue(n) : float(n);
+    }
+
+    QString getBinValueUnit() const override {
+        return "Hz";
+    }
+
+    bool shouldUseLogValueScale() const override {
+        return true;
+    }
+
+    QString getTypeName() const override {
+        return tr("Instantaneous Frequency");
+    }
+
+    int getCompletion() const override {
+        auto source = ModelById::get(m_source);
+        return source ? source->getCompletion() : 100;
+    }
+
+    QVector<QString>
+    getStringExportHeaders(DataExportOptions) const override {
+        return {};
+    }
+
+    QVector<QVector<QString>>
+    toStringExportRows(DataExportOptions, sv_frame_t, sv_frame_t) const override {
+        return {};
+    }
+
+protected slots:
+    void sourceModelChanged(ModelId);
+
+private:
+    ModelId m_source;
+    int m_cacheColumns;
+
+    // The source's bin layout when the cached columns were
+    // calculated. The source does not notify us when its zoom band
+    // or maximum frequency changes, so this is checked on each
+    // lookup and the cache cleared if it differs
+    struct BinLayout {
+        int height;
+        int binOffset;
+        double resolution;
+        double maximumFrequency;
+        bool operator==(const BinLayout &l) const {
+            return height == l.height && binOffset == l.binOffset &&
+                resolution == l.resolution &&
+                maximumFrequency == l.maximumFrequency;
+        }
+    };
+
+    mutable QMutex m_mutex;
+    mutable std::map<int, Column> m_cache;
+    mutable std::deque<int> m_cacheOrder; // oldest first
+    mutable BinLayout m_cacheLayout;
+
+    // Return the cached column, calculating it first if necessary.
+    // Call with m_mutex held; the reference is valid until it is
+    // released
+    const Column &getCachedColumn(int x) const;
+};
+
+#endif
@@ -21,6 +21,7 @@
 #include "base/HitCount.h"
 #include "base/Debug.h"
 #include "base/MovingMedian.h"
+#include "base/AccessTracer.h"
 
 #include <algorithm>
 
@@ -32,6 +33,8 @@ using namespace std;
 static HitCount inSmallCache("FFTModel: Small FFT cache");
 static HitCount inSourceCache("FFTModel: Source data cache");
 
+const int FFTModel::PrunedPadRatio = 4;
+
 FFTModel::FFTModel(ModelId modelId,
                    int channel,
                    WindowType windowType,
@@ -48,6 +51,7 @@ FFTModel::FFTModel(ModelId modelId,
     m_windower(windowType, windowSize),
     m_fft(fftSize),
     m_maximumFrequency(0.0),
+    m_zoom(),
     m_cacheWriteIndex(0),
     m_cacheSize(3)
 {
@@ -61,6 +65,27 @@ FFTModel::FFTModel(ModelId modelId,
 
     m_fft.initFloat();
 
+    if (m_windowSize % 2 == 0 &&
+        m_fftSize % m_windowSize == 0 &&
+        m_fftSize / m_windowSize >= PrunedPadRatio) {
+
+        // See calculatePrunedColumn. Twiddles are for residues 1 to
+        // ratio/2 inclusive, one window's worth for each
+        
+        int ratio = m_fftSize / m_windowSize;
+        int half = m_windowSize / 2;
+        m_prunedTwiddles.reserve(sv_frame_t(ratio / 2) * m_windowSize);
+        for (int r = 1; r <= ratio / 2; ++r) {
+            for (int i = 0; i < m_windowSize; ++i) {
+                m_prunedTwiddles.push_back
+                    (polar(1.0, (-2.0 * M_PI * r * (i - half)) / m_fftSize));
+            }
+        }
+
+        m_prunedFft.reset(new breakfastquay::FFT(m_windowSize));
+        m_prunedFft->initDouble();
+    }
+
     auto model = ModelById::getAs<DenseTimeValueModel>(m_model);
     if (model) {
         m_sampleRate = model->getSampleRate();
@@ -123,6 +148,166 @@ FFTModel::setMaximumFrequency(double freq)
     clearCaches();
 }
 
+void
+FFTModel::setZoomBand(double minFreq, double maxFreq, double resolution)
+{
+    m_zoom = ZoomParameters();
+    m_zoomFft.reset();
+    m_zoomWindower.reset();
+    m_zoomBuffers = ZoomBuffers();
+
+    if (maxFreq > minFreq && m_sampleRate > 0) {
+
+        double requested = m_sampleRate / m_fftSize;
+        if (resolution > 0.0) requested = resolution;
+
+        // The band, once shifted down to centre on zero, must fit
+        // within the middle half of the decimated spectrum, so that
+        // it lies in the passband of the decimation filters and
+        // nothing from their transition bands aliases into it. Allow
+        // a bin either side for rounding the band to bins
+        
+        double span = (maxFreq - minFreq) + 2.0 * requested;
+        double minLength = ceil(m_sampleRate / requested);
+        
+        int decimation = 1;
+        while (m_sampleRate / (decimation * 2) >= span * 2 &&
+               minLength / (decimation * 2) >= 16) {
+            if (resolution <= 0.0 && m_fftSize % (decimation * 2) != 0) {
+                break;
+            }
+            decimation *= 2;
+        }
+
+        // The equivalent full-band FFT is the model's own if no
+        // resolution was requested, otherwise the shortest that is
+        // the decimation factor times a power of two and has at
+        // least the requested resolution
+        
+        int length = m_fftSize;
+        if (resolution > 0.0) {
+            int size = 16;
+            while (double(size) * decimation < minLength) size *= 2;
+            length = size * decimation;
+        }
+
+        int nyquistBin = length / 2;
+        double binWidth = m_sampleRate / length;
+        
+        int minBin = int(floor(minFreq / binWidth));
+        int maxBin = int(ceil(maxFreq / binWidth));
+        if (minBin < 0) minBin = 0;
+        if (minBin > nyquistBin) minBin = nyquistBin;
+        if (maxBin > nyquistBin) maxBin = nyquistBin;
+        if (maxBin < minBin) maxBin = minBin;
+
+        m_zoom.minFrequency = minFreq;
+        m_zoom.maxFrequency = maxFreq;
+        m_zoom.resolution = (resolution > 0.0 ? resolution : 0.0);
+        m_zoom.length = length;
+        m_zoom.windowSize = int((sv_frame_t(length) * m_windowSize) /
+                                m_fftSize);
+        m_zoom.minBin = minBin;
+        m_zoom.height = maxBin - minBin + 1;
+        m_zoom.centreBin = (minBin + maxBin) / 2;
+        m_zoom.decimation = decimation;
+        m_zoom.size = length / decimation;
+
+        if (decimation > 1 || length != m_fftSize) {
+
+            // Each stage halves the sample rate. The band extends at
+            // most a quarter of the final rate either side of zero,
+            // and a stage folds onto it only what lies within that
+            // distance of half the stage's own rate, so that is where
+            // its stopband must begin. Relative to their own rates,
+            // the early stages therefore have a wide transition band
+            // and need few taps
+            
+            int padding = 0;
+            for (int factor = 1; factor < decimation; factor *= 2) {
+                double halfWidth = double(factor * 2) / (decimation * 8);
+                m_zoom.stages.push_back(makeHalfBandKernel
+                                        (0.5 - 2.0 * halfWidth));
+                int taps = int(m_zoom.stages.rbegin()->size()) - 1;
+                padding = std::max(padding, taps * 2 + 2);
+            }
+            m_zoom.padding = padding;
+
+            m_zoomWindower.reset(new Window<double>(m_windowType,
+                                                    m_zoom.windowSize));
+
+            m_zoomFft.reset(new breakfastquay::FFT(m_zoom.size));
+            m_zoomFft->initDouble();
+
+            // Room for the window (which is the longest signal at any
+            // stage) plus the zeros either side, and enough extra for
+            // a very short window to grow by the filter length
+            for (int i = 0; i < 2; ++i) {
+                m_zoomBuffers.re[i].resize(m_zoom.windowSize + padding * 3);
+                m_zoomBuffers.im[i].resize(m_zoom.windowSize + padding * 3);
+            }
+            m_zoomBuffers.fftRe.resize(m_zoom.size);
+            m_zoomBuffers.fftIm.resize(m_zoom.size);
+            int hs = m_zoom.size / 2 + 1;
+            m_zoomBuffers.aRe.resize(hs);
+            m_zoomBuffers.aIm.resize(hs);
+            m_zoomBuffers.bRe.resize(hs);
+            m_zoomBuffers.bIm.resize(hs);
+        }
+
+        SVDEBUG << "FFTModel::setZoomBand: band " << minFreq << " to "
+                << maxFreq << " Hz at resolution " << binWidth
+                << " Hz covers bins " << minBin << " to " << maxBin
+                << " of " << length << ", decimation " << decimation
+                << " in " << m_zoom.stages.size() << " stages, FFT size "
+                << m_zoom.size << endl;
+    }
+    
+    clearCaches();
+}
+
+vector<double>
+FFTModel::makeHalfBandKernel(double transition)
+{
+    // Kaiser-windowed sinc with cutoff at a quarter of the sample
+    // rate, designed for 100dB stopband attenuation over a
+    // transition band of the given width (as a proportion of the
+    // sample rate), and with unity gain at DC. Every other tap apart
+    // from the centre one is zero. It is symmetrical, so we return
+    // only the centre tap onwards
+
+    const double attenuation = 100.0;
+    const double beta = 0.1102 * (attenuation - 8.7);
+
+    int length = int(ceil((attenuation - 8.0) /
+                          (2.285 * 2.0 * M_PI * transition))) + 1;
+    int taps = length / 2;
+    if (taps % 2 == 0) ++taps;
+
+    auto bessel0 = [](double x) {
+        double sum = 1.0, term = 1.0;
+        for (int k = 1; k < 50; ++k) {
+            term *= (x / (2.0 * k)) * (x / (2.0 * k));
+            sum += term;
+            if (term < sum * 1e-16) break;
+        }
+        return sum;
+    };
+    
+    vector<double> kernel(taps + 1, 0.0);
+    double sum = 0.0;
+    for (int i = 0; i <= taps; i += (i == 0 ? 1 : 2)) {
+        double x = double(i) / 2.0;
+        double sinc = (i == 0 ? 1.0 : sin(M_PI * x) / (M_PI * x));
+        double r = double(i) / (taps + 1);
+        double kaiser = bessel0(beta * sqrt(1.0 - r * r)) / bessel0(beta);
+        kernel[i] = sinc * kaiser;
+        sum += (i == 0 ? 1.0 : 2.0) * kernel[i];
+    }
+    for (auto &k: kernel) k /= sum;
+    return kernel;
+}
+
 int
 FFTModel::getWidth() const
 {
@@ -135,6 +320,9 @@ FFTModel::getWidth() const
 int
 FFTModel::getHeight() const
 {
+    if (isZoomed()) {
+        return m_zoom.height;
+    }
     int height = m_fftSize / 2 + 1;
     if (m_maximumFrequency != 0.0) {
         int maxBin = int(ceil(m_maximumFrequency * m_fftSize) / m_sampleRate);
@@ -154,7 +342,7 @@ FFTModel::getBinName(int n) const
 float
 FFTModel::getBinValue(int n) const
 {
-    return float((m_sampleRate * n) / m_fftSize);
+    return float((m_sampleRate * (n + m_zoom.minBin)) / getTransformSize());
 }
 
 FFTModel::Column
@@ -167,6 +355,34 @@ FFTModel::getColumn(int x) const
     return col;
 }
 
+void
+FFTModel::getColumns(int x0, int count, int bin0, int binCount,
+                     float *dest, ColumnLayout layout) const
+{
+    // Calculate magnitudes only for the requested bins, reusing one
+    // buffer for all columns
+    
+    int width = getWidth();
+    Column magnitudes(getHeight(), 0.f);
+    
+    for (int i = 0; i < count; ++i) {
+        int x = x0 + i;
+        if (x < 0 || x >= width) {
+            copyToColumns(nullptr, 0, i, count, bin0, binCount, dest, layout);
+            continue;
+        }
+        const auto &cplx = getFFTColumn(x);
+        int n = std::min(int(magnitudes.size()), int(cplx.size()));
+        int from = std::max(bin0, 0);
+        int to = std::min(bin0 + binCount, n);
+        for (int y = from; y < to; ++y) {
+            magnitudes[y] = float(abs(cplx[y]));
+        }
+        copyToColumns(magnitudes.data(), std::max(to, 0),
+                      i, count, bin0, binCount, dest, layout);
+    }
+}
+
 FFTModel::Column
 FFTModel::getPhases(int x) const
 {
@@ -345,9 +561,16 @@ FFTModel::getSourceDataUncached(pair<sv_frame_t, sv_frame_t> range) const
         range = { 0, range.second };
     }
 
-    auto data = model->getData(m_channel,
-                               range.first,
-                               range.second - range.first);
+    // For a mixdown, use the mean instead of the sum of the channels
+    // as fft model input
+    int channels = model->getChannelCount();
+    auto data = (m_channel == -1 && channels > 1) ?
+        model->getMixedData(range.first,
+                            range.second - range.first,
+                            1.f / float(channels)) :
+        model->getData(m_channel,
+                       range.first,
+                       range.second - range.first);
 /*
     if (data.empty()) {
         SVDEBUG << "NOTE: empty source data for range (" << range.first << ","
@@ -364,18 +587,6 @@ FFTModel::getSourceDataUncached(pair<sv_frame_t, sv_frame_t> range) const
         data.insert(data.begin(), pad.begin(), pad.end());
     }
     
-    if (m_channel == -1) {
-        int channels = model->getChannelCount();
-        if (channels > 1) {
-            int n = int(data.size());
-            float factor = 1.f / float(channels);
-            // use mean instead of sum for fft model input
-            for (int i = 0; i < n; ++i) {
-                data[i] *= factor;
-            }
-        }
-    }
-    
     return data;
 }
 
@@ -391,13 +602,47 @@ FFTModel::getFFTColumn(int n) const
     for (const auto &incache : m_cached) {
         if (incache.n == n) {
             inSmallCache.hit();
+            AccessTracer::record(AccessTracer::FFTColumn, getId().untyped,
+                                 m_channel, n, 1, AccessTracer::Hit);
             return incache.col;
         }
     }
     inSmallCache.miss();
+    AccessTracer::record(AccessTracer::FFTColumn, getId().untyped,
+                         m_channel, n, 1, AccessTracer::Miss);
 
     Profiler profiler("FFTModel::getFFTColumn (cache miss)");
     
+    doublecomplexvec_t &col = m_cached[m_cacheWriteIndex].col;
+
+    if (m_zoomFft) {
+
+        calculateZoomColumn(n, col);
+
+        m_cached[m_cacheWriteIndex].n = n;
+        m_cacheWriteIndex = (m_cacheWriteIndex + 1) % m_cacheSize;
+        return col;
+    }
+    
+    if (m_prunedFft) {
+
+        // Zero-padded, but only the unpadded part is needed
+        auto fsamples = getSourceData(getSourceSampleRange(n));
+        vector<double> samples(fsamples.begin(), fsamples.end());
+        m_windower.cut(samples.data());
+
+        calculatePrunedColumn(samples.data(), m_zoom.minBin + getHeight(),
+                              col);
+
+        if (m_zoom.minBin > 0) {
+            col.erase(col.begin(), col.begin() + m_zoom.minBin);
+        }
+
+        m_cached[m_cacheWriteIndex].n = n;
+        m_cacheWriteIndex = (m_cacheWriteIndex + 1) % m_cacheSize;
+        return col;
+    }
+    
     auto fsamples = getSourceSamples(n);
 
     // Ensure that windowing and FFT happen in double precision
@@ -408,16 +653,20 @@ FFTModel::getFFTColumn(int n) const
     }
     
     m_windower.cut(samples.data() + (m_fftSize - m_windowSize) / 2);
-    breakfastquay::v_fftshift(samples.data(), m_fftSize);
 
-    doublecomplexvec_t &col = m_cached[m_cacheWriteIndex].col;
+    breakfastquay::v_fftshift(samples.data(), m_fftSize);
 
-    // expand to large enough for fft destination, if truncated previously
+    // expand to large enough for fft destination, if truncated
+    // previously
     col.resize(m_fftSize / 2 + 1);
 
     m_fft.forwardInterleaved(samples.data(),
                              reinterpret_cast<double *>(col.data()));
 
+    if (m_zoom.minBin > 0) {
+        col.erase(col.begin(), col.begin() + m_zoom.minBin);
+    }
+    
     // keep only the number of elements we need - so that we can
     // return a const ref without having to resize on a cache hit
     col.resize(getHeight());
@@ -429,15 +678,291 @@ FFTModel::getFFTColumn(int n) const
     return col;
 }
 
+void
+FFTModel::calculateZoomColumn(int column, doublecomplexvec_t &col) const
+{
+    Profiler profiler("FFTModel::calculateZoomColumn");
+
+    // We read only the zoom window's worth of samples, centred on the
+    // column as for the full-band FFT. Within the frame of the
+    // equivalent full-band FFT (of length n), they are at start to
+    // start + w, and the frame's centre (at n/2) is the phase origin
+    
+    const int n = m_zoom.length;
+    const int half = n / 2;
+    const int w = m_zoom.windowSize;
+    const int start = (n - w) / 2;
+    const int padding = m_zoom.padding;
+    const int size = m_zoom.size;
+
+    sv_frame_t centre = m_windowIncrement * sv_frame_t(column);
+    auto fsamples = getSourceData({ centre - w/2, centre - w/2 + w });
+
+    auto &buf = m_zoomBuffers;
+    int cur = 0;
+    double *re = buf.re[cur].data() + padding;
+    double *im = buf.im[cur].data() + padding;
+
+    // Window the samples and shift the centre of the band down to
+    // zero frequency by multiplying with a complex oscillator. The
+    // oscillator is advanced by rotation and re-seeded exactly every
+    // so often to avoid accumulating error
+
+    int got = std::min(int(fsamples.size()), w);
+    for (int i = 0; i < got; ++i) re[i] = fsamples[i];
+    std::fill(re + got, re + w, 0.0);
+    m_zoomWindower->cut(re);
+    
+    const complex<double> step = polar(1.0, -2.0 * M_PI * m_zoom.centreBin / n);
+    complex<double> osc;
+    for (int i = 0; i < w; ++i) {
+        if (i % 256 == 0) {
+            int64_t p = (int64_t(m_zoom.centreBin) * (start + i - half)) % n;
+            osc = polar(1.0, -2.0 * M_PI * double(p) / n);
+        }
+        im[i] = re[i] * osc.imag();
+        re[i] *= osc.real();
+        osc *= step;
+    }
+
+    // The signal at each stage is non-zero only from index lo to hi
+    // (exclusive) of that stage's frame, and is held in the current
+    // buffer with zeros either side of it, so that the filter needs
+    // no special treatment at the edges. Each stage calculates only
+    // the samples at even indices of its input, i.e. those it keeps,
+    // and only those within reach of the non-zero ones. These may
+    // extend beyond either end of the frame, in which case they wrap
+    // around when the frame is transformed, as they would for a DFT
+    // of the frame
+    
+    int lo = start, hi = start + w;
+
+    auto zeroPadding = [&](double *r, double *i, int count) {
+        std::fill(r - padding, r, 0.0);
+        std::fill(i - padding, i, 0.0);
+        std::fill(r + count, r + count + padding, 0.0);
+        std::fill(i + count, i + count + padding, 0.0);
+    };
+
+    zeroPadding(re, im, hi - lo);
+
+    for (const auto &kernel: m_zoom.stages) {
+
+        const int taps = int(kernel.size()) - 1;
+        const double *h = kernel.data();
+
+        // Output j is centred on input 2j, so we want j from (lo -
+        // taps) / 2 rounded up to (hi - 1 + taps) / 2 rounded down,
+        // either of which may be negative
+        auto floorHalf = [](int x) { return x >= 0 ? x / 2 : -((1 - x) / 2); };
+        int jlo = -floorHalf(taps - lo);
+        int jhi = floorHalf(hi - 1 + taps) + 1;
+        
+        double *outRe = buf.re[1 - cur].data() + padding;
+        double *outIm = buf.im[1 - cur].data() + padding;
+        
+        for (int j = jlo; j < jhi; ++j) {
+            const double *xr = re + (2 * j - lo);
+            const double *xi = im + (2 * j - lo);
+            double sumRe = h[0] * xr[0];
+            double sumIm = h[0] * xi[0];
+            for (int k = 1; k <= taps; k += 2) {
+                sumRe += h[k] * (xr[-k] + xr[k]);
+                sumIm += h[k] * (xi[-k] + xi[k]);
+            }
+            outRe[j - jlo] = sumRe;
+            outIm[j - jlo] = sumIm;
+        }
+
+        cur = 1 - cur;
+        re = outRe;
+        im = outIm;
+        lo = jlo;
+        hi = jhi;
+        zeroPadding(re, im, hi - lo);
+    }
+
+    // Place the decimated samples in their frame, FFT-shifted so
+    // that the frame's centre is at index 0, and wrapping any that
+    // lie outside it
+    
+    std::fill(buf.fftRe.begin(), buf.fftRe.end(), 0.0);
+    std::fill(buf.fftIm.begin(), buf.fftIm.end(), 0.0);
+    for (int j = lo; j < hi; ++j) {
+        int k = ((j + size / 2) % size + size) % size;
+        buf.fftRe[k] += re[j - lo];
+        buf.fftIm[k] += im[j - lo];
+    }
+
+    // The decimated signal is complex, so we need its full spectrum,
+    // which we get from two real transforms: the spectrum of re + i
+    // im is A + iB, where A and B are the (conjugate-symmetric)
+    // spectra of re and im
+    
+    int hs = size / 2 + 1;
+    m_zoomFft->forward(buf.fftRe.data(), buf.aRe.data(), buf.aIm.data());
+    m_zoomFft->forward(buf.fftIm.data(), buf.bRe.data(), buf.bIm.data());
+
+    // Each decimated sample stands in for "decimation" input samples
+    const double gain = m_zoom.decimation;
+    
+    col.resize(m_zoom.height);
+    for (int b = 0; b < m_zoom.height; ++b) {
+        int k = (m_zoom.minBin + b - m_zoom.centreBin + size) % size;
+        complex<double> a, bb;
+        if (k < hs) {
+            a = { buf.aRe[k], buf.aIm[k] };
+            bb = { buf.bRe[k], buf.bIm[k] };
+        } else {
+            a = { buf.aRe[size - k], -buf.aIm[size - k] };
+            bb = { buf.bRe[size - k], -buf.bIm[size - k] };
+        }
+        col[b] = (a + complex<double>(0.0, 1.0) * bb) * gain;
+    }
+}
+
+void
+FFTModel::calculatePrunedColumn(const double *frame, int bins,
+                                doublecomplexvec_t &col) const
+{
+    Profiler profiler("FFTModel::calculatePrunedColumn");
+
+    // The frame contains the m_windowSize windowed samples from the
+    // middle of an FFT frame whose remaining samples are all zero.
+    //
+    // With ratio = fftSize / windowSize, write each output bin k as
+    // ratio * q + r. Then bin k of the full FFT is bin q of a
+    // window-sized FFT of the frame multiplied by exp(-2 pi i r t /
+    // fftSize), t being the time relative to the frame centre. So
+    // each residue r needs one small complex FFT, calculated here
+    // from two real ones. The input is real, so bin fftSize - k is
+    // the conjugate of bin k, and residue ratio - r comes for free
+    // with residue r. The total cost is about log(windowSize) /
+    // log(fftSize) of the full padded FFT, and it's exact.
+    
+    const int w = m_windowSize;
+    const int half = w / 2;
+    const int hs = half + 1;
+    const int ratio = m_fftSize / w;
+
+    col.resize(bins);
+
+    vector<double> re(w), im(w, 0.0);
+    vector<double> aRe(hs), aIm(hs), bRe(hs, 0.0), bIm(hs, 0.0);
+
+    auto binOf = [&](int q) -> complex<double> {
+        // bin q of the complex FFT (re + i im), for q in [0, w)
+        complex<double> a, b;
+        if (q < hs) {
+            a = { aRe[q], aIm[q] };
+            b = { bRe[q], bIm[q] };
+        } else {
+            a = { aRe[w - q], -aIm[w - q] };
+            b = { bRe[w - q], -bIm[w - q] };
+        }
+        return a + complex<double>(0.0, 1.0) * b;
+    };
+    
+    for (int r = 0; r <= ratio / 2 && r < bins; ++r) {
+
+        // Modulate, and FFT-shift by writing from the centre outward
+        
+        if (r == 0) {
+            for (int i = 0; i < w; ++i) {
+                re[(i + half) % w] = frame[i];
+            }
+            m_prunedFft->forward(re.data(), aRe.data(), aIm.data());
+        } else {
+            const complex<double> *tw =
+                m_prunedTwiddles.data() + sv_frame_t(r - 1) * w;
+            for (int i = 0; i < w; ++i) {
+                re[(i + half) % w] = frame[i] * tw[i].real();
+                im[(i + half) % w] = frame[i] * tw[i].imag();
+            }
+            m_prunedFft->forward(re.data(), aRe.data(), aIm.data());
+            m_prunedFft->forward(im.data(), bRe.data(), bIm.data());
+        }
+
+        for (int q = 0; q < w; ++q) {
+            int k = ratio * q + r;
+            if (k >= bins) break;
+            col[k] = binOf(q);
+        }
+
+        int mirror = ratio - r;
+        if (r > 0 && mirror > r) {
+            // bin ratio * q + mirror = fftSize - (ratio * (w-q-1) + r)
+            for (int q = 0; q < w; ++q) {
+                int k = ratio * q + mirror;
+                if (k >= bins) break;
+                col[k] = conj(binOf(w - q - 1));
+            }
+        }
+    }
+}
+
 bool
 FFTModel::estimateStableFrequency(int x, int y, double &frequency)
 {
     if (!isOK()) return false;
 
-    frequency = double(y * getSampleRate()) / m_fftSize;
+    int bin = y + m_zoom.minBin;
+    
+    frequency = double(bin * getSampleRate()) / getTransformSize();
 
     if (x+1 >= getWidth()) return false;
 
+    complex<double> from, to;
+    if (y >= 0 && y < getHeight()) {
+        from = getFFTColumn(x)[y];
+        to = getFFTColumn(x+1)[y];
+    }
+    
+    frequency = estimateFrequency(bin, from, to);
+    return true;
+}
+
+bool
+FFTModel::getInstantaneousFrequenciesAt(int x, float *frequencies,
+                                        int minbin, int count) const
+{
+    if (!isOK()) return false;
+
+    int height = getHeight();
+    if (count == 0) {
+        count = height - minbin;
+    }
+    if (minbin < 0 || count < 0 || minbin + count > height) {
+        return false;
+    }
+
+    if (x < 0 || x+1 >= getWidth()) {
+        for (int i = 0; i < count; ++i) {
+            int bin = minbin + i + m_zoom.minBin;
+            frequencies[i] = float(double(bin * getSampleRate()) / getTransformSize());
+        }
+        return true;
+    }
+
+    // Copy the first column, as retrieving the second may overwrite
+    // it in the column cache
+    const auto &col0 = getFFTColumn(x);
+    doublecomplexvec_t from(col0.begin() + minbin,
+                            col0.begin() + minbin + count);
+    const auto &to = getFFTColumn(x+1);
+    
+    for (int i = 0; i < count; ++i) {
+        int bin = minbin + i + m_zoom.minBin;
+        frequencies[i] = float(estimateFrequency(bin, from[i], to[minbin + i]));
+    }
+    return true;
+}
+
+double
+FFTModel::estimateFrequency(int bin,
+                            complex<double> from,
+                            complex<double> to) const
+{
     // At frequency f, a phase shift of 2pi (one cycle) happens in 1/f sec.
     // At hopsize h and sample rate sr, one hop happens in h/sr sec.
     // At window size w, for bin b, f is b*sr/w.
@@ -447,23 +972,22 @@ FFTModel::estimateStableFrequency(int x, int y, double &frequency)
     //  = 2pi * ((h * b * sr) / (w * sr))
     //  = 2pi * (h * b) / w.
 
-    double oldPhase = getPhaseAt(x, y);
-    double newPhase = getPhaseAt(x+1, y);
-
     int incr = getResolution();
 
-    double expectedPhase = oldPhase + (2.0 * M_PI * y * incr) / m_fftSize;
+    double expectedAdvance = (2.0 * M_PI * bin * incr) / getTransformSize();
 
-    double phaseError = princarg(newPhase - expectedPhase);
+    // The phase of to * conj(from) is the difference between their
+    // phases, found with one arg() rather than two
+    
+    double advance = arg(to * conj(from));
+    
+    double phaseError = princarg(advance - expectedAdvance);
 
     // The new frequency estimate based on the phase error resulting
     // from assuming the "native" frequency of this bin
 
-    frequency =
-        (getSampleRate() * (expectedPhase + phaseError - oldPhase)) /
+    return (getSampleRate() * (expectedAdvance + phaseError)) /
         (2.0 * M_PI * incr);
-
-    return true;
 }
 
 FFTModel::PeakLocationSet
@@ -592,12 +1116,13 @@ FFTModel::getPeakPickWindowSize(PeakPickType type, sv_samplerate_t sampleRate,
 {
     dist = 0.5; // dist is percentile / 100.0
     if (type == MajorPeaks) return 10;
+    bin += m_zoom.minBin;
     if (bin == 0) return 3;
 
-    double binfreq = (sampleRate * bin) / m_fftSize;
+    double binfreq = (sampleRate * bin) / getTransformSize();
     double hifreq = Pitch::getFrequencyForPitch(73, 0, binfreq);
 
-    int hibin = int(lrint((hifreq * m_fftSize) / sampleRate));
+    int hibin = int(lrint((hifreq * getTransformSize()) / sampleRate));
     int medianWinSize = hibin - bin;
 
     if (medianWinSize < 3) {
@@ -640,32 +1165,24 @@ FFTModel::getPeakFrequencies(PeakPickType type, int x,
     if (!isOK()) return peaks;
     PeakLocationSet locations = getPeaks(type, x, ymin, ymax);
 
-    sv_samplerate_t sampleRate = getSampleRate();
-    int incr = getResolution();
+    if (locations.empty()) return peaks;
+
+    if (x < 0 || x+1 >= getWidth()) {
+        for (int y: locations) {
+            int bin = y + m_zoom.minBin;
+            peaks[y] = double(bin * getSampleRate()) / getTransformSize();
+        }
+        return peaks;
+    }
+
+    // Retrieve each of the two columns once, copying the first as
+    // retrieving the second may overwrite it in the column cache
+
+    doublecomplexvec_t from(getFFTColumn(x));
+    const auto &to = getFFTColumn(x+1);
 
-    // This duplicates some of the work of estimateStableFrequency to
-    // allow us to retrieve the phases in two separate vertical
-    // columns, instead of jumping back and forth between columns x and
-    // x+1, which may be significantly slower if re-seeking is needed
-
-    vector<float> phases;
-    for (PeakLocationSet::iterator i = locations.begin();
-         i != locations.end(); ++i) {
-        phases.push_back(getPhaseAt(x, *i));
-    }
-
-    int phaseIndex = 0;
-    for (PeakLocationSet::iterator i = locations.begin();
-         i != locations.end(); ++i) {
-        double oldPhase = phases[phaseIndex];
-        double newPhase = getPhaseAt(x+1, *i);
-        double expectedPhase = oldPhase + (2.0 * M_PI * *i * incr) / m_fftSize;
-        double phaseError = princarg(newPhase - expectedPhase);
-        double frequency =
-            (sampleRate * (expectedPhase + phaseError - oldPhase))
-            / (2 * M_PI * incr);
-        peaks[*i] = frequency;
-        ++phaseIndex;
+    for (int y: locations) {
+        peaks[y] = estimateFrequency(y + m_zoom.minBin, from[y], to[y]);
     }
 
     return peaks;
@@ -27,6 +27,7 @@
 #include <set>
 #include <vector>
 #include <complex>
+#include <memory>
 
 /**
  * An implementation of DenseThreeDimensionalModel that makes FFT data
@@ -89,6 +90,9 @@ public:
     float getMaximumLevel() const override { return 1.f; } // Can't provide
 
     Column getColumn(int x) const override; // magnitudes
+    void getColumns(int x0, int count, int bin0, int binCount,
+                    float *dest,
+                    ColumnLayout layout = ColumnMajor) const override;
 
     bool hasBinValues() const override {
         return true;
@@ -104,18 +108,21 @@ public:
 
     QVector<QString>
     getStringExportHeaders(DataExportOptions) const override {
-        return {};
+        return getBinExportHeaders();
     }
 
     QVector<QVector<QString>>
-    toStringExportRows(DataExportOptions, sv_frame_t, sv_frame_t) const override {
-        return {};
+    toStringExportRows(DataExportOptions,
+                       sv_frame_t startFrame,
+                       sv_frame_t duration) const override {
+        return getColumnExportRows(startFrame, duration);
     }
 
     // FFTModel methods:
     //
     QString getError() const { return m_error; }
 
+    ModelId getInputModel() const { return m_model; }
     int getChannel() const { return m_channel; }
     WindowType getWindowType() const { return m_windowType; }
     int getWindowSize() const { return m_windowSize; }
@@ -125,6 +132,72 @@ public:
     void setMaximumFrequency(double freq);
     double getMaximumFrequency() const { return m_maximumFrequency; }
 
+    /**
+     * Restrict analysis to the band of frequencies from minFreq to
+     * maxFreq Hz, with bins spaced at the given resolution in Hz.
+     * While a band is set, the model's bins cover that band only:
+     * bin 0 is the bin at or below minFreq, and getHeight() and
+     * getBinValue() change to match.
+     *
+     * The values are those of an FFT of size sampleRate / resolution
+     * (rounded up so that the resolution obtained is at least as
+     * fine as requested; see getZoomResolution), with a window
+     * longer than the model's window size in the same proportion,
+     * centred on the same frame. A resolution of zero means the
+     * model's own bin spacing, sampleRate / fftSize, and then the
+     * values are those of the model's own FFT.
+     *
+     * Columns are calculated as a "zoom FFT": the windowed frame is
+     * shifted down so that the band is centred on zero frequency,
+     * then low-pass filtered and decimated through a series of
+     * half-band filters, each calculating only the samples it
+     * keeps, and finally a small FFT sized for the band is run. The
+     * cost per column is roughly proportional to the window length,
+     * rather than to that times its logarithm as for a full FFT of
+     * the same resolution, and only the bins in the band are
+     * stored. This makes fine resolution in a narrow band (e.g. 0.1Hz
+     * below 500Hz) practical. Zoomed values agree with those of the
+     * full FFT to within about 90dB of the largest value in the
+     * frame, the limit being the passband ripple and stopband of
+     * the decimation filters.
+     *
+     * A band overrides any maximum frequency. Call with maxFreq <=
+     * minFreq to return to full-band analysis.
+     */
+    void setZoomBand(double minFreq, double maxFreq, double resolution = 0.0);
+    bool isZoomed() const { return m_zoom.height > 0; }
+    double getZoomMinFrequency() const { return m_zoom.minFrequency; }
+    double getZoomMaxFrequency() const { return m_zoom.maxFrequency; }
+
+    /**
+     * Return the resolution requested when the zoom band was set,
+     * which is zero for the model's own bin spacing.
+     */
+    double getZoomRequestedResolution() const { return m_zoom.resolution; }
+    
+    /**
+     * Return the spacing in Hz between adjacent bins. This is
+     * sampleRate / fftSize unless a zoom band is set, in which case
+     * it is the zoom resolution actually obtained.
+     */
+    double getZoomResolution() const {
+        return m_sampleRate / getTransformSize();
+    }
+
+    /**
+     * Return the factor by which frames are decimated for zoomed
+     * analysis, or 1 if they are not decimated (either because no
+     * band is set or because the band is too wide to gain anything
+     * from decimation).
+     */
+    int getZoomDecimation() const { return m_zoom.decimation; }
+
+    /**
+     * Return the index of this model's bin 0 within the full FFT of
+     * the same resolution. This is zero unless a zoom band is set.
+     */
+    int getBinOffset() const { return m_zoom.minBin; }
+
 //!!! review which of these are ever actually called
     
     float getMagnitudeAt(int x, int y) const;
@@ -143,6 +216,20 @@ public:
      */
     virtual bool estimateStableFrequency(int x, int y, double &frequency);
 
+    /**
+     * Calculate estimated frequencies, as estimateStableFrequency
+     * does, for count bins starting at minbin in column x (or from
+     * minbin to the top if count is zero), writing them to
+     * frequencies. This makes a single pass over the two columns
+     * involved, rather than retrieving them for each bin. In the
+     * final column there is no following column to compare with, so
+     * the centre frequency of each bin is returned. Return false,
+     * writing nothing, if the model is not OK or if the requested
+     * bins do not all lie within 0 to getHeight()-1.
+     */
+    bool getInstantaneousFrequenciesAt(int x, float *frequencies,
+                                       int minbin = 0, int count = 0) const;
+
     enum PeakPickType
     {
         AllPeaks,                /// Any bin exceeding its immediate neighbours
@@ -184,10 +271,62 @@ private:
     mutable breakfastquay::FFT m_fft;
     double m_maximumFrequency;
     mutable QString m_error;
+
+    struct ZoomParameters {
+        double minFrequency = 0.0;
+        double maxFrequency = 0.0;
+        double resolution = 0.0; // as requested
+        int length = 0;     // size of the equivalent full-band FFT
+        int windowSize = 0; // window size for the equivalent FFT
+        int minBin = 0;     // full-FFT bin reported as our bin 0
+        int height = 0;     // number of bins reported, 0 if not zoomed
+        int centreBin = 0;  // full-FFT bin shifted down to zero frequency
+        int decimation = 1; // 1 if not decimated
+        int size = 0;       // size of the decimated FFT
+        int padding = 0;    // zeros either side of each stage's samples
+        // Half-band kernels, one per factor-of-two decimation stage,
+        // centre tap first
+        std::vector<std::vector<double>> stages;
+    };
+    ZoomParameters m_zoom;
+    std::unique_ptr<breakfastquay::FFT> m_zoomFft; // null if full FFT used
+    std::unique_ptr<Window<double>> m_zoomWindower;
+
+    // Working buffers for the zoom FFT, reused across columns
+    struct ZoomBuffers {
+        std::vector<double> re[2];
+        std::vector<double> im[2];
+        std::vector<double> fftRe, fftIm;
+        std::vector<double> aRe, aIm, bRe, bIm;
+    };
+    mutable ZoomBuffers m_zoomBuffers;
+
+    int getTransformSize() const {
+        return isZoomed() ? m_zoom.length : m_fftSize;
+    }
+
+    static std::vector<double> makeHalfBandKernel(double transition);
+    
+    void calculateZoomColumn(int column, doublecomplexvec_t &col) const;
+
+    // For zero-padded FFTs with a large enough pad ratio we use a
+    // transform that skips the padding, made from window-sized FFTs
+    static const int PrunedPadRatio;
+    std::unique_ptr<breakfastquay::FFT> m_prunedFft;
+    std::vector<std::complex<double>> m_prunedTwiddles;
+
+    void calculatePrunedColumn(const double *frame, int bins,
+                               doublecomplexvec_t &col) const;
     
     int getPeakPickWindowSize(PeakPickType type, sv_samplerate_t sampleRate,
                               int bin, double &dist) const;
 
+    // Estimate the frequency of the given (full-FFT) bin from its
+    // values in two adjacent columns, using phase unwrapping
+    double estimateFrequency(int bin,
+                             std::complex<double> from,
+                             std::complex<double> to) const;
+
     std::pair<sv_frame_t, sv_frame_t> getSourceSampleRange(int column) const {
         sv_frame_t startFrame = m_windowIncrement * sv_frame_t(column);
         sv_frame_t endFrame = startFrame + m_windowSize;
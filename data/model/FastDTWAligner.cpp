@@ -0,0 +1,471 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#include "FastDTWAligner.h"
+
+#include "AlignmentModel.h"
+#include "DenseTimeValueModel.h"
+#include "FFTModel.h"
+#include "Path.h"
+
+#include "base/Debug.h"
+#include "base/Pitch.h"
+#include "base/Profiler.h"
+
+#include "system/System.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+using namespace std;
+
+// Chroma is taken from this range only: below it the bins are too
+// wide to resolve semitones, and above it harmonics dominate
+static const double MinFrequency = 55.0;
+static const double MaxFrequency = 2000.0;
+
+static const int ChromaBins = 12;
+
+// Weight of the chroma-onset half of the feature vector in the
+// distance measure, relative to the chroma half
+static const double OnsetWeight = 0.5;
+
+namespace {
+
+typedef FastDTWAligner::FeatureSequence FeatureSequence;
+typedef FastDTWAligner::IndexPath IndexPath;
+
+// For each element of the first sequence, the first and last
+// elements of the second sequence within the search band
+typedef vector<pair<int, int>> Band;
+
+enum Step : unsigned char {
+    FromStart,
+    FromDiagonal,  // from (i-1, j-1)
+    FromBelow,     // from (i-1, j)
+    FromLeft       // from (i, j-1)
+};
+
+double
+distance(const float *a, const float *b, int dimension)
+{
+    double d = 0.0;
+    for (int k = 0; k < dimension; ++k) {
+        double diff = a[k] - b[k];
+        d += diff * diff;
+    }
+    return d;
+}
+
+FeatureSequence
+halve(const FeatureSequence &s)
+{
+    int n = s.size();
+    int d = s.dimension;
+    FeatureSequence h(d);
+    h.values.resize(sv_frame_t((n + 1) / 2) * d);
+    for (int i = 0; 2 * i < n; ++i) {
+        const float *a = s.at(2 * i);
+        const float *b = (2 * i + 1 < n ? s.at(2 * i + 1) : a);
+        float *out = h.values.data() + sv_frame_t(i) * d;
+        for (int k = 0; k < d; ++k) {
+            out[k] = (a[k] + b[k]) * 0.5f;
+        }
+    }
+    return h;
+}
+
+Band
+expandBand(const IndexPath &coarse, int n, int m, int radius)
+{
+    Band band(n, { m - 1, 0 });
+
+    for (const auto &p: coarse) {
+        int i0 = 2 * p.first, j0 = 2 * p.second;
+        int jlo = max(0, j0 - radius);
+        int jhi = min(m - 1, j0 + 1 + radius);
+        int ihi = min(n - 1, i0 + 1 + radius);
+        for (int i = max(0, i0 - radius); i <= ihi; ++i) {
+            band[i].first = min(band[i].first, jlo);
+            band[i].second = max(band[i].second, jhi);
+        }
+    }
+
+    // Make sure that the band includes both corners and that every
+    // row can be reached from the one before it
+
+    band[0].first = 0;
+    band[n-1].second = m - 1;
+
+    for (int i = 1; i < n; ++i) {
+        auto &b = band[i];
+        const auto &prev = band[i-1];
+        if (b.first > prev.second + 1) b.first = prev.second + 1;
+        if (b.second < prev.first) b.second = prev.first;
+        if (b.second < b.first) b.second = b.first;
+    }
+
+    return band;
+}
+
+IndexPath
+warp(const FeatureSequence &a, const FeatureSequence &b, const Band &band,
+     const atomic<bool> *abandoned)
+{
+    const int n = a.size();
+    const int m = b.size();
+    const int d = a.dimension;
+    const double inf = numeric_limits<double>::max();
+
+    // We keep only two rows of accumulated costs, but the step into
+    // every cell in the band, so as to be able to trace back
+
+    vector<sv_frame_t> rowStart(n + 1, 0);
+    for (int i = 0; i < n; ++i) {
+        rowStart[i+1] = rowStart[i] + (band[i].second - band[i].first + 1);
+    }
+    vector<Step> steps(rowStart[n], FromStart);
+
+    vector<double> prev, cur;
+    int prevLo = 0, prevHi = -1;
+
+    for (int i = 0; i < n; ++i) {
+
+        if (abandoned && *abandoned) return {};
+
+        const int lo = band[i].first, hi = band[i].second;
+        cur.assign(hi - lo + 1, inf);
+        Step *rowSteps = steps.data() + rowStart[i];
+
+        for (int j = lo; j <= hi; ++j) {
+
+            double best = inf;
+            Step step = FromStart;
+
+            if (i == 0 && j == 0) {
+                best = 0.0;
+            }
+            if (i > 0 && j > prevLo && j - 1 <= prevHi &&
+                prev[j - 1 - prevLo] < best) {
+                best = prev[j - 1 - prevLo];
+                step = FromDiagonal;
+            }
+            if (i > 0 && j >= prevLo && j <= prevHi &&
+                prev[j - prevLo] < best) {
+                best = prev[j - prevLo];
+                step = FromBelow;
+            }
+            if (j > lo && cur[j - 1 - lo] < best) {
+                best = cur[j - 1 - lo];
+                step = FromLeft;
+            }
+
+            if (best == inf) continue; // unreachable
+
+            cur[j - lo] = best + distance(a.at(i), b.at(j), d);
+            rowSteps[j - lo] = step;
+        }
+
+        prev.swap(cur);
+        prevLo = lo;
+        prevHi = hi;
+    }
+
+    if (prevHi != m - 1 || prev[m - 1 - prevLo] == inf) {
+        SVCERR << "WARNING: FastDTWAligner: end of path is unreachable"
+               << endl;
+        return {};
+    }
+
+    IndexPath path;
+    int i = n - 1, j = m - 1;
+    while (true) {
+        path.push_back({ i, j });
+        Step step = steps[rowStart[i] + (j - band[i].first)];
+        if (step == FromStart) break;
+        if (step != FromLeft) --i;
+        if (step != FromBelow) --j;
+    }
+
+    reverse(path.begin(), path.end());
+    return path;
+}
+
+IndexPath
+fastDTW(const FeatureSequence &a, const FeatureSequence &b, int radius,
+        const atomic<bool> *abandoned)
+{
+    int n = a.size(), m = b.size();
+    int minSize = radius + 2;
+
+    if (n <= minSize || m <= minSize) {
+        return warp(a, b, Band(n, { 0, m - 1 }), abandoned);
+    }
+
+    IndexPath coarse = fastDTW(halve(a), halve(b), radius, abandoned);
+    if (coarse.empty()) return {};
+
+    return warp(a, b, expandBand(coarse, n, m, radius), abandoned);
+}
+
+void
+setCompletion(ModelId alignmentModel, int completion)
+{
+    if (auto am = ModelById::getAs<AlignmentModel>(alignmentModel)) {
+        am->setCompletion(completion);
+    }
+}
+
+}
+
+FastDTWAligner::FastDTWAligner(Parameters parameters) :
+    m_parameters(parameters),
+    m_abandoned(false)
+{
+    if (m_parameters.radius < 1) {
+        m_parameters.radius = 1;
+    }
+}
+
+FastDTWAligner::~FastDTWAligner()
+{
+}
+
+FastDTWAligner::IndexPath
+FastDTWAligner::alignSequences(const FeatureSequence &a,
+                               const FeatureSequence &b,
+                               int radius,
+                               const atomic<bool> *abandoned)
+{
+    Profiler profiler("FastDTWAligner::alignSequences");
+
+    if (a.size() == 0 || b.size() == 0 || a.dimension != b.dimension) {
+        return {};
+    }
+
+    return fastDTW(a, b, max(radius, 1), abandoned);
+}
+
+bool
+FastDTWAligner::align(ModelId alignmentModel)
+{
+    ModelId referenceId, alignedId;
+    {
+        auto am = ModelById::getAs<AlignmentModel>(alignmentModel);
+        if (!am) return false;
+        referenceId = am->getReferenceModel();
+        alignedId = am->getAlignedModel();
+    }
+
+    auto fail = [&](QString error) {
+        SVCERR << "FastDTWAligner::align: " << error << endl;
+        if (auto am = ModelById::getAs<AlignmentModel>(alignmentModel)) {
+            am->setError(error);
+        }
+        return false;
+    };
+
+    if (!waitForModel(referenceId) || !waitForModel(alignedId)) {
+        if (m_abandoned) return fail("Alignment abandoned");
+        return fail("Model to be aligned is not available");
+    }
+
+    setCompletion(alignmentModel, 0);
+
+    FeatureSequence referenceFeatures, alignedFeatures;
+    int referenceHop = 0, alignedHop = 0;
+    QString error;
+
+    if (!extractFeatures(referenceId, alignmentModel, 0, 40,
+                         referenceFeatures, referenceHop, error) ||
+        !extractFeatures(alignedId, alignmentModel, 40, 80,
+                         alignedFeatures, alignedHop, error)) {
+        return fail(error);
+    }
+
+    IndexPath indexPath = alignSequences(alignedFeatures, referenceFeatures,
+                                         m_parameters.radius, &m_abandoned);
+
+    if (m_abandoned) {
+        return fail("Alignment abandoned");
+    }
+    if (indexPath.empty()) {
+        return fail("No audio to align");
+    }
+
+    sv_samplerate_t alignedRate = 0;
+    {
+        auto aligned = ModelById::getAs<DenseTimeValueModel>(alignedId);
+        if (!aligned) return fail("Model to be aligned is not available");
+        alignedRate = aligned->getSampleRate();
+    }
+
+    // The DTW path can dwell on one aligned frame for several
+    // reference frames, which the AlignmentModel would not
+    // interpolate through usefully: emit one point per aligned
+    // frame, mapped to the mean of its reference frames
+
+    Path path(alignedRate, alignedHop);
+
+    size_t k = 0;
+    while (k < indexPath.size()) {
+        int i = indexPath[k].first;
+        double sum = 0.0;
+        int count = 0;
+        while (k < indexPath.size() && indexPath[k].first == i) {
+            sum += indexPath[k].second;
+            ++count;
+            ++k;
+        }
+        path.add(PathPoint(sv_frame_t(i) * alignedHop,
+                           sv_frame_t(lrint((sum * referenceHop) / count))));
+    }
+
+    SVDEBUG << "FastDTWAligner::align: aligned " << alignedFeatures.size()
+            << " frames against " << referenceFeatures.size()
+            << ", path has " << path.getPointCount() << " points" << endl;
+
+    auto am = ModelById::getAs<AlignmentModel>(alignmentModel);
+    if (!am) return false;
+    am->setPath(path);
+    am->setCompletion(100);
+    return true;
+}
+
+bool
+FastDTWAligner::waitForModel(ModelId modelId)
+{
+    while (!m_abandoned) {
+        { // scope so as to release the shared_ptr before sleeping
+            auto model = ModelById::getAs<DenseTimeValueModel>(modelId);
+            if (!model || !model->isOK()) return false;
+            if (model->isReady()) return true;
+        }
+        SVDEBUG << "FastDTWAligner: Waiting for model " << modelId
+                << " to be ready..." << endl;
+        usleep(100000);
+    }
+    return false;
+}
+
+bool
+FastDTWAligner::extractFeatures(ModelId modelId,
+                                ModelId alignmentModel,
+                                int progressFrom, int progressTo,
+                                FeatureSequence &features,
+                                int &hop,
+                                QString &error)
+{
+    Profiler profiler("FastDTWAligner::extractFeatures");
+
+    sv_samplerate_t rate = 0;
+    {
+        auto model = ModelById::getAs<DenseTimeValueModel>(modelId);
+        if (!model) {
+            error = "Model to be aligned is not available";
+            return false;
+        }
+        rate = model->getSampleRate();
+    }
+
+    int windowSize = 2;
+    while (windowSize < m_parameters.windowDuration * rate) {
+        windowSize *= 2;
+    }
+    hop = int(lrint(m_parameters.hopDuration * rate));
+    if (hop < 1) hop = 1;
+
+    // Only the bins up to MaxFrequency contribute to the chroma, so
+    // the model need not return any above it. We don't use a zoom
+    // band: the chroma band is too wide for one to decimate by more
+    // than a small factor at this resolution, so it would cost about
+    // as much as the full FFT
+
+    FFTModel fft(modelId, -1, HanningWindow, windowSize, hop, windowSize);
+    fft.setMaximumFrequency(MaxFrequency);
+
+    const int width = fft.getWidth();
+    const int height = fft.getHeight();
+
+    vector<int> pitchClass(height, -1);
+    for (int y = 0; y < height; ++y) {
+        double frequency = fft.getBinValue(y);
+        if (frequency < MinFrequency || frequency > MaxFrequency) continue;
+        double cents = 0.0;
+        pitchClass[y] = Pitch::getPitchForFrequency(frequency, &cents, 440.0)
+            % ChromaBins;
+    }
+
+    // Each feature vector is a log-compressed chroma vector followed
+    // by its half-wave rectified difference from the previous one
+    // (an onset measure). Each half is normalised to unit length, or
+    // left as zero in silence, so that the squared Euclidean
+    // distance between corresponding halves of two vectors is 2 * (1
+    // - their cosine similarity), before the onset half is scaled by
+    // the square root of OnsetWeight
+
+    features = FeatureSequence(2 * ChromaBins);
+    features.values.resize(sv_frame_t(width) * features.dimension, 0.f);
+
+    auto normalise = [](const vector<double> &in, float *out, double scale) {
+        double norm = 0.0;
+        for (double v: in) norm += v * v;
+        norm = sqrt(norm);
+        if (norm < 1e-6) return;
+        for (int c = 0; in_range_for(in, c); ++c) {
+            out[c] = float((in[c] / norm) * scale);
+        }
+    };
+
+    vector<float> magnitudes(height, 0.f);
+    vector<double> chroma(ChromaBins), previous(ChromaBins, 0.0);
+    vector<double> onset(ChromaBins);
+    int lastProgress = progressFrom;
+
+    for (int x = 0; x < width; ++x) {
+
+        if (m_abandoned) {
+            error = "Alignment abandoned";
+            return false;
+        }
+
+        fft.getMagnitudesAt(x, magnitudes.data(), 0, height);
+
+        fill(chroma.begin(), chroma.end(), 0.0);
+        for (int y = 0; y < height; ++y) {
+            if (pitchClass[y] >= 0) {
+                chroma[pitchClass[y]] += magnitudes[y];
+            }
+        }
+        for (int c = 0; c < ChromaBins; ++c) {
+            chroma[c] = log1p(chroma[c]);
+            onset[c] = max(0.0, chroma[c] - previous[c]);
+        }
+        previous = chroma;
+
+        float *out = features.values.data() + sv_frame_t(x) * features.dimension;
+        normalise(chroma, out, 1.0);
+        normalise(onset, out + ChromaBins, sqrt(OnsetWeight));
+
+        int progress = progressFrom +
+            int((sv_frame_t(progressTo - progressFrom) * x) / width);
+        if (progress != lastProgress) {
+            setCompletion(alignmentModel, progress);
+            lastProgress = progress;
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,138 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef SV_FAST_DTW_ALIGNER_H
+#define SV_FAST_DTW_ALIGNER_H
+
+#include "base/BaseTypes.h"
+#include "base/ById.h"
+
+#include <QString>
+
+#include <vector>
+#include <atomic>
+
+/**
+ * A built-in audio-to-audio aligner, for use where an external
+ * aligner plugin is unavailable or too slow. It computes chroma and
+ * chroma-onset features for the reference and aligned models of an
+ * AlignmentModel using FFTModel, finds a warping path between the
+ * feature sequences using multiscale dynamic time warping, and sets
+ * the result as the AlignmentModel's path.
+ *
+ * The time warping is along the lines of FastDTW (Salvador and Chan,
+ * 2007): the sequences are repeatedly halved in length and aligned
+ * at the coarsest scale, then each finer scale is aligned only within
+ * a band of the given radius around the path projected from the
+ * scale above. Time and memory are therefore linear in the sequence
+ * lengths rather than quadratic, at the cost of possibly missing the
+ * optimal path where it departs from the coarse one by more than the
+ * radius.
+ */
+class FastDTWAligner
+{
+public:
+    struct Parameters {
+        /// Duration of each analysis frame in seconds. The actual
+        /// window size is this rounded up to a power of two samples.
+        double windowDuration;
+
+        /// Time between analysis frames in seconds. This is the
+        /// resolution of the resulting path.
+        double hopDuration;
+
+        /// Half-width of the search band at each scale, in frames.
+        int radius;
+
+        Parameters() :
+            windowDuration(0.1),
+            hopDuration(0.02),
+            radius(16) { }
+    };
+
+    FastDTWAligner(Parameters parameters = Parameters());
+    ~FastDTWAligner();
+
+    /**
+     * Align the aligned model of the given AlignmentModel to its
+     * reference model, both of which must be DenseTimeValueModels,
+     * and set the path of the AlignmentModel from the result. This
+     * blocks until the alignment is complete, and so is normally
+     * called from a separate thread. The completion of the
+     * AlignmentModel is updated as the work proceeds. If either input
+     * model is not yet ready, wait for it.
+     *
+     * Return true on success. On failure, set the error string of the
+     * AlignmentModel as well as returning false.
+     */
+    bool align(ModelId alignmentModel); // an AlignmentModel
+
+    /**
+     * Abandon an alignment in progress in another thread. The
+     * align() call will return false.
+     */
+    void abandon() { m_abandoned = true; }
+
+    /**
+     * A sequence of feature vectors of equal dimension, stored
+     * contiguously.
+     */
+    struct FeatureSequence {
+        int dimension;
+        std::vector<float> values;
+
+        FeatureSequence(int d = 0) : dimension(d) { }
+
+        int size() const {
+            return dimension > 0 ? int(values.size()) / dimension : 0;
+        }
+        const float *at(int i) const {
+            return values.data() + sv_frame_t(i) * dimension;
+        }
+    };
+
+    /**
+     * A warping path, as pairs of indices into the first and second
+     * of two aligned feature sequences. It starts at (0, 0), ends at
+     * the last element of each, and both indices are non-decreasing.
+     */
+    typedef std::vector<std::pair<int, int>> IndexPath;
+
+    /**
+     * Return the approximately cheapest warping path between two
+     * feature sequences of the same dimension, using the distance
+     * measure and multiscale method described above. Either sequence
+     * being empty results in an empty path. If abandoned is non-null
+     * and becomes true during the calculation, return an empty path.
+     */
+    static IndexPath alignSequences(const FeatureSequence &a,
+                                    const FeatureSequence &b,
+                                    int radius,
+                                    const std::atomic<bool> *abandoned = nullptr);
+
+private:
+    Parameters m_parameters;
+    std::atomic<bool> m_abandoned;
+
+    bool waitForModel(ModelId model);
+
+    bool extractFeatures(ModelId model, // a DenseTimeValueModel
+                         ModelId alignmentModel,
+                         int progressFrom, int progressTo,
+                         FeatureSequence &features,
+                         int &hop,
+                         QString &error);
+};
+
+#endif
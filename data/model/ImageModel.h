@@ -112,6 +112,9 @@ public:
     EventVector getAllEvents() const {
         return m_events.getAllEvents();
     }
+    EventSeries getEventSnapshot() const {
+        return m_events; // cheap: shares chunks until they are edited
+    }
     EventVector getEventsSpanning(sv_frame_t f, sv_frame_t duration) const {
         return m_events.getEventsSpanning(f, duration);
     }
@@ -128,6 +131,27 @@ public:
     EventVector getEventsStartingAt(sv_frame_t f) const {
         return m_events.getEventsStartingAt(f);
     }
+
+    /**
+     * Visit events in place, without copying them; see the
+     * corresponding EventSeries methods.
+     */
+    bool visitEventsSpanning(sv_frame_t f, sv_frame_t duration,
+                             const EventSeries::EventVisitor &visitor) const {
+        return m_events.visitEventsSpanning(f, duration, visitor);
+    }
+    bool visitEventsCovering(sv_frame_t f,
+                             const EventSeries::EventVisitor &visitor) const {
+        return m_events.visitEventsCovering(f, visitor);
+    }
+    bool visitEventsWithin(sv_frame_t f, sv_frame_t duration,
+                           const EventSeries::EventVisitor &visitor) const {
+        return m_events.visitEventsWithin(f, duration, visitor);
+    }
+    bool visitEventsStartingWithin(sv_frame_t f, sv_frame_t duration,
+                                   const EventSeries::EventVisitor &visitor) const {
+        return m_events.visitEventsStartingWithin(f, duration, visitor);
+    }
     bool getNearestEventMatching(sv_frame_t startSearchAt,
                                  std::function<bool(Event)> predicate,
                                  EventSeries::Direction direction,
@@ -61,6 +61,7 @@ public:
                    DeferredNotifier::NOTIFY_ALWAYS :
                    DeferredNotifier::NOTIFY_DEFERRED),
         m_completion(100) {
+        m_events.setSearchIndexed(true);
         if (subtype == FLEXI_NOTE) {
             m_valueMinimum = 33.f;
             m_valueMaximum = 88.f;
@@ -87,6 +88,7 @@ public:
                    DeferredNotifier::NOTIFY_ALWAYS :
                    DeferredNotifier::NOTIFY_DEFERRED),
         m_completion(100) {
+        m_events.setSearchIndexed(true);
         PlayParameterRepository::getInstance()->addPlayable
             (getId().untyped, this);
     }
@@ -176,6 +178,9 @@ public:
     EventVector getAllEvents() const {
         return m_events.getAllEvents();
     }
+    EventSeries getEventSnapshot() const {
+        return m_events; // cheap: shares chunks until they are edited
+    }
     EventVector getEventsSpanning(sv_frame_t f, sv_frame_t duration) const {
         return m_events.getEventsSpanning(f, duration);
     }
@@ -191,6 +196,27 @@ public:
     EventVector getEventsStartingAt(sv_frame_t f) const {
         return m_events.getEventsStartingAt(f);
     }
+
+    /**
+     * Visit events in place, without copying them; see the
+     * corresponding EventSeries methods.
+     */
+    bool visitEventsSpanning(sv_frame_t f, sv_frame_t duration,
+                             const EventSeries::EventVisitor &visitor) const {
+        return m_events.visitEventsSpanning(f, duration, visitor);
+    }
+    bool visitEventsCovering(sv_frame_t f,
+                             const EventSeries::EventVisitor &visitor) const {
+        return m_events.visitEventsCovering(f, visitor);
+    }
+    bool visitEventsWithin(sv_frame_t f, sv_frame_t duration,
+                           const EventSeries::EventVisitor &visitor) const {
+        return m_events.visitEventsWithin(f, duration, visitor);
+    }
+    bool visitEventsStartingWithin(sv_frame_t f, sv_frame_t duration,
+                                   const EventSeries::EventVisitor &visitor) const {
+        return m_events.visitEventsStartingWithin(f, duration, visitor);
+    }
     bool getNearestEventMatching(sv_frame_t startSearchAt,
                                  std::function<bool(Event)> predicate,
                                  EventSeries::Direction direction,
@@ -198,6 +224,27 @@ public:
         return m_events.getNearestEventMatching
             (startSearchAt, predicate, direction, found);
     }
+    bool getNearestEventWithLabel(sv_frame_t startSearchAt,
+                                  QString label,
+                                  EventSeries::Direction direction,
+                                  Event &found) const {
+        return m_events.getNearestEventWithLabel
+            (startSearchAt, label, direction, found);
+    }
+    bool getNearestEventWithValueAbove(sv_frame_t startSearchAt,
+                                       float threshold,
+                                       EventSeries::Direction direction,
+                                       Event &found) const {
+        return m_events.getNearestEventWithValueAbove
+            (startSearchAt, threshold, direction, found);
+    }
+    bool getNearestEventWithValueBelow(sv_frame_t startSearchAt,
+                                       float threshold,
+                                       EventSeries::Direction direction,
+                                       Event &found) const {
+        return m_events.getNearestEventWithValueBelow
+            (startSearchAt, threshold, direction, found);
+    }
     int getIndexForEvent(const Event &e) {
         return m_events.getIndexForEvent(e);
     }
@@ -358,11 +405,13 @@ public:
     NoteList getNotesActiveAt(sv_frame_t frame) const override {
 
         NoteList notes;
-        EventVector ee = m_events.getEventsCovering(frame);
-        for (const auto &e: ee) {
-            notes.push_back(e.toNoteData(getSampleRate(),
-                                         getScaleUnits() != "Hz"));
-        }
+        sv_samplerate_t sampleRate = getSampleRate();
+        bool valueIsMidiPitch = (getScaleUnits() != "Hz");
+        m_events.visitEventsCovering
+            (frame, [&](const Event &e) {
+                notes.push_back(e.toNoteData(sampleRate, valueIsMidiPitch));
+                return true;
+            });
         return notes;
     }
     
@@ -370,14 +419,23 @@ public:
                                     sv_frame_t duration) const override {
 
         NoteList notes;
-        EventVector ee = m_events.getEventsStartingWithin(startFrame, duration);
-        for (const auto &e: ee) {
-            notes.push_back(e.toNoteData(getSampleRate(),
-                                         getScaleUnits() != "Hz"));
-        }
+        sv_samplerate_t sampleRate = getSampleRate();
+        bool valueIsMidiPitch = (getScaleUnits() != "Hz");
+        m_events.visitEventsStartingWithin
+            (startFrame, duration, [&](const Event &e) {
+                notes.push_back(e.toNoteData(sampleRate, valueIsMidiPitch));
+                return true;
+            });
         return notes;
     }
 
+    const EventSeries *getNoteEvents(sv_samplerate_t &sampleRate,
+                                     bool &valueIsMidiPitch) const override {
+        sampleRate = getSampleRate();
+        valueIsMidiPitch = (getScaleUnits() != "Hz");
+        return &m_events;
+    }
+
     /**
      * XmlExportable methods.
      */
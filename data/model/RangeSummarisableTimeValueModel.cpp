@@ -16,3 +16,24 @@
 #include "RangeSummarisableTimeValueModel.h"
 
 #include <iostream>
+
+void
+RangeSummarisableTimeValueModel::getMultiChannelSummaries(int fromchannel,
+                                                          int tochannel,
+                                                          sv_frame_t start,
+                                                          sv_frame_t count,
+                                                          std::vector<RangeBlock> &ranges,
+                                                          int &blockSize) const
+{
+    ranges.clear();
+    if (fromchannel > tochannel) return;
+    
+    ranges.resize(tochannel - fromchannel + 1);
+
+    int requestedBlockSize = blockSize;
+    
+    for (int c = fromchannel; c <= tochannel; ++c) {
+        blockSize = requestedBlockSize;
+        getSummaries(c, start, count, ranges[c - fromchannel], blockSize);
+    }
+}
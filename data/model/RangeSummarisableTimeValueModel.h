@@ -90,6 +90,24 @@ public:
                               RangeBlock &ranges,
                               int &blockSize) const = 0;
 
+    /**
+     * Return ranges for each of a contiguous range of channels, from
+     * the given start frame, corresponding to the given number of
+     * underlying sample frames, summarised at the given block
+     * size. On return, ranges will contain one RangeBlock per
+     * channel, in order from fromchannel to tochannel inclusive.
+     *
+     * The block size is adjusted as for getSummaries. The default
+     * implementation simply calls getSummaries once for each
+     * channel; subclasses that read interleaved data should override
+     * it so as to read the underlying data only once for all
+     * channels.
+     */
+    virtual void getMultiChannelSummaries(int fromchannel, int tochannel,
+                                          sv_frame_t start, sv_frame_t count,
+                                          std::vector<RangeBlock> &ranges,
+                                          int &blockSize) const;
+
     /**
      * Return the range from the given start frame, corresponding to
      * the given number of underlying sample frames, summarised at a
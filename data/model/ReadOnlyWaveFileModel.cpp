@@ -22,12 +22,17 @@
 
 #include "base/Preferences.h"
 #include "base/PlayParameterRepository.h"
+#include "base/SampleOps.h"
+#include "base/NumericKernels.h"
+#include "base/AccessTracer.h"
+#include "base/StorageAdviser.h"
 
 #include <QFileInfo>
 #include <QTextStream>
 
 #include <iostream>
 #include <cmath>
+#include <algorithm>
 #include <sndfile.h>
 
 #include <cassert>
@@ -46,6 +51,7 @@ ReadOnlyWaveFileModel::ReadOnlyWaveFileModel(FileSource source, sv_samplerate_t
     m_reader(nullptr),
     m_myReader(true),
     m_startFrame(0),
+    m_cacheTierKB(0),
     m_fillThread(nullptr),
     m_updateTimer(nullptr),
     m_lastFillExtent(0),
@@ -99,6 +105,7 @@ ReadOnlyWaveFileModel::ReadOnlyWaveFileModel(FileSource source, AudioFileReader
     m_reader(nullptr),
     m_myReader(false),
     m_startFrame(0),
+    m_cacheTierKB(0),
     m_fillThread(nullptr),
     m_updateTimer(nullptr),
     m_lastFillExtent(0),
@@ -131,6 +138,11 @@ ReadOnlyWaveFileModel::~ReadOnlyWaveFileModel()
     if (m_myReader) delete m_reader;
     m_reader = nullptr;
 
+    if (m_cacheTierKB > 0) {
+        StorageAdviser::notifyTierRelease(StorageAdviser::MemoryTier,
+                                          m_cacheTierKB);
+    }
+
     SVDEBUG << "ReadOnlyWaveFileModel: Destructor exiting; we had caches of "
             << (m_cache[0].size() * sizeof(Range)) << " and "
             << (m_cache[1].size() * sizeof(Range)) << " bytes" << endl;
@@ -250,6 +262,25 @@ ReadOnlyWaveFileModel::getData(int channel,
                                sv_frame_t start,
                                sv_frame_t count)
     const
+{
+    return readData(channel, start, count, 1.f);
+}
+
+floatvec_t
+ReadOnlyWaveFileModel::getMixedData(sv_frame_t start,
+                                    sv_frame_t count,
+                                    float gain)
+    const
+{
+    return readData(-1, start, count, gain);
+}
+
+floatvec_t
+ReadOnlyWaveFileModel::readData(int channel,
+                                sv_frame_t start,
+                                sv_frame_t count,
+                                float mixGain)
+    const
 {
     // Read a single channel (if channel >= 0) or a mixdown of all
     // channels (if channel == -1) directly from the file.  This is
@@ -285,26 +316,25 @@ ReadOnlyWaveFileModel::getData(int channel,
         }
     }
 
+    if (channel != -1) {
+        // get a single channel; the reader may be able to provide
+        // this without reading the others
+        auto channelData = m_reader->getChannelFrames
+            (channel, channel, start, count);
+        if (channelData.empty()) return {};
+        return channelData[0];
+    }
+    
     floatvec_t interleaved = m_reader->getInterleavedFrames(start, count);
-    if (channels == 1) return interleaved;
+    if (channels == 1 && mixGain == 1.f) return interleaved;
 
     sv_frame_t obtained = interleaved.size() / channels;
     
     floatvec_t result(obtained, 0.f);
     
-    if (channel != -1) {
-        // get a single channel
-        for (int i = 0; i < obtained; ++i) {
-            result[i] = interleaved[i * channels + channel];
-        }
-    } else {
-        // channel == -1, mix down all channels
-        for (int i = 0; i < obtained; ++i) {
-            for (int c = 0; c < channels; ++c) {
-                result[i] += interleaved[i * channels + c];
-            }
-        }
-    }
+    // channel == -1, mix down all channels
+    SampleOps::mixdown(interleaved.data(), channels,
+                       result.data(), obtained, mixGain);
 
     return result;
 }
@@ -357,18 +387,9 @@ ReadOnlyWaveFileModel::getMultiChannelData(int fromchannel, int tochannel,
         }
     }
 
-    floatvec_t interleaved = m_reader->getInterleavedFrames(start, count);
-    if (channels == 1) return { interleaved };
-
-    sv_frame_t obtained = interleaved.size() / channels;
-    vector<floatvec_t> result(reqchannels, floatvec_t(obtained, 0.f));
-
-    for (int c = fromchannel; c <= tochannel; ++c) {
-        int destc = c - fromchannel;
-        for (int i = 0; i < obtained; ++i) {
-            result[destc][i] = interleaved[i * channels + c];
-        }
-    }
+    vector<floatvec_t> result = m_reader->getChannelFrames
+        (fromchannel, tochannel, start, count);
+    if (int(result.size()) != reqchannels) return {};
     
     return result;
 }
@@ -395,9 +416,38 @@ ReadOnlyWaveFileModel::getSummaries(int channel, sv_frame_t start, sv_frame_t co
                                     RangeBlock &ranges, int &blockSize) const
 {
     ranges.clear();
+
+    vector<RangeBlock> multiRanges;
+    getMultiChannelSummaries(channel, channel, start, count,
+                             multiRanges, blockSize);
+
+    if (!multiRanges.empty()) {
+        ranges = std::move(multiRanges[0]);
+    }
+}
+
+void
+ReadOnlyWaveFileModel::getMultiChannelSummaries(int fromchannel, int tochannel,
+                                                sv_frame_t start, sv_frame_t count,
+                                                vector<RangeBlock> &ranges,
+                                                int &blockSize) const
+{
+    ranges.clear();
     if (!isOK()) return;
-    ranges.reserve((count / blockSize) + 1);
 
+    int channels = getChannelCount();
+
+    if (fromchannel < 0 || fromchannel > tochannel || tochannel >= channels) {
+        SVCERR << "ERROR: ReadOnlyWaveFileModel::getMultiChannelSummaries: "
+               << "invalid channel range " << fromchannel << " -> "
+               << tochannel << " (channel count is " << channels << ")"
+               << endl;
+        return;
+    }
+
+    int reqchannels = (tochannel - fromchannel) + 1;
+    ranges.resize(reqchannels);
+    
     if (start > m_startFrame) start -= m_startFrame;
     else if (count <= m_startFrame - start) return;
     else {
@@ -410,56 +460,74 @@ ReadOnlyWaveFileModel::getSummaries(int channel, sv_frame_t start, sv_frame_t co
     int roundedBlockSize = m_zoomConstraint.getNearestBlockSize
         (blockSize, cacheType, power, ZoomConstraint::RoundDown);
 
-    int channels = getChannelCount();
+    // Per-channel accumulators for the block currently being
+    // summarised. These are indexed by channel within the requested
+    // range, so that the innermost loops below run over contiguous
+    // elements and can be vectorised
+    vector<float> mins(reqchannels, 0.f);
+    vector<float> maxes(reqchannels, 0.f);
+    vector<float> totals(reqchannels, 0.f);
 
     if (cacheType != 0 && cacheType != 1) {
 
         // We need to read directly from the file.  We haven't got
-        // this cached.  Hope the requested area is small.  This is
-        // not optimal -- we'll end up reading the same frames twice
-        // for stereo files, in two separate calls to this method.
-        // We could fairly trivially handle this for most cases that
-        // matter by putting a single cache in getInterleavedFrames
-        // for short queries.
+        // this cached.  Hope the requested area is small.  We read
+        // all channels at once, so a caller that wants summaries for
+        // several channels should ask for them together through this
+        // method rather than through getSummaries for each; the
+        // single-slot cache below helps those that don't.
 
-        m_directReadMutex.lock();
+        for (auto &r: ranges) r.reserve((count / blockSize) + 1);
+        
+        QMutexLocker locker(&m_directReadMutex);
 
         if (m_lastDirectReadStart != start ||
             m_lastDirectReadCount != count ||
             m_directRead.empty()) {
 
+            AccessTracer::record(AccessTracer::RangeSummary, getId().untyped,
+                                 fromchannel, start, count,
+                                 AccessTracer::Miss);
+
             m_directRead = m_reader->getInterleavedFrames(start, count);
             m_lastDirectReadStart = start;
             m_lastDirectReadCount = count;
+
+        } else {
+            AccessTracer::record(AccessTracer::RangeSummary, getId().untyped,
+                                 fromchannel, start, count,
+                                 AccessTracer::Hit);
         }
 
-        float max = 0.0, min = 0.0, total = 0.0;
-        sv_frame_t i = 0, got = 0;
+        sv_frame_t available = sv_frame_t(m_directRead.size()) / channels;
+        if (available > count) available = count;
 
-        while (i < count) {
+        const float *data = m_directRead.data();
+        
+        for (sv_frame_t i0 = 0; i0 < available; i0 += blockSize) {
 
-            sv_frame_t index = i * channels + channel;
-            if (index >= (sv_frame_t)m_directRead.size()) break;
-            
-            float sample = m_directRead[index];
-            if (sample > max || got == 0) max = sample;
-            if (sample < min || got == 0) min = sample;
-            total += fabsf(sample);
+            sv_frame_t got = std::min(sv_frame_t(blockSize), available - i0);
 
-            ++i;
-            ++got;
+            const float *frame = data + i0 * channels + fromchannel;
+            for (int c = 0; c < reqchannels; ++c) {
+                mins[c] = maxes[c] = frame[c];
+                totals[c] = 0.f;
+            }
             
-            if (got == blockSize) {
-                ranges.push_back(Range(min, max, total / float(got)));
-                min = max = total = 0.0f;
-                got = 0;
+            for (sv_frame_t i = 0; i < got; ++i) {
+                frame = data + (i0 + i) * channels + fromchannel;
+                for (int c = 0; c < reqchannels; ++c) {
+                    float sample = frame[c];
+                    mins[c] = std::min(mins[c], sample);
+                    maxes[c] = std::max(maxes[c], sample);
+                    totals[c] += fabsf(sample);
+                }
             }
-        }
 
-        m_directReadMutex.unlock();
-
-        if (got > 0) {
-            ranges.push_back(Range(min, max, total / float(got)));
+            for (int c = 0; c < reqchannels; ++c) {
+                ranges[c].push_back(Range(mins[c], maxes[c],
+                                          totals[c] / float(got)));
+            }
         }
 
         return;
@@ -470,8 +538,13 @@ ReadOnlyWaveFileModel::getSummaries(int channel, sv_frame_t start, sv_frame_t co
     
         const RangeBlock &cache = m_cache[cacheType];
 
+        AccessTracer::record(AccessTracer::RangeSummary, getId().untyped,
+                             fromchannel, start, count, AccessTracer::Hit);
+
         blockSize = roundedBlockSize;
 
+        for (auto &r: ranges) r.reserve((count / blockSize) + 1);
+        
         sv_frame_t cacheBlock, div;
 
         cacheBlock = (sv_frame_t(1) << m_zoomConstraint.getMinCachePower());
@@ -483,40 +556,60 @@ ReadOnlyWaveFileModel::getSummaries(int channel, sv_frame_t start, sv_frame_t co
         sv_frame_t startIndex = start / cacheBlock;
         sv_frame_t endIndex = (start + count) / cacheBlock;
 
-        float max = 0.0, min = 0.0, total = 0.0;
         sv_frame_t i = 0, got = 0;
 
 #ifdef DEBUG_WAVE_FILE_MODEL_READ
         cerr << "blockSize is " << blockSize << ", cacheBlock " << cacheBlock << ", start " << start << ", count " << count << " (frame count " << getFrameCount() << "), power is " << power << ", div is " << div << ", startIndex " << startIndex << ", endIndex " << endIndex << endl;
 #endif
 
+        // The cache holds the ranges for all channels of a given
+        // cache block together, so any one block is either present
+        // for every channel or for none
+
         for (i = 0; i <= endIndex - startIndex; ) {
         
-            sv_frame_t index = (i + startIndex) * channels + channel;
-            if (!in_range_for(cache, index)) break;
-            
-            const Range &range = cache[index];
-            if (range.max() > max || got == 0) max = range.max();
-            if (range.min() < min || got == 0) min = range.min();
-            total += range.absmean();
+            sv_frame_t base = (i + startIndex) * channels + fromchannel;
+            if (!in_range_for(cache, base + reqchannels - 1)) break;
+
+            const Range *rr = cache.data() + base;
+
+            if (got == 0) {
+                for (int c = 0; c < reqchannels; ++c) {
+                    mins[c] = rr[c].min();
+                    maxes[c] = rr[c].max();
+                    totals[c] = rr[c].absmean();
+                }
+            } else {
+                for (int c = 0; c < reqchannels; ++c) {
+                    mins[c] = std::min(mins[c], rr[c].min());
+                    maxes[c] = std::max(maxes[c], rr[c].max());
+                    totals[c] += rr[c].absmean();
+                }
+            }
             
             ++i;
             ++got;
             
             if (got == div) {
-                ranges.push_back(Range(min, max, total / float(got)));
-                min = max = total = 0.0f;
+                for (int c = 0; c < reqchannels; ++c) {
+                    ranges[c].push_back(Range(mins[c], maxes[c],
+                                              totals[c] / float(got)));
+                }
                 got = 0;
             }
         }
                 
         if (got > 0) {
-            ranges.push_back(Range(min, max, total / float(got)));
+            for (int c = 0; c < reqchannels; ++c) {
+                ranges[c].push_back(Range(mins[c], maxes[c],
+                                          totals[c] / float(got)));
+            }
         }
     }
 
 #ifdef DEBUG_WAVE_FILE_MODEL_READ
-    cerr << "returning " << ranges.size() << " ranges" << endl;
+    cerr << "returning " << ranges.size() << " x " << ranges[0].size()
+         << " ranges" << endl;
 #endif
     return;
 }
@@ -576,6 +669,22 @@ ReadOnlyWaveFileModel::getSummary(int channel, sv_frame_t start, sv_frame_t coun
 void
 ReadOnlyWaveFileModel::fillCache()
 {
+    // The range cache has no disc form, so it is held in memory
+    // whatever tier is advised for it. Its planned size is at most
+    // two ranges per channel per cache block of the smaller size;
+    // the size actually used is recorded in the memory tier once it
+    // has been filled
+    sv_frame_t ranges = 2 * getChannelCount() *
+        (getFrameCount() >> m_zoomConstraint.getMinCachePower());
+    StorageAdviser::StorageTier tier = StorageAdviser::recommendTier
+        (StorageAdviser::SummaryCache,
+         size_t(ranges * sv_frame_t(sizeof(Range)) / 1024));
+    if (tier != StorageAdviser::MemoryTier) {
+        SVDEBUG << "ReadOnlyWaveFileModel: Range cache can only be held "
+                << "in memory, ignoring advice of "
+                << StorageAdviser::tierToString(tier) << " tier" << endl;
+    }
+
     m_mutex.lock();
 
     m_updateTimer = new QTimer(this);
@@ -623,6 +732,17 @@ ReadOnlyWaveFileModel::cacheFilled()
     m_updateTimer = nullptr;
     auto prevFillExtent = m_lastFillExtent;
     m_lastFillExtent = getEndFrame();
+    size_t kb = ((m_cache[0].capacity() + m_cache[1].capacity()) *
+                 sizeof(Range)) / 1024;
+    if (m_cacheTierKB > 0) {
+        StorageAdviser::notifyTierRelease(StorageAdviser::MemoryTier,
+                                          m_cacheTierKB);
+    }
+    m_cacheTierKB = kb;
+    if (m_cacheTierKB > 0) {
+        StorageAdviser::notifyTierAllocation(StorageAdviser::MemoryTier,
+                                             m_cacheTierKB);
+    }
     m_mutex.unlock();
 #ifdef DEBUG_WAVE_FILE_MODEL
     SVCERR << "ReadOnlyWaveFileModel(" << objectName() << ")::cacheFilled, about to emit things" << endl;
@@ -672,6 +792,9 @@ ReadOnlyWaveFileModel::RangeCacheFillThread::run()
         means[i] = 0.f;
     }
 
+    floatvec_t channelBuffer;
+    std::vector<float *> channelPtrs(channels, nullptr);
+    
     bool first = true;
 
     while (first || updating) {
@@ -698,25 +821,44 @@ ReadOnlyWaveFileModel::RangeCacheFillThread::run()
 
             sv_frame_t gotBlockSize = block.size() / channels;
 
+            // De-interleave first, so that the range summaries can
+            // be taken over contiguous runs of each channel
+
+            if (sv_frame_t(channelBuffer.size()) < gotBlockSize * channels) {
+                channelBuffer.resize(gotBlockSize * channels);
+            }
+            for (int ch = 0; ch < channels; ++ch) {
+                channelPtrs[ch] = channelBuffer.data() + ch * gotBlockSize;
+            }
+            SampleOps::deinterleave(block.data(), channels, 0, channels,
+                                    channelPtrs.data(), gotBlockSize);
+            
             m_model.m_mutex.lock();
 
-            for (sv_frame_t i = 0; i < gotBlockSize; ++i) {
-                
-                for (int ch = 0; ch < channels; ++ch) {
+            for (int cacheType = 0; cacheType < 2; ++cacheType) {
 
-                    sv_frame_t index = channels * i + ch;
-                    float sample = block[index];
+                sv_frame_t i = 0;
+
+                while (i < gotBlockSize) {
+
+                    sv_frame_t n = std::min
+                        (gotBlockSize - i,
+                         sv_frame_t(cacheBlockSize[cacheType] - count[cacheType]));
                     
-                    for (int cacheType = 0; cacheType < 2; ++cacheType) {
-                        sv_frame_t rangeIndex = ch * 2 + cacheType;
-                        range[rangeIndex].sample(sample);
-                        means[rangeIndex] += fabsf(sample);
+                    for (int ch = 0; ch < channels; ++ch) {
+                        int rangeIndex = ch * 2 + cacheType;
+                        float min = 0.f, max = 0.f, sum = 0.f;
+                        NumericKernels::minMaxSumAbs(channelPtrs[ch] + i, n,
+                                                     min, max, sum);
+                        range[rangeIndex].sample(min);
+                        range[rangeIndex].sample(max);
+                        means[rangeIndex] += sum;
                     }
-                }
 
-                for (int cacheType = 0; cacheType < 2; ++cacheType) {
+                    i += n;
+                    count[cacheType] += int(n);
 
-                    if (++count[cacheType] == cacheBlockSize[cacheType]) {
+                    if (count[cacheType] == cacheBlockSize[cacheType]) {
                         
                         for (int ch = 0; ch < int(channels); ++ch) {
                             int rangeIndex = ch * 2 + cacheType;
@@ -730,10 +872,10 @@ ReadOnlyWaveFileModel::RangeCacheFillThread::run()
                         count[cacheType] = 0;
                     }
                 }
-                
-                ++frame;
             }
 
+            frame += gotBlockSize;
+
             if (m_model.m_exiting) break;
             m_fillExtent = frame;
         }
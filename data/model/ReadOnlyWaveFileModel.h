@@ -85,6 +85,8 @@ public:
 
     floatvec_t getData(int channel, sv_frame_t start, sv_frame_t count) const override;
 
+    floatvec_t getMixedData(sv_frame_t start, sv_frame_t count, float gain) const override;
+
     std::vector<floatvec_t> getMultiChannelData(int fromchannel, int tochannel, sv_frame_t start, sv_frame_t count) const override;
 
     int getSummaryBlockSize(int desired) const override;
@@ -93,6 +95,11 @@ public:
                               RangeBlock &ranges,
                               int &blockSize) const override;
 
+    void getMultiChannelSummaries(int fromchannel, int tochannel,
+                                  sv_frame_t start, sv_frame_t count,
+                                  std::vector<RangeBlock> &ranges,
+                                  int &blockSize) const override;
+
     Range getSummary(int channel, sv_frame_t start, sv_frame_t count) const override;
 
     QString getTypeName() const override { return tr("Wave File"); }
@@ -126,6 +133,10 @@ protected:
          
     void fillCache();
 
+    // As getData, multiplying the mixdown by mixGain if channel is -1
+    floatvec_t readData(int channel, sv_frame_t start, sv_frame_t count,
+                        float mixGain) const;
+
     FileSource m_source;
     QString m_path;
     AudioFileReader *m_reader;
@@ -134,6 +145,7 @@ protected:
     sv_frame_t m_startFrame;
 
     RangeBlock m_cache[2]; // interleaved at two base resolutions
+    size_t m_cacheTierKB; // amount notified to StorageAdviser
     mutable QMutex m_mutex;
     RangeCacheFillThread *m_fillThread;
     QTimer *m_updateTimer;
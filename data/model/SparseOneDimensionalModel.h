@@ -54,6 +54,7 @@ public:
                    DeferredNotifier::NOTIFY_ALWAYS :
                    DeferredNotifier::NOTIFY_DEFERRED),
         m_completion(100) {
+        m_events.setSearchIndexed(true);
         PlayParameterRepository::getInstance()->addPlayable
             (getId().untyped, this);
     }
@@ -122,6 +123,9 @@ public:
     EventVector getAllEvents() const {
         return m_events.getAllEvents();
     }
+    EventSeries getEventSnapshot() const {
+        return m_events; // cheap: shares chunks until they are edited
+    }
     EventVector getEventsSpanning(sv_frame_t f, sv_frame_t duration) const {
         return m_events.getEventsSpanning(f, duration);
     }
@@ -138,6 +142,27 @@ public:
     EventVector getEventsStartingAt(sv_frame_t f) const {
         return m_events.getEventsStartingAt(f);
     }
+
+    /**
+     * Visit events in place, without copying them; see the
+     * corresponding EventSeries methods.
+     */
+    bool visitEventsSpanning(sv_frame_t f, sv_frame_t duration,
+                             const EventSeries::EventVisitor &visitor) const {
+        return m_events.visitEventsSpanning(f, duration, visitor);
+    }
+    bool visitEventsCovering(sv_frame_t f,
+                             const EventSeries::EventVisitor &visitor) const {
+        return m_events.visitEventsCovering(f, visitor);
+    }
+    bool visitEventsWithin(sv_frame_t f, sv_frame_t duration,
+                           const EventSeries::EventVisitor &visitor) const {
+        return m_events.visitEventsWithin(f, duration, visitor);
+    }
+    bool visitEventsStartingWithin(sv_frame_t f, sv_frame_t duration,
+                                   const EventSeries::EventVisitor &visitor) const {
+        return m_events.visitEventsStartingWithin(f, duration, visitor);
+    }
     bool getNearestEventMatching(sv_frame_t startSearchAt,
                                  std::function<bool(Event)> predicate,
                                  EventSeries::Direction direction,
@@ -145,6 +170,13 @@ public:
         return m_events.getNearestEventMatching
             (startSearchAt, predicate, direction, found);
     }
+    bool getNearestEventWithLabel(sv_frame_t startSearchAt,
+                                  QString label,
+                                  EventSeries::Direction direction,
+                                  Event &found) const {
+        return m_events.getNearestEventWithLabel
+            (startSearchAt, label, direction, found);
+    }
 
     /**
      * Editing methods.
@@ -281,12 +313,23 @@ public:
                                     sv_frame_t duration) const override {
         
         NoteList notes;
-        EventVector ee = m_events.getEventsStartingWithin(startFrame, duration);
-        for (const auto &e: ee) {
-            notes.push_back(e.toNoteData(getSampleRate(), true));
-        }
+        sv_samplerate_t sampleRate = getSampleRate();
+        m_events.visitEventsStartingWithin
+            (startFrame, duration, [&](const Event &e) {
+                notes.push_back(e.toNoteData(sampleRate, true));
+                return true;
+            });
         return notes;
     }
+
+    const EventSeries *getNoteEvents(sv_samplerate_t &sampleRate,
+                                     bool &valueIsMidiPitch) const override {
+        // Our events have no duration, so the notes active at a
+        // frame are those starting at it, as in getNotesActiveAt
+        sampleRate = getSampleRate();
+        valueIsMidiPitch = true;
+        return &m_events;
+    }
     
     /**
      * XmlExportable methods.
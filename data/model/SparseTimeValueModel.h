@@ -53,6 +53,7 @@ public:
                    DeferredNotifier::NOTIFY_ALWAYS :
                    DeferredNotifier::NOTIFY_DEFERRED),
         m_completion(100) {
+        m_events.setSearchIndexed(true);
         // Model is playable, but may not sound (if units not Hz or
         // range unsuitable)
         PlayParameterRepository::getInstance()->addPlayable
@@ -74,6 +75,7 @@ public:
                    DeferredNotifier::NOTIFY_ALWAYS :
                    DeferredNotifier::NOTIFY_DEFERRED),
         m_completion(100) {
+        m_events.setSearchIndexed(true);
         // Model is playable, but may not sound (if units not Hz or
         // range unsuitable)
         PlayParameterRepository::getInstance()->addPlayable
@@ -159,6 +161,9 @@ public:
     EventVector getAllEvents() const {
         return m_events.getAllEvents();
     }
+    EventSeries getEventSnapshot() const {
+        return m_events; // cheap: shares chunks until they are edited
+    }
     EventVector getEventsSpanning(sv_frame_t f, sv_frame_t duration) const {
         return m_events.getEventsSpanning(f, duration);
     }
@@ -175,6 +180,27 @@ public:
     EventVector getEventsStartingAt(sv_frame_t f) const {
         return m_events.getEventsStartingAt(f);
     }
+
+    /**
+     * Visit events in place, without copying them; see the
+     * corresponding EventSeries methods.
+     */
+    bool visitEventsSpanning(sv_frame_t f, sv_frame_t duration,
+                             const EventSeries::EventVisitor &visitor) const {
+        return m_events.visitEventsSpanning(f, duration, visitor);
+    }
+    bool visitEventsCovering(sv_frame_t f,
+                             const EventSeries::EventVisitor &visitor) const {
+        return m_events.visitEventsCovering(f, visitor);
+    }
+    bool visitEventsWithin(sv_frame_t f, sv_frame_t duration,
+                           const EventSeries::EventVisitor &visitor) const {
+        return m_events.visitEventsWithin(f, duration, visitor);
+    }
+    bool visitEventsStartingWithin(sv_frame_t f, sv_frame_t duration,
+                                   const EventSeries::EventVisitor &visitor) const {
+        return m_events.visitEventsStartingWithin(f, duration, visitor);
+    }
     bool getNearestEventMatching(sv_frame_t startSearchAt,
                                  std::function<bool(Event)> predicate,
                                  EventSeries::Direction direction,
@@ -182,6 +208,27 @@ public:
         return m_events.getNearestEventMatching
             (startSearchAt, predicate, direction, found);
     }
+    bool getNearestEventWithLabel(sv_frame_t startSearchAt,
+                                  QString label,
+                                  EventSeries::Direction direction,
+                                  Event &found) const {
+        return m_events.getNearestEventWithLabel
+            (startSearchAt, label, direction, found);
+    }
+    bool getNearestEventWithValueAbove(sv_frame_t startSearchAt,
+                                       float threshold,
+                                       EventSeries::Direction direction,
+                                       Event &found) const {
+        return m_events.getNearestEventWithValueAbove
+            (startSearchAt, threshold, direction, found);
+    }
+    bool getNearestEventWithValueBelow(sv_frame_t startSearchAt,
+                                       float threshold,
+                                       EventSeries::Direction direction,
+                                       Event &found) const {
+        return m_events.getNearestEventWithValueBelow
+            (startSearchAt, threshold, direction, found);
+    }
     
     /**
      * Editing methods.
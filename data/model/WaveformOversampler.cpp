@@ -15,9 +15,12 @@
 #include "WaveformOversampler.h"
 
 #include "base/Profiler.h"
+#include "base/NumericKernels.h"
 
 #include "data/model/DenseTimeValueModel.h"
 
+#include <algorithm>
+
 floatvec_t
 WaveformOversampler::getOversampledData(const DenseTimeValueModel &source,
                                         int channel,
@@ -90,12 +93,11 @@ WaveformOversampler::getFixedRatioData(const DenseTimeValueModel &source,
         float v = sourceData[i - i0];
         sv_frame_t outOffset =
             (i - sourceStartFrame) * m_filterRatio - filterTailOut;
-        for (sv_frame_t j = 0; j < filterLength; ++j) {
-            sv_frame_t outIndex = outOffset + j;
-            if (outIndex < 0 || outIndex >= targetFrameCount) {
-                continue;
-            }
-            oversampled[outIndex] += v * m_filter[j];
+        sv_frame_t j0 = std::max(sv_frame_t(0), -outOffset);
+        sv_frame_t j1 = std::min(filterLength, targetFrameCount - outOffset);
+        if (j1 > j0) {
+            NumericKernels::addScaled(oversampled.data() + outOffset + j0,
+                                      m_filter.data() + j0, v, j1 - j0);
         }
     }
 
@@ -18,6 +18,7 @@
 #include "ReadOnlyWaveFileModel.h"
 
 #include "base/TempDirectory.h"
+#include "base/StorageAdviser.h"
 #include "base/Exceptions.h"
 #include "base/PlayParameterRepository.h"
 
@@ -40,9 +41,12 @@ const int WritableWaveFileModel::PROPORTION_UNKNOWN = -1;
 WritableWaveFileModel::WritableWaveFileModel(QString path,
                                              sv_samplerate_t sampleRate,
                                              int channels,
-                                             Normalisation norm) :
+                                             Normalisation norm,
+                                             sv_frame_t expectedFrames) :
     m_model(nullptr),
     m_temporaryWriter(nullptr),
+    m_temporaryTier(StorageAdviser::BulkDiscTier),
+    m_temporaryTierKB(0),
     m_targetWriter(nullptr),
     m_reader(nullptr),
     m_normalisation(norm),
@@ -52,14 +56,17 @@ WritableWaveFileModel::WritableWaveFileModel(QString path,
     m_startFrame(0),
     m_proportion(PROPORTION_UNKNOWN)
 {
-    init(path);
+    init(path, expectedFrames);
 }
 
 WritableWaveFileModel::WritableWaveFileModel(sv_samplerate_t sampleRate,
                                              int channels,
-                                             Normalisation norm) :
+                                             Normalisation norm,
+                                             sv_frame_t expectedFrames) :
     m_model(nullptr),
     m_temporaryWriter(nullptr),
+    m_temporaryTier(StorageAdviser::BulkDiscTier),
+    m_temporaryTierKB(0),
     m_targetWriter(nullptr),
     m_reader(nullptr),
     m_normalisation(norm),
@@ -69,13 +76,15 @@ WritableWaveFileModel::WritableWaveFileModel(sv_samplerate_t sampleRate,
     m_startFrame(0),
     m_proportion(PROPORTION_UNKNOWN)
 {
-    init();
+    init("", expectedFrames);
 }
 
 WritableWaveFileModel::WritableWaveFileModel(sv_samplerate_t sampleRate,
                                              int channels) :
     m_model(nullptr),
     m_temporaryWriter(nullptr),
+    m_temporaryTier(StorageAdviser::BulkDiscTier),
+    m_temporaryTierKB(0),
     m_targetWriter(nullptr),
     m_reader(nullptr),
     m_normalisation(Normalisation::None),
@@ -89,7 +98,7 @@ WritableWaveFileModel::WritableWaveFileModel(sv_samplerate_t sampleRate,
 }
 
 void
-WritableWaveFileModel::init(QString path)
+WritableWaveFileModel::init(QString path, sv_frame_t expectedFrames)
 {
     if (path.isEmpty()) {
         try {
@@ -126,11 +135,32 @@ WritableWaveFileModel::init(QString path)
     if (m_normalisation != Normalisation::None) {
 
         // Temp dir is exclusive to this run of the application, so
-        // the filename only needs to be unique within that
-        QDir dir(TempDirectory::getInstance()->getPath());
+        // the filename only needs to be unique within that. This
+        // file is only an intermediate, so it goes in whichever tier
+        // is advised for temporary caches, given its expected size
+        // in float samples. It is always a file, so a placement in
+        // memory means the fastest disc available
+        size_t kb = 0;
+        if (expectedFrames > 0) {
+            kb = size_t(expectedFrames * m_channels * sizeof(float) / 1024);
+        }
+        m_temporaryTier = StorageAdviser::recommendTier
+            (StorageAdviser::TemporaryCache, kb);
+        if (m_temporaryTier == StorageAdviser::MemoryTier) {
+            m_temporaryTier = StorageAdviser::FastDiscTier;
+        }
+        QDir dir(TempDirectory::getInstance()->getPath
+                 (m_temporaryTier == StorageAdviser::FastDiscTier ?
+                  TempDirectory::FastDisc : TempDirectory::DefaultDisc));
         m_temporaryPath = dir.filePath(QString("prenorm_%1.wav")
                                        .arg(getId().untyped));
 
+        m_temporaryTierKB = kb;
+        if (m_temporaryTierKB > 0) {
+            StorageAdviser::notifyTierAllocation
+                (m_temporaryTier, m_temporaryTierKB);
+        }
+
         m_temporaryWriter = new WavFileWriter
             (m_temporaryPath, m_sampleRate, m_channels,
              WavFileWriter::WriteToTarget);
@@ -176,6 +206,10 @@ WritableWaveFileModel::~WritableWaveFileModel()
     delete m_targetWriter;
     delete m_temporaryWriter;
     delete m_reader;
+
+    if (m_temporaryTierKB > 0) {
+        StorageAdviser::notifyTierRelease(m_temporaryTier, m_temporaryTierKB);
+    }
 }
 
 void
@@ -307,6 +341,11 @@ WritableWaveFileModel::normaliseToTarget()
     delete m_temporaryWriter;
     m_temporaryWriter = nullptr;
     QFile::remove(m_temporaryPath);
+
+    if (m_temporaryTierKB > 0) {
+        StorageAdviser::notifyTierRelease(m_temporaryTier, m_temporaryTierKB);
+        m_temporaryTierKB = 0;
+    }
 }
 
 sv_frame_t
@@ -323,6 +362,14 @@ WritableWaveFileModel::getData(int channel, sv_frame_t start, sv_frame_t count)
     return m_model->getData(channel, start, count);
 }
 
+floatvec_t
+WritableWaveFileModel::getMixedData(sv_frame_t start, sv_frame_t count,
+                                    float gain) const
+{
+    if (!m_model || m_model->getChannelCount() == 0) return {};
+    return m_model->getMixedData(start, count, gain);
+}
+
 vector<floatvec_t>
 WritableWaveFileModel::getMultiChannelData(int fromchannel, int tochannel,
                                            sv_frame_t start, sv_frame_t count) const
@@ -348,6 +395,18 @@ WritableWaveFileModel::getSummaries(int channel, sv_frame_t start, sv_frame_t co
     m_model->getSummaries(channel, start, count, ranges, blockSize);
 }
 
+void
+WritableWaveFileModel::getMultiChannelSummaries(int fromchannel, int tochannel,
+                                                sv_frame_t start, sv_frame_t count,
+                                                vector<RangeBlock> &ranges,
+                                                int &blockSize) const
+{
+    ranges.clear();
+    if (!m_model || m_model->getChannelCount() == 0) return;
+    m_model->getMultiChannelSummaries(fromchannel, tochannel, start, count,
+                                      ranges, blockSize);
+}
+
 WritableWaveFileModel::Range
 WritableWaveFileModel::getSummary(int channel, sv_frame_t start, sv_frame_t count) const
 {
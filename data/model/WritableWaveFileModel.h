@@ -20,6 +20,8 @@
 #include "ReadOnlyWaveFileModel.h"
 #include "PowerOfSqrtTwoZoomConstraint.h"
 
+#include "base/StorageAdviser.h"
+
 class WavFileWriter;
 class WavFileReader;
 
@@ -42,11 +44,16 @@ public:
      * will require an additional pass and temporary file, and no
      * samples will be available to read until after writeComplete()
      * has returned.
+     *
+     * If the number of frames to be written is known or can be
+     * estimated, pass it as expectedFrames; it is used to choose
+     * where to put the temporary file needed for normalisation.
      */
     WritableWaveFileModel(QString path,
                           sv_samplerate_t sampleRate,
                           int channels,
-                          Normalisation normalisation);
+                          Normalisation normalisation,
+                          sv_frame_t expectedFrames = 0);
     
     /**
      * Create a WritableWaveFileModel of the given sample rate and
@@ -60,10 +67,15 @@ public:
      * will require an additional pass and temporary file, and no
      * samples will be available to read until after writeComplete()
      * has returned.
+     *
+     * If the number of frames to be written is known or can be
+     * estimated, pass it as expectedFrames; it is used to choose
+     * where to put the temporary file needed for normalisation.
      */
     WritableWaveFileModel(sv_samplerate_t sampleRate,
                           int channels,
-                          Normalisation normalisation);
+                          Normalisation normalisation,
+                          sv_frame_t expectedFrames = 0);
 
     /**
      * Create a WritableWaveFileModel of the given sample rate and
@@ -181,6 +193,8 @@ public:
 
     floatvec_t getData(int channel, sv_frame_t start, sv_frame_t count) const override;
 
+    floatvec_t getMixedData(sv_frame_t start, sv_frame_t count, float gain) const override;
+
     std::vector<floatvec_t> getMultiChannelData(int fromchannel, int tochannel, sv_frame_t start, sv_frame_t count) const override;
 
     int getSummaryBlockSize(int desired) const override;
@@ -188,6 +202,11 @@ public:
     void getSummaries(int channel, sv_frame_t start, sv_frame_t count,
                               RangeBlock &ranges, int &blockSize) const override;
 
+    void getMultiChannelSummaries(int fromchannel, int tochannel,
+                                  sv_frame_t start, sv_frame_t count,
+                                  std::vector<RangeBlock> &ranges,
+                                  int &blockSize) const override;
+
     Range getSummary(int channel, sv_frame_t start, sv_frame_t count) const override;
 
     QString getTypeName() const override { return tr("Writable Wave File"); }
@@ -212,6 +231,8 @@ protected:
      */
     WavFileWriter *m_temporaryWriter;
     QString m_temporaryPath;
+    StorageAdviser::StorageTier m_temporaryTier;
+    size_t m_temporaryTierKB; // amount notified to StorageAdviser
 
     /** When not normalising, this writer is used to write verbatim
      *  samples direct to the target file. When normalising, it is
@@ -232,7 +253,7 @@ protected:
     int m_proportion;
 
 private:
-    void init(QString path = "");
+    void init(QString path = "", sv_frame_t expectedFrames = 0);
     void normaliseToTarget();
 };
 
@@ -0,0 +1,157 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef TEST_DECIMATED_TIME_VALUE_MODEL_H
+#define TEST_DECIMATED_TIME_VALUE_MODEL_H
+
+#include "../DecimatedTimeValueModel.h"
+
+#include <QObject>
+#include <QtTest>
+
+#include <cmath>
+#include <vector>
+
+using namespace std;
+
+class TestDecimatedTimeValueModel : public QObject
+{
+    Q_OBJECT
+
+    // Brute-force summary of values[from, to), for comparison
+    static DecimatedTimeValueModel::Range summarise(const vector<float> &v,
+                                                    sv_frame_t from,
+                                                    sv_frame_t to) {
+        DecimatedTimeValueModel::Range r;
+        for (sv_frame_t i = from; i < to && i < sv_frame_t(v.size()); ++i) {
+            if (!std::isnan(v[i])) r.sample(v[i]);
+        }
+        return r;
+    }
+
+private slots:
+    void empty() {
+        DecimatedTimeValueModel m(100, 10, false);
+        QCOMPARE(m.getValueCount(), sv_frame_t(0));
+        QCOMPARE(m.getStartFrame(), sv_frame_t(0));
+        QCOMPARE(m.getEndFrame(), sv_frame_t(0));
+        QCOMPARE(m.getSampleRate(), 100.0);
+        QCOMPARE(m.getResolution(), 10);
+        QVERIFY(std::isnan(m.getValue(0)));
+        QCOMPARE(m.getValues(0, 10).size(), size_t(0));
+        DecimatedTimeValueModel::RangeBlock ranges;
+        m.getSummaries(0, 100, ranges, 10);
+        QCOMPARE(ranges.size(), size_t(0));
+    }
+
+    void values() {
+        // Enough values to span several chunks and levels
+        DecimatedTimeValueModel m(44100, 4, false);
+        const sv_frame_t n = 200000;
+        for (sv_frame_t i = 0; i < n; ++i) {
+            m.setValue(i, float(i % 1000) - 500.f);
+        }
+        QCOMPARE(m.getValueCount(), n);
+        QCOMPARE(m.getEndFrame(), n * 4);
+        QCOMPARE(m.getValueMinimum(), -500.f);
+        QCOMPARE(m.getValueMaximum(), 499.f);
+        QCOMPARE(m.getValue(65535), float(65535 % 1000) - 500.f);
+        QCOMPARE(m.getValue(65536), float(65536 % 1000) - 500.f);
+        auto v = m.getValues(65530, 10);
+        QCOMPARE(v.size(), size_t(10));
+        for (sv_frame_t i = 0; i < 10; ++i) {
+            QCOMPARE(v[i], float((65530 + i) % 1000) - 500.f);
+        }
+        v = m.getValues(n - 5, 10);
+        QCOMPARE(v.size(), size_t(5));
+    }
+
+    void gaps() {
+        DecimatedTimeValueModel m(100, 10, false);
+        m.setValue(0, 1.f);
+        m.setValue(3, 2.f);
+        QCOMPARE(m.getValueCount(), sv_frame_t(4));
+        QVERIFY(std::isnan(m.getValue(1)));
+        QVERIFY(std::isnan(m.getValue(2)));
+        auto r = m.getSummary(10, 20);
+        QCOMPARE(r.min(), 0.f);
+        QCOMPARE(r.max(), 0.f);
+        r = m.getSummary(0, 40);
+        QCOMPARE(r.min(), 1.f);
+        QCOMPARE(r.max(), 2.f);
+        QCOMPARE(r.absmean(), 1.5f);
+    }
+
+    void summaries() {
+        DecimatedTimeValueModel m(100, 3, false);
+        vector<float> v;
+        srand(42);
+        for (int i = 0; i < 50000; ++i) {
+            float value = float(rand() % 2001 - 1000) / 10.f;
+            if (i % 97 == 0) value = NAN;
+            v.push_back(value);
+            m.setValue(i, value);
+        }
+        // Overwrite a few, which must update all levels
+        for (int i = 0; i < 100; ++i) {
+            int index = rand() % int(v.size());
+            v[index] = 5000.f + float(i);
+            m.setValue(index, v[index]);
+        }
+        for (int i = 0; i < 500; ++i) {
+            sv_frame_t a = rand() % int(v.size()), b = rand() % int(v.size());
+            if (a > b) std::swap(a, b);
+            auto expected = summarise(v, a, b + 1);
+            auto actual = m.getSummary(a * 3, (b - a + 1) * 3);
+            QCOMPARE(actual.min(), expected.min());
+            QCOMPARE(actual.max(), expected.max());
+        }
+        DecimatedTimeValueModel::RangeBlock ranges;
+        m.getSummaries(0, 3000, ranges, 300);
+        QCOMPARE(ranges.size(), size_t(10));
+        for (int i = 0; i < 10; ++i) {
+            auto expected = summarise(v, i * 100, (i + 1) * 100);
+            QCOMPARE(ranges[i].min(), expected.min());
+            QCOMPARE(ranges[i].max(), expected.max());
+        }
+        // Blocks smaller than the resolution get the covering value
+        m.getSummaries(3, 3, ranges, 1);
+        QCOMPARE(ranges.size(), size_t(3));
+        for (int i = 0; i < 3; ++i) {
+            QCOMPARE(ranges[i].min(), v[1]);
+            QCOMPARE(ranges[i].max(), v[1]);
+        }
+    }
+
+    void exportRows() {
+        DecimatedTimeValueModel m(100, 10, false);
+        m.setValue(0, 1.f);
+        m.setValue(2, 2.5f);
+        auto headers = m.getStringExportHeaders(DataExportWriteTimeInFrames);
+        QCOMPARE(headers, QVector<QString>({ "FRAME", "VALUE", "LABEL" }));
+        auto rows = m.toStringExportRows(DataExportWriteTimeInFrames, 0, 30);
+        QCOMPARE(rows.size(), 2);
+        QCOMPARE(rows[0], QVector<QString>({ "0", "1" }));
+        QCOMPARE(rows[1], QVector<QString>({ "20", "2.5" }));
+        rows = m.toStringExportRows(DataExportWriteTimeInFrames |
+                                    DataExportFillGaps, 0, 30);
+        QCOMPARE(rows.size(), 3);
+        QCOMPARE(rows[1], QVector<QString>({ "10", "0" }));
+        rows = m.toStringExportRows(DataExportWriteTimeInFrames, 5, 20);
+        QCOMPARE(rows.size(), 1);
+        QCOMPARE(rows[0], QVector<QString>({ "20", "2.5" }));
+    }
+};
+
+#endif
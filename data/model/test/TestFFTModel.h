@@ -16,6 +16,7 @@
 #define TEST_FFT_MODEL_H
 
 #include "../FFTModel.h"
+#include "../FFTFrequencyModel.h"
 
 #include "MockWaveModel.h"
 
@@ -268,7 +269,205 @@ private slots:
              { { {}, {}, {}, {}, {} } }, 7);
         releaseMock(mwm);
     }
-    
+
+    void sine_padded_hann() {
+        // With 4x zero padding or more the model skips the padding
+        // when transforming; compare against a direct DFT of the
+        // padded and FFT-shifted frame
+        auto mwm = makeMock({ Sine }, 64, 8);
+        auto model = ModelById::getAs<DenseTimeValueModel>(mwm);
+        Window<double> window(HanningWindow, 16);
+        for (int fftSize : { 64, 80 }) {
+            FFTModel fftm(mwm, 0, HanningWindow, 16, 8, fftSize);
+            int hs1 = fftSize/2 + 1;
+            QCOMPARE(fftm.getHeight(), hs1);
+            for (int x = 1; x < 8; ++x) {
+                auto data = model->getData(0, x * 8 - 8, 16);
+                data.resize(16, 0.f);
+                vector<double> frame(data.begin(), data.end());
+                window.cut(frame.data());
+                for (int k = 0; k < hs1; ++k) {
+                    complex<double> expected;
+                    for (int i = 0; i < 16; ++i) {
+                        expected += frame[i] *
+                            polar(1.0, (-2.0 * M_PI * k * (i - 8)) / fftSize);
+                    }
+                    float re = 0.f, im = 0.f;
+                    fftm.getValuesAt(x, k, re, im);
+                    QVERIFY(fabs(re - expected.real()) < 1e-5);
+                    QVERIFY(fabs(im - expected.imag()) < 1e-5);
+                }
+            }
+        }
+        releaseMock(mwm);
+    }
+
+    void sine_zoom_band() {
+        // The mock sine has a period of 8 samples, i.e. 5512.5 Hz at
+        // 44100. A zoomed model over 5-6kHz should be decimated, and
+        // should report the same bins as the full-band model does
+        auto mwm = makeMock({ Sine }, 8192, 1024);
+        FFTModel full(mwm, 0, HanningWindow, 2048, 1024, 2048);
+        FFTModel zoomed(mwm, 0, HanningWindow, 2048, 1024, 2048);
+        zoomed.setZoomBand(5000.0, 6000.0);
+        QVERIFY(zoomed.isZoomed());
+        QVERIFY(zoomed.getZoomDecimation() > 1);
+        int offset = zoomed.getBinOffset();
+        QCOMPARE(offset, int(floor(5000.0 * 2048 / 44100)));
+        QCOMPARE(zoomed.getHeight(), int(ceil(6000.0 * 2048 / 44100)) - offset + 1);
+        QCOMPARE(zoomed.getBinValue(0), full.getBinValue(offset));
+        for (int x = 0; x < 6; ++x) {
+            for (int y = 0; y < zoomed.getHeight(); ++y) {
+                float zre = 0.f, zim = 0.f, fre = 0.f, fim = 0.f;
+                zoomed.getValuesAt(x, y, zre, zim);
+                full.getValuesAt(x, y + offset, fre, fim);
+                // relative to a peak magnitude of 512
+                QVERIFY(fabsf(zre - fre) < 0.01f);
+                QVERIFY(fabsf(zim - fim) < 0.01f);
+            }
+        }
+        zoomed.setZoomBand(0.0, 0.0);
+        QVERIFY(!zoomed.isZoomed());
+        QCOMPARE(zoomed.getHeight(), full.getHeight());
+        releaseMock(mwm);
+    }
+
+    void sine_zoom_resolution() {
+        // Zooming a 1024-point model with a finer resolution should
+        // give the bins of an 8192-point model, whose window is
+        // scaled up to match, without the zoom depending on the
+        // model's own FFT size
+        auto mwm = makeMock({ Sine }, 32768, 4096);
+        FFTModel full(mwm, 0, HanningWindow, 8192, 512, 8192);
+        FFTModel zoomed(mwm, 0, HanningWindow, 1024, 512, 1024);
+        zoomed.setZoomBand(5000.0, 6000.0, 5.4);
+        QVERIFY(zoomed.isZoomed());
+        QVERIFY(zoomed.getZoomDecimation() > 1);
+        QCOMPARE(zoomed.getZoomRequestedResolution(), 5.4);
+        QCOMPARE(zoomed.getZoomResolution(), 44100.0 / 8192);
+        int offset = zoomed.getBinOffset();
+        QCOMPARE(offset, int(floor(5000.0 * 8192 / 44100)));
+        QCOMPARE(zoomed.getHeight(), int(ceil(6000.0 * 8192 / 44100)) - offset + 1);
+        QCOMPARE(zoomed.getBinValue(0), full.getBinValue(offset));
+        QCOMPARE(zoomed.getWidth(), full.getWidth());
+        for (int x = 4; x < 12; ++x) {
+            for (int y = 0; y < zoomed.getHeight(); ++y) {
+                float zre = 0.f, zim = 0.f, fre = 0.f, fim = 0.f;
+                zoomed.getValuesAt(x, y, zre, zim);
+                full.getValuesAt(x, y + offset, fre, fim);
+                // relative to a peak magnitude of 2048
+                QVERIFY(fabsf(zre - fre) < 0.05f);
+                QVERIFY(fabsf(zim - fim) < 0.05f);
+            }
+        }
+        // The sine sits exactly on bin 1024 of the longer transform
+        double frequency = 0.0;
+        QVERIFY(zoomed.estimateStableFrequency(8, 1024 - offset, frequency));
+        QVERIFY(fabs(frequency - 5512.5) < 0.5);
+        releaseMock(mwm);
+    }
+
+    void columns_batch() {
+        // getColumns should agree with getColumn in both layouts,
+        // including zeros for columns and bins out of range
+        auto mwm = makeMock({ Sine, Cosine }, 256, 16);
+        FFTModel fftm(mwm, 0, HanningWindow, 32, 16, 32);
+        int w = fftm.getWidth(), h = fftm.getHeight();
+        int x0 = -2, count = w + 4, bin0 = 3, binCount = h;
+        vector<float> cm(count * binCount, -1.f), rm(count * binCount, -1.f);
+        fftm.getColumns(x0, count, bin0, binCount, cm.data(),
+                        DenseThreeDimensionalModel::ColumnMajor);
+        fftm.getColumns(x0, count, bin0, binCount, rm.data(),
+                        DenseThreeDimensionalModel::RowMajor);
+        for (int i = 0; i < count; ++i) {
+            int x = x0 + i;
+            auto col = (x >= 0 && x < w) ?
+                fftm.getColumn(x) : DenseThreeDimensionalModel::Column();
+            for (int j = 0; j < binCount; ++j) {
+                int y = bin0 + j;
+                float expected = (y < int(col.size()) ? col[y] : 0.f);
+                QCOMPARE(cm[i * binCount + j], expected);
+                QCOMPARE(rm[j * count + i], expected);
+            }
+        }
+        releaseMock(mwm);
+    }
+
+    void instantaneous_frequency() {
+        // The mock sine has a period of 8 samples, i.e. 5512.5 Hz at
+        // 44100, exactly at bin 32 of a 256-point FFT. Bins either
+        // side of it should report that frequency, and every bin
+        // should agree with the single-bin estimate
+        auto mwm = makeMock({ Sine }, 4096, 128);
+        auto fftId = ModelById::add
+            (std::make_shared<FFTModel>(mwm, 0, HanningWindow, 256, 64, 256));
+        auto fftm = ModelById::getAs<FFTModel>(fftId);
+        FFTFrequencyModel ifm(fftId);
+        QCOMPARE(ifm.getWidth(), fftm->getWidth());
+        QCOMPARE(ifm.getHeight(), fftm->getHeight());
+        int x = 20;
+        for (int y = 31; y <= 33; ++y) {
+            QVERIFY(fabsf(ifm.getValueAt(x, y) - 5512.5f) < 1.f);
+        }
+        for (int y = 0; y < fftm->getHeight(); ++y) {
+            double expected = 0.0;
+            QVERIFY(fftm->estimateStableFrequency(x, y, expected));
+            QVERIFY(fabs(ifm.getValueAt(x, y) - expected) <
+                    1e-3 * fabs(expected) + 1e-3);
+        }
+        auto column = ifm.getColumn(x);
+        QCOMPARE(int(column.size()), fftm->getHeight());
+        QCOMPARE(column[32], ifm.getValueAt(x, 32));
+
+        // Requests for bins outside the column are refused, in
+        // columns with or without a successor
+        int h = fftm->getHeight();
+        vector<float> frequencies(h + 2, 0.f);
+        for (int cx: { x, fftm->getWidth() - 1 }) {
+            QVERIFY(fftm->getInstantaneousFrequenciesAt
+                    (cx, frequencies.data(), 0, h));
+            QVERIFY(fftm->getInstantaneousFrequenciesAt
+                    (cx, frequencies.data(), h - 2, 0));
+            QVERIFY(!fftm->getInstantaneousFrequenciesAt
+                    (cx, frequencies.data(), 0, h + 1));
+            QVERIFY(!fftm->getInstantaneousFrequenciesAt
+                    (cx, frequencies.data(), h - 2, 3));
+            QVERIFY(!fftm->getInstantaneousFrequenciesAt
+                    (cx, frequencies.data(), -1, 2));
+            QVERIFY(!fftm->getInstantaneousFrequenciesAt
+                    (cx, frequencies.data(), h + 1, 0));
+        }
+
+        // Changing the source's bin layout must not leave columns
+        // calculated for the old layout in the cache
+        auto checkAgainstSource = [&]() {
+            QCOMPARE(ifm.getHeight(), fftm->getHeight());
+            int height = fftm->getHeight();
+            vector<float> expected(height, 0.f);
+            QVERIFY(fftm->getInstantaneousFrequenciesAt
+                    (x, expected.data(), 0, height));
+            auto c = ifm.getColumn(x);
+            QCOMPARE(int(c.size()), height);
+            for (int y = 0; y < height; ++y) {
+                QCOMPARE(c[y], expected[y]);
+                QCOMPARE(ifm.getValueAt(x, y), expected[y]);
+            }
+        };
+        fftm->setZoomBand(4000.0, 7000.0);
+        checkAgainstSource();
+        fftm->setZoomBand(5000.0, 6000.0, 20.0);
+        checkAgainstSource();
+        fftm->setZoomBand(0.0, 0.0);
+        fftm->setMaximumFrequency(8000.0);
+        checkAgainstSource();
+        fftm->setMaximumFrequency(0.0);
+        checkAgainstSource();
+        QCOMPARE(ifm.getColumn(x), column);
+
+        ModelById::release(fftId);
+        releaseMock(mwm);
+    }
+
 };
 
 #endif
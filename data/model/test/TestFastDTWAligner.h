@@ -0,0 +1,106 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+    
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef TEST_FAST_DTW_ALIGNER_H
+#define TEST_FAST_DTW_ALIGNER_H
+
+#include "../FastDTWAligner.h"
+
+#include <QObject>
+#include <QtTest>
+
+#include <cmath>
+
+class TestFastDTWAligner : public QObject
+{
+    Q_OBJECT
+
+private:
+    typedef FastDTWAligner::FeatureSequence FeatureSequence;
+    typedef FastDTWAligner::IndexPath IndexPath;
+
+    // A deterministic sequence with no repeats: each element is a
+    // different mixture of a few slow sinusoids
+    FeatureSequence makeSequence(int n) {
+        FeatureSequence s(4);
+        for (int i = 0; i < n; ++i) {
+            s.values.push_back(float(sin(i * 0.05)));
+            s.values.push_back(float(cos(i * 0.031)));
+            s.values.push_back(float(sin(i * 0.017 + 1.0)));
+            s.values.push_back(float(cos(i * 0.0071)));
+        }
+        return s;
+    }
+
+    void checkWellFormed(const IndexPath &path, int n, int m) {
+        QVERIFY(!path.empty());
+        QCOMPARE(path.front().first, 0);
+        QCOMPARE(path.front().second, 0);
+        QCOMPARE(path.back().first, n - 1);
+        QCOMPARE(path.back().second, m - 1);
+        for (int k = 1; in_range_for(path, k); ++k) {
+            int di = path[k].first - path[k-1].first;
+            int dj = path[k].second - path[k-1].second;
+            QVERIFY(di == 0 || di == 1);
+            QVERIFY(dj == 0 || dj == 1);
+            QVERIFY(di + dj > 0);
+        }
+    }
+
+private slots:
+    void empty() {
+        FeatureSequence a(4), b = makeSequence(10);
+        QVERIFY(FastDTWAligner::alignSequences(a, b, 4).empty());
+        QVERIFY(FastDTWAligner::alignSequences(b, a, 4).empty());
+    }
+
+    void identity() {
+        FeatureSequence a = makeSequence(1000);
+        IndexPath path = FastDTWAligner::alignSequences(a, a, 4);
+        checkWellFormed(path, 1000, 1000);
+        QCOMPARE(int(path.size()), 1000);
+        for (const auto &p: path) {
+            QCOMPARE(p.first, p.second);
+        }
+    }
+
+    void warped() {
+        // b runs slower than a for its first half and faster for its
+        // second; the path should recover the warp
+        FeatureSequence a = makeSequence(3000);
+        FeatureSequence b(a.dimension);
+        std::vector<int> warp;
+        double t = 0.0;
+        while (t < 2999.0) {
+            int i = int(t);
+            warp.push_back(i);
+            b.values.insert(b.values.end(), a.at(i), a.at(i) + a.dimension);
+            t += (i < 1500 ? 0.8 : 1.3);
+        }
+        int m = b.size();
+        IndexPath path = FastDTWAligner::alignSequences(a, b, 8);
+        checkWellFormed(path, 3000, m);
+        for (const auto &p: path) {
+            QVERIFY(abs(p.first - warp[p.second]) <= 2);
+        }
+    }
+
+    void abandoned() {
+        FeatureSequence a = makeSequence(1000);
+        std::atomic<bool> abandoned(true);
+        QVERIFY(FastDTWAligner::alignSequences(a, a, 4, &abandoned).empty());
+    }
+};
+
+#endif
@@ -21,6 +21,8 @@
 #include "../Path.h"
 #include "../ImageModel.h"
 
+#include "base/NoteCursor.h"
+
 #include <QObject>
 #include <QtTest>
 
@@ -300,6 +302,48 @@ private slots:
         }
         QCOMPARE(xml, expected);
     }
+
+    void note_cursor() {
+        NoteModel m(100, 10, false);
+        for (int i = 0; i < 1000; ++i) {
+            m.add(Event(i * 5, float(60 + i % 12), 20, 0.8f, ""));
+        }
+
+        // Successive blocks get the same notes as the model returns
+        // for them, including after edits and seeks
+        auto compare = [&](NoteCursor &cursor, sv_frame_t f, sv_frame_t d) {
+            NoteList expected = m.getNotesStartingWithin(f, d);
+            NoteList obtained;
+            cursor.getNotesStartingWithin(f, d, obtained);
+            QCOMPARE(obtained.size(), expected.size());
+            for (int i = 0; in_range_for(expected, i); ++i) {
+                QCOMPARE(obtained[i].start, expected[i].start);
+                QCOMPARE(obtained[i].duration, expected[i].duration);
+                QCOMPARE(obtained[i].midiPitch, expected[i].midiPitch);
+                QCOMPARE(obtained[i].isMidiPitchQuantized,
+                         expected[i].isMidiPitchQuantized);
+            }
+        };
+
+        NoteCursor cursor(&m);
+        for (sv_frame_t f = 0; f < 2000; f += 7) {
+            compare(cursor, f, 7);
+        }
+        m.add(Event(2003, 70.f, 20, 0.8f, ""));
+        m.remove(Event(2010, float(60 + 402 % 12), 20, 0.8f, ""));
+        for (sv_frame_t f = 2000; f < 3000; f += 7) {
+            compare(cursor, f, 7);
+        }
+        m.setScaleUnits("Hz");
+        compare(cursor, 3000, 100);
+        compare(cursor, 500, 100);
+
+        NoteList active;
+        cursor.getNotesActiveAt(1001, active);
+        QCOMPARE(active.size(), m.getNotesActiveAt(1001).size());
+        compare(cursor, 1001, 50);
+        compare(cursor, 1051, 50);
+    }
 };
 
 #endif
@@ -0,0 +1,255 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef TEST_WAVE_MODEL_SUMMARIES_H
+#define TEST_WAVE_MODEL_SUMMARIES_H
+
+#include "../ReadOnlyWaveFileModel.h"
+#include "../WritableWaveFileModel.h"
+#include "../AggregateWaveModel.h"
+
+#include "data/fileio/WavFileWriter.h"
+#include "data/fileio/FileSource.h"
+
+#include <QObject>
+#include <QtTest>
+#include <QTemporaryDir>
+
+#include <cmath>
+#include <vector>
+
+using namespace std;
+
+class TestWaveModelSummaries : public QObject
+{
+    Q_OBJECT
+
+    typedef RangeSummarisableTimeValueModel::Range Range;
+    typedef RangeSummarisableTimeValueModel::RangeBlock RangeBlock;
+
+    static const int channels = 3;
+    static const int frames = 10000;
+
+    QTemporaryDir m_dir;
+    ModelId m_model;
+
+    // Channel c is a sinusoid with a channel-specific frequency,
+    // amplitude and DC offset, so that no two channels share a
+    // summary
+    static vector<vector<float>> generate() {
+        vector<vector<float>> data(channels, vector<float>(frames));
+        for (int c = 0; c < channels; ++c) {
+            for (int i = 0; i < frames; ++i) {
+                data[c][i] = float(0.2 * c - 0.2 +
+                                   (0.7 - 0.2 * c) *
+                                   sin(2.0 * M_PI * i * (c + 1) / 441.0));
+            }
+        }
+        return data;
+    }
+
+    // Brute-force summary of channel from getData, for comparison
+    static RangeBlock summarise(const RangeSummarisableTimeValueModel &m,
+                                int channel, sv_frame_t start,
+                                sv_frame_t count, int blockSize) {
+        RangeBlock ranges;
+        auto data = m.getData(channel, start, count);
+        for (sv_frame_t i0 = 0; i0 < sv_frame_t(data.size()); i0 += blockSize) {
+            sv_frame_t got = min(sv_frame_t(blockSize),
+                                 sv_frame_t(data.size()) - i0);
+            float mn = data[i0], mx = data[i0], total = 0.f;
+            for (sv_frame_t i = 0; i < got; ++i) {
+                mn = min(mn, data[i0 + i]);
+                mx = max(mx, data[i0 + i]);
+                total += fabsf(data[i0 + i]);
+            }
+            ranges.push_back(Range(mn, mx, total / float(got)));
+        }
+        return ranges;
+    }
+
+    static void compareRanges(const RangeBlock &actual,
+                              const RangeBlock &expected,
+                              float absmeanTolerance) {
+        QCOMPARE(actual.size(), expected.size());
+        for (size_t i = 0; i < actual.size(); ++i) {
+            QCOMPARE(actual[i].min(), expected[i].min());
+            QCOMPARE(actual[i].max(), expected[i].max());
+            QVERIFY(fabsf(actual[i].absmean() - expected[i].absmean()) <=
+                    absmeanTolerance);
+        }
+    }
+
+    // Compare getMultiChannelSummaries for a channel range against
+    // getSummaries for each channel in turn
+    static void compareWithSingleChannel(const RangeSummarisableTimeValueModel &m,
+                                         int fromchannel, int tochannel,
+                                         sv_frame_t start, sv_frame_t count,
+                                         int blockSize) {
+        vector<RangeBlock> multi;
+        int multiBlockSize = blockSize;
+        m.getMultiChannelSummaries(fromchannel, tochannel, start, count,
+                                   multi, multiBlockSize);
+        QCOMPARE(int(multi.size()), tochannel - fromchannel + 1);
+        for (int c = fromchannel; c <= tochannel; ++c) {
+            RangeBlock single;
+            int singleBlockSize = blockSize;
+            m.getSummaries(c, start, count, single, singleBlockSize);
+            QCOMPARE(multiBlockSize, singleBlockSize);
+            QVERIFY(!single.empty());
+            compareRanges(multi[c - fromchannel], single, 0.f);
+        }
+    }
+
+    static void waitUntilReady(const RangeSummarisableTimeValueModel &m) {
+        QTRY_VERIFY_WITH_TIMEOUT(m.isReady(nullptr), 20000);
+    }
+
+private slots:
+    void initTestCase() {
+        QVERIFY(m_dir.isValid());
+        QString path = m_dir.path() + "/summaries.wav";
+        auto data = generate();
+        vector<const float *> ptrs;
+        for (const auto &d: data) ptrs.push_back(d.data());
+        {
+            WavFileWriter writer(path, 44100, channels,
+                                 WavFileWriter::WriteToTemporary);
+            QVERIFY(writer.isOK());
+            QVERIFY(writer.writeSamples(ptrs.data(), frames));
+            QVERIFY(writer.close());
+        }
+        m_model = ModelById::add
+            (std::make_shared<ReadOnlyWaveFileModel>(FileSource(path)));
+        auto model = ModelById::getAs<ReadOnlyWaveFileModel>(m_model);
+        QVERIFY(model->isOK());
+        waitUntilReady(*model);
+        QCOMPARE(model->getChannelCount(), channels);
+        QCOMPARE(model->getFrameCount(), sv_frame_t(frames));
+    }
+
+    void cleanupTestCase() {
+        ModelById::release(m_model);
+    }
+
+    void directRead() {
+        // Block sizes below the minimum cache block are read
+        // directly from the file
+        auto model = ModelById::getAs<ReadOnlyWaveFileModel>(m_model);
+        compareWithSingleChannel(*model, 0, channels - 1, 0, frames, 32);
+        compareWithSingleChannel(*model, 1, 2, 1001, 2347, 23);
+        compareWithSingleChannel(*model, 1, 1, 17, 100, 7);
+        // and one that runs past the end
+        compareWithSingleChannel(*model, 0, 1, frames - 50, 200, 32);
+
+        vector<RangeBlock> multi;
+        int blockSize = 23;
+        model->getMultiChannelSummaries(0, channels - 1, 1001, 2347,
+                                        multi, blockSize);
+        QCOMPARE(blockSize, 23);
+        for (int c = 0; c < channels; ++c) {
+            compareRanges(multi[c], summarise(*model, c, 1001, 2347, 23), 0.f);
+        }
+    }
+
+    void cachedRead() {
+        // Block sizes at or above the minimum cache block come from
+        // the range cache, which has both power-of-two and
+        // power-of-sqrt-two levels
+        auto model = ModelById::getAs<ReadOnlyWaveFileModel>(m_model);
+        compareWithSingleChannel(*model, 0, channels - 1, 0, frames, 256);
+        compareWithSingleChannel(*model, 0, channels - 1, 0, frames, 90);
+        compareWithSingleChannel(*model, 1, 2, 700, 5000, 1024);
+        compareWithSingleChannel(*model, 2, 2, 0, frames, 181);
+
+        // With a start and count aligned to the block size, the
+        // cached summaries should agree with a summary of the
+        // underlying data, up to rounding in the absmean. The cached
+        // read also returns the block that starts at the end frame,
+        // so ignore anything beyond the expected blocks
+        vector<RangeBlock> multi;
+        int blockSize = 256;
+        model->getMultiChannelSummaries(0, channels - 1, 512, 4096,
+                                        multi, blockSize);
+        QCOMPARE(blockSize, 256);
+        for (int c = 0; c < channels; ++c) {
+            RangeBlock expected = summarise(*model, c, 512, 4096, 256);
+            QVERIFY(multi[c].size() >= expected.size());
+            multi[c].resize(expected.size());
+            compareRanges(multi[c], expected, 1e-4f);
+        }
+    }
+
+    void invalidChannels() {
+        auto model = ModelById::getAs<ReadOnlyWaveFileModel>(m_model);
+        vector<RangeBlock> multi;
+        int blockSize = 32;
+        model->getMultiChannelSummaries(1, 0, 0, frames, multi, blockSize);
+        QVERIFY(multi.empty());
+        model->getMultiChannelSummaries(0, channels, 0, frames,
+                                        multi, blockSize);
+        QVERIFY(multi.empty());
+    }
+
+    void aggregate() {
+        // Channels out of order and repeated, so that the aggregate
+        // has to split the request into several runs
+        AggregateWaveModel::ChannelSpecList specs;
+        specs.push_back({ m_model, 2 });
+        specs.push_back({ m_model, 0 });
+        specs.push_back({ m_model, 1 });
+        specs.push_back({ m_model, 1 });
+        AggregateWaveModel agg(specs);
+        QVERIFY(agg.isOK());
+        waitUntilReady(agg);
+
+        for (int blockSize: { 32, 256, 90 }) {
+            compareWithSingleChannel(agg, 0, 3, 0, frames, blockSize);
+            compareWithSingleChannel(agg, 1, 2, 300, 4000, blockSize);
+        }
+
+        // and against the source model, channel by channel
+        auto model = ModelById::getAs<ReadOnlyWaveFileModel>(m_model);
+        vector<RangeBlock> multi;
+        int blockSize = 32;
+        agg.getMultiChannelSummaries(0, 3, 0, frames, multi, blockSize);
+        QCOMPARE(int(multi.size()), 4);
+        int sourceChannels[] = { 2, 0, 1, 1 };
+        for (int c = 0; c < 4; ++c) {
+            RangeBlock single;
+            int singleBlockSize = 32;
+            model->getSummaries(sourceChannels[c], 0, frames,
+                                single, singleBlockSize);
+            compareRanges(multi[c], single, 0.f);
+        }
+    }
+
+    void writable() {
+        WritableWaveFileModel model(44100, channels);
+        QVERIFY(model.isOK());
+        auto data = generate();
+        vector<const float *> ptrs;
+        for (const auto &d: data) ptrs.push_back(d.data());
+        QVERIFY(model.addSamples(ptrs.data(), frames));
+        model.writeComplete();
+
+        // The writable model always reports itself ready, while its
+        // read model may still be filling its cache in the
+        // background, so stick to direct reads here
+        compareWithSingleChannel(model, 0, channels - 1, 0, frames, 32);
+        compareWithSingleChannel(model, 1, 2, 1234, 5678, 45);
+    }
+};
+
+#endif
@@ -1,8 +1,11 @@
 TEST_HEADERS += \
 	Compares.h \
 	MockWaveModel.h \
+	TestDecimatedTimeValueModel.h \
+	TestFastDTWAligner.h \
 	TestFFTModel.h \
         TestSparseModels.h \
+        TestWaveModelSummaries.h \
         TestWaveformOversampler.h \
         TestZoomConstraints.h
 	
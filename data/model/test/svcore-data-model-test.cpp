@@ -15,6 +15,9 @@
 #include "TestZoomConstraints.h"
 #include "TestWaveformOversampler.h"
 #include "TestSparseModels.h"
+#include "TestFastDTWAligner.h"
+#include "TestDecimatedTimeValueModel.h"
+#include "TestWaveModelSummaries.h"
 
 #include "system/Init.h"
 
@@ -58,6 +61,24 @@ int main(int argc, char *argv[])
         else ++bad;
     }
 
+    {
+        TestFastDTWAligner t;
+        if (QTest::qExec(&t, argc, argv) == 0) ++good;
+        else ++bad;
+    }
+
+    {
+        TestDecimatedTimeValueModel t;
+        if (QTest::qExec(&t, argc, argv) == 0) ++good;
+        else ++bad;
+    }
+
+    {
+        TestWaveModelSummaries t;
+        if (QTest::qExec(&t, argc, argv) == 0) ++good;
+        else ++bad;
+    }
+
     if (bad > 0) {
         SVCERR << "\n********* " << bad << " test suite(s) failed!\n" << endl;
         return 1;
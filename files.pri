@@ -1,22 +1,30 @@
 SVCORE_HEADERS = \
+           base/AccessTraceSimulator.h \
+           base/AccessTracer.h \
            base/AudioLevel.h \
            base/AudioPlaySource.h \
            base/AudioRecordTarget.h \
            base/BaseTypes.h \
            base/ById.h \
+           base/ChunkedVector.h \
            base/Clipboard.h \
            base/ColumnOp.h \
            base/Command.h \
+           base/CPUFeatures.h \
            base/Debug.h \
            base/Event.h \
+           base/EventBoxIndex.h \
            base/EventSeries.h \
+           base/EventXmlWriter.h \
            base/Exceptions.h \
            base/Extents.h \
            base/HelperExecPath.h \
            base/HitCount.h \
            base/LogRange.h \
            base/MagnitudeRange.h \
+           base/NoteCursor.h \
            base/NoteData.h \
+           base/NumericKernels.h \
            base/NoteExportable.h \
            base/Pitch.h \
            base/Playable.h \
@@ -35,6 +43,7 @@ SVCORE_HEADERS = \
            base/RingBuffer.h \
            base/ScaleTickIntervals.h \
            base/Scavenger.h \
+           base/SampleOps.h \
            base/Selection.h \
            base/Serialiser.h \
            base/StorageAdviser.h \
@@ -50,6 +59,7 @@ SVCORE_HEADERS = \
            base/XmlExportable.h \
            base/ZoomConstraint.h \
            base/ZoomLevel.h \
+           data/fileio/AudioFileMetadataCache.h \
            data/fileio/AudioFileReader.h \
            data/fileio/AudioFileReaderFactory.h \
            data/fileio/AudioFileSizeEstimator.h \
@@ -71,6 +81,7 @@ SVCORE_HEADERS = \
            data/fileio/MIDIFileWriter.h \
            data/fileio/MP3FileReader.h \
            data/fileio/PlaylistFileReader.h \
+           data/fileio/SpectrogramExporter.h \
            data/fileio/TextTest.h \
            data/fileio/WavFileReader.h \
            data/fileio/WavFileWriter.h \
@@ -80,12 +91,15 @@ SVCORE_HEADERS = \
            data/model/AggregateWaveModel.h \
            data/model/AlignmentModel.h \
            data/model/BasicCompressedDenseThreeDimensionalModel.h \
+           data/model/DecimatedTimeValueModel.h \
            data/model/Dense3DModelPeakCache.h \
            data/model/DenseThreeDimensionalModel.h \
            data/model/DenseTimeValueModel.h \
            data/model/DeferredNotifier.h \
            data/model/EditableDenseThreeDimensionalModel.h \
            data/model/EventCommands.h \
+           data/model/FastDTWAligner.h \
+           data/model/FFTFrequencyModel.h \
            data/model/FFTModel.h \
            data/model/ImageModel.h \
            data/model/Labeller.h \
@@ -139,6 +153,7 @@ SVCORE_HEADERS = \
            rdf/RDFFeatureWriter.h \
            rdf/RDFImporter.h \
            rdf/RDFTransformFactory.h \
+           rdf/TurtleStreamReader.h \
 	   system/Init.h \
            system/System.h \
 	   transform/CSVFeatureWriter.h \
@@ -153,16 +168,23 @@ SVCORE_HEADERS = \
            transform/ModelTransformerFactory.h
 	   
 SVCORE_SOURCES = \
+           base/AccessTraceSimulator.cpp \
+           base/AccessTracer.cpp \
            base/AudioLevel.cpp \
            base/ById.cpp \
            base/Clipboard.cpp \
            base/ColumnOp.cpp \
            base/Command.cpp \
+           base/CPUFeatures.cpp \
            base/Debug.cpp \
+           base/EventBoxIndex.cpp \
            base/EventSeries.cpp \
+           base/EventXmlWriter.cpp \
            base/Exceptions.cpp \
            base/HelperExecPath.cpp \
            base/LogRange.cpp \
+           base/NoteCursor.cpp \
+           base/NumericKernels.cpp \
            base/Pitch.cpp \
            base/PlayParameterRepository.cpp \
            base/PlayParameters.cpp \
@@ -189,6 +211,7 @@ SVCORE_SOURCES = \
            base/ViewManagerBase.cpp \
            base/XmlExportable.cpp \
            base/ZoomLevel.cpp \
+           data/fileio/AudioFileMetadataCache.cpp \
            data/fileio/AudioFileReader.cpp \
            data/fileio/AudioFileReaderFactory.cpp \
            data/fileio/AudioFileSizeEstimator.cpp \
@@ -207,6 +230,7 @@ SVCORE_SOURCES = \
            data/fileio/MIDIFileWriter.cpp \
            data/fileio/MP3FileReader.cpp \
            data/fileio/PlaylistFileReader.cpp \
+           data/fileio/SpectrogramExporter.cpp \
            data/fileio/TextTest.cpp \
            data/fileio/WavFileReader.cpp \
            data/fileio/WavFileWriter.cpp \
@@ -215,9 +239,12 @@ SVCORE_SOURCES = \
            data/model/AggregateWaveModel.cpp \
            data/model/AlignmentModel.cpp \
            data/model/BasicCompressedDenseThreeDimensionalModel.cpp \
+           data/model/DecimatedTimeValueModel.cpp \
            data/model/Dense3DModelPeakCache.cpp \
            data/model/DenseTimeValueModel.cpp \
            data/model/EditableDenseThreeDimensionalModel.cpp \
+           data/model/FastDTWAligner.cpp \
+           data/model/FFTFrequencyModel.cpp \
            data/model/FFTModel.cpp \
            data/model/Model.cpp \
            data/model/ModelDataTableModel.cpp \
@@ -251,6 +278,7 @@ SVCORE_SOURCES = \
            rdf/RDFFeatureWriter.cpp \
            rdf/RDFImporter.cpp \
            rdf/RDFTransformFactory.cpp \
+           rdf/TurtleStreamReader.cpp \
 	   system/Init.cpp \
            system/System.cpp \
            system/os-other.cpp \
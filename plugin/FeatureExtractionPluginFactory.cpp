@@ -22,6 +22,18 @@
 #include "base/Preferences.h"
 #include "base/Debug.h"
 
+// Idle initialised instances kept for reuse by transforms that run
+// the same plugin configuration again, e.g. across a batch of files
+static const int nativeInstancePoolSize = 4;
+
+static FeatureExtractionPluginFactory *
+createNativeFactory()
+{
+    NativeVampPluginFactory *factory = new NativeVampPluginFactory();
+    factory->setInstancePoolSize(nativeInstancePoolSize);
+    return factory;
+}
+
 FeatureExtractionPluginFactory *
 FeatureExtractionPluginFactory::instance()
 {
@@ -35,16 +47,44 @@ FeatureExtractionPluginFactory::instance()
 #ifdef HAVE_PIPER
         if (Preferences::getInstance()->getRunPluginsInProcess()) {
             SVDEBUG << "FeatureExtractionPluginFactory: in-process preference set, using native factory" << endl;
-            instance = new NativeVampPluginFactory();
+            instance = createNativeFactory();
         } else {
             SVDEBUG << "FeatureExtractionPluginFactory: in-process preference not set, using Piper factory" << endl;
             instance = new PiperVampPluginFactory();
         }
 #else
         SVDEBUG << "FeatureExtractionPluginFactory: no Piper support compiled in, using native factory" << endl;
-        instance = new NativeVampPluginFactory();
+        instance = createNativeFactory();
 #endif
     }
 
     return instance;
 }
+
+std::shared_ptr<Vamp::Plugin>
+FeatureExtractionPluginFactory::instantiateInitialisedPlugin
+(QString identifier,
+ sv_samplerate_t inputSampleRate,
+ int channels,
+ int stepSize,
+ int blockSize,
+ const ParameterMap &parameters,
+ std::string program)
+{
+    auto plugin = instantiatePlugin(identifier, inputSampleRate);
+    if (!plugin) return {};
+
+    if (program != "") {
+        plugin->selectProgram(program);
+    }
+    for (const auto &p: parameters) {
+        plugin->setParameter(p.first, p.second);
+    }
+
+    if (!plugin->initialise(channels, stepSize, blockSize)) {
+        SVDEBUG << "FeatureExtractionPluginFactory::instantiateInitialisedPlugin: Failed to initialise " << identifier << " with channels = " << channels << ", step = " << stepSize << ", block = " << blockSize << endl;
+        return {};
+    }
+
+    return plugin;
+}
@@ -25,6 +25,8 @@
 #include <QString>
 
 #include <memory>
+#include <map>
+#include <string>
 
 class FeatureExtractionPluginFactory
 {
@@ -51,6 +53,26 @@ public:
      */
     virtual std::shared_ptr<Vamp::Plugin> instantiatePlugin(QString identifier,
                                                             sv_samplerate_t inputSampleRate) = 0;
+
+    typedef std::map<std::string, float> ParameterMap;
+
+    /**
+     * Instantiate the plugin with the given identifier, select the
+     * given program (if non-empty) and set the given parameters, and
+     * initialise it with the given channel count, step size and
+     * block size. Return nullptr if the plugin could not be loaded or
+     * initialised with these values. The caller must not change the
+     * parameters or program of the returned plugin, as a factory may
+     * reuse instances that it has already initialised.
+     */
+    virtual std::shared_ptr<Vamp::Plugin> instantiateInitialisedPlugin
+    (QString identifier,
+     sv_samplerate_t inputSampleRate,
+     int channels,
+     int stepSize,
+     int blockSize,
+     const ParameterMap &parameters = {},
+     std::string program = "");
     
     /**
      * Get category metadata about a plugin (without instantiating it).
@@ -297,115 +297,329 @@ NativeVampPluginFactory::findPluginFile(QString soname, QString inDir)
     }
 }
 
-std::shared_ptr<Vamp::Plugin>
-NativeVampPluginFactory::instantiatePlugin(QString identifier,
-                                           sv_samplerate_t inputSampleRate)
+NativeVampPluginFactory::NativeVampPluginFactory() :
+    m_idleLibraryLimit(16),
+    m_poolSize(0),
+    m_pooledCount(0)
+{
+}
+
+NativeVampPluginFactory::~NativeVampPluginFactory()
+{
+    // Deleting the pooled instances leaves their libraries idle, and
+    // then all idle libraries are unloaded. Any library with a plugin
+    // still in use elsewhere stays loaded
+    setInstancePoolSize(0);
+    setIdleLibraryLimit(0);
+}
+
+NativeVampPluginFactory::Library *
+NativeVampPluginFactory::loadLibrary(QString path)
 {
-    Profiler profiler("NativeVampPluginFactory::instantiatePlugin");
+    auto itr = m_loadedLibraries.find(path);
+    if (itr != m_loadedLibraries.end()) {
+        return &itr->second;
+    }
+
+    void *libraryHandle = DLOPEN(path, RTLD_LAZY | RTLD_LOCAL);
+            
+    if (!libraryHandle) {
+        SVDEBUG << "NativeVampPluginFactory::loadLibrary: Failed to load library " << path << ": " << DLERROR() << endl;
+        return nullptr;
+    }
+
+    VampGetPluginDescriptorFunction fn = (VampGetPluginDescriptorFunction)
+        DLSYM(libraryHandle, "vampGetPluginDescriptor");
+    
+    if (!fn) {
+        SVDEBUG << "NativeVampPluginFactory::loadLibrary: No descriptor function in " << path << endl;
+        if (DLCLOSE(libraryHandle) != 0) {
+            SVDEBUG << "WARNING: NativeVampPluginFactory::loadLibrary: Failed to unload library " << path << endl;
+        }
+        return nullptr;
+    }
 
-    std::shared_ptr<Vamp::Plugin> rv = nullptr;
-    Vamp::PluginHostAdapter *plugin = nullptr;
+    Library library;
+    library.handle = libraryHandle;
+    library.instances = 0;
 
     const VampPluginDescriptor *descriptor = nullptr;
     int index = 0;
 
+    while ((descriptor = fn(VAMP_API_VERSION, index))) {
+        // As before, the first descriptor with a given label wins
+        if (library.descriptors.find(descriptor->identifier) ==
+            library.descriptors.end()) {
+            library.descriptors[descriptor->identifier] = descriptor;
+        }
+        ++index;
+    }
+
+#ifdef DEBUG_PLUGIN_SCAN_AND_INSTANTIATE
+    SVCERR << "NativeVampPluginFactory::loadLibrary: Loaded " << path
+           << " with " << library.descriptors.size() << " plugin(s)" << endl;
+#endif
+
+    return &(m_loadedLibraries[path] = library);
+}
+
+std::shared_ptr<Vamp::Plugin>
+NativeVampPluginFactory::instantiatePlugin(QString identifier,
+                                           sv_samplerate_t inputSampleRate)
+{
+    return std::shared_ptr<Vamp::Plugin>
+        (createPlugin(identifier, inputSampleRate));
+}
+
+Vamp::Plugin *
+NativeVampPluginFactory::createPlugin(QString identifier,
+                                      sv_samplerate_t inputSampleRate)
+{
+    Profiler profiler("NativeVampPluginFactory::createPlugin");
+
     QString type, soname, label;
     PluginIdentifier::parseIdentifier(identifier, type, soname, label);
     if (type != "vamp") {
 #ifdef DEBUG_PLUGIN_SCAN_AND_INSTANTIATE
-        SVCERR << "NativeVampPluginFactory::instantiatePlugin: Wrong factory for plugin type " << type << endl;
+        SVCERR << "NativeVampPluginFactory::createPlugin: Wrong factory for plugin type " << type << endl;
 #endif
         return nullptr;
     }
 
-    QString found = findPluginFile(soname);
+    QMutexLocker locker(&m_libraryMutex);
 
-    if (found == "") {
-        SVDEBUG << "NativeVampPluginFactory::instantiatePlugin: Failed to find library file " << soname << endl;
-        return nullptr;
-    } else if (found != soname) {
+    QString found;
+
+    auto fitr = m_libraryFiles.find(soname);
+    if (fitr != m_libraryFiles.end()) {
+        found = fitr->second;
+    } else {
+        found = findPluginFile(soname);
+        if (found == "") {
+            SVDEBUG << "NativeVampPluginFactory::createPlugin: Failed to find library file " << soname << endl;
+            return nullptr;
+        }
 
 #ifdef DEBUG_PLUGIN_SCAN_AND_INSTANTIATE
-        SVCERR << "NativeVampPluginFactory::instantiatePlugin: Given library name was " << soname << ", found at " << found << endl;
-        SVCERR << soname << " -> " << found << endl;
+        if (found != soname) {
+            SVCERR << "NativeVampPluginFactory::createPlugin: Given library name was " << soname << ", found at " << found << endl;
+        }
 #endif
 
-    }        
-
-    soname = found;
-
-    void *libraryHandle = DLOPEN(soname, RTLD_LAZY | RTLD_LOCAL);
-            
-    if (!libraryHandle) {
-        SVDEBUG << "NativeVampPluginFactory::instantiatePlugin: Failed to load library " << soname << ": " << DLERROR() << endl;
-        return nullptr;
+        m_libraryFiles[soname] = found;
     }
 
-    VampGetPluginDescriptorFunction fn = (VampGetPluginDescriptorFunction)
-        DLSYM(libraryHandle, "vampGetPluginDescriptor");
-    
-    if (!fn) {
-        SVDEBUG << "NativeVampPluginFactory::instantiatePlugin: No descriptor function in " << soname << endl;
-        goto done;
+    Library *library = loadLibrary(found);
+    if (!library) {
+        SVCERR << "NativeVampPluginFactory::createPlugin: Failed to construct plugin" << endl;
+        return nullptr;
     }
 
-    while ((descriptor = fn(VAMP_API_VERSION, index))) {
-        if (label == descriptor->identifier) break;
-        ++index;
+    auto ditr = library->descriptors.find(label.toStdString());
+    if (ditr == library->descriptors.end()) {
+        SVDEBUG << "NativeVampPluginFactory::createPlugin: Failed to find plugin \"" << label << "\" in library " << found << endl;
+        SVCERR << "NativeVampPluginFactory::createPlugin: Failed to construct plugin" << endl;
+        if (library->instances <= 0) {
+            libraryIdle(found);
+        }
+        return nullptr;
     }
 
-    if (!descriptor) {
-        SVDEBUG << "NativeVampPluginFactory::instantiatePlugin: Failed to find plugin \"" << label << "\" in library " << soname << endl;
-        goto done;
-    }
+    const VampPluginDescriptor *descriptor = ditr->second;
 
-    plugin = new Vamp::PluginHostAdapter(descriptor, float(inputSampleRate));
+    Vamp::PluginHostAdapter *plugin =
+        new Vamp::PluginHostAdapter(descriptor, float(inputSampleRate));
 
-    if (plugin) {
-        m_handleMap[plugin] = libraryHandle;
-        rv = std::shared_ptr<Vamp::Plugin>
-            (new PluginDeletionNotifyAdapter(plugin, this));
+    m_handleMap[plugin] = found;
+    if (library->instances++ <= 0) {
+        libraryInUse(found);
     }
 
+    Vamp::Plugin *rv = new PluginDeletionNotifyAdapter(plugin, this);
+
 #ifdef DEBUG_PLUGIN_SCAN_AND_INSTANTIATE
-    if (rv) {
-        SVCERR << "NativeVampPluginFactory::instantiatePlugin: Instantiated plugin " << label << " from library " << soname << ": descriptor " << descriptor << ", rv "<< rv << ", label " << rv->getName() << ", outputs " << rv->getOutputDescriptors().size() << endl;
-    }
+    SVCERR << "NativeVampPluginFactory::createPlugin: Instantiated plugin " << label << " from library " << found << ": descriptor " << descriptor << ", rv "<< rv << ", label " << rv->getName() << ", outputs " << rv->getOutputDescriptors().size() << endl;
 #endif
 
-done:
-    if (!rv) {
-        SVCERR << "NativeVampPluginFactory::instantiatePlugin: Failed to construct plugin" << endl;
-        if (DLCLOSE(libraryHandle) != 0) {
-            SVDEBUG << "WARNING: NativeVampPluginFactory::instantiatePlugin: Failed to unload library " << soname << endl;
-        }
-    }
-    
     return rv;
 }
 
 void
 NativeVampPluginFactory::pluginDeleted(Vamp::Plugin* plugin)
 {
-    void *handle = m_handleMap[plugin];
-    if (!handle) return;
+    QMutexLocker locker(&m_libraryMutex);
+
+    auto itr = m_handleMap.find(plugin);
+    if (itr == m_handleMap.end()) return;
 
-    m_handleMap.erase(plugin);
+    auto litr = m_loadedLibraries.find(itr->second);
+    m_handleMap.erase(itr);
 
 #ifdef DEBUG_PLUGIN_SCAN_AND_INSTANTIATE
     SVCERR << "NativeVampPluginFactory::pluginDeleted: Removed from handle map, which now has " << m_handleMap.size() << " entries" << endl;
 #endif
 
-    for (auto h: m_handleMap) {
-        if (h.second == handle) {
-            // still in use
-            SVDEBUG << "NativeVampPluginFactory::pluginDeleted: Not unloading library " << handle << " as other plugins are still loaded from it" << endl;
+    // Pooled instances have not been deleted, so a library is not
+    // idle while any of its plugins is pooled or in use
+    if (litr != m_loadedLibraries.end()) {
+        if (--litr->second.instances <= 0) {
+            libraryIdle(litr->first);
+        }
+    }
+}
+
+void
+NativeVampPluginFactory::libraryIdle(QString path)
+{
+    m_idleLibraries.remove(path);
+    m_idleLibraries.push_front(path);
+    trimIdleLibraries();
+}
+
+void
+NativeVampPluginFactory::libraryInUse(QString path)
+{
+    m_idleLibraries.remove(path);
+}
+
+void
+NativeVampPluginFactory::trimIdleLibraries()
+{
+    while (!m_idleLibraries.empty() &&
+           int(m_idleLibraries.size()) > m_idleLibraryLimit) {
+        QString path = m_idleLibraries.back();
+        m_idleLibraries.pop_back();
+        unloadLibrary(path);
+    }
+}
+
+void
+NativeVampPluginFactory::setIdleLibraryLimit(int count)
+{
+    QMutexLocker locker(&m_libraryMutex);
+    m_idleLibraryLimit = count;
+    trimIdleLibraries();
+}
+
+void
+NativeVampPluginFactory::unloadLibrary(QString path)
+{
+    auto itr = m_loadedLibraries.find(path);
+    if (itr == m_loadedLibraries.end()) return;
+
+#ifdef DEBUG_PLUGIN_SCAN_AND_INSTANTIATE
+    SVCERR << "NativeVampPluginFactory::unloadLibrary: Unloading library " << path << endl;
+#endif
+
+    if (DLCLOSE(itr->second.handle) != 0) {
+        SVDEBUG << "WARNING: NativeVampPluginFactory::unloadLibrary: Failed to unload library " << path << endl;
+    }
+    m_loadedLibraries.erase(itr);
+}
+
+std::shared_ptr<Vamp::Plugin>
+NativeVampPluginFactory::instantiateInitialisedPlugin(QString identifier,
+                                                      sv_samplerate_t rate,
+                                                      int channels,
+                                                      int stepSize,
+                                                      int blockSize,
+                                                      const ParameterMap &parameters,
+                                                      std::string program)
+{
+    QString key = QString("%1|%2|%3|%4|%5|%6")
+        .arg(identifier).arg(rate, 0, 'g', 17)
+        .arg(channels).arg(stepSize).arg(blockSize)
+        .arg(QString::fromStdString(program));
+    for (const auto &p: parameters) {
+        key += QString("|%1=%2")
+            .arg(QString::fromStdString(p.first))
+            .arg(p.second, 0, 'g', 9);
+    }
+
+    Vamp::Plugin *plugin = nullptr;
+    
+    {
+        QMutexLocker locker(&m_poolMutex);
+        auto itr = m_pool.find(key);
+        if (itr != m_pool.end() && !itr->second.empty()) {
+            plugin = itr->second.back();
+            itr->second.pop_back();
+            --m_pooledCount;
+        }
+    }
+
+    if (plugin) {
+#ifdef DEBUG_PLUGIN_SCAN_AND_INSTANTIATE
+        SVCERR << "NativeVampPluginFactory::instantiateInitialisedPlugin: Reusing pooled instance " << plugin << " for key " << key << endl;
+#endif
+        plugin->reset();
+        return makePooled(plugin, key);
+    }
+    
+    plugin = createPlugin(identifier, rate);
+    if (!plugin) return {};
+
+    if (program != "") {
+        plugin->selectProgram(program);
+    }
+    for (const auto &p: parameters) {
+        plugin->setParameter(p.first, p.second);
+    }
+
+    if (!plugin->initialise(channels, stepSize, blockSize)) {
+        SVDEBUG << "NativeVampPluginFactory::instantiateInitialisedPlugin: Failed to initialise " << identifier << " with channels = " << channels << ", step = " << stepSize << ", block = " << blockSize << endl;
+        delete plugin;
+        return {};
+    }
+
+    return makePooled(plugin, key);
+}
+
+std::shared_ptr<Vamp::Plugin>
+NativeVampPluginFactory::makePooled(Vamp::Plugin *plugin, QString key)
+{
+    return std::shared_ptr<Vamp::Plugin>
+        (plugin,
+         [this, key](Vamp::Plugin *p) { returnToPool(p, key); });
+}
+
+void
+NativeVampPluginFactory::returnToPool(Vamp::Plugin *plugin, QString key)
+{
+    {
+        QMutexLocker locker(&m_poolMutex);
+        if (m_pooledCount < m_poolSize) {
+            m_pool[key].push_back(plugin);
+            ++m_pooledCount;
             return;
         }
     }
 
-    SVDEBUG << "NativeVampPluginFactory::pluginDeleted: Unloading library " << handle << " after last plugin from this library " << plugin << " was deleted" << endl;
-    DLCLOSE(handle);
+    delete plugin;
+}
+
+void
+NativeVampPluginFactory::setInstancePoolSize(int size)
+{
+    vector<Vamp::Plugin *> excess;
+
+    {
+        QMutexLocker locker(&m_poolMutex);
+        m_poolSize = size;
+        for (auto &p: m_pool) {
+            while (m_pooledCount > m_poolSize && !p.second.empty()) {
+                excess.push_back(p.second.back());
+                p.second.pop_back();
+                --m_pooledCount;
+            }
+        }
+    }
+
+    // Delete outside the pool lock, as deletion calls back into
+    // pluginDeleted
+    for (auto p: excess) {
+        delete p;
+    }
 }
 
 QString
@@ -18,8 +18,12 @@
 
 #include "FeatureExtractionPluginFactory.h"
 
+#include <vamp/vamp.h>
+
 #include <vector>
 #include <map>
+#include <list>
+#include <string>
 
 #include "base/Debug.h"
 
@@ -28,11 +32,23 @@
 /**
  * FeatureExtractionPluginFactory type for Vamp plugins hosted
  * in-process.
+ *
+ * A plugin library is loaded when a plugin is instantiated from it,
+ * and stays loaded, with its plugin descriptors indexed by label, so
+ * that further instantiations from it need no library load or
+ * descriptor scan. A library none of whose plugins is in use (or
+ * idle in the instance pool, see setInstancePoolSize) is kept loaded
+ * among a limited number of idle libraries, the least recently used
+ * of which is unloaded when the limit is exceeded (see
+ * setIdleLibraryLimit), and the rest when the factory is destroyed.
+ * The file found for each library name is remembered for the
+ * lifetime of the factory.
  */
 class NativeVampPluginFactory : public FeatureExtractionPluginFactory
 {
 public:
-    virtual ~NativeVampPluginFactory() { }
+    NativeVampPluginFactory();
+    virtual ~NativeVampPluginFactory();
 
     virtual std::vector<QString> getPluginIdentifiers(QString &errorMessage)
         override;
@@ -48,6 +64,48 @@ public:
 
     virtual QString getPluginLibraryPath(QString identifier) override;
 
+    /**
+     * Instantiate and initialise a plugin as described in
+     * FeatureExtractionPluginFactory.
+     *
+     * If an instance pool size has been set (see setInstancePoolSize),
+     * a plugin returned from this function is returned to the pool
+     * instead of being deleted when the last reference to it goes
+     * away (unless the pool is full), and a later call with the same
+     * identifier, sample rate, channels, step and block sizes,
+     * program and parameters will reset() and return that same
+     * instance. This avoids the cost of construction and
+     * initialisation for hosts that run the same plugin
+     * configuration many times over, e.g. across a batch of files.
+     *
+     * The caller must not change the parameters or program of a
+     * plugin obtained this way.
+     */
+    std::shared_ptr<Vamp::Plugin> instantiateInitialisedPlugin
+    (QString identifier,
+     sv_samplerate_t inputSampleRate,
+     int channels,
+     int stepSize,
+     int blockSize,
+     const ParameterMap &parameters = {},
+     std::string program = "") override;
+
+    /**
+     * Set the maximum number of idle plugin instances to keep for
+     * reuse by instantiateInitialisedPlugin. The default is 0, which
+     * disables the pool. Reducing the size deletes any excess idle
+     * instances. FeatureExtractionPluginFactory::instance() sets a
+     * small pool for the factory it creates.
+     */
+    void setInstancePoolSize(int size);
+
+    /**
+     * Set the maximum number of libraries to keep loaded while none
+     * of their plugins is in use. The default is 16. Reducing the
+     * limit unloads the least recently used excess libraries.
+     */
+    void setIdleLibraryLimit(int count);
+
 protected:
     QMutex m_mutex;
     std::vector<QString> m_pluginPath;
@@ -56,9 +114,37 @@ protected:
     std::map<QString, piper_vamp::PluginStaticData> m_pluginData; // identifier -> data (created opportunistically)
     std::map<QString, QString> m_libraries; // identifier -> full file path
 
+    struct Library {
+        void *handle;
+        int instances; // plugins instantiated and not yet deleted
+        std::map<std::string, const VampPluginDescriptor *> descriptors;
+    };
+
+    QMutex m_libraryMutex; // for the following maps and idle list
+    std::map<QString, Library> m_loadedLibraries; // file path -> library
+    std::map<QString, QString> m_libraryFiles; // soname -> file path
+    std::map<Vamp::Plugin *, QString> m_handleMap; // plugin -> file path
+    std::list<QString> m_idleLibraries; // file paths, most recent first
+    int m_idleLibraryLimit;
+
+    // Call these with m_libraryMutex held
+    Library *loadLibrary(QString path);
+    void unloadLibrary(QString path);
+    void libraryIdle(QString path);
+    void libraryInUse(QString path);
+    void trimIdleLibraries();
+    Vamp::Plugin *createPlugin(QString identifier,
+                               sv_samplerate_t inputSampleRate);
+
     friend class PluginDeletionNotifyAdapter;
     void pluginDeleted(Vamp::Plugin *);
-    std::map<Vamp::Plugin *, void *> m_handleMap;
+
+    QMutex m_poolMutex;
+    int m_poolSize;
+    int m_pooledCount;
+    std::map<QString, std::vector<Vamp::Plugin *>> m_pool; // key -> idle
+    std::shared_ptr<Vamp::Plugin> makePooled(Vamp::Plugin *, QString key);
+    void returnToPool(Vamp::Plugin *, QString key);
 
     QString findPluginFile(QString soname, QString inDir = "");
     std::vector<QString> getPluginPath();
@@ -0,0 +1,274 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+    
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef TEST_NATIVE_VAMP_PLUGIN_FACTORY_H
+#define TEST_NATIVE_VAMP_PLUGIN_FACTORY_H
+
+#include "../NativeVampPluginFactory.h"
+
+#include <vamp-hostsdk/Plugin.h>
+
+#include <QObject>
+#include <QtTest>
+#include <QMutexLocker>
+
+#include <vector>
+
+using namespace std;
+
+class TestNativeVampPluginFactory : public QObject
+{
+    Q_OBJECT
+
+    // Exposes the pool and library state that the tests check
+    class Factory : public NativeVampPluginFactory
+    {
+    public:
+        int getPooledCount() {
+            QMutexLocker locker(&m_poolMutex);
+            return m_pooledCount;
+        }
+        int getLoadedLibraryCount() {
+            QMutexLocker locker(&m_libraryMutex);
+            return int(m_loadedLibraries.size());
+        }
+    };
+
+    // The amplitude follower from the Vamp example plugins carries
+    // its envelope from one process call to the next, so a reused
+    // instance that had not been reset would give different results
+    // from a fresh one
+    static QString pluginId() {
+        return "vamp:vamp-example-plugins:amplitudefollower";
+    }
+
+    static const int rate = 44100;
+    static const int block = 1024;
+
+    // Two blocks at constant amplitude, leaving the envelope high.
+    // The follower returns one value per block
+    static vector<float> run(Vamp::Plugin *plugin) {
+        vector<float> input(block, 0.5f);
+        const float *ptr = input.data();
+        vector<float> values;
+        for (int i = 0; i < 2; ++i) {
+            auto fs = plugin->process
+                (&ptr, Vamp::RealTime::frame2RealTime(i * block, rate));
+            for (const auto &f: fs[0]) {
+                values.insert(values.end(), f.values.begin(), f.values.end());
+            }
+        }
+        auto fs = plugin->getRemainingFeatures();
+        for (const auto &f: fs[0]) {
+            values.insert(values.end(), f.values.begin(), f.values.end());
+        }
+        return values;
+    }
+
+private slots:
+    void initTestCase() {
+        Factory factory;
+        if (!factory.instantiatePlugin(pluginId(), rate)) {
+#if ( QT_VERSION >= 0x050000 )
+            QSKIP("Vamp example plugins not found, skipping");
+#else
+            QSKIP("Vamp example plugins not found, skipping", SkipAll);
+#endif
+        }
+    }
+
+    void idleLibraries() {
+        Factory factory;
+        QCOMPARE(factory.getLoadedLibraryCount(), 0);
+        auto p = factory.instantiatePlugin(pluginId(), rate);
+        QVERIFY(p);
+        auto q = factory.instantiatePlugin(pluginId(), rate);
+        QVERIFY(q);
+        QCOMPARE(factory.getLoadedLibraryCount(), 1);
+        p.reset();
+        q.reset();
+
+        // The library stays loaded while idle, so instantiating from
+        // it again needs no load or scan
+        QCOMPARE(factory.getLoadedLibraryCount(), 1);
+        p = factory.instantiatePlugin(pluginId(), rate);
+        QVERIFY(p);
+        QCOMPARE(factory.getLoadedLibraryCount(), 1);
+
+        // A library in use is never unloaded, whatever the limit
+        factory.setIdleLibraryLimit(0);
+        QCOMPARE(factory.getLoadedLibraryCount(), 1);
+
+        // but with a limit of zero, it goes as soon as it is idle
+        p.reset();
+        QCOMPARE(factory.getLoadedLibraryCount(), 0);
+
+        // With no pool, initialised plugins are deleted as usual
+        auto r = factory.instantiateInitialisedPlugin
+            (pluginId(), rate, 1, block, block);
+        QVERIFY(r);
+        QCOMPARE(factory.getLoadedLibraryCount(), 1);
+        r.reset();
+        QCOMPARE(factory.getPooledCount(), 0);
+        QCOMPARE(factory.getLoadedLibraryCount(), 0);
+
+        // Raising the limit again leaves the next idle library loaded
+        factory.setIdleLibraryLimit(1);
+        r = factory.instantiateInitialisedPlugin
+            (pluginId(), rate, 1, block, block);
+        QVERIFY(r);
+        r.reset();
+        QCOMPARE(factory.getLoadedLibraryCount(), 1);
+    }
+
+    void failures() {
+        Factory factory;
+        factory.setInstancePoolSize(2);
+        QVERIFY(!factory.instantiateInitialisedPlugin
+                ("vamp:vamp-example-plugins:nonexistent",
+                 rate, 1, block, block));
+        QVERIFY(!factory.instantiateInitialisedPlugin
+                ("vamp:nonexistent-library:amplitudefollower",
+                 rate, 1, block, block));
+        // too many channels for this plugin
+        QVERIFY(!factory.instantiateInitialisedPlugin
+                (pluginId(), rate, 2, block, block));
+        QCOMPARE(factory.getPooledCount(), 0);
+        // The example library was loaded, and is now idle, but the
+        // nonexistent one was not
+        QCOMPARE(factory.getLoadedLibraryCount(), 1);
+    }
+
+    void reuse() {
+        Factory factory;
+        factory.setInstancePoolSize(2);
+
+        auto p = factory.instantiateInitialisedPlugin
+            (pluginId(), rate, 1, block, block);
+        QVERIFY(p);
+        Vamp::Plugin *raw = p.get();
+        vector<float> first = run(p.get());
+        QCOMPARE(int(first.size()), 2); // one value per block
+        p.reset();
+        QCOMPARE(factory.getPooledCount(), 1);
+        QCOMPARE(factory.getLoadedLibraryCount(), 1);
+
+        auto q = factory.instantiateInitialisedPlugin
+            (pluginId(), rate, 1, block, block);
+        QCOMPARE(q.get(), raw);
+        QCOMPARE(factory.getPooledCount(), 0);
+
+        // The reused instance has been reset, so it gives the same
+        // results as the first run, and as a fresh instance
+        QCOMPARE(run(q.get()), first);
+        
+        auto fresh = factory.instantiatePlugin(pluginId(), rate);
+        QVERIFY(fresh->initialise(1, block, block));
+        QCOMPARE(run(fresh.get()), first);
+    }
+
+    void keyMismatch() {
+        Factory factory;
+        factory.setInstancePoolSize(4);
+
+        NativeVampPluginFactory::ParameterMap params;
+        params["attack"] = 0.01f;
+        
+        auto p = factory.instantiateInitialisedPlugin
+            (pluginId(), rate, 1, block, block, params);
+        QVERIFY(p);
+        Vamp::Plugin *raw = p.get();
+        p.reset();
+        QCOMPARE(factory.getPooledCount(), 1);
+
+        // Changed parameter
+        params["attack"] = 0.1f;
+        auto q = factory.instantiateInitialisedPlugin
+            (pluginId(), rate, 1, block, block, params);
+        QVERIFY(q);
+        QVERIFY(q.get() != raw);
+        QCOMPARE(q->getParameter("attack"), 0.1f);
+        QCOMPARE(factory.getPooledCount(), 1);
+
+        // Changed step and block sizes
+        params["attack"] = 0.01f;
+        auto r = factory.instantiateInitialisedPlugin
+            (pluginId(), rate, 1, block / 2, block / 2, params);
+        QVERIFY(r);
+        QVERIFY(r.get() != raw);
+        QCOMPARE(factory.getPooledCount(), 1);
+
+        // Changed sample rate
+        auto s = factory.instantiateInitialisedPlugin
+            (pluginId(), 48000, 1, block, block, params);
+        QVERIFY(s);
+        QVERIFY(s.get() != raw);
+        QCOMPARE(factory.getPooledCount(), 1);
+
+        // and finally the original configuration again
+        auto t = factory.instantiateInitialisedPlugin
+            (pluginId(), rate, 1, block, block, params);
+        QCOMPARE(t.get(), raw);
+        QCOMPARE(factory.getPooledCount(), 0);
+    }
+
+    void poolFull() {
+        Factory factory;
+        factory.setInstancePoolSize(1);
+        auto p = factory.instantiateInitialisedPlugin
+            (pluginId(), rate, 1, block, block);
+        auto q = factory.instantiateInitialisedPlugin
+            (pluginId(), rate, 1, block, block);
+        QVERIFY(p);
+        QVERIFY(q);
+        QVERIFY(p.get() != q.get());
+        p.reset();
+        q.reset();
+        QCOMPARE(factory.getPooledCount(), 1);
+        QCOMPARE(factory.getLoadedLibraryCount(), 1);
+    }
+
+    void shrink() {
+        Factory factory;
+        factory.setInstancePoolSize(3);
+        {
+            vector<shared_ptr<Vamp::Plugin>> plugins;
+            for (int i = 0; i < 3; ++i) {
+                plugins.push_back(factory.instantiateInitialisedPlugin
+                                  (pluginId(), rate, 1, block, block));
+                QVERIFY(plugins[i]);
+            }
+        }
+        QCOMPARE(factory.getPooledCount(), 3);
+
+        factory.setInstancePoolSize(1);
+        QCOMPARE(factory.getPooledCount(), 1);
+        QCOMPARE(factory.getLoadedLibraryCount(), 1);
+
+        // Emptying the pool deletes the last instance, which leaves
+        // the library idle
+        factory.setInstancePoolSize(0);
+        QCOMPARE(factory.getPooledCount(), 0);
+        QCOMPARE(factory.getLoadedLibraryCount(), 1);
+
+        // and with a size of zero, nothing is pooled
+        auto p = factory.instantiateInitialisedPlugin
+            (pluginId(), rate, 1, block, block);
+        QVERIFY(p);
+        p.reset();
+        QCOMPARE(factory.getPooledCount(), 0);
+    }
+};
+
+#endif
@@ -0,0 +1,5 @@
+TEST_HEADERS = \
+	     TestNativeVampPluginFactory.h
+
+TEST_SOURCES += \
+	     svcore-plugin-test.cpp
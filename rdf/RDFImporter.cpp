@@ -14,9 +14,13 @@
 */
 
 #include "RDFImporter.h"
+#include "TurtleStreamReader.h"
 
 #include <map>
+#include <set>
 #include <vector>
+#include <memory>
+#include <atomic>
 
 #include <iostream>
 #include <cmath>
@@ -41,6 +45,9 @@
 #include <dataquay/BasicStore.h>
 #include <dataquay/PropertyObject.h>
 
+#include <QFile>
+#include <QFileInfo>
+
 using Dataquay::Uri;
 using Dataquay::Node;
 using Dataquay::Nodes;
@@ -73,10 +80,38 @@ protected:
 
     std::map<ModelId, std::map<QString, float> > m_labelValueMap;
 
+    // Map from timeline uri to event type to dimensionality to
+    // presence of duration to model id.  Whee!
+    typedef std::map<QString, std::map<QString, std::map<int, std::map<bool, ModelId> > > >
+        SparseModelMap;
+
+    /**
+     * The document as read by the streaming path, if it could be
+     * used. If this is set, nothing was imported into m_store.
+     */
+    struct StreamedDocument;
+    std::unique_ptr<StreamedDocument> m_streamed;
+
+    bool readStreamed(QUrl url);
+    bool handleStreamedStatement(const std::vector<TurtleStreamReader::Triple> &);
+
     void getDataModelsAudio(std::vector<ModelId> &, ProgressReporter *);
     void getDataModelsSparse(std::vector<ModelId> &, ProgressReporter *);
+    void getDataModelsSparseStreamed(std::vector<ModelId> &);
     void getDataModelsDense(std::vector<ModelId> &, ProgressReporter *);
 
+    void loadSignalAudio(std::vector<ModelId> &, QString signal, QString source,
+                         ProgressReporter *);
+
+    template <typename Values>
+    void addDenseModel(std::vector<ModelId> &, QString featureUri,
+                       QString featureTypeUri, Values &values);
+
+    ModelId getSparseModel(std::vector<ModelId> &, SparseModelMap &,
+                           QString source, QString timeline, QString type,
+                           int dimensions, bool haveDuration);
+
+    QString getTitle(QString uri);
     QString getDenseModelTitle(QString featureUri, QString featureTypeUri);
 
     void getDenseFeatureProperties(QString featureUri,
@@ -87,6 +122,255 @@ protected:
                    bool, std::vector<float> &, QString);
 };
 
+typedef TurtleStreamReader::Term StreamTerm;
+typedef TurtleStreamReader::Triple StreamTriple;
+
+static const QString rdfTypeUri("http://www.w3.org/1999/02/22-rdf-syntax-ns#type");
+static const QString rdfsLabelUri("http://www.w3.org/2000/01/rdf-schema#label");
+static const QString dcTitleUri("http://purl.org/dc/elements/1.1/title");
+static const QString moNs("http://purl.org/ontology/mo/");
+static const QString afNs("http://purl.org/ontology/af/");
+static const QString tlNs("http://purl.org/NET/c4dm/timeline.owl#");
+static const QString eventTimeUri("http://purl.org/NET/c4dm/event.owl#time");
+
+static const QString moAudioFileUri(moNs + "AudioFile");
+static const QString moSignalUri(moNs + "Signal");
+static const QString moEncodesUri(moNs + "encodes");
+static const QString moAvailableAsUri(moNs + "available_as");
+static const QString moTimeUri(moNs + "time");
+static const QString afSignalFeatureUri(afNs + "signal_feature");
+static const QString afValueUri(afNs + "value");
+static const QString afDimensionsUri(afNs + "dimensions");
+static const QString afFeatureUri(afNs + "feature");
+static const QString afTextUri(afNs + "text");
+static const QString tlIntervalUri(tlNs + "Interval");
+static const QString tlOnTimeLineUri(tlNs + "onTimeLine");
+static const QString tlAtUri(tlNs + "at");
+static const QString tlBeginsAtUri(tlNs + "beginsAt");
+static const QString tlDurationUri(tlNs + "duration");
+static const QString tlRangeTimeLineUri(tlNs + "rangeTimeLine");
+static const QString tlSampleRateUri(tlNs + "sampleRate");
+static const QString tlHopSizeUri(tlNs + "hopSize");
+static const QString tlWindowLengthUri(tlNs + "windowLength");
+
+/**
+ * A local Turtle file, mapped into memory (or read, if it cannot be
+ * mapped) for reading with TurtleStreamReader.
+ */
+class StreamableFile
+{
+public:
+    StreamableFile(QUrl url) : m_data(nullptr), m_length(0), m_ok(false) {
+
+        if (!url.isLocalFile()) return;
+
+        // TurtleStreamReader reads only the Turtle subset that we
+        // write ourselves, and never RDF/XML
+        QString path = url.toLocalFile();
+        QString extension = QFileInfo(path).suffix().toLower();
+        if (extension != "ttl" && extension != "n3") return;
+
+        m_file.setFileName(path);
+        if (!m_file.open(QFile::ReadOnly)) return;
+
+        qint64 size = m_file.size();
+        if (size > 0) {
+            uchar *mapped = m_file.map(0, size);
+            if (mapped) {
+                m_data = reinterpret_cast<const char *>(mapped);
+            } else {
+                m_contents = m_file.readAll();
+                m_data = m_contents.constData();
+                size = m_contents.size();
+            }
+            m_length = size_t(size);
+        }
+        m_ok = true;
+    }
+
+    bool isOK() const { return m_ok; }
+    const char *getData() const { return m_data; }
+    size_t getLength() const { return m_length; }
+
+private:
+    QFile m_file;
+    QByteArray m_contents;
+    const char *m_data;
+    size_t m_length;
+    bool m_ok;
+
+    StreamableFile(const StreamableFile &) =delete;
+    StreamableFile &operator=(const StreamableFile &) =delete;
+};
+
+static QString
+getTermValue(const StreamTerm *term)
+{
+    if (!term) return {};
+    if (term->type == StreamTerm::Literal) return term->getText();
+    return term->value;
+}
+
+static const StreamTerm *
+findObject(const std::vector<StreamTriple> &triples,
+           const QString &subject, const QString &predicate)
+{
+    for (const auto &t: triples) {
+        if (t.predicate == predicate && t.subject.value == subject) {
+            return &t.object;
+        }
+    }
+    return nullptr;
+}
+
+/**
+ * The parts of a document that we need in order to make models from
+ * it, as gathered in a single pass by TurtleStreamReader.
+ *
+ * Events, which may number in the millions, are decoded as they are
+ * read into compact records, and their triples are not retained; all
+ * other triples are kept, indexed by subject, for the much smaller
+ * number of lookups needed to find signals and dense features. The
+ * values of dense features are left in the file until the models are
+ * made.
+ */
+struct RDFImporterImpl::StreamedDocument
+{
+    StreamedDocument(QUrl url) : file(url), unsupported(false) { }
+
+    StreamableFile file;
+
+    typedef std::multimap<QString, StreamTerm> Properties;
+    std::map<QString, Properties> nodes;
+
+    struct Event {
+        QString type;
+        int timeline; // index into timelines
+        RealTime time;
+        RealTime duration;
+        QString label;
+        std::vector<float> values;
+    };
+    std::vector<Event> events;
+
+    std::vector<QString> timelines;
+    QHash<QString, int> timelineIndex;
+
+    // Set if the document contains something that was valid Turtle,
+    // but that we cannot handle without a complete store
+    bool unsupported;
+
+    const StreamTerm *get(const QString &subject,
+                          const QString &predicate) const {
+        auto i = nodes.find(subject);
+        if (i == nodes.end()) return nullptr;
+        auto j = i->second.find(predicate);
+        if (j == i->second.end()) return nullptr;
+        return &j->second;
+    }
+
+    QString getValue(const QString &subject, const QString &predicate) const {
+        return getTermValue(get(subject, predicate));
+    }
+
+    bool contains(const QString &subject, const QString &predicate,
+                  const QString &object) const {
+        auto i = nodes.find(subject);
+        if (i == nodes.end()) return false;
+        auto range = i->second.equal_range(predicate);
+        for (auto j = range.first; j != range.second; ++j) {
+            if (j->second.type != StreamTerm::Literal &&
+                j->second.value == object) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    std::vector<QString> getSubjects(const QString &predicate,
+                                     const QString &object) const {
+        std::vector<QString> subjects;
+        for (const auto &n: nodes) {
+            if (contains(n.first, predicate, object)) {
+                subjects.push_back(n.first);
+            }
+        }
+        return subjects;
+    }
+
+    std::vector<QString> getObjects(const QString &predicate) const {
+        std::vector<QString> objects;
+        for (const auto &n: nodes) {
+            auto range = n.second.equal_range(predicate);
+            for (auto j = range.first; j != range.second; ++j) {
+                if (j->second.type != StreamTerm::Literal) {
+                    objects.push_back(j->second.value);
+                }
+            }
+        }
+        return objects;
+    }
+};
+
+/**
+ * The values of a dense feature, as a list of strings.
+ */
+class StringListValues
+{
+public:
+    StringListValues(QString value) :
+        m_values(value.split(' ', QString::SkipEmptyParts)),
+        m_index(0) { }
+
+    bool empty() const { return m_values.empty(); }
+
+    bool next(float &f) {
+        if (m_index >= m_values.size()) return false;
+        f = m_values[m_index++].toFloat();
+        return true;
+    }
+
+private:
+    QStringList m_values;
+    int m_index;
+};
+
+/**
+ * The values of a dense feature, parsed directly from the text of
+ * its literal.
+ */
+class TextValues
+{
+public:
+    TextValues(const char *data, size_t length) :
+        m_data(data), m_length(length), m_pos(0) { }
+
+    bool empty() const {
+        for (size_t i = 0; i < m_length; ++i) {
+            if (m_data[i] != ' ') return false;
+        }
+        return true;
+    }
+
+    bool next(float &f) {
+        while (m_pos < m_length && m_data[m_pos] == ' ') ++m_pos;
+        if (m_pos >= m_length) return false;
+        size_t start = m_pos;
+        while (m_pos < m_length && m_data[m_pos] != ' ') ++m_pos;
+        // If this fails, f is still set to whatever QString::toFloat
+        // returned, as StringListValues would use
+        TurtleStreamReader::parseFloat(m_data + start, m_pos - start, f);
+        return true;
+    }
+
+private:
+    const char *m_data;
+    size_t m_length;
+    size_t m_pos;
+};
+
+static std::atomic<bool> streamingEnabled(true);
+
 QString
 RDFImporter::getKnownExtensions()
 {
@@ -127,6 +411,12 @@ RDFImporter::getDataModels(ProgressReporter *r)
     return m_d->getDataModels(r);
 }
 
+void
+RDFImporter::setStreamingEnabled(bool enabled)
+{
+    streamingEnabled = enabled;
+}
+
 RDFImporterImpl::RDFImporterImpl(QString uri, sv_samplerate_t sampleRate) :
     m_store(new BasicStore),
     m_uristring(uri),
@@ -148,12 +438,142 @@ RDFImporterImpl::RDFImporterImpl(QString uri, sv_samplerate_t sampleRate) :
         } else {
             url = QUrl::fromLocalFile(uri);
         }
-        m_store->import(url, BasicStore::ImportIgnoreDuplicates);
+        if (!streamingEnabled || !readStreamed(url)) {
+            m_store->import(url, BasicStore::ImportIgnoreDuplicates);
+        }
     } catch (std::exception &e) {
         m_errorString = e.what();
     }
 }
 
+bool
+RDFImporterImpl::readStreamed(QUrl url)
+{
+    m_streamed.reset(new StreamedDocument(url));
+
+    if (!m_streamed->file.isOK()) {
+        m_streamed.reset();
+        return false;
+    }
+
+    TurtleStreamReader reader(m_streamed->file.getData(),
+                              m_streamed->file.getLength(),
+                              url.toString());
+
+    bool ok = reader.read([this](const std::vector<StreamTriple> &triples) {
+                              return handleStreamedStatement(triples);
+                          });
+
+    if (!ok || m_streamed->unsupported) {
+        SVDEBUG << "RDFImporterImpl::readStreamed: Cannot stream document ("
+                << (ok ? QString("unsupported structure") : reader.getError())
+                << " at byte " << reader.getPosition()
+                << "), falling back to full import" << endl;
+        m_streamed.reset();
+        return false;
+    }
+
+    SVDEBUG << "RDFImporterImpl::readStreamed: Read "
+            << m_streamed->events.size() << " events and "
+            << m_streamed->nodes.size() << " other nodes" << endl;
+    return true;
+}
+
+bool
+RDFImporterImpl::handleStreamedStatement(const std::vector<StreamTriple> &triples)
+{
+    StreamedDocument &d = *m_streamed;
+
+    if (triples.empty()) return true;
+
+    // The triples of any blank nodes nested within a statement come
+    // before those of the statement's own subject
+    const QString &subject = triples.back().subject.value;
+
+    const StreamTerm *tn = findObject(triples, subject, eventTimeUri);
+
+    if (!tn) {
+        for (const auto &t: triples) {
+            d.nodes[t.subject.value].insert({ t.predicate, t.object });
+        }
+        return true;
+    }
+
+    // An event. We can only decode it here if its time is described
+    // within the same statement, as RDFFeatureWriter writes it
+
+    bool timeDescribed = false;
+    for (const auto &t: triples) {
+        if (t.subject.value == tn->value) {
+            timeDescribed = true;
+            break;
+        }
+    }
+    if (tn->type != StreamTerm::Blank || !timeDescribed) {
+        d.unsupported = true;
+        return false;
+    }
+
+    StreamedDocument::Event e;
+
+    e.type = getTermValue(findObject(triples, subject, rdfTypeUri));
+    if (e.type == "") return true;
+
+    QString timeline = getTermValue(findObject(triples, tn->value,
+                                               tlOnTimeLineUri));
+    if (timeline == "") return true;
+
+    auto ti = d.timelineIndex.find(timeline);
+    if (ti == d.timelineIndex.end()) {
+        e.timeline = int(d.timelines.size());
+        d.timelineIndex[timeline] = e.timeline;
+        d.timelines.push_back(timeline);
+    } else {
+        e.timeline = *ti;
+    }
+
+    bool text = (e.type.contains("Text") || e.type.contains("text"));
+    if (text) {
+        e.label = getTermValue(findObject(triples, subject, afTextUri));
+    }
+    if (e.label == "") {
+        e.label = getTermValue(findObject(triples, subject, rdfsLabelUri));
+    }
+
+    const StreamTerm *at = findObject(triples, tn->value, tlAtUri);
+    if (at) {
+        e.time = RealTime::fromXsdDuration(getTermValue(at).toStdString());
+    } else {
+        const StreamTerm *start = findObject(triples, tn->value, tlBeginsAtUri);
+        const StreamTerm *dur = findObject(triples, tn->value, tlDurationUri);
+        if (start && dur) {
+            e.time = RealTime::fromXsdDuration
+                (getTermValue(start).toStdString());
+            e.duration = RealTime::fromXsdDuration
+                (getTermValue(dur).toStdString());
+        }
+    }
+
+    const StreamTerm *feature = findObject(triples, subject, afFeatureUri);
+    if (feature && feature->type == StreamTerm::Literal) {
+        const char *data = feature->data;
+        size_t n = feature->length, i = 0;
+        while (i < n) {
+            while (i < n && data[i] == ' ') ++i;
+            if (i >= n) break;
+            size_t start = i;
+            while (i < n && data[i] != ' ') ++i;
+            float f = 0.f;
+            if (TurtleStreamReader::parseFloat(data + start, i - start, f)) {
+                e.values.push_back(f);
+            }
+        }
+    }
+
+    d.events.push_back(std::move(e));
+    return true;
+}
+
 RDFImporterImpl::~RDFImporterImpl()
 {
     delete m_store;
@@ -211,6 +631,30 @@ void
 RDFImporterImpl::getDataModelsAudio(std::vector<ModelId> &models,
                                     ProgressReporter *reporter)
 {
+    if (m_streamed) {
+
+        const StreamedDocument &d = *m_streamed;
+
+        for (QString signal: d.getSubjects(rdfTypeUri, moSignalUri)) {
+
+            std::vector<QString> files = d.getSubjects(moEncodesUri, signal);
+            QString source;
+            if (!files.empty()) {
+                source = files[0];
+            } else {
+                source = d.getValue(signal, moAvailableAsUri);
+            }
+            if (source == "") {
+                cerr << "RDFImporterImpl::getDataModelsAudio: ERROR: No source for signal " << signal << endl;
+                continue;
+            }
+
+            loadSignalAudio(models, signal, source, reporter);
+        }
+
+        return;
+    }
+
     Nodes sigs = m_store->match
         (Triple(Node(), Uri("a"), expand("mo:Signal"))).subjects();
 
@@ -225,68 +669,73 @@ RDFImporterImpl::getDataModelsAudio(std::vector<ModelId> &models,
             continue;
         }
 
-        QString signal = sig.value;
-        QString source = file.value;
+        loadSignalAudio(models, sig.value, file.value, reporter);
+    }
+}
+
+void
+RDFImporterImpl::loadSignalAudio(std::vector<ModelId> &models,
+                                 QString signal, QString source,
+                                 ProgressReporter *reporter)
+{
+    SVDEBUG << "NOTE: Seeking signal source \"" << source
+            << "\"..." << endl;
 
-        SVDEBUG << "NOTE: Seeking signal source \"" << source
+    FileSource *fs = new FileSource(source, reporter);
+    if (fs->isAvailable()) {
+        SVDEBUG << "NOTE: Source is available: Local filename is \""
+                << fs->getLocalFilename()
                 << "\"..." << endl;
+    }
 
-        FileSource *fs = new FileSource(source, reporter);
-        if (fs->isAvailable()) {
-            SVDEBUG << "NOTE: Source is available: Local filename is \""
-                    << fs->getLocalFilename()
-                    << "\"..." << endl;
-        }
-            
 #ifdef NO_SV_GUI
-        if (!fs->isAvailable()) {
-            m_errorString = QString("Signal source \"%1\" is not available").arg(source);
-            delete fs;
-            continue;
-        }
+    if (!fs->isAvailable()) {
+        m_errorString = QString("Signal source \"%1\" is not available").arg(source);
+        delete fs;
+        return;
+    }
 #else
-        if (!fs->isAvailable()) {
-            SVDEBUG << "NOTE: Signal source \"" << source
-                    << "\" is not available, using file finder..." << endl;
-            FileFinder *ff = FileFinder::getInstance();
-            if (ff) {
-                QString path = ff->find(FileFinder::AudioFile,
-                                        fs->getLocation(),
-                                        m_uristring);
-                if (path != "") {
-                    cerr << "File finder returns: \"" << path
-                              << "\"" << endl;
+    if (!fs->isAvailable()) {
+        SVDEBUG << "NOTE: Signal source \"" << source
+                << "\" is not available, using file finder..." << endl;
+        FileFinder *ff = FileFinder::getInstance();
+        if (ff) {
+            QString path = ff->find(FileFinder::AudioFile,
+                                    fs->getLocation(),
+                                    m_uristring);
+            if (path != "") {
+                cerr << "File finder returns: \"" << path
+                          << "\"" << endl;
+                delete fs;
+                fs = new FileSource(path, reporter);
+                if (!fs->isAvailable()) {
                     delete fs;
-                    fs = new FileSource(path, reporter);
-                    if (!fs->isAvailable()) {
-                        delete fs;
-                        m_errorString = QString("Signal source \"%1\" is not available").arg(source);
-                        continue;
-                    }
+                    m_errorString = QString("Signal source \"%1\" is not available").arg(source);
+                    return;
                 }
             }
         }
+    }
 #endif
 
-        if (reporter) {
-            reporter->setMessage(RDFImporter::tr("Importing audio referenced in RDF..."));
-        }
-        fs->waitForData();
-        auto newModel = std::make_shared<ReadOnlyWaveFileModel>
-            (*fs, m_sampleRate);
-        if (newModel->isOK()) {
-            cerr << "Successfully created wave file model from source at \"" << source << "\"" << endl;
-            auto modelId = ModelById::add(newModel);
-            models.push_back(modelId);
-            m_audioModelMap[signal] = modelId;
-            if (m_sampleRate == 0) {
-                m_sampleRate = newModel->getSampleRate();
-            }
-        } else {
-            m_errorString = QString("Failed to create wave file model from source at \"%1\"").arg(source);
+    if (reporter) {
+        reporter->setMessage(RDFImporter::tr("Importing audio referenced in RDF..."));
+    }
+    fs->waitForData();
+    auto newModel = std::make_shared<ReadOnlyWaveFileModel>
+        (*fs, m_sampleRate);
+    if (newModel->isOK()) {
+        cerr << "Successfully created wave file model from source at \"" << source << "\"" << endl;
+        auto modelId = ModelById::add(newModel);
+        models.push_back(modelId);
+        m_audioModelMap[signal] = modelId;
+        if (m_sampleRate == 0) {
+            m_sampleRate = newModel->getSampleRate();
         }
-        delete fs;
+    } else {
+        m_errorString = QString("Failed to create wave file model from source at \"%1\"").arg(source);
     }
+    delete fs;
 }
 
 void
@@ -297,6 +746,28 @@ RDFImporterImpl::getDataModelsDense(std::vector<ModelId> &models,
         reporter->setMessage(RDFImporter::tr("Importing dense signal data from RDF..."));
     }
 
+    if (m_streamed) {
+
+        const StreamedDocument &d = *m_streamed;
+
+        for (QString feature: d.getObjects(afSignalFeatureUri)) {
+
+            QString type = d.getValue(feature, rdfTypeUri);
+            const StreamTerm *v = d.get(feature, afValueUri);
+
+            if (type == "" || !v || v->type != StreamTerm::Literal ||
+                v->length == 0) {
+                continue;
+            }
+
+            // The values are parsed straight from the file
+            TextValues values(v->data, v->length);
+            addDenseModel(models, feature, type, values);
+        }
+
+        return;
+    }
+
     Nodes sigFeatures = m_store->match
         (Triple(Node(), expand("af:signal_feature"), Node())).objects();
 
@@ -313,97 +784,125 @@ RDFImporterImpl::getDataModelsDense(std::vector<ModelId> &models,
         
         if (type == "" || value == "") continue;
 
-        sv_samplerate_t sampleRate = 0;
-        int windowLength = 0;
-        int hopSize = 0;
-        int width = 0;
-        int height = 0;
-        getDenseFeatureProperties
-            (feature, sampleRate, windowLength, hopSize, width, height);
+        StringListValues values(value);
+        addDenseModel(models, feature, type, values);
+    }
+}
 
-        if (sampleRate != 0 && sampleRate != m_sampleRate) {
-            cerr << "WARNING: Sample rate in dense feature description does not match our underlying rate -- using rate from feature description" << endl;
-        }
-        if (sampleRate == 0) sampleRate = m_sampleRate;
+template <typename Values>
+void
+RDFImporterImpl::addDenseModel(std::vector<ModelId> &models,
+                               QString feature, QString type,
+                               Values &values)
+{
+    sv_samplerate_t sampleRate = 0;
+    int windowLength = 0;
+    int hopSize = 0;
+    int width = 0;
+    int height = 0;
+    getDenseFeatureProperties
+        (feature, sampleRate, windowLength, hopSize, width, height);
+
+    if (sampleRate != 0 && sampleRate != m_sampleRate) {
+        cerr << "WARNING: Sample rate in dense feature description does not match our underlying rate -- using rate from feature description" << endl;
+    }
+    if (sampleRate == 0) sampleRate = m_sampleRate;
 
-        if (hopSize == 0) {
-            cerr << "WARNING: Dense feature description does not specify a hop size -- assuming 1" << endl;
-            hopSize = 1;
-        }
+    if (hopSize == 0) {
+        cerr << "WARNING: Dense feature description does not specify a hop size -- assuming 1" << endl;
+        hopSize = 1;
+    }
 
-        if (height == 0) {
-            cerr << "WARNING: Dense feature description does not specify feature signal dimensions -- assuming one-dimensional (height = 1)" << endl;
-            height = 1;
-        }
+    if (height == 0) {
+        cerr << "WARNING: Dense feature description does not specify feature signal dimensions -- assuming one-dimensional (height = 1)" << endl;
+        height = 1;
+    }
 
-        QStringList values = value.split(' ', QString::SkipEmptyParts);
+    if (values.empty()) {
+        cerr << "WARNING: Dense feature description does not specify any values!" << endl;
+        return;
+    }
 
-        if (values.empty()) {
-            cerr << "WARNING: Dense feature description does not specify any values!" << endl;
-            continue;
-        }
+    float f = 0.f;
 
-        if (height == 1) {
+    if (height == 1) {
 
-            auto m = std::make_shared<SparseTimeValueModel>
-                (sampleRate, hopSize, false);
+        auto m = std::make_shared<SparseTimeValueModel>
+            (sampleRate, hopSize, false);
 
-            for (int j = 0; j < values.size(); ++j) {
-                float f = values[j].toFloat();
-                Event e(j * hopSize, f, "");
-                m->add(e);
-            }
+        for (sv_frame_t j = 0; values.next(f); ++j) {
+            Event e(j * hopSize, f, "");
+            m->add(e);
+        }
 
-            m->setObjectName(getDenseModelTitle(feature, type));
-            m->setRDFTypeURI(type);
-            models.push_back(ModelById::add(m));
+        m->setObjectName(getDenseModelTitle(feature, type));
+        m->setRDFTypeURI(type);
+        models.push_back(ModelById::add(m));
 
-        } else {
+    } else {
 
-            auto m = std::make_shared<EditableDenseThreeDimensionalModel>
-                (sampleRate, hopSize, height, false);
+        auto m = std::make_shared<EditableDenseThreeDimensionalModel>
+            (sampleRate, hopSize, height, false);
             
-            EditableDenseThreeDimensionalModel::Column column;
-
-            int x = 0;
+        EditableDenseThreeDimensionalModel::Column column;
+        column.reserve(height);
 
-            for (int j = 0; j < values.size(); ++j) {
-                if (j % height == 0 && !column.empty()) {
-                    m->setColumn(x++, column);
-                    column.clear();
-                }
-                column.push_back(values[j].toFloat());
-            }
+        int x = 0;
 
-            if (!column.empty()) {
+        for (int j = 0; values.next(f); ++j) {
+            if (j % height == 0 && !column.empty()) {
                 m->setColumn(x++, column);
+                column.clear();
             }
+            column.push_back(f);
+        }
 
-            m->setObjectName(getDenseModelTitle(feature, type));
-            m->setRDFTypeURI(type);
-            models.push_back(ModelById::add(m));
+        if (!column.empty()) {
+            m->setColumn(x++, column);
         }
+
+        m->setObjectName(getDenseModelTitle(feature, type));
+        m->setRDFTypeURI(type);
+        models.push_back(ModelById::add(m));
     }
 }
 
 QString
-RDFImporterImpl::getDenseModelTitle(QString featureUri,
-                                    QString featureTypeUri)
+RDFImporterImpl::getTitle(QString uri)
 {
+    if (m_streamed) {
+        const StreamTerm *t = m_streamed->get(uri, dcTitleUri);
+        if (t && t->type == StreamTerm::Literal) {
+            return t->getText();
+        }
+        return {};
+    }
+
     Node n = m_store->complete
-        (Triple(Uri(featureUri), expand("dc:title"), Node()));
+        (Triple(Uri(uri), expand("dc:title"), Node()));
 
-    if (n.type == Node::Literal && n.value != "") {
-        SVDEBUG << "RDFImporterImpl::getDenseModelTitle: Title (from signal) \"" << n.value << "\"" << endl;
+    if (n.type == Node::Literal) {
         return n.value;
     }
+    return {};
+}
+
+QString
+RDFImporterImpl::getDenseModelTitle(QString featureUri,
+                                    QString featureTypeUri)
+{
+    QString title = getTitle(featureUri);
+
+    if (title != "") {
+        SVDEBUG << "RDFImporterImpl::getDenseModelTitle: Title (from signal) \"" << title << "\"" << endl;
+        return title;
+    }
 
-    n = m_store->complete
-        (Triple(Uri(featureTypeUri), expand("dc:title"), Node()));
+    title = getTitle(featureTypeUri);
 
-    if (n.type == Node::Literal && n.value != "") {
-        SVDEBUG << "RDFImporterImpl::getDenseModelTitle: Title (from signal type) \"" << n.value << "\"" << endl;
-        return n.value;
+    if (title != "") {
+        SVDEBUG << "RDFImporterImpl::getDenseModelTitle: Title (from signal type) \"" << title << "\"" << endl;
+        return title;
     }
 
     SVDEBUG << "RDFImporterImpl::getDenseModelTitle: No title available for feature <" << featureUri << ">" << endl;
@@ -415,14 +914,26 @@ RDFImporterImpl::getDenseFeatureProperties(QString featureUri,
                                            sv_samplerate_t &sampleRate, int &windowLength,
                                            int &hopSize, int &width, int &height)
 {
-    Node dim = m_store->complete
-        (Triple(Uri(featureUri), expand("af:dimensions"), Node()));
+    QString dimensions;
+
+    if (m_streamed) {
+        const StreamTerm *dim = m_streamed->get(featureUri, afDimensionsUri);
+        if (dim && dim->type == StreamTerm::Literal) {
+            dimensions = dim->getText();
+        }
+    } else {
+        Node dim = m_store->complete
+            (Triple(Uri(featureUri), expand("af:dimensions"), Node()));
+        if (dim.type == Node::Literal) {
+            dimensions = dim.value;
+        }
+    }
 
-    cerr << "Dimensions = \"" << dim.value << "\"" << endl;
+    cerr << "Dimensions = \"" << dimensions << "\"" << endl;
 
-    if (dim.type == Node::Literal && dim.value != "") {
-        QStringList dl = dim.value.split(" ");
-        if (dl.empty()) dl.push_back(dim.value);
+    if (dimensions != "") {
+        QStringList dl = dimensions.split(" ");
+        if (dl.empty()) dl.push_back(dimensions);
         if (dl.size() > 0) height = dl[0].toInt();
         if (dl.size() > 1) width = dl[1].toInt();
     }
@@ -437,6 +948,48 @@ RDFImporterImpl::getDenseFeatureProperties(QString featureUri,
     // ?map tl:hopSize ?hop .
     // ?map tl:windowLength ?window .
 
+    if (m_streamed) {
+
+        const StreamedDocument &d = *m_streamed;
+
+        QString interval = d.getValue(featureUri, moTimeUri);
+
+        if (!d.contains(interval, rdfTypeUri, tlIntervalUri)) {
+            cerr << "RDFImporterImpl::getDenseFeatureProperties: Feature time node "
+                 << interval << " is not a tl:Interval" << endl;
+            return;
+        }
+
+        QString tl = d.getValue(interval, tlOnTimeLineUri);
+
+        if (tl == "") {
+            cerr << "RDFImporterImpl::getDenseFeatureProperties: Interval node "
+                 << interval << " lacks tl:onTimeLine property" << endl;
+            return;
+        }
+
+        std::vector<QString> maps = d.getSubjects(tlRangeTimeLineUri, tl);
+
+        if (maps.empty()) {
+            cerr << "RDFImporterImpl::getDenseFeatureProperties: No map for "
+                 << "timeline node " << tl << endl;
+            return;
+        }
+
+        if (d.get(maps[0], tlSampleRateUri)) {
+            sampleRate = d.getValue(maps[0], tlSampleRateUri).toDouble();
+        }
+        if (d.get(maps[0], tlHopSizeUri)) {
+            hopSize = d.getValue(maps[0], tlHopSizeUri).toInt();
+        }
+        if (d.get(maps[0], tlWindowLengthUri)) {
+            windowLength = d.getValue(maps[0], tlWindowLengthUri).toInt();
+        }
+
+        cerr << "sr = " << sampleRate << ", hop = " << hopSize << ", win = " << windowLength << endl;
+        return;
+    }
+
     Node interval = m_store->complete(Triple(Uri(featureUri), expand("mo:time"), Node()));
 
     if (!m_store->contains(Triple(interval, expand("a"), expand("tl:Interval")))) {
@@ -501,13 +1054,15 @@ RDFImporterImpl::getDataModelsSparse(std::vector<ModelId> &models,
       different models.
     */
 
+    if (m_streamed) {
+        getDataModelsSparseStreamed(models);
+        return;
+    }
+
     Nodes sigs = m_store->match
         (Triple(Node(), expand("a"), expand("mo:Signal"))).subjects();
 
-    // Map from timeline uri to event type to dimensionality to
-    // presence of duration to model id.  Whee!
-    std::map<QString, std::map<QString, std::map<int, std::map<bool, ModelId> > > >
-        modelMap;
+    SparseModelMap modelMap;
 
     foreach (Node sig, sigs) {
         
@@ -559,7 +1114,6 @@ RDFImporterImpl::getDataModelsSparse(std::vector<ModelId> &models,
 
                 QString label = "";
                 bool text = (type.contains("Text") || type.contains("text")); // Ha, ha
-                bool note = (type.contains("Note") || type.contains("note")); // Guffaw
 
                 if (text) {
                     label = m_store->complete(Triple(thing, expand("af:text"), Node())).value;
@@ -612,87 +1166,147 @@ RDFImporterImpl::getDataModelsSparse(std::vector<ModelId> &models,
                 if (values.size() == 1) dimensions = 2;
                 else if (values.size() > 1) dimensions = 3;
 
-                ModelId modelId;
+                ModelId modelId = getSparseModel
+                    (models, modelMap, source, timeline, type,
+                     dimensions, haveDuration);
 
-                if (modelMap[timeline][type][dimensions].find(haveDuration) ==
-                    modelMap[timeline][type][dimensions].end()) {
+                if (!modelId.isNone()) {
+                    sv_frame_t ftime =
+                        RealTime::realTime2Frame(time, m_sampleRate);
+                    sv_frame_t fduration =
+                        RealTime::realTime2Frame(duration, m_sampleRate);
+                    fillModel(modelId, ftime, fduration,
+                              haveDuration, values, label);
+                }
+            }
+        }
+    }
+}
 
-/*
-            SVDEBUG << "Creating new model: source = " << source                      << ", type = " << type << ", dimensions = "
-                      << dimensions << ", haveDuration = " << haveDuration
-                      << ", time = " << time << ", duration = " << duration
-                      << endl;
-*/
+ModelId
+RDFImporterImpl::getSparseModel(std::vector<ModelId> &models,
+                                SparseModelMap &modelMap,
+                                QString source,
+                                QString timeline,
+                                QString type,
+                                int dimensions,
+                                bool haveDuration)
+{
+    auto &byDuration = modelMap[timeline][type][dimensions];
 
-                    Model *model = nullptr;
-                    
-                    if (!haveDuration) {
-
-                        if (dimensions == 1) {
-                            if (text) {
-                                model = new TextModel(m_sampleRate, 1, false);
-                            } else {
-                                model = new SparseOneDimensionalModel(m_sampleRate, 1, false);
-                            }
-                        } else if (dimensions == 2) {
-                            if (text) {
-                                model = new TextModel(m_sampleRate, 1, false);
-                            } else {
-                                model = new SparseTimeValueModel(m_sampleRate, 1, false);
-                            }
-                        } else {
-                            // We don't have a three-dimensional sparse model,
-                            // so use a note model.  We do have some logic (in
-                            // extractStructure below) for guessing whether
-                            // this should after all have been a dense model,
-                            // but it's hard to apply it because we don't have
-                            // all the necessary timing data yet... hmm
-                            model = new NoteModel(m_sampleRate, 1, false);
-                        }
-
-                    } else { // haveDuration
-
-                        if (note || (dimensions > 2)) {
-                            model = new NoteModel(m_sampleRate, 1, false);
-                        } else {
-                            // If our units are frequency or midi pitch, we
-                            // should be using a note model... hm
-                            model = new RegionModel(m_sampleRate, 1, false);
-                        }
-                    }
+    if (byDuration.find(haveDuration) == byDuration.end()) {
 
-                    model->setRDFTypeURI(type);
+        bool text = (type.contains("Text") || type.contains("text")); // Ha, ha
+        bool note = (type.contains("Note") || type.contains("note")); // Guffaw
 
-                    if (m_audioModelMap.find(source) != m_audioModelMap.end()) {
-                        cerr << "source model for " << model << " is " << m_audioModelMap[source] << endl;
-                        model->setSourceModel(m_audioModelMap[source]);
-                    }
+        Model *model = nullptr;
 
-                    QString title = m_store->complete
-                        (Triple(typ, expand("dc:title"), Node())).value;
-                    if (title == "") {
-                        // take it from the end of the event type
-                        title = type;
-                        title.replace(QRegExp("^.*[/#]"), "");
-                    }
-                    model->setObjectName(title);
+        if (!haveDuration) {
 
-                    modelId = ModelById::add(std::shared_ptr<Model>(model));
-                    modelMap[timeline][type][dimensions][haveDuration] = modelId;
-                    models.push_back(modelId);
+            if (dimensions == 1) {
+                if (text) {
+                    model = new TextModel(m_sampleRate, 1, false);
+                } else {
+                    model = new SparseOneDimensionalModel(m_sampleRate, 1, false);
+                }
+            } else if (dimensions == 2) {
+                if (text) {
+                    model = new TextModel(m_sampleRate, 1, false);
+                } else {
+                    model = new SparseTimeValueModel(m_sampleRate, 1, false);
                 }
+            } else {
+                // We don't have a three-dimensional sparse model,
+                // so use a note model.  We do have some logic (in
+                // extractStructure below) for guessing whether
+                // this should after all have been a dense model,
+                // but it's hard to apply it because we don't have
+                // all the necessary timing data yet... hmm
+                model = new NoteModel(m_sampleRate, 1, false);
+            }
 
-                modelId = modelMap[timeline][type][dimensions][haveDuration];
+        } else { // haveDuration
 
-                if (!modelId.isNone()) {
-                    sv_frame_t ftime =
-                        RealTime::realTime2Frame(time, m_sampleRate);
-                    sv_frame_t fduration =
-                        RealTime::realTime2Frame(duration, m_sampleRate);
-                    fillModel(modelId, ftime, fduration,
-                              haveDuration, values, label);
-                }
+            if (note || (dimensions > 2)) {
+                model = new NoteModel(m_sampleRate, 1, false);
+            } else {
+                // If our units are frequency or midi pitch, we
+                // should be using a note model... hm
+                model = new RegionModel(m_sampleRate, 1, false);
+            }
+        }
+
+        model->setRDFTypeURI(type);
+
+        if (m_audioModelMap.find(source) != m_audioModelMap.end()) {
+            cerr << "source model for " << model << " is " << m_audioModelMap[source] << endl;
+            model->setSourceModel(m_audioModelMap[source]);
+        }
+
+        QString title = getTitle(type);
+        if (title == "") {
+            // take it from the end of the event type
+            title = type;
+            title.replace(QRegExp("^.*[/#]"), "");
+        }
+        model->setObjectName(title);
+
+        ModelId modelId = ModelById::add(std::shared_ptr<Model>(model));
+        byDuration[haveDuration] = modelId;
+        models.push_back(modelId);
+    }
+
+    return byDuration[haveDuration];
+}
+
+void
+RDFImporterImpl::getDataModelsSparseStreamed(std::vector<ModelId> &models)
+{
+    // As getDataModelsSparse, but with the events already decoded
+
+    StreamedDocument &d = *m_streamed;
+
+    SparseModelMap modelMap;
+
+    for (QString signal: d.getSubjects(rdfTypeUri, moSignalUri)) {
+
+        QString interval = d.getValue(signal, moTimeUri);
+        if (interval == "") continue;
+
+        QString timeline = d.getValue(interval, tlOnTimeLineUri);
+        if (timeline == "") continue;
+
+        auto ti = d.timelineIndex.find(timeline);
+        if (ti == d.timelineIndex.end()) continue;
+        int timelineIndex = *ti;
+
+        // Events of one type are usually written together, so we
+        // only need to look up the model again when the type changes
+        QString type;
+        int dimensions = 0;
+        ModelId modelId;
+
+        for (auto &e: d.events) {
+
+            if (e.timeline != timelineIndex) continue;
+
+            int eventDimensions = 1;
+            if (e.values.size() == 1) eventDimensions = 2;
+            else if (e.values.size() > 1) eventDimensions = 3;
+
+            if (modelId.isNone() ||
+                eventDimensions != dimensions || e.type != type) {
+                type = e.type;
+                dimensions = eventDimensions;
+                modelId = getSparseModel(models, modelMap, signal, timeline,
+                                         type, dimensions, false);
             }
+
+            sv_frame_t ftime =
+                RealTime::realTime2Frame(e.time, m_sampleRate);
+            sv_frame_t fduration =
+                RealTime::realTime2Frame(e.duration, m_sampleRate);
+            fillModel(modelId, ftime, fduration, false, e.values, e.label);
         }
     }
 }
@@ -791,6 +1405,80 @@ RDFImporterImpl::fillModel(ModelId modelId,
     return;
 }
 
+static RDFImporter::RDFDocumentType
+getDocumentType(bool haveAudio, bool haveAnnotations)
+{
+    if (haveAudio) {
+        if (haveAnnotations) {
+            return RDFImporter::AudioRefAndAnnotations;
+        } else {
+            return RDFImporter::AudioRef;
+        }
+    } else {
+        if (haveAnnotations) {
+            return RDFImporter::Annotations;
+        } else {
+            return RDFImporter::OtherRDFDocument;
+        }
+    }
+}
+
+/**
+ * Look for the same things as identifyDocumentType, in a single pass
+ * with TurtleStreamReader, stopping as soon as both audio and
+ * annotations have been found. Return false if the document cannot
+ * be read this way.
+ */
+static bool
+identifyStreamed(QUrl url, bool &haveRDF, bool &haveAudio,
+                 bool &haveAnnotations)
+{
+    StreamableFile file(url);
+    if (!file.isOK()) return false;
+
+    std::set<QString> signalUris;
+    std::set<QString> availableUris;
+
+    TurtleStreamReader reader(file.getData(), file.getLength(),
+                              url.toString());
+
+    bool ok = reader.read([&](const std::vector<StreamTriple> &triples) {
+            for (const auto &t: triples) {
+                haveRDF = true;
+                if (t.predicate == eventTimeUri ||
+                    t.predicate == afSignalFeatureUri) {
+                    haveAnnotations = true;
+                } else if (t.predicate == rdfTypeUri) {
+                    if (t.object.value == moAudioFileUri &&
+                        t.subject.type == StreamTerm::URI) {
+                        haveAudio = true;
+                    } else if (t.object.value == moSignalUri) {
+                        signalUris.insert(t.subject.value);
+                    }
+                } else if (t.predicate == moAvailableAsUri) {
+                    availableUris.insert(t.subject.value);
+                }
+            }
+            return !(haveAudio && haveAnnotations);
+        });
+
+    if (!ok) {
+        haveRDF = haveAudio = haveAnnotations = false;
+        return false;
+    }
+
+    if (!haveAudio) {
+        for (const auto &s: signalUris) {
+            if (availableUris.find(s) != availableUris.end()) {
+                haveAudio = true;
+                break;
+            }
+        }
+    }
+
+    return true;
+}
+
 RDFImporter::RDFDocumentType
 RDFImporter::identifyDocumentType(QUrl url)
 {
@@ -802,6 +1490,16 @@ RDFImporter::identifyDocumentType(QUrl url)
         return NotRDF;
     }
 
+    if (identifyStreamed(url, haveRDF, haveAudio, haveAnnotations)) {
+        SVDEBUG << "NOTE: RDFImporter::identifyDocumentType: streamed: haveAudio = "
+                << haveAudio << ", haveAnnotations = " << haveAnnotations
+                << endl;
+        if (!haveRDF) {
+            return NotRDF;
+        }
+        return getDocumentType(haveAudio, haveAnnotations);
+    }
+
     BasicStore *store = nullptr;
     
     // This is not expected to return anything useful, but if it does
@@ -868,21 +1566,7 @@ RDFImporter::identifyDocumentType(QUrl url)
 
     delete store;
 
-    if (haveAudio) {
-        if (haveAnnotations) {
-            return AudioRefAndAnnotations;
-        } else {
-            return AudioRef;
-        }
-    } else {
-        if (haveAnnotations) {
-            return Annotations;
-        } else {
-            return OtherRDFDocument;
-        }
-    }
-
-    return OtherRDFDocument;
+    return getDocumentType(haveAudio, haveAnnotations);
 }
 
 bool
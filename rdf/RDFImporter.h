@@ -65,6 +65,14 @@ public:
     static RDFDocumentType identifyDocumentType(QUrl url);
 
     static bool isPlausibleDocumentOfAnyKind(QUrl url);
+
+    /**
+     * Enable or disable reading of local Turtle documents with
+     * TurtleStreamReader where it can handle them. It is enabled by
+     * default; when disabled, every document is imported through the
+     * complete RDF parser (for testing).
+     */
+    static void setStreamingEnabled(bool enabled);
     
 protected:
     RDFImporterImpl *m_d;
@@ -0,0 +1,587 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#include "TurtleStreamReader.h"
+
+#include <QUrl>
+
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+
+const QString
+TurtleStreamReader::rdfType("http://www.w3.org/1999/02/22-rdf-syntax-ns#type");
+
+static const QString xsdPrefix("http://www.w3.org/2001/XMLSchema#");
+
+static bool
+isNameChar(char c)
+{
+    return ((unsigned char)c > ' ' && !strchr(";,[]()<>\"'{}^@#\\", c));
+}
+
+static bool
+isDigit(char c)
+{
+    return (c >= '0' && c <= '9');
+}
+
+TurtleStreamReader::TurtleStreamReader(const char *data, size_t length,
+                                       QString baseUri) :
+    m_data(data),
+    m_length(length),
+    m_pos(0),
+    m_base(baseUri),
+    m_blankCount(0)
+{
+}
+
+bool
+TurtleStreamReader::fail(QString message)
+{
+    int line = 1 + int(std::count(m_data, m_data + m_pos, '\n'));
+    m_error = QString("%1 at line %2").arg(message).arg(line);
+    return false;
+}
+
+bool
+TurtleStreamReader::expect(char c)
+{
+    skipSpace();
+    if (peek() != c) {
+        return fail(QString("Expected '%1'").arg(c));
+    }
+    ++m_pos;
+    return true;
+}
+
+void
+TurtleStreamReader::skipSpace()
+{
+    while (m_pos < m_length) {
+        char c = m_data[m_pos];
+        if (c == ' ' || c == '\t' || c == '\n' || c == '\r') {
+            ++m_pos;
+        } else if (c == '#') {
+            while (m_pos < m_length && m_data[m_pos] != '\n') {
+                ++m_pos;
+            }
+        } else {
+            break;
+        }
+    }
+}
+
+bool
+TurtleStreamReader::read(StatementHandler handler)
+{
+    while (true) {
+
+        skipSpace();
+        if (m_pos >= m_length) {
+            return true;
+        }
+
+        if (peek() == '@') {
+            if (!readPrefixDirective()) {
+                return false;
+            }
+            continue;
+        }
+
+        m_triples.clear();
+
+        Term subject;
+        if (!readTerm(subject, false)) {
+            return false;
+        }
+        if (subject.type == Term::Literal) {
+            return fail("Literal subject");
+        }
+
+        // A blank node property list may stand alone as a statement
+        skipSpace();
+        if (!(subject.type == Term::Blank && peek() == '.')) {
+            if (!readPredicateObjectList(subject)) {
+                return false;
+            }
+        }
+
+        if (!expect('.')) {
+            return false;
+        }
+
+        if (!handler(m_triples)) {
+            return true;
+        }
+    }
+}
+
+bool
+TurtleStreamReader::readPrefixDirective()
+{
+    static const char *directive = "@prefix";
+    size_t n = strlen(directive);
+    if (m_length - m_pos < n || strncmp(m_data + m_pos, directive, n) ||
+        !(m_pos + n < m_length && isspace((unsigned char)m_data[m_pos + n]))) {
+        return fail("Unsupported directive");
+    }
+    m_pos += n;
+
+    skipSpace();
+    size_t start = m_pos;
+    while (m_pos < m_length && m_data[m_pos] != ':' &&
+           isNameChar(m_data[m_pos])) {
+        ++m_pos;
+    }
+    if (peek() != ':') {
+        return fail("Expected prefix name");
+    }
+    QByteArray prefix(m_data + start, int(m_pos - start));
+    ++m_pos;
+
+    skipSpace();
+    QString uri;
+    if (!readIRI(uri)) {
+        return false;
+    }
+    m_prefixes[prefix] = uri;
+    m_nameCache.clear();
+
+    return expect('.');
+}
+
+bool
+TurtleStreamReader::readPredicateObjectList(const Term &subject)
+{
+    while (true) {
+
+        QString predicate;
+        if (!readVerb(predicate)) {
+            return false;
+        }
+
+        while (true) {
+            Triple t;
+            t.subject = subject;
+            t.predicate = predicate;
+            // Cache type names, which recur, but not other objects,
+            // which are mostly unique
+            if (!readTerm(t.object, predicate == rdfType)) {
+                return false;
+            }
+            m_triples.push_back(t);
+            skipSpace();
+            if (peek() != ',') {
+                break;
+            }
+            ++m_pos;
+        }
+
+        skipSpace();
+        if (peek() != ';') {
+            return true;
+        }
+        while (peek() == ';') {
+            ++m_pos;
+            skipSpace();
+        }
+        char c = peek();
+        if (c == '.' || c == ']') {
+            return true;
+        }
+    }
+}
+
+bool
+TurtleStreamReader::readVerb(QString &predicate)
+{
+    skipSpace();
+    if (peek() == 'a' && m_pos + 1 < m_length &&
+        !isNameChar(m_data[m_pos + 1])) {
+        ++m_pos;
+        predicate = rdfType;
+        return true;
+    }
+    Term term;
+    if (!readTerm(term, true)) {
+        return false;
+    }
+    if (term.type != Term::URI) {
+        return fail("Expected predicate");
+    }
+    predicate = term.value;
+    return true;
+}
+
+bool
+TurtleStreamReader::readTerm(Term &term, bool cacheName)
+{
+    skipSpace();
+    if (m_pos >= m_length) {
+        return fail("Unexpected end of document");
+    }
+
+    char c = m_data[m_pos];
+
+    if (c == '<') {
+        term.type = Term::URI;
+        return readIRI(term.value);
+    }
+
+    if (c == '"' || c == '\'') {
+        return readLiteral(term);
+    }
+
+    if (c == '[') {
+        return readBlank(term);
+    }
+
+    if (c == '_' && m_pos + 1 < m_length && m_data[m_pos + 1] == ':') {
+        size_t start = m_pos;
+        m_pos += 2;
+        while (m_pos < m_length && isNameChar(m_data[m_pos])) {
+            ++m_pos;
+        }
+        while (m_pos > start + 2 && m_data[m_pos - 1] == '.') {
+            --m_pos;
+        }
+        term.type = Term::Blank;
+        term.value = QString::fromUtf8(m_data + start, int(m_pos - start));
+        return true;
+    }
+
+    if (isDigit(c) || c == '+' || c == '-' ||
+        (c == '.' && m_pos + 1 < m_length && isDigit(m_data[m_pos + 1]))) {
+        size_t start = m_pos;
+        bool isDouble = false, isDecimal = false;
+        while (m_pos < m_length) {
+            char d = m_data[m_pos];
+            if (d == 'e' || d == 'E') {
+                isDouble = true;
+            } else if (d == '.') {
+                // A full stop not followed by a digit ends the statement
+                if (!(m_pos + 1 < m_length && isDigit(m_data[m_pos + 1]))) {
+                    break;
+                }
+                isDecimal = true;
+            } else if (!(isDigit(d) || d == '+' || d == '-')) {
+                break;
+            }
+            ++m_pos;
+        }
+        term.type = Term::Literal;
+        term.data = m_data + start;
+        term.length = m_pos - start;
+        term.datatype = xsdPrefix + (isDouble ? "double" :
+                                     isDecimal ? "decimal" : "integer");
+        return true;
+    }
+
+    for (const char *word: { "true", "false" }) {
+        size_t n = strlen(word);
+        if (m_length - m_pos >= n && !strncmp(m_data + m_pos, word, n) &&
+            !(m_pos + n < m_length && isNameChar(m_data[m_pos + n]) &&
+              m_data[m_pos + n] != '.')) {
+            term.type = Term::Literal;
+            term.data = m_data + m_pos;
+            term.length = n;
+            term.datatype = xsdPrefix + "boolean";
+            m_pos += n;
+            return true;
+        }
+    }
+
+    if (c == '(') {
+        return fail("Collections are not supported");
+    }
+
+    term.type = Term::URI;
+    return readPrefixedName(term.value, cacheName);
+}
+
+bool
+TurtleStreamReader::readIRI(QString &uri)
+{
+    if (peek() != '<') {
+        return fail("Expected IRI");
+    }
+    const char *start = m_data + m_pos + 1;
+    const char *end = static_cast<const char *>
+        (memchr(start, '>', m_length - m_pos - 1));
+    if (!end) {
+        return fail("Unterminated IRI");
+    }
+    if (memchr(start, '\\', end - start)) {
+        return fail("Escapes in IRIs are not supported");
+    }
+    uri = resolve(QString::fromUtf8(start, int(end - start)));
+    m_pos = (end - m_data) + 1;
+    return true;
+}
+
+bool
+TurtleStreamReader::readPrefixedName(QString &uri, bool cacheName)
+{
+    size_t start = m_pos;
+    while (m_pos < m_length && isNameChar(m_data[m_pos])) {
+        ++m_pos;
+    }
+    // A name cannot end with a full stop: it must end the statement
+    while (m_pos > start && m_data[m_pos - 1] == '.') {
+        --m_pos;
+    }
+    if (m_pos == start) {
+        return fail(QString("Unexpected character '%1'").arg(m_data[m_pos]));
+    }
+
+    const char *token = m_data + start;
+    int n = int(m_pos - start);
+
+    if (cacheName) {
+        auto itr = m_nameCache.constFind(QByteArray::fromRawData(token, n));
+        if (itr != m_nameCache.constEnd()) {
+            uri = *itr;
+            return true;
+        }
+    }
+
+    const char *colon = static_cast<const char *>(memchr(token, ':', n));
+    if (!colon) {
+        return fail("Expected prefixed name");
+    }
+    int pn = int(colon - token);
+    auto itr = m_prefixes.constFind(QByteArray::fromRawData(token, pn));
+    if (itr == m_prefixes.constEnd()) {
+        return fail("Undeclared prefix");
+    }
+    uri = *itr + QString::fromUtf8(colon + 1, n - pn - 1);
+
+    if (cacheName) {
+        m_nameCache[QByteArray(token, n)] = uri;
+    }
+    return true;
+}
+
+bool
+TurtleStreamReader::readLiteral(Term &term)
+{
+    const char q = m_data[m_pos];
+    const bool isLong = (m_pos + 2 < m_length &&
+                         m_data[m_pos + 1] == q && m_data[m_pos + 2] == q);
+    const size_t start = m_pos + (isLong ? 3 : 1);
+    size_t end = start;
+
+    while (true) {
+        const char *found = static_cast<const char *>
+            (memchr(m_data + end, q, m_length - end));
+        if (!found) {
+            return fail("Unterminated literal");
+        }
+        size_t i = found - m_data;
+        size_t backslashes = 0;
+        while (i - backslashes > start && m_data[i - backslashes - 1] == '\\') {
+            ++backslashes;
+        }
+        if (backslashes % 2 == 1) {
+            end = i + 1;
+            continue;
+        }
+        if (!isLong) {
+            end = i;
+            break;
+        }
+        size_t run = 0;
+        while (i + run < m_length && m_data[i + run] == q) {
+            ++run;
+        }
+        if (run >= 3) {
+            // Any quotes beyond the closing three belong to the text
+            end = i + run - 3;
+            break;
+        }
+        end = i + run;
+    }
+
+    term.type = Term::Literal;
+    term.data = m_data + start;
+    term.length = end - start;
+    m_pos = end + (isLong ? 3 : 1);
+
+    if (memchr(term.data, '\\', term.length)) {
+        QByteArray &u = term.unescaped;
+        for (size_t i = 0; i < term.length; ++i) {
+            char c = term.data[i];
+            if (c != '\\' || i + 1 == term.length) {
+                u.push_back(c);
+                continue;
+            }
+            c = term.data[++i];
+            switch (c) {
+            case 't': u.push_back('\t'); break;
+            case 'n': u.push_back('\n'); break;
+            case 'r': u.push_back('\r'); break;
+            case 'b': u.push_back('\b'); break;
+            case 'f': u.push_back('\f'); break;
+            case 'u': case 'U': {
+                int digits = (c == 'u' ? 4 : 8);
+                if (i + digits >= term.length) {
+                    return fail("Truncated escape in literal");
+                }
+                bool ok = false;
+                uint code = QByteArray(term.data + i + 1, digits).toUInt(&ok, 16);
+                if (!ok) {
+                    return fail("Invalid escape in literal");
+                }
+                u.append(QString::fromUcs4(&code, 1).toUtf8());
+                i += digits;
+                break;
+            }
+            default: u.push_back(c); break;
+            }
+        }
+        term.data = u.constData();
+        term.length = size_t(u.size());
+    }
+
+    if (m_pos + 1 < m_length && m_data[m_pos] == '^' && m_data[m_pos + 1] == '^') {
+        m_pos += 2;
+        Term type;
+        if (!readTerm(type, true)) {
+            return false;
+        }
+        if (type.type != Term::URI) {
+            return fail("Expected datatype");
+        }
+        term.datatype = type.value;
+    } else if (peek() == '@') {
+        ++m_pos;
+        while (m_pos < m_length &&
+               (isalnum((unsigned char)m_data[m_pos]) || m_data[m_pos] == '-')) {
+            ++m_pos;
+        }
+    }
+
+    return true;
+}
+
+bool
+TurtleStreamReader::readBlank(Term &term)
+{
+    ++m_pos; // the '['
+    term.type = Term::Blank;
+    // Not a valid blank node label, so cannot clash with one
+    term.value = QString("_:[%1]").arg(++m_blankCount);
+    skipSpace();
+    if (peek() == ']') {
+        ++m_pos;
+        return true;
+    }
+    if (!readPredicateObjectList(term)) {
+        return false;
+    }
+    return expect(']');
+}
+
+QString
+TurtleStreamReader::resolve(QString iri) const
+{
+    for (int i = 0; i < iri.length(); ++i) {
+        QChar c = iri[i];
+        if (c == ':') {
+            return iri; // absolute
+        }
+        if (c == '/' || c == '?' || c == '#') {
+            break;
+        }
+    }
+    return QUrl(m_base).resolved(QUrl(iri)).toString();
+}
+
+bool
+TurtleStreamReader::parseFloat(const char *s, size_t n, float &f)
+{
+    static const double powers[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+
+    size_t i = 0;
+    bool negative = false;
+    if (i < n && (s[i] == '-' || s[i] == '+')) {
+        negative = (s[i] == '-');
+        ++i;
+    }
+
+    uint64_t mantissa = 0;
+    int significant = 0;
+    int exponent = 0;
+    bool haveDigits = false;
+    bool fast = true;
+
+    while (i < n && s[i] >= '0' && s[i] <= '9') {
+        haveDigits = true;
+        if (mantissa > 0 || s[i] != '0') {
+            mantissa = mantissa * 10 + uint64_t(s[i] - '0');
+            ++significant;
+        }
+        ++i;
+    }
+    if (i < n && s[i] == '.') {
+        ++i;
+        while (i < n && s[i] >= '0' && s[i] <= '9') {
+            haveDigits = true;
+            if (mantissa > 0 || s[i] != '0') {
+                mantissa = mantissa * 10 + uint64_t(s[i] - '0');
+                ++significant;
+            }
+            --exponent;
+            ++i;
+        }
+    }
+    if (haveDigits && i < n && (s[i] == 'e' || s[i] == 'E')) {
+        ++i;
+        bool negativeExponent = false;
+        if (i < n && (s[i] == '-' || s[i] == '+')) {
+            negativeExponent = (s[i] == '-');
+            ++i;
+        }
+        int e = 0;
+        bool haveExponentDigits = false;
+        while (i < n && s[i] >= '0' && s[i] <= '9') {
+            haveExponentDigits = true;
+            if (e < 10000) e = e * 10 + (s[i] - '0');
+            ++i;
+        }
+        if (!haveExponentDigits) fast = false;
+        exponent += (negativeExponent ? -e : e);
+    }
+
+    if (!haveDigits || i != n || significant > 15 ||
+        exponent < -22 || exponent > 22) {
+        fast = false;
+    }
+
+    if (!fast) {
+        bool ok = false;
+        f = QString::fromUtf8(s, int(n)).toFloat(&ok);
+        return ok;
+    }
+
+    double d = double(mantissa);
+    if (exponent < 0) d /= powers[-exponent];
+    else d *= powers[exponent];
+    f = float(negative ? -d : d);
+    return true;
+}
@@ -0,0 +1,151 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef SV_TURTLE_STREAM_READER_H
+#define SV_TURTLE_STREAM_READER_H
+
+#include <QString>
+#include <QByteArray>
+#include <QHash>
+
+#include <vector>
+#include <functional>
+
+/**
+ * A minimal single-pass reader for the subset of Turtle that Sonic
+ * Visualiser writes itself (see RDFFeatureWriter), for use where
+ * importing a whole document into a triple store would be too slow.
+ *
+ * The reader works on a buffer holding the whole document (typically
+ * a memory-mapped file) and passes the triples of each top-level
+ * statement, including those of any blank nodes nested within it, to
+ * a handler as soon as the statement is complete. Literals are not
+ * copied: each refers to its text within the buffer, unless it
+ * contained escape sequences, so even a very long literal (such as
+ * the values of a dense feature) costs nothing until it is used.
+ *
+ * Prefix declarations, IRIs (resolved against the base URI if
+ * relative), prefixed names, "a", blank node labels and property
+ * lists, and quoted, numeric and boolean literals are supported.
+ * Anything else, such as @base or collections, is reported as an
+ * error, so that the caller can fall back to a complete parser.
+ */
+class TurtleStreamReader
+{
+public:
+    struct Term {
+        enum Type { Nothing, URI, Blank, Literal };
+
+        Term() : type(Nothing), data(nullptr), length(0) { }
+
+        Type type;
+
+        /**
+         * The URI, or the blank node identifier. Empty for literals.
+         */
+        QString value;
+
+        /**
+         * The literal text, as UTF-8, and the datatype URI if any.
+         * The text remains valid as long as the buffer and the term
+         * do.
+         */
+        const char *data;
+        size_t length;
+        QString datatype;
+
+        /**
+         * The unescaped literal text, if the literal contained escape
+         * sequences (data then points into this).
+         */
+        QByteArray unescaped;
+
+        QString getText() const {
+            return QString::fromUtf8(data, int(length));
+        }
+    };
+
+    struct Triple {
+        Term subject;
+        QString predicate;
+        Term object;
+    };
+
+    /**
+     * Function called with the triples of each statement. Return
+     * true to continue reading, false to stop.
+     */
+    typedef std::function<bool(const std::vector<Triple> &)> StatementHandler;
+
+    TurtleStreamReader(const char *data, size_t length, QString baseUri);
+
+    /**
+     * Read statements from the buffer, passing each to the handler,
+     * until the end of the buffer or until the handler returns
+     * false. Return false if the document could not be read, in
+     * which case getError describes why.
+     */
+    bool read(StatementHandler handler);
+
+    QString getError() const { return m_error; }
+
+    /**
+     * Return the number of bytes read so far.
+     */
+    size_t getPosition() const { return m_pos; }
+
+    static const QString rdfType;
+
+    /**
+     * Parse the text of a numeric literal, or of one of the values
+     * of a dense feature, as a float. Most numbers written by
+     * RDFFeatureWriter are converted here directly, with no more than
+     * a single rounding in double precision, which gives the same
+     * result as QString::toFloat; anything else is passed to
+     * QString::toFloat. Return false if the text is not a number,
+     * or is out of range; f is then set to what QString::toFloat
+     * returned.
+     */
+    static bool parseFloat(const char *s, size_t n, float &f);
+
+private:
+    const char *m_data;
+    size_t m_length;
+    size_t m_pos;
+    QString m_base;
+    QHash<QByteArray, QString> m_prefixes;
+    QHash<QByteArray, QString> m_nameCache;
+    int m_blankCount;
+    std::vector<Triple> m_triples;
+    QString m_error;
+
+    char peek() const {
+        return m_pos < m_length ? m_data[m_pos] : '\0';
+    }
+
+    bool fail(QString message);
+    bool expect(char c);
+    void skipSpace();
+    bool readPrefixDirective();
+    bool readPredicateObjectList(const Term &subject);
+    bool readVerb(QString &predicate);
+    bool readTerm(Term &term, bool cacheName);
+    bool readIRI(QString &uri);
+    bool readPrefixedName(QString &uri, bool cacheName);
+    bool readLiteral(Term &term);
+    bool readBlank(Term &term);
+    QString resolve(QString iri) const;
+};
+
+#endif
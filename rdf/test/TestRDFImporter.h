@@ -0,0 +1,381 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef TEST_RDF_IMPORTER_H
+#define TEST_RDF_IMPORTER_H
+
+#include "../RDFImporter.h"
+#include "../RDFFeatureWriter.h"
+#include "../TurtleStreamReader.h"
+
+#include "data/fileio/WavFileWriter.h"
+#include "data/model/Model.h"
+#include "data/model/DenseThreeDimensionalModel.h"
+#include "data/model/SparseTimeValueModel.h"
+
+#include <QObject>
+#include <QtTest>
+#include <QTemporaryDir>
+#include <QFile>
+#include <QUrl>
+
+#include <vector>
+#include <limits>
+#include <random>
+
+using namespace std;
+
+class TestRDFImporter : public QObject
+{
+    Q_OBJECT
+
+    typedef Vamp::Plugin::Feature Feature;
+    typedef Vamp::Plugin::FeatureList FeatureList;
+    typedef Vamp::Plugin::OutputDescriptor OutputDescriptor;
+
+    static const int frames = 44100;
+
+    QTemporaryDir m_dir;
+    QString m_audioPath;
+    QString m_featurePath;
+
+    static Feature feature(double sec, QString label,
+                           vector<float> values = {}) {
+        Feature f;
+        f.hasTimestamp = true;
+        f.timestamp = Vamp::RealTime::fromSeconds(sec);
+        f.label = label.toStdString();
+        f.values = values;
+        return f;
+    }
+
+    static void writeOutput(RDFFeatureWriter &writer, QString trackId,
+                            QString outputId, const FeatureList &features) {
+        Transform t;
+        t.setIdentifier("vamp:test-library:test-plugin:" + outputId);
+        OutputDescriptor od;
+        od.identifier = outputId.toStdString();
+        od.name = ("Test " + outputId).toStdString();
+        od.unit = "Hz";
+        od.description = "Output for testing";
+        od.hasFixedBinCount = false;
+        od.sampleType = OutputDescriptor::VariableSampleRate;
+        od.sampleRate = 0;
+        writer.write(trackId, t, od, features);
+    }
+
+    // A summary of everything about a model that should not depend
+    // on how its document was read. Models are compared via these,
+    // sorted, as their order is not significant. The document's own
+    // URL, against which its local URIs were resolved, is replaced
+    // so that copies of a document can be compared
+    static QString describe(ModelId modelId, QString documentUrl) {
+        // Values are written with enough precision to distinguish
+        // any two floats
+        auto exact = [](float v) { return QString::number(v, 'g', 9); };
+        auto model = ModelById::get(modelId);
+        if (!model) return "(none)";
+        QStringList parts;
+        parts << model->getTypeName()
+              << model->objectName()
+              << model->getRDFTypeURI()
+              << QString::number(model->getSampleRate())
+              << QString::number(model->getStartFrame())
+              << QString::number(model->getEndFrame())
+              << (model->getSourceModel().isNone() ? "no source" : "source");
+        if (model->isSparse()) {
+            auto rows = model->toStringExportRows
+                (DataExportDefaults, model->getStartFrame(),
+                 model->getEndFrame() - model->getStartFrame() + 1);
+            for (const auto &row: rows) {
+                parts << QStringList(row.toList()).join(",");
+            }
+        }
+        if (auto stvm = ModelById::getAs<SparseTimeValueModel>(modelId)) {
+            parts << QString("resolution %1").arg(stvm->getResolution());
+            for (const auto &e: stvm->getAllEvents()) {
+                parts << QString("%1: %2").arg(e.getFrame())
+                    .arg(exact(e.getValue()));
+            }
+        }
+        if (auto dtdm = ModelById::getAs<DenseThreeDimensionalModel>(modelId)) {
+            parts << QString("%1x%2, resolution %3")
+                .arg(dtdm->getWidth()).arg(dtdm->getHeight())
+                .arg(dtdm->getResolution());
+            for (int x = 0; x < dtdm->getWidth(); ++x) {
+                auto column = dtdm->getColumn(x);
+                QStringList bins;
+                for (float v: column) bins << exact(v);
+                parts << bins.join(" ");
+            }
+        }
+        return parts.join("\n").replace(documentUrl, "document:");
+    }
+
+    static QStringList import(QString path, bool streaming,
+                              sv_samplerate_t sampleRate = 0) {
+        RDFImporter::setStreamingEnabled(streaming);
+        RDFImporter importer(path, sampleRate);
+        RDFImporter::setStreamingEnabled(true);
+        if (!importer.isOK()) {
+            qWarning() << "Import failed:" << importer.getErrorString();
+            return {};
+        }
+        auto models = importer.getDataModels(nullptr);
+        QStringList descriptions;
+        QString url = QUrl::fromLocalFile(path).toString();
+        for (auto m: models) {
+            descriptions << describe(m, url);
+            ModelById::release(m);
+        }
+        descriptions.sort();
+        return descriptions;
+    }
+
+    static bool isStreamable(QString path) {
+        QFile file(path);
+        if (!file.open(QIODevice::ReadOnly)) return false;
+        QByteArray data = file.readAll();
+        TurtleStreamReader reader(data.constData(), size_t(data.size()),
+                                  QUrl::fromLocalFile(path).toString());
+        return reader.read([](const vector<TurtleStreamReader::Triple> &) {
+                               return true;
+                           });
+    }
+
+    bool writeVariant(QString path, QByteArray prefix, QByteArray suffix) {
+        QFile in(m_featurePath);
+        if (!in.open(QIODevice::ReadOnly)) return false;
+        QFile out(path);
+        if (!out.open(QIODevice::WriteOnly)) return false;
+        out.write(prefix);
+        out.write(in.readAll());
+        out.write(suffix);
+        return true;
+    }
+
+private slots:
+    void initTestCase() {
+        QVERIFY(m_dir.isValid());
+
+        m_audioPath = m_dir.path() + "/audio.wav";
+        vector<float> samples(frames);
+        for (int i = 0; i < frames; ++i) {
+            samples[i] = float(i % 100) / 100.f - 0.5f;
+        }
+        const float *ptr = samples.data();
+        {
+            WavFileWriter writer(m_audioPath, 44100, 1,
+                                 WavFileWriter::WriteToTemporary);
+            QVERIFY(writer.isOK());
+            QVERIFY(writer.writeSamples(&ptr, frames));
+            QVERIFY(writer.close());
+        }
+
+        m_featurePath = m_dir.path() + "/features.ttl";
+        QString trackId = QUrl::fromLocalFile(m_audioPath).toString();
+        {
+            RDFFeatureWriter writer;
+            map<string, string> params;
+            params["one-file"] = m_featurePath.toStdString();
+            params["force"] = "";
+            writer.setParameters(params);
+
+            // Instants, with and without labels
+            FeatureList instants;
+            instants.push_back(feature(0.0, "first"));
+            instants.push_back(feature(0.1, ""));
+            instants.push_back(feature(0.25, QString::fromUtf8("caf\xc3\xa9")));
+            instants.push_back(feature(0.9999, "last"));
+            writeOutput(writer, trackId, "onsets", instants);
+
+            // Single values, written with the default precision,
+            // including some that parseFloat has to pass on to
+            // QString::toFloat
+            FeatureList values;
+            vector<float> v {
+                0.f, -0.f, 1.f / 3.f, -2.5f, 1e-7f, 123456.789f,
+                1e22f, 1e23f, 1e-30f, 3.4028235e38f, -1e38f,
+                std::numeric_limits<float>::infinity()
+            };
+            for (int i = 0; i < int(v.size()); ++i) {
+                values.push_back(feature(0.05 * i, QString("v%1").arg(i),
+                                         { v[i] }));
+            }
+            writeOutput(writer, trackId, "values", values);
+
+            // Several values per event
+            FeatureList notes;
+            notes.push_back(feature(0.2, "a", { 440.f, 1000.f, 0.8f }));
+            notes.push_back(feature(0.4, "b", { 220.5f, 44.f }));
+            notes.push_back(feature(0.6, "", { 1e-5f, 2.f, -0.125f }));
+            writeOutput(writer, trackId, "notes", notes);
+
+            writer.finish();
+        }
+
+        QVERIFY(QFile(m_featurePath).exists());
+    }
+
+    void streamable() {
+        // Otherwise the comparisons below would compare the
+        // complete parser with itself
+        QVERIFY(isStreamable(m_featurePath));
+    }
+
+    void streamedMatchesComplete() {
+        QStringList streamed = import(m_featurePath, true);
+        QStringList complete = import(m_featurePath, false);
+
+        // the audio, and one model for each output
+        QCOMPARE(streamed.size(), 4);
+        QCOMPARE(streamed, complete);
+
+        QStringList types;
+        for (auto d: streamed) types << d.section('\n', 0, 0);
+        types.sort();
+        QCOMPARE(types, QStringList()
+                 << "Note" << "Sparse 1-D" << "Sparse Time-Value"
+                 << "Wave File");
+    }
+
+    void unsupportedFallsBack() {
+        QStringList expected = import(m_featurePath, true);
+        QVERIFY(!expected.empty());
+
+        // A base declaration naming the document itself, so that
+        // every URI resolves as it would have done without it
+        QString withBase = m_dir.path() + "/base.ttl";
+        QVERIFY(writeVariant
+                (withBase,
+                 "@base <" + QUrl::fromLocalFile(withBase).toEncoded() +
+                 "> .\n", ""));
+        QVERIFY(!isStreamable(withBase));
+        QCOMPARE(import(withBase, true), expected);
+
+        // A collection, in a statement that has nothing to do with
+        // any model
+        QString withCollection = m_dir.path() + "/collection.ttl";
+        QVERIFY(writeVariant
+                (withCollection, "",
+                 "\n:collection rdfs:comment ( \"a\" \"b\" ) .\n"));
+        QVERIFY(!isStreamable(withCollection));
+        QCOMPARE(import(withCollection, true), expected);
+    }
+
+    void dense() {
+        // RDFFeatureWriter only writes dense features for plugins
+        // with an installed RDF description, so write them here in
+        // the same form: one of height 3, as a dense model, and one
+        // of height 1, as a time-value model. The values are in a
+        // mixture of formats and precisions, with runs of spaces and
+        // a value that is not a number, and the last column of the
+        // height 3 feature is incomplete
+
+        mt19937 rng(54321);
+        auto randomValues = [&](int count) {
+            QStringList tokens;
+            for (int i = 0; i < count; ++i) {
+                float v = float(rng() % 2000000) / 1000.f - 1000.f;
+                switch (rng() % 8) {
+                case 0: tokens << QString::number(v); break;
+                case 1: tokens << QString::number(v, 'g', 9); break;
+                case 2: tokens << QString::number(v * 1e-20f, 'e', 8); break;
+                case 3: tokens << QString::number(double(v) * 1e30, 'g', 17); break;
+                case 4: tokens << QString::number(v / 7.0, 'f', 20); break;
+                case 5: tokens << QString::number(int(v)); break;
+                case 6: tokens << QString::number(v, 'g', 3) + "  "; break;
+                case 7: tokens << QString::number(v / 1e5, 'g', 15); break;
+                }
+            }
+            return tokens;
+        };
+
+        QStringList chroma = randomValues(3 * 40 + 2);
+        chroma[5] = "1e23";
+        chroma[6] = "-.5";
+        chroma[7] = "3.4028236e38";
+        chroma[8] = "nonsense";
+        chroma[9] = "123456789012345678";
+        QStringList energy = randomValues(100);
+        energy[0] = "0.1234567890123456789";
+        energy[1] = "+2.5";
+
+        QString document =
+            "@prefix dc: <http://purl.org/dc/elements/1.1/> .\n"
+            "@prefix af: <http://purl.org/ontology/af/> .\n"
+            "@prefix mo: <http://purl.org/ontology/mo/> .\n"
+            "@prefix rdfs: <http://www.w3.org/2000/01/rdf-schema#> .\n"
+            "@prefix xsd: <http://www.w3.org/2001/XMLSchema#> .\n"
+            "@prefix tl: <http://purl.org/NET/c4dm/timeline.owl#> .\n"
+            "@prefix : <#> .\n\n";
+
+        auto addFeature = [&](int n, QString type, QString title,
+                              int height, int hop, QStringList tokens) {
+            QString f = QString::number(n);
+            document +=
+                ":signal_type_" + type + " rdfs:subClassOf af:Signal ;\n"
+                "    dc:title \"" + title + "\" .\n\n"
+                ":feature_timeline_" + f + " a tl:DiscreteTimeLine .\n\n"
+                ":feature_timeline_map_" + f +
+                " a tl:UniformSamplingWindowingMap ;\n"
+                "    tl:rangeTimeLine :feature_timeline_" + f + " ;\n"
+                "    tl:sampleRate \"44100\"^^xsd:float ;\n"
+                "    tl:windowLength \"" + QString::number(hop * 2) +
+                "\"^^xsd:int ;\n"
+                "    tl:hopSize \"" + QString::number(hop) +
+                "\"^^xsd:int .\n\n"
+                ":signal af:signal_feature :feature_" + f + " .\n\n"
+                ":feature_" + f + " a :signal_type_" + type + " ;\n"
+                "    mo:time [\n"
+                "        a tl:Interval ;\n"
+                "        tl:onTimeLine :feature_timeline_" + f + " ;\n"
+                "    ] ;\n"
+                "    af:dimensions \"" + QString::number(height) +
+                " 0\" ;\n"
+                "    af:value \"" + tokens.join(" ") + " \" .\n\n";
+        };
+
+        addFeature(1, "chroma", "Chroma", 3, 512, chroma);
+        addFeature(2, "energy", "Energy", 1, 256, energy);
+
+        QString path = m_dir.path() + "/dense.ttl";
+        {
+            QFile file(path);
+            QVERIFY(file.open(QIODevice::WriteOnly));
+            file.write(document.toUtf8());
+        }
+
+        QVERIFY(isStreamable(path));
+
+        QStringList streamed = import(path, true, 44100);
+        QStringList complete = import(path, false, 44100);
+
+        QCOMPARE(streamed.size(), 2);
+        QCOMPARE(streamed, complete);
+
+        // Check the shapes too, in case both paths went wrong in
+        // the same way
+        QStringList types;
+        for (auto d: streamed) types << d.section('\n', 0, 1);
+        QCOMPARE(types, QStringList()
+                 << "Editable Dense 3-D\nChroma"
+                 << "Sparse Time-Value\nEnergy");
+        QVERIFY(streamed[0].contains("\n41x3, resolution 512\n"));
+        QVERIFY(streamed[1].contains("\nresolution 256\n"));
+        QCOMPARE(streamed[1].count(QRegExp("\n[0-9]+: ")), 100);
+    }
+};
+
+#endif
@@ -0,0 +1,247 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef TEST_TURTLE_STREAM_READER_H
+#define TEST_TURTLE_STREAM_READER_H
+
+#include "../TurtleStreamReader.h"
+
+#include <QObject>
+#include <QtTest>
+
+#include <cfloat>
+#include <cmath>
+#include <random>
+#include <vector>
+
+using namespace std;
+
+class TestTurtleStreamReader : public QObject
+{
+    Q_OBJECT
+
+    // Check parseFloat against QString::toFloat, which it defers to
+    // for anything it does not convert itself, and against
+    // QString::toDouble wherever the result is a normal float (the
+    // handling of overflow and underflow when narrowing to float
+    // differs between Qt versions)
+    static void checkParse(QByteArray text) {
+        float f = 0.f;
+        bool ok = TurtleStreamReader::parseFloat
+            (text.constData(), size_t(text.size()), f);
+
+        bool expectedOk = false;
+        float expected = QString::fromUtf8(text).toFloat(&expectedOk);
+        if (ok != expectedOk) {
+            QFAIL(QString("parseFloat(\"%1\") returned %2, toFloat gave %3")
+                  .arg(QString::fromUtf8(text)).arg(ok ? "true" : "false")
+                  .arg(expectedOk ? "true" : "false")
+                  .toLocal8Bit().data());
+        }
+        // Even on failure, the value is the one toFloat returned
+        if (std::isnan(expected)) {
+            QVERIFY(std::isnan(f));
+            return;
+        }
+        if (f != expected) {
+            QFAIL(QString("parseFloat(\"%1\") gave %2, toFloat gave %3")
+                  .arg(QString::fromUtf8(text))
+                  .arg(double(f), 0, 'g', 9).arg(double(expected), 0, 'g', 9)
+                  .toLocal8Bit().data());
+        }
+        if (!ok) return;
+
+        bool doubleOk = false;
+        double d = QString::fromUtf8(text).toDouble(&doubleOk);
+        QVERIFY(doubleOk);
+        if (d == 0.0 || (fabs(d) >= FLT_MIN && fabs(d) <= FLT_MAX)) {
+            QCOMPARE(f, float(d));
+        }
+    }
+
+    static bool read(QByteArray text) {
+        TurtleStreamReader reader(text.constData(), size_t(text.size()),
+                                  "file:///test.ttl");
+        return reader.read([](const vector<TurtleStreamReader::Triple> &) {
+                               return true;
+                           });
+    }
+
+private slots:
+    void parseFloatSimple() {
+        float f = 0.f;
+        QVERIFY(TurtleStreamReader::parseFloat("1.5", 3, f));
+        QCOMPARE(f, 1.5f);
+        QVERIFY(TurtleStreamReader::parseFloat("-0.25e2", 7, f));
+        QCOMPARE(f, -25.f);
+        // Only the given length is read
+        QVERIFY(TurtleStreamReader::parseFloat("12 34", 2, f));
+        QCOMPARE(f, 12.f);
+        QVERIFY(!TurtleStreamReader::parseFloat("x", 1, f));
+        QVERIFY(!TurtleStreamReader::parseFloat("", 0, f));
+    }
+
+    void parseFloatManyDigits() {
+        checkParse("123456789012345");
+        checkParse("1234567890123456");
+        checkParse("12345678901234567890123");
+        checkParse("0.1234567890123456789");
+        checkParse("3.14159265358979323846264338327950288");
+        checkParse("0.000000000000000000000000000012345");
+        checkParse("0000000000000000000000001.5");
+        checkParse("1.00000000000000000000");
+        checkParse("16777217");
+        checkParse("16777217.000000000001");
+        checkParse("0.30000000000000004");
+    }
+
+    void parseFloatExponents() {
+        checkParse("1e22");
+        checkParse("1e23");
+        checkParse("1e-22");
+        checkParse("1e-23");
+        checkParse("9.99999e22");
+        checkParse("123456789012345e22");
+        checkParse("123456789012345e-22");
+        checkParse("3.40282e+38");
+        checkParse("3.4028234e38");
+        checkParse("3.4028236e38");
+        checkParse("1e39");
+        checkParse("1e308");
+        checkParse("1e309");
+        checkParse("1.17549e-38");
+        checkParse("1e-40");
+        checkParse("1e-50");
+        checkParse("1e-400");
+        checkParse("1e99999999999");
+        checkParse("1E5");
+        checkParse("1e+05");
+        checkParse("1e-0005");
+        checkParse("0e500");
+    }
+
+    void parseFloatSigns() {
+        checkParse("0");
+        checkParse("-0");
+        checkParse("+0");
+        checkParse("+1.5");
+        checkParse("-1.5");
+        checkParse("-1e-7");
+        checkParse("+1e+7");
+        checkParse("--1");
+        checkParse("+-1");
+        checkParse("-");
+        checkParse("+");
+        checkParse("1-");
+        checkParse("1e+-5");
+    }
+
+    void parseFloatNoLeadingDigit() {
+        checkParse(".5");
+        checkParse("-.5");
+        checkParse("+.5");
+        checkParse(".5e3");
+        checkParse("5.");
+        checkParse("-5.e2");
+        checkParse(".");
+        checkParse("-.");
+        checkParse(".e5");
+        checkParse("e5");
+    }
+
+    void parseFloatOther() {
+        checkParse("");
+        checkParse("1e");
+        checkParse("1e+");
+        checkParse("1.2.3");
+        checkParse("1,5");
+        checkParse("0x10");
+        checkParse(" 1");
+        checkParse("1 ");
+        checkParse("nan");
+        checkParse("inf");
+        checkParse("-inf");
+        checkParse("infinity");
+        checkParse("abc");
+    }
+
+    void parseFloatRandom() {
+        // Random decimals of up to 18 digits, with and without
+        // exponents, spanning both sides of the limits of the
+        // direct conversion
+        mt19937 rng(12345);
+        for (int i = 0; i < 100000; ++i) {
+            QByteArray text;
+            if (rng() % 2) text += '-';
+            int digits = 1 + int(rng() % 18);
+            int point = int(rng() % (digits + 1));
+            for (int j = 0; j < digits; ++j) {
+                if (j == point) text += '.';
+                text += char('0' + rng() % 10);
+            }
+            if (rng() % 2) {
+                text += 'e';
+                text += QByteArray::number(int(rng() % 70) - 35);
+            }
+            checkParse(text);
+            if (QTest::currentTestFailed()) return;
+        }
+    }
+
+    void readSupported() {
+        QByteArray text =
+            "@prefix ex: <http://example.com/> .\n"
+            "@prefix : <#> .\n"
+            ":a a ex:Thing ;\n"
+            "    ex:value \"1.5\"^^<http://www.w3.org/2001/XMLSchema#float> ;\n"
+            "    ex:label \"\"\"multi\nline\"\"\" ;\n"
+            "    ex:at [ a ex:Instant ; ex:n 3 ] .\n";
+        TurtleStreamReader reader(text.constData(), size_t(text.size()),
+                                  "file:///test.ttl");
+        vector<TurtleStreamReader::Triple> triples;
+        QVERIFY(reader.read([&](const vector<TurtleStreamReader::Triple> &t) {
+                                triples.insert(triples.end(), t.begin(), t.end());
+                                return true;
+                            }));
+        QCOMPARE(int(triples.size()), 6);
+        // The triples of a blank node come before the one that
+        // refers to it
+        QVERIFY(triples[3].subject.type == TurtleStreamReader::Term::Blank);
+        QVERIFY(triples[4].subject.type == TurtleStreamReader::Term::Blank);
+        QCOMPARE(triples.back().subject.value,
+                 QString("file:///test.ttl#a"));
+        QCOMPARE(triples.back().predicate, QString("http://example.com/at"));
+        QCOMPARE(triples.back().object.value, triples[3].subject.value);
+        for (const auto &t: triples) {
+            if (t.predicate == "http://example.com/value") {
+                QVERIFY(t.object.type == TurtleStreamReader::Term::Literal);
+                QCOMPARE(t.object.getText(), QString("1.5"));
+            }
+        }
+        QCOMPARE(reader.getPosition(), size_t(text.size()));
+    }
+
+    void readUnsupported() {
+        // These are valid Turtle, but outside the subset the reader
+        // handles, so the caller must fall back to a complete parser
+        QVERIFY(!read("@base <http://example.com/> .\n"
+                      "<a> <b> <c> .\n"));
+        QVERIFY(!read("@prefix ex: <http://example.com/> .\n"
+                      "ex:a ex:b ( ex:c ex:d ) .\n"));
+        QVERIFY(!read("@prefix ex: <http://example.com/> .\n"
+                      "ex:a ex:b ex:c"));
+    }
+};
+
+#endif
@@ -0,0 +1,6 @@
+TEST_HEADERS = \
+	     TestTurtleStreamReader.h \
+	     TestRDFImporter.h
+
+TEST_SOURCES += \
+	     svcore-rdf-test.cpp
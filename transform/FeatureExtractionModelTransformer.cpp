@@ -25,6 +25,7 @@
 #include "base/Exceptions.h"
 #include "data/model/SparseOneDimensionalModel.h"
 #include "data/model/SparseTimeValueModel.h"
+#include "data/model/DecimatedTimeValueModel.h"
 #include "data/model/BasicCompressedDenseThreeDimensionalModel.h"
 #include "data/model/DenseTimeValueModel.h"
 #include "data/model/NoteModel.h"
@@ -71,6 +72,56 @@ areTransformsSimilar(const Transform &t1, const Transform &t2)
     return t1 == t2o;
 }
 
+// Obtain a plugin initialised for the transform from the factory,
+// which may reuse one it initialised identically for an earlier
+// transform. This is only possible when the transform's step and
+// block sizes are already known: otherwise the plugin has to be
+// asked for its preferences before it can be initialised, and we
+// return nullptr to say so, as we do if the factory could not
+// initialise it with these values
+static std::shared_ptr<Vamp::Plugin>
+instantiateInitialisedPlugin(FeatureExtractionPluginFactory *factory,
+                             const Transform &transform,
+                             sv_samplerate_t sampleRate,
+                             int inputChannels)
+{
+    int step = transform.getStepSize();
+    int block = transform.getBlockSize();
+    if (step <= 0 || block <= 0) {
+        return {};
+    }
+
+    QString pluginId = transform.getPluginIdentifier();
+    
+    piper_vamp::PluginStaticData psd = factory->getPluginStaticData(pluginId);
+    if (psd.pluginKey == "") {
+        return {};
+    }
+
+    int channelCount = inputChannels;
+    if ((int)psd.maxChannelCount < channelCount) {
+        channelCount = 1;
+    }
+    if ((int)psd.minChannelCount > channelCount) {
+        return {};
+    }
+
+    // As in TransformFactory::setPluginParameters, only those
+    // parameters the plugin actually has
+    const Transform::ParameterMap &pmap = transform.getParameters();
+    FeatureExtractionPluginFactory::ParameterMap parameters;
+    for (const auto &pd: psd.parameters) {
+        auto pmi = pmap.find(QString::fromStdString(pd.identifier));
+        if (pmi != pmap.end()) {
+            parameters[pd.identifier] = pmi->second;
+        }
+    }
+
+    return factory->instantiateInitialisedPlugin
+        (pluginId, sampleRate, channelCount, step, block,
+         parameters, transform.getProgram().toStdString());
+}
+
 bool
 FeatureExtractionModelTransformer::initialise()
 {
@@ -114,18 +165,26 @@ FeatureExtractionModelTransformer::initialise()
     SVDEBUG << "FeatureExtractionModelTransformer: Instantiating plugin for transform in thread "
             << QThread::currentThreadId() << endl;
     
-    m_plugin = factory->instantiatePlugin(pluginId, input->getSampleRate());
-    if (!m_plugin) {
-        m_message = tr("Failed to instantiate plugin \"%1\"").arg(pluginId);
-        SVCERR << m_message << endl;
-        return false;
-    }
+    m_plugin = instantiateInitialisedPlugin(factory, primaryTransform,
+                                            input->getSampleRate(),
+                                            input->getChannelCount());
+    bool initialised = bool(m_plugin);
 
-    TransformFactory::getInstance()->makeContextConsistentWithPlugin
-        (primaryTransform, m_plugin);
+    if (!initialised) {
+        
+        m_plugin = factory->instantiatePlugin(pluginId, input->getSampleRate());
+        if (!m_plugin) {
+            m_message = tr("Failed to instantiate plugin \"%1\"").arg(pluginId);
+            SVCERR << m_message << endl;
+            return false;
+        }
+
+        TransformFactory::getInstance()->makeContextConsistentWithPlugin
+            (primaryTransform, m_plugin);
     
-    TransformFactory::getInstance()->setPluginParameters
-        (primaryTransform, m_plugin);
+        TransformFactory::getInstance()->setPluginParameters
+            (primaryTransform, m_plugin);
+    }
     
     int channelCount = input->getChannelCount();
     if ((int)m_plugin->getMaxChannelCount() < channelCount) {
@@ -149,7 +208,11 @@ FeatureExtractionModelTransformer::initialise()
             << channelCount << ", step = " << step
             << ", block = " << block << endl;
 
-    if (!m_plugin->initialise(channelCount, step, block)) {
+    if (initialised) {
+
+        SVDEBUG << "Plugin was already initialised by factory" << endl;
+        
+    } else if (!m_plugin->initialise(channelCount, step, block)) {
 
         int preferredStep = int(m_plugin->getPreferredStepSize());
         int preferredBlock = int(m_plugin->getPreferredBlockSize());
@@ -536,24 +599,50 @@ FeatureExtractionModelTransformer::createOutputModels(int n)
             m_needAdditionalModels[n] = true;
         }
 
-        SVDEBUG << "FeatureExtractionModelTransformer::createOutputModels: "
-                << "creating a SparseTimeValueModel "
-                << "(additional models to come? -> "
-                << m_needAdditionalModels[n] << ")" << endl;
-
-        SparseTimeValueModel *model;
-        if (haveExtents) {
-            model = new SparseTimeValueModel
-                (modelRate, modelResolution, minValue, maxValue, false);
+        Vamp::Plugin::OutputList outputs = m_plugin->getOutputDescriptors();
+
+        if (shouldUseDecimatedModel(n, modelResolution)) {
+
+            // A single value at a regular, high rate: if the user has
+            // opted in, store it densely rather than as one event
+            // per value. Any feature labels are lost.
+
+            SVDEBUG << "FeatureExtractionModelTransformer::createOutputModels: "
+                    << "creating a DecimatedTimeValueModel" << endl;
+
+            DecimatedTimeValueModel *model;
+            if (haveExtents) {
+                model = new DecimatedTimeValueModel
+                    (modelRate, modelResolution, minValue, maxValue, false);
+            } else {
+                model = new DecimatedTimeValueModel
+                    (modelRate, modelResolution, false);
+            }
+
+            model->setScaleUnits(outputs[m_outputNos[n]].unit.c_str());
+
+            out.reset(model);
+
         } else {
-            model = new SparseTimeValueModel
-                (modelRate, modelResolution, false);
-        }
 
-        Vamp::Plugin::OutputList outputs = m_plugin->getOutputDescriptors();
-        model->setScaleUnits(outputs[m_outputNos[n]].unit.c_str());
+            SVDEBUG << "FeatureExtractionModelTransformer::createOutputModels: "
+                    << "creating a SparseTimeValueModel "
+                    << "(additional models to come? -> "
+                    << m_needAdditionalModels[n] << ")" << endl;
 
-        out.reset(model);
+            SparseTimeValueModel *model;
+            if (haveExtents) {
+                model = new SparseTimeValueModel
+                    (modelRate, modelResolution, minValue, maxValue, false);
+            } else {
+                model = new SparseTimeValueModel
+                    (modelRate, modelResolution, false);
+            }
+
+            model->setScaleUnits(outputs[m_outputNos[n]].unit.c_str());
+
+            out.reset(model);
+        }
 
         QString outputEventTypeURI = description.getOutputEventTypeURI(outputId);
         if (outputEventTypeURI != "") {
@@ -603,6 +692,48 @@ FeatureExtractionModelTransformer::createOutputModels(int n)
     }
 }
 
+bool
+FeatureExtractionModelTransformer::shouldUseDecimatedModel(int n,
+                                                           int modelResolution)
+{
+    // Only for outputs with exactly one value per feature, at a fixed
+    // rate, and only if there will be enough values for storing them
+    // as events to be costly
+
+    static const sv_frame_t minimumValueCount = 100000;
+
+    if (m_needAdditionalModels[n] ||
+        !m_descriptors[n].hasFixedBinCount ||
+        m_descriptors[n].binCount != 1 ||
+        m_descriptors[n].sampleType ==
+        Vamp::Plugin::OutputDescriptor::VariableSampleRate) {
+        return false;
+    }
+
+    QSettings settings;
+    settings.beginGroup("Transformer");
+    bool decimate = settings.value("use-decimated-time-value-model",
+                                   false).toBool();
+    settings.endGroup();
+
+    if (!decimate) {
+        return false;
+    }
+
+    auto input = ModelById::get(getInputModel());
+    if (!input) {
+        return false;
+    }
+
+    sv_frame_t duration = input->getEndFrame() - input->getStartFrame();
+    if (m_transforms[n].getDuration() != RealTime::zeroTime) {
+        duration = RealTime::realTime2Frame(m_transforms[n].getDuration(),
+                                            input->getSampleRate());
+    }
+
+    return duration / std::max(modelResolution, 1) >= minimumValueCount;
+}
+
 void
 FeatureExtractionModelTransformer::awaitOutputModels()
 {
@@ -940,8 +1071,7 @@ FeatureExtractionModelTransformer::run()
             if (m_abandoned) break;
 
             for (int j = 0; in_range_for(m_outputNos, j); ++j) {
-                for (int fi = 0; in_range_for(features[m_outputNos[j]], fi); ++fi) {
-                    auto feature = features[m_outputNos[j]][fi];
+                for (const auto &feature: features[m_outputNos[j]]) {
                     addFeature(j, blockFrame, feature);
                 }
             }
@@ -961,8 +1091,7 @@ FeatureExtractionModelTransformer::run()
             auto features = m_plugin->getRemainingFeatures();
 
             for (int j = 0; in_range_for(m_outputNos, j); ++j) {
-                for (int fi = 0; in_range_for(features[m_outputNos[j]], fi); ++fi) {
-                    auto feature = features[m_outputNos[j]][fi];
+                for (const auto &feature: features[m_outputNos[j]]) {
                     addFeature(j, blockFrame, feature);
                     if (m_abandoned) {
                         break;
@@ -1140,18 +1269,20 @@ FeatureExtractionModelTransformer::addFeature(int n,
 
         auto model = ModelById::getAs<SparseOneDimensionalModel>(outputId);
         if (!model) return;
-        model->add(Event(frame, feature.label.c_str()));
+        model->add(Event(frame, getLabel(feature.label)));
         
     } else if (isOutputType<SparseTimeValueModel>(n)) {
 
         auto model = ModelById::getAs<SparseTimeValueModel>(outputId);
         if (!model) return;
 
+        QString featureLabel = getLabel(feature.label);
+
         for (int i = 0; in_range_for(feature.values, i); ++i) {
 
             float value = feature.values[i];
 
-            QString label = feature.label.c_str();
+            QString label = featureLabel;
             if (feature.values.size() > 1) {
                 label = QString("[%1] %2").arg(i+1).arg(label);
             }
@@ -1167,6 +1298,24 @@ FeatureExtractionModelTransformer::addFeature(int n,
             targetModel->add(Event(frame, value, label));
         }
 
+    } else if (isOutputType<DecimatedTimeValueModel>(n)) {
+
+        auto model = ModelById::getAs<DecimatedTimeValueModel>(outputId);
+        if (!model || feature.values.empty()) return;
+
+        // For fixed-rate outputs the feature number is the index,
+        // unless the output rate exceeds the model's
+        sv_frame_t index = model->getIndexForFrame(frame);
+        if (m_descriptors[n].sampleType ==
+            Vamp::Plugin::OutputDescriptor::FixedSampleRate &&
+            m_descriptors[n].sampleRate > 0.0 &&
+            m_descriptors[n].sampleRate <= inputRate &&
+            m_fixedRateFeatureNos[n] >= 0) {
+            index = m_fixedRateFeatureNos[n];
+        }
+
+        model->setValue(index, feature.values[0]);
+
     } else if (isOutputType<NoteModel>(n) || isOutputType<RegionModel>(n)) {
     
         int index = 0;
@@ -1198,19 +1347,21 @@ FeatureExtractionModelTransformer::addFeature(int n,
             noteModel->add(Event(frame, value, // value is pitch
                                  duration,
                                  velocity / 127.f,
-                                 feature.label.c_str()));
+                                 getLabel(feature.label)));
         }
 
         auto regionModel = ModelById::getAs<RegionModel>(outputId);
         if (regionModel) {
             
+            QString featureLabel = getLabel(feature.label);
+
             if (feature.hasDuration && !feature.values.empty()) {
                 
                 for (int i = 0; in_range_for(feature.values, i); ++i) {
                     
                     float value = feature.values[i];
                     
-                    QString label = feature.label.c_str();
+                    QString label = featureLabel;
                     if (feature.values.size() > 1) {
                         label = QString("[%1] %2").arg(i+1).arg(label);
                     }
@@ -1225,7 +1376,7 @@ FeatureExtractionModelTransformer::addFeature(int n,
                 regionModel->add(Event(frame,
                                        value,
                                        duration,
-                                       feature.label.c_str()));
+                                       featureLabel));
             }
         }
 
@@ -1235,14 +1386,17 @@ FeatureExtractionModelTransformer::addFeature(int n,
             <BasicCompressedDenseThreeDimensionalModel>(outputId);
         if (!model) return;
         
-        DenseThreeDimensionalModel::Column values;
-        values.insert(values.begin(),
-                      feature.values.begin(), feature.values.end());
+        // The column has a different allocator from the feature's
+        // values, so this copy is unavoidable, but the model can take
+        // it over rather than copying it again
+        DenseThreeDimensionalModel::Column values(feature.values.begin(),
+                                                  feature.values.end());
         
         if (!feature.hasTimestamp && m_fixedRateFeatureNos[n] >= 0) {
-            model->setColumn(m_fixedRateFeatureNos[n], values);
+            model->setColumn(m_fixedRateFeatureNos[n], std::move(values));
         } else {
-            model->setColumn(int(frame / model->getResolution()), values);
+            model->setColumn(int(frame / model->getResolution()),
+                             std::move(values));
         }
     } else {
         
@@ -1251,6 +1405,25 @@ FeatureExtractionModelTransformer::addFeature(int n,
     }
 }
 
+QString
+FeatureExtractionModelTransformer::getLabel(const std::string &label)
+{
+    // Limit the number of labels kept, in case a plugin returns a
+    // different one for every feature
+    static const size_t maxLabels = 1000;
+
+    auto itr = m_labels.find(label);
+    if (itr != m_labels.end()) {
+        return itr->second;
+    }
+
+    QString converted = QString::fromUtf8(label.c_str());
+    if (m_labels.size() < maxLabels) {
+        m_labels[label] = converted;
+    }
+    return converted;
+}
+
 void
 FeatureExtractionModelTransformer::setCompletion(int n, int completion)
 {
@@ -1262,6 +1435,7 @@ FeatureExtractionModelTransformer::setCompletion(int n, int completion)
     (void)
         (setOutputCompletion<SparseOneDimensionalModel>(n, completion) ||
          setOutputCompletion<SparseTimeValueModel>(n, completion) ||
+         setOutputCompletion<DecimatedTimeValueModel>(n, completion) ||
          setOutputCompletion<NoteModel>(n, completion) ||
          setOutputCompletion<RegionModel>(n, completion) ||
          setOutputCompletion<BasicCompressedDenseThreeDimensionalModel>(n, completion));
@@ -71,6 +71,11 @@ protected:
 
     void createOutputModels(int n);
 
+    // whether to store output n in a DecimatedTimeValueModel rather
+    // than a SparseTimeValueModel ("use-decimated-time-value-model"
+    // setting in the Transformer group)
+    bool shouldUseDecimatedModel(int n, int modelResolution);
+
     // map from transformNo -> necessity
     std::map<int, bool> m_needAdditionalModels;
 
@@ -85,6 +90,12 @@ protected:
                     sv_frame_t blockFrame,
                     const Vamp::Plugin::Feature &feature);
 
+    // Plugin feature labels usually come from a small set (note or
+    // chord names, segment types etc), so we convert each distinct
+    // label to a QString once and then share it between events
+    std::map<std::string, QString> m_labels;
+    QString getLabel(const std::string &label);
+
     void setCompletion(int, int);
 
     void getFrames(int channelCount, sv_frame_t startFrame, sv_frame_t size,
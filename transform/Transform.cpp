@@ -21,15 +21,80 @@
 #include "plugin/RealTimePluginFactory.h"
 
 #include <QXmlAttributes>
-
-#include <QDomDocument>
-#include <QDomElement>
-#include <QDomNamedNodeMap>
-#include <QDomAttr>
+#include <QXmlStreamReader>
+#include <QCryptographicHash>
+#include <QMutex>
+#include <QMutexLocker>
 
 #include <QTextStream>
 
 #include <iostream>
+#include <list>
+
+/**
+ * Set the main transform data from a set of XML attributes, given a
+ * function that returns the value of a named attribute, or an empty
+ * string if it is absent. Used for both QXmlAttributes and
+ * QXmlStreamAttributes. This assigns the members directly, leaving
+ * the caller to update the key once it has finished.
+ */
+template <typename AttributeValue>
+void
+Transform::setFromAttributeValues(AttributeValue value)
+{
+    if (value("id") != "") {
+        m_id = value("id");
+    }
+
+    if (value("pluginVersion") != "") {
+        m_pluginVersion = value("pluginVersion");
+    }
+
+    if (value("program") != "") {
+        m_program = value("program");
+    }
+
+    if (value("stepSize") != "") {
+        m_stepSize = value("stepSize").toInt();
+    }
+
+    if (value("blockSize") != "") {
+        m_blockSize = value("blockSize").toInt();
+    }
+
+    if (value("windowType") != "") {
+        m_windowType = Window<float>::getTypeForName
+            (value("windowType").toStdString());
+    }
+
+    if (value("startTime") != "") {
+        m_startTime = RealTime::fromString(value("startTime").toStdString());
+    }
+
+    if (value("duration") != "") {
+        m_duration = RealTime::fromString(value("duration").toStdString());
+    }
+
+    if (value("sampleRate") != "") {
+        m_sampleRate = value("sampleRate").toFloat();
+    }
+
+    if (value("summaryType") != "") {
+        m_summaryType = stringToSummaryType(value("summaryType"));
+    }
+}
+
+// Transforms already parsed from XML, by their XML. Session files and
+// batch job lists often contain the same definition many times over.
+// When full, the least recently used entry is dropped
+struct ParsedTransform {
+    Transform transform;
+    std::list<QString>::iterator recency;
+};
+static QMutex parsedMutex;
+static QHash<QString, ParsedTransform> parsedTransforms;
+static std::list<QString> parsedRecency; // most recently used first
+static const int maxParsedTransforms = 1000;
 
 Transform::Transform() :
     m_summaryType(NoSummary),
@@ -38,6 +103,7 @@ Transform::Transform() :
     m_windowType(HanningWindow),
     m_sampleRate(0)
 {
+    updateKey();
 }
 
 Transform::Transform(QString xml) :
@@ -47,58 +113,107 @@ Transform::Transform(QString xml) :
     m_windowType(HanningWindow),
     m_sampleRate(0)
 {
-    QDomDocument doc;
-    
-    QString error;
-    int errorLine;
-    int errorColumn;
-
-    if (!doc.setContent(xml, false, &error, &errorLine, &errorColumn)) {
-        m_errorString = QString("%1 at line %2, column %3")
-            .arg(error).arg(errorLine).arg(errorColumn);
-        return;
+    {
+        QMutexLocker locker(&parsedMutex);
+        auto itr = parsedTransforms.find(xml);
+        if (itr != parsedTransforms.end()) {
+            parsedRecency.splice(parsedRecency.begin(), parsedRecency,
+                                 itr->recency);
+            *this = itr->transform;
+            return;
+        }
     }
-    
-    QDomElement transformElt = doc.firstChildElement("transform");
-    QDomNamedNodeMap attrNodes = transformElt.attributes();
-    QXmlAttributes attrs;
 
-    for (int i = 0; i < attrNodes.length(); ++i) {
-        QDomAttr attr = attrNodes.item(i).toAttr();
-        if (!attr.isNull()) attrs.append(attr.name(), "", "", attr.value());
+    parseXml(xml);
+
+    if (m_errorString == "") {
+        QMutexLocker locker(&parsedMutex);
+        if (parsedTransforms.contains(xml)) {
+            // Another thread parsed the same XML meanwhile
+            return;
+        }
+        if (parsedTransforms.size() >= maxParsedTransforms) {
+            parsedTransforms.remove(parsedRecency.back());
+            parsedRecency.pop_back();
+        }
+        parsedRecency.push_front(xml);
+        ParsedTransform parsed;
+        parsed.transform = *this;
+        parsed.recency = parsedRecency.begin();
+        parsedTransforms.insert(xml, parsed);
     }
+}
 
-    setFromXmlAttributes(attrs);
+void
+Transform::parseXml(QString xml)
+{
+    // We only want the attributes of the root transform element and
+    // of its parameter and configuration children, so read them as
+    // they go past rather than building a document
 
-    for (QDomElement paramElt = transformElt.firstChildElement("parameter");
-         !paramElt.isNull();
-         paramElt = paramElt.nextSiblingElement("parameter")) {
+    QXmlStreamReader reader(xml);
+    reader.setNamespaceProcessing(false);
 
-        QDomNamedNodeMap paramAttrs = paramElt.attributes();
+    int depth = 0;
+    bool inTransform = false;
 
-        QDomAttr nameAttr = paramAttrs.namedItem("name").toAttr();
-        if (nameAttr.isNull() || nameAttr.value() == "") continue;
-        
-        QDomAttr valueAttr = paramAttrs.namedItem("value").toAttr();
-        if (valueAttr.isNull() || valueAttr.value() == "") continue;
+    while (!reader.atEnd()) {
 
-        setParameter(nameAttr.value(), valueAttr.value().toFloat());
-    }
+        QXmlStreamReader::TokenType token = reader.readNext();
 
-    for (QDomElement configElt = transformElt.firstChildElement("configuration");
-         !configElt.isNull();
-         configElt = configElt.nextSiblingElement("configuration")) {
+        if (token == QXmlStreamReader::EndElement) {
+            --depth;
+            continue;
+        }
 
-        QDomNamedNodeMap configAttrs = configElt.attributes();
+        if (token != QXmlStreamReader::StartElement) {
+            continue;
+        }
 
-        QDomAttr nameAttr = configAttrs.namedItem("name").toAttr();
-        if (nameAttr.isNull() || nameAttr.value() == "") continue;
-        
-        QDomAttr valueAttr = configAttrs.namedItem("value").toAttr();
-        if (valueAttr.isNull() || valueAttr.value() == "") continue;
+        ++depth;
+
+        QXmlStreamAttributes attrs = reader.attributes();
+
+        if (depth == 1) {
 
-        setConfigurationValue(nameAttr.value(), valueAttr.value());
+            inTransform = (reader.name() == QLatin1String("transform"));
+
+            if (inTransform) {
+                setFromAttributeValues([&](const char *name) {
+                        return attrs.value(name).toString();
+                    });
+            }
+
+        } else if (depth == 2 && inTransform) {
+
+            QString name = attrs.value("name").toString();
+            if (name == "") continue;
+
+            QString value = attrs.value("value").toString();
+            if (value == "") continue;
+
+            if (reader.name() == QLatin1String("parameter")) {
+                m_parameters[name] = value.toFloat();
+            } else if (reader.name() == QLatin1String("configuration")) {
+                m_configuration[name] = value;
+            }
+        }
     }
+
+    if (reader.hasError()) {
+        // Leave nothing half-parsed, as we would if the document
+        // could not be read at all
+        *this = Transform();
+        m_errorString = QString("%1 at line %2, column %3")
+            .arg(reader.errorString())
+            .arg(reader.lineNumber())
+            .arg(reader.columnNumber());
+        return;
+    }
+
+    // Only once everything has been read, rather than for each
+    // attribute and child element as the setters would
+    updateKey();
 }
 
 Transform::~Transform()
@@ -169,10 +284,64 @@ Transform::operator<(const Transform &t) const
     return false;
 }
 
+QString
+Transform::getKey() const
+{
+    return m_key;
+}
+
+void
+Transform::updateKey()
+{
+    // A canonical serialisation of the compared elements, with each
+    // string preceded by its length so that no two distinct sets of
+    // strings can produce the same text
+
+    QString text;
+    QTextStream out(&text);
+
+    auto str = [&](QString s) {
+        out << s.length() << ":" << s << ";";
+    };
+    auto num = [&](double d) {
+        if (d == 0.0) d = 0.0; // not -0
+        out << QString::number(d, 'g', 17) << ";";
+    };
+
+    str(m_id);
+    str(m_program);
+    out << int(m_summaryType) << ";"
+        << m_stepSize << ";"
+        << m_blockSize << ";"
+        << int(m_windowType) << ";"
+        << m_startTime.sec << "," << m_startTime.nsec << ";"
+        << m_duration.sec << "," << m_duration.nsec << ";";
+    num(m_sampleRate);
+
+    out << m_parameters.size() << ";";
+    for (const auto &p: m_parameters) {
+        str(p.first);
+        num(p.second);
+    }
+
+    out << m_configuration.size() << ";";
+    for (const auto &c: m_configuration) {
+        str(c.first);
+        str(c.second);
+    }
+
+    out.flush();
+
+    m_key = QString::fromLatin1
+        (QCryptographicHash::hash(text.toUtf8(),
+                                  QCryptographicHash::Sha1).toHex());
+}
+
 void
 Transform::setIdentifier(TransformId id)
 {
     m_id = id;
+    updateKey();
 }
 
 TransformId
@@ -225,12 +394,14 @@ void
 Transform::setPluginIdentifier(QString pluginIdentifier)
 {
     m_id = pluginIdentifier + ':' + getOutput();
+    updateKey();
 }
 
 void
 Transform::setOutput(QString output)
 {
     m_id = getPluginIdentifier() + ':' + output;
+    updateKey();
 }
 
 TransformId
@@ -250,6 +421,7 @@ void
 Transform::setParameters(const ParameterMap &pm)
 {
     m_parameters = pm;
+    updateKey();
 }
 
 void
@@ -257,6 +429,7 @@ Transform::setParameter(QString name, float value)
 {
 //    SVDEBUG << "Transform::setParameter(" << name//              << ") -> " << value << endl;
     m_parameters[name] = value;
+    updateKey();
 }
 
 const Transform::ConfigurationMap &
@@ -269,6 +442,7 @@ void
 Transform::setConfiguration(const ConfigurationMap &cm)
 {
     m_configuration = cm;
+    updateKey();
 }
 
 void
@@ -276,6 +450,7 @@ Transform::setConfigurationValue(QString name, QString value)
 {
     SVDEBUG << "Transform::setConfigurationValue(" << name              << ") -> " << value << endl;
     m_configuration[name] = value;
+    updateKey();
 }
 
 QString
@@ -300,6 +475,7 @@ void
 Transform::setProgram(QString program)
 {
     m_program = program;
+    updateKey();
 }
 
 Transform::SummaryType
@@ -312,6 +488,7 @@ void
 Transform::setSummaryType(SummaryType type)
 {
     m_summaryType = type;
+    updateKey();
 }
     
 int
@@ -324,6 +501,7 @@ void
 Transform::setStepSize(int s)
 {
     m_stepSize = s;
+    updateKey();
 }
     
 int
@@ -336,6 +514,7 @@ void
 Transform::setBlockSize(int s)
 {
     m_blockSize = s;
+    updateKey();
 }
 
 WindowType
@@ -348,6 +527,7 @@ void
 Transform::setWindowType(WindowType type)
 {
     m_windowType = type;
+    updateKey();
 }
 
 RealTime
@@ -360,6 +540,7 @@ void
 Transform::setStartTime(RealTime t)
 {
     m_startTime = t;
+    updateKey();
 }
 
 RealTime
@@ -372,6 +553,7 @@ void
 Transform::setDuration(RealTime d)
 {
     m_duration = d;
+    updateKey();
 }
     
 sv_samplerate_t
@@ -384,6 +566,7 @@ void
 Transform::setSampleRate(sv_samplerate_t rate)
 {
     m_sampleRate = rate;
+    updateKey();
 }
 
 void
@@ -485,45 +668,9 @@ Transform::summaryTypeToString(SummaryType type)
 void
 Transform::setFromXmlAttributes(const QXmlAttributes &attrs)
 {
-    if (attrs.value("id") != "") {
-        setIdentifier(attrs.value("id"));
-    }
-
-    if (attrs.value("pluginVersion") != "") {
-        setPluginVersion(attrs.value("pluginVersion"));
-    }
-
-    if (attrs.value("program") != "") {
-        setProgram(attrs.value("program"));
-    }
-
-    if (attrs.value("stepSize") != "") {
-        setStepSize(attrs.value("stepSize").toInt());
-    }
-
-    if (attrs.value("blockSize") != "") {
-        setBlockSize(attrs.value("blockSize").toInt());
-    }
-
-    if (attrs.value("windowType") != "") {
-        setWindowType(Window<float>::getTypeForName
-                      (attrs.value("windowType").toStdString()));
-    }
-
-    if (attrs.value("startTime") != "") {
-        setStartTime(RealTime::fromString(attrs.value("startTime").toStdString()));
-    }
-
-    if (attrs.value("duration") != "") {
-        setDuration(RealTime::fromString(attrs.value("duration").toStdString()));
-    }
-    
-    if (attrs.value("sampleRate") != "") {
-        setSampleRate(attrs.value("sampleRate").toFloat());
-    }
-
-    if (attrs.value("summaryType") != "") {
-        setSummaryType(stringToSummaryType(attrs.value("summaryType")));
-    }
+    setFromAttributeValues([&](const char *name) {
+            return attrs.value(name);
+        });
+    updateKey();
 }
 
@@ -23,6 +23,7 @@
 #include <vamp-hostsdk/PluginBase.h>
 
 #include <QString>
+#include <QHash>
 
 #include <map>
 #include <vector>
@@ -48,6 +49,9 @@ public:
      * Construct a Transform by parsing the given XML data string.
      * This is the inverse of toXmlString. If this fails,
      * getErrorString() will return a non-empty string.
+     *
+     * Successfully parsed Transforms are remembered by their XML, so
+     * constructing another from the same string is cheap.
      */
     Transform(QString xml);
 
@@ -65,6 +69,25 @@ public:
      */
     bool operator<(const Transform &) const;
 
+    /**
+     * Return a key summarising every data element that takes part in
+     * comparison with operator==, that is, everything that can affect
+     * the result of running the transform: plugin identifier and
+     * output, parameters, configuration, program, summary type, step
+     * and block size, window type, start time, duration and sample
+     * rate. (The plugin version does not take part.) Two Transforms
+     * that compare equal have the same key, and two that do not will
+     * in practice never do so.
+     *
+     * The key is a fixed-length hex string, suitable for grouping
+     * and deduplicating transforms or for naming cached results. It
+     * is recalculated whenever the Transform is modified, so this
+     * only returns a stored value: it is cheap to call often, and
+     * safe to call from several threads at once, like the other
+     * const methods.
+     */
+    QString getKey() const;
+
     void setIdentifier(TransformId id);
     TransformId getIdentifier() const;
 
@@ -199,8 +222,20 @@ protected:
     RealTime m_duration;
     sv_samplerate_t m_sampleRate;
     QString m_errorString;
+
+    QString m_key;
+    void updateKey();
+
+    void parseXml(QString xml);
+
+    template <typename AttributeValue>
+    void setFromAttributeValues(AttributeValue value);
 };
 
+inline uint qHash(const Transform &t, uint seed = 0) {
+    return qHash(t.getKey(), seed);
+}
+
 typedef std::vector<Transform> Transforms;
 
 #endif
@@ -0,0 +1,199 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+    
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef TEST_TRANSFORM_H
+#define TEST_TRANSFORM_H
+
+#include "../Transform.h"
+
+#include <QObject>
+#include <QtTest>
+#include <QXmlAttributes>
+
+#include <functional>
+#include <vector>
+
+using namespace std;
+
+class TestTransform : public QObject
+{
+    Q_OBJECT
+
+    // A transform with every compared element set to something
+    // other than its default, including text that needs escaping
+    static Transform makeTransform() {
+        Transform t;
+        t.setIdentifier("vamp:test-plugins:test:output");
+        t.setPluginVersion("3");
+        t.setProgram("Program <\"one\"> & two");
+        t.setStepSize(256);
+        t.setBlockSize(1024);
+        t.setWindowType(HammingWindow);
+        t.setStartTime(RealTime(1, 500000000));
+        t.setDuration(RealTime(10, 0));
+        t.setSampleRate(22050);
+        t.setSummaryType(Transform::Mean);
+        t.setParameter("threshold", 0.25f);
+        t.setParameter("size", -3.f);
+        t.setConfigurationValue("mode", "a&b <c>");
+        t.setConfigurationValue("other", "x");
+        return t;
+    }
+
+private slots:
+    void roundTrip() {
+        Transform t = makeTransform();
+        QString xml = t.toXmlString();
+        Transform u(xml);
+        QCOMPARE(u.getErrorString(), QString());
+        QVERIFY(u == t);
+        QCOMPARE(u.getKey(), t.getKey());
+        QCOMPARE(u.getPluginVersion(), t.getPluginVersion());
+        QCOMPARE(u.getProgram(), t.getProgram());
+        QCOMPARE(u.toXmlString(), xml);
+
+        // Again, which comes from the cache of parsed transforms
+        Transform v(xml);
+        QVERIFY(v == t);
+        QCOMPARE(v.getKey(), t.getKey());
+
+        // An empty transform also round-trips
+        Transform e;
+        Transform f(e.toXmlString());
+        QCOMPARE(f.getErrorString(), QString());
+        QVERIFY(f == e);
+        QCOMPARE(f.getKey(), e.getKey());
+    }
+
+    void manyParsed() {
+        // More distinct transforms than the parse cache holds,
+        // interleaved with repeats of the first, which should
+        // always come back intact
+        Transform first = makeTransform();
+        QString firstXml = first.toXmlString();
+        for (int i = 0; i < 2500; ++i) {
+            Transform t = makeTransform();
+            t.setStepSize(i + 1);
+            Transform u(t.toXmlString());
+            QVERIFY(u == t);
+            if (i % 100 == 0) {
+                Transform v(firstXml);
+                QVERIFY(v == first);
+            }
+        }
+        Transform t = makeTransform();
+        t.setStepSize(1);
+        Transform u(t.toXmlString());
+        QVERIFY(u == t);
+        QCOMPARE(u.getKey(), t.getKey());
+    }
+
+    void malformed() {
+        Transform empty;
+        vector<QString> bad {
+            "<transform id=\"vamp:a:b:c\"",
+            "<transform id=\"vamp:a:b:c\" stepSize=\"256\"><parameter name=\"x\" value=\"1\"/>",
+            "<transform id=\"vamp:a:b:c\"></other>",
+            "<transform id=\"vamp:a:b:c\" id=\"vamp:d:e:f\"/>",
+            "<transform id=vamp:a:b:c/>"
+        };
+        for (auto xml: bad) {
+            Transform t(xml);
+            QVERIFY(t.getErrorString() != "");
+            // Nothing half-parsed is kept
+            QVERIFY(t == empty);
+            QCOMPARE(t.getKey(), empty.getKey());
+            QCOMPARE(t.getStepSize(), 0);
+            QVERIFY(t.getParameters().empty());
+            // and failures are not remembered as successes
+            Transform again(xml);
+            QVERIFY(again.getErrorString() != "");
+        }
+    }
+
+    void keyMatchesEquality() {
+        Transform a = makeTransform(), b = makeTransform();
+        QVERIFY(a == b);
+        QCOMPARE(a.getKey(), b.getKey());
+        QCOMPARE(a.getKey().length(), 40);
+
+        // The plugin version is not compared, and not in the key
+        b.setPluginVersion("4");
+        QVERIFY(a == b);
+        QCOMPARE(a.getKey(), b.getKey());
+
+        // Each compared element changes both
+        vector<function<void(Transform &)>> changes {
+            [](Transform &t) { t.setIdentifier("vamp:test-plugins:test:other"); },
+            [](Transform &t) { t.setProgram("Program two"); },
+            [](Transform &t) { t.setStepSize(512); },
+            [](Transform &t) { t.setBlockSize(2048); },
+            [](Transform &t) { t.setWindowType(HanningWindow); },
+            [](Transform &t) { t.setStartTime(RealTime(1, 0)); },
+            [](Transform &t) { t.setDuration(RealTime(9, 0)); },
+            [](Transform &t) { t.setSampleRate(44100); },
+            [](Transform &t) { t.setSummaryType(Transform::Median); },
+            [](Transform &t) { t.setParameter("threshold", 0.5f); },
+            [](Transform &t) { t.setParameter("extra", 0.f); },
+            [](Transform &t) { t.setParameters({}); },
+            [](Transform &t) { t.setConfigurationValue("mode", "a&b"); },
+            [](Transform &t) { t.setConfiguration({}); }
+        };
+        for (const auto &change: changes) {
+            Transform c = makeTransform();
+            change(c);
+            QVERIFY(!(c == a));
+            QVERIFY(c.getKey() != a.getKey());
+            // Applying the same change to another copy agrees
+            Transform d = makeTransform();
+            change(d);
+            QVERIFY(c == d);
+            QCOMPARE(c.getKey(), d.getKey());
+        }
+
+        // Strings that would run together without their lengths
+        Transform p, q;
+        p.setConfigurationValue("ab", "c");
+        q.setConfigurationValue("a", "bc");
+        QVERIFY(!(p == q));
+        QVERIFY(p.getKey() != q.getKey());
+
+        // Changing back restores the key
+        Transform r = makeTransform();
+        r.setStepSize(1);
+        r.setStepSize(256);
+        QVERIFY(r == a);
+        QCOMPARE(r.getKey(), a.getKey());
+
+        // and equal transforms hash equally
+        QCOMPARE(qHash(r), qHash(a));
+    }
+
+    void keyFromAttributes() {
+        // Attributes are assigned without going through the setters,
+        // so the key must still be brought up to date afterwards
+        Transform t = makeTransform();
+        QXmlAttributes attrs;
+        attrs.append("stepSize", "", "stepSize", "512");
+        attrs.append("summaryType", "", "summaryType", "median");
+        Transform u = t;
+        u.setFromXmlAttributes(attrs);
+        t.setStepSize(512);
+        t.setSummaryType(Transform::Median);
+        QVERIFY(u == t);
+        QCOMPARE(u.getKey(), t.getKey());
+    }
+};
+
+#endif
@@ -0,0 +1,5 @@
+TEST_HEADERS = \
+	     TestTransform.h
+
+TEST_SOURCES += \
+	     svcore-transform-test.cpp